@@ -5,7 +5,7 @@
 TEMPLATE = vcapp
 TARGET   = NifSkope
 
-QT += xml opengl network widgets
+QT += xml opengl network widgets concurrent
 
 # Require Qt 5.7 or higher
 contains(QT_VERSION, ^5\\.[0-6]\\..*) {
@@ -140,6 +140,7 @@ INCLUDEPATH += src lib
 
 HEADERS += \
 	src/data/nifitem.h \
+	src/data/nifpool.h \
 	src/data/niftypes.h \
 	src/data/nifvalue.h \
 	src/gl/marker/constraints.h \
@@ -156,18 +157,30 @@ HEADERS += \
 	src/gl/glscene.h \
 	src/gl/glshape.h \
 	src/gl/gltex.h \
+	src/gl/gltexdecode.h \
+	src/gl/gltexdiskcache.h \
+	src/gl/gltexindex.h \
 	src/gl/gltexloaders.h \
 	src/gl/gltools.h \
 	src/gl/icontrollable.h \
 	src/gl/renderer.h \
 	src/io/material.h \
+	src/io/MeshDecode.h \
 	src/io/MeshFile.h \
 	src/io/nifstream.h \
 	src/lib/importex/3ds.h \
+	src/lib/bonepacking.h \
+	src/lib/convexdecomposition.h \
+	src/lib/meshoptimize.h \
+	src/lib/meshsimplify.h \
+	src/lib/moppbuilder.h \
+	src/lib/nifmopp.h \
 	src/lib/nvtristripwrapper.h \
 	src/lib/qhull.h \
+	src/lib/vertexweld.h \
 	src/model/basemodel.h \
 	src/model/kfmmodel.h \
+	src/model/meshstreams.h \
 	src/model/nifmodel.h \
 	src/model/nifproxymodel.h \
 	src/model/undocommands.h \
@@ -216,6 +229,7 @@ HEADERS += \
 
 SOURCES += \
 	src/data/nifitem.cpp \
+	src/data/nifpool.cpp \
 	src/data/niftypes.cpp \
 	src/data/nifvalue.cpp \
 	src/gl/BSMesh.cpp \
@@ -230,10 +244,14 @@ SOURCES += \
 	src/gl/glscene.cpp \
 	src/gl/glshape.cpp \
 	src/gl/gltex.cpp \
+	src/gl/gltexdecode.cpp \
+	src/gl/gltexdiskcache.cpp \
+	src/gl/gltexindex.cpp \
 	src/gl/gltexloaders.cpp \
 	src/gl/gltools.cpp \
 	src/gl/renderer.cpp \
 	src/io/material.cpp \
+	src/io/MeshDecode.cpp \
 	src/io/MeshFile.cpp \
 	src/io/nifstream.cpp \
 	src/lib/importex/3ds.cpp \
@@ -241,10 +259,18 @@ SOURCES += \
 	src/lib/importex/obj.cpp \
 	src/lib/importex/col.cpp \
 	src/lib/importex/gltf.cpp \
+	src/lib/bonepacking.cpp \
+	src/lib/convexdecomposition.cpp \
+	src/lib/meshoptimize.cpp \
+	src/lib/meshsimplify.cpp \
+	src/lib/moppbuilder.cpp \
+	src/lib/nifmopp.cpp \
 	src/lib/nvtristripwrapper.cpp \
 	src/lib/qhull.cpp \
+	src/lib/vertexweld.cpp \
 	src/model/basemodel.cpp \
 	src/model/kfmmodel.cpp \
+	src/model/meshstreams.cpp \
 	src/model/nifdelegate.cpp \
 	src/model/nifmodel.cpp \
 	src/model/nifproxymodel.cpp \
@@ -266,12 +292,14 @@ SOURCES += \
 	src/spells/normals.cpp \
 	src/spells/optimize.cpp \
 	src/spells/sanitize.cpp \
+	src/spells/simplify.cpp \
 	src/spells/skeleton.cpp \
 	src/spells/stringpalette.cpp \
 	src/spells/strippify.cpp \
 	src/spells/tangentspace.cpp \
 	src/spells/texture.cpp \
 	src/spells/transform.cpp \
+	src/spells/vertexformat.cpp \
 	src/ui/widgets/colorwheel.cpp \
 	src/ui/widgets/fileselect.cpp \
 	src/ui/widgets/floatedit.cpp \
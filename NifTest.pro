@@ -0,0 +1,44 @@
+###############################
+## NifTest
+###############################
+# Checks and benchmarks for the NifSkope sources, see test/niftest.h
+#
+# Usage:
+#    qmake NifTest.pro && make
+#    NifTest --help
+#
+# Builds everything NifSkope.pro builds, including the post link copy
+# of nif.xml next to the executable, with test/ providing main().
+
+include(NifSkope.pro)
+
+TARGET = NifTest
+
+DEFINES += NIFSKOPE_TEST
+
+CONFIG += console
+CONFIG -= app_bundle
+
+win32:LIBS += -lpsapi
+
+HEADERS += \
+	test/niftest.h
+
+SOURCES += \
+	test/conditiontest.cpp \
+	test/fieldtest.cpp \
+	test/lazytest.cpp \
+	test/meshdecodetest.cpp \
+	test/meshoptimizetest.cpp \
+	test/meshsimplifytest.cpp \
+	test/mopptest.cpp \
+	test/niftest.cpp \
+	test/pooltest.cpp \
+	test/removetest.cpp \
+	test/roundtriptest.cpp \
+	test/texdecodetest.cpp \
+	test/undotest.cpp \
+	test/valuetest.cpp \
+	test/weldtest.cpp
+
+# vim: set filetype=config : 
@@ -658,26 +658,12 @@ bool BSA::fileContents( const QString & fn, QByteArray & content )
 					// Start at 1st chunk now
 					for ( int i = 0; i < file->tex.chunks.count(); i++ ) {
 						const F4TexChunk & chunk = file->tex.chunks[i];
-						if ( bsa.seek( chunk.offset ) ) {
-							QByteArray chunkData;
-
-							if ( chunk.packedSize > 0 ) {
-								chunkData.resize( chunk.packedSize );
-								if ( bsa.read( chunkData.data(), chunk.packedSize ) == chunk.packedSize ) {
-									chunkData = gUncompress( chunkData, chunk.packedSize );
-
-									if ( chunkData.size() != chunk.unpackedSize )
-										qCritical() << "Size does not match at " << chunk.offset;
-								}
-							} else if ( !(bsa.read( chunkData.data(), chunk.unpackedSize ) == chunk.unpackedSize) ) {
-								qCritical() << "Size does not match at " << chunk.offset;
-							}
+						QByteArray chunkData;
+						if ( readTextureChunk( chunk, chunkData ) ) {
 							texSize += chunk.unpackedSize;
 
 							content.append( chunkData );
 							//Q_ASSERT( content.size() - hdrSize == texSize );
-						} else {
-							qCritical() << "Seek error";
 						}
 					}
 
@@ -690,6 +676,75 @@ bool BSA::fileContents( const QString & fn, QByteArray & content )
 	return false;
 }
 
+// see bsa.h
+bool BSA::fileRange( const QString & fn, qint64 offset, qint64 length, QByteArray & content )
+{
+	const BSAFile * file = getFile( fn );
+	if ( !file || file->tex.chunks.count() || offset < 0 || length < 0 )
+		return false;
+
+	bool compressed = (file->sizeFlags > 0) ? (file->compressed() ^ compressToggle) : (file->packedLength > 0);
+	if ( compressed )
+		return false;
+
+	QMutexLocker lock( &bsaMutex );
+
+	qint64 start = file->offset;
+	qint64 filesz = file->size();
+	if ( namePrefix ) {
+		quint8 len;
+		if ( !bsa.seek( start ) || bsa.read( (char *)&len, 1 ) != 1 )
+			return false;
+		start += len + 1;
+		filesz -= len + 1;
+	}
+
+	if ( offset + length > filesz )
+		return false;
+
+	content.resize( int( length ) );
+	return bsa.seek( start + offset ) && bsa.read( content.data(), length ) == length;
+}
+
+// see bsa.h
+bool BSA::textureChunk( const QString & fn, int chunk, QByteArray & content )
+{
+	const BSAFile * file = getFile( fn );
+	if ( !file || chunk < 0 || chunk >= file->tex.chunks.count() )
+		return false;
+
+	QMutexLocker lock( &bsaMutex );
+	return readTextureChunk( file->tex.chunks.at( chunk ), content );
+}
+
+bool BSA::readTextureChunk( const F4TexChunk & chunk, QByteArray & content )
+{
+	if ( !bsa.seek( chunk.offset ) ) {
+		qCritical() << "Seek error";
+		return false;
+	}
+
+	if ( chunk.packedSize > 0 ) {
+		content.resize( chunk.packedSize );
+		if ( bsa.read( content.data(), chunk.packedSize ) != chunk.packedSize ) {
+			qCritical() << "Size does not match at " << chunk.offset;
+			return false;
+		}
+		content = gUncompress( content, chunk.packedSize );
+	} else {
+		content.resize( chunk.unpackedSize );
+		if ( bsa.read( content.data(), chunk.unpackedSize ) != chunk.unpackedSize ) {
+			qCritical() << "Size does not match at " << chunk.offset;
+			return false;
+		}
+	}
+
+	if ( content.size() != int( chunk.unpackedSize ) )
+		qCritical() << "Size does not match at " << chunk.offset;
+
+	return true;
+}
+
 // see bsa.h
 QString BSA::getAbsoluteFilePath( const QString & fn ) const
 {
@@ -838,6 +893,7 @@ bool BSA::scan( const BSA::BSAFolder * folder, QStandardItem * item, QString pat
 				auto fileItem = new QStandardItem( it.key() );
 				auto pathItem = new QStandardItem( fullpath );
 				auto sizeItem = new QStandardItem( filesize );
+				sizeItem->setData( bytes, BSAModel::SortRole );
 
 				folderItem->appendRow( { fileItem, pathItem, sizeItem } );
 			}
@@ -861,8 +917,8 @@ BSAModel::BSAModel( QObject * parent )
 
 void BSAModel::init()
 {
-	setColumnCount( 3 );
-	setHorizontalHeaderLabels( { "File", "Path", "Size" } );
+	setColumnCount( NumColumns );
+	setHorizontalHeaderLabels( { "File", "Path", "Size", "Format", "Dimensions", "Mipmaps" } );
 }
 
 Qt::ItemFlags BSAModel::flags( const QModelIndex & index ) const
@@ -942,5 +998,11 @@ bool BSAProxyModel::lessThan( const QModelIndex & left, const QModelIndex & righ
 	if ( leftChild.isValid() && !rightChild.isValid() )
 		return true;
 
+	// Numeric columns
+	QVariant leftKey = sourceModel()->data( left, BSAModel::SortRole );
+	QVariant rightKey = sourceModel()->data( right, BSAModel::SortRole );
+	if ( leftKey.isValid() && rightKey.isValid() )
+		return leftKey.toLongLong() < rightKey.toLongLong();
+
 	return leftString < rightString;
 }
@@ -269,6 +269,24 @@ public:
 	* \return True if successful
 	*/
 	bool fileContents( const QString &, QByteArray & ) override final;
+	//! Reads part of a file without extracting the rest
+	/*!
+	* Only possible for files stored uncompressed, other files must be read with fileContents().
+	* \param fn The filename to read from
+	* \param offset The offset of the first byte to read
+	* \param length The number of bytes to read
+	* \param content Reference to the byte array that holds the bytes read
+	* \return True if successful, false if the file is compressed or too small
+	*/
+	bool fileRange( const QString & fn, qint64 offset, qint64 length, QByteArray & content );
+	//! Reads and decompresses a single chunk of a Fallout 4 texture, without the DDS header
+	/*!
+	* \param fn The filename of the texture
+	* \param chunk The index into BSAFile::tex chunks
+	* \param content Reference to the byte array that holds the chunk data
+	* \return True if successful
+	*/
+	bool textureChunk( const QString & fn, int chunk, QByteArray & content );
 	
 	//! See QFileInfo::ownerId().
 	uint ownerId( const QString & ) const override final;
@@ -338,6 +356,8 @@ public:
 	bool fillModel( BSAModel *, const QString & );
 
 protected:
+	//! Reads a Fallout 4 texture chunk, the caller must hold bsaMutex
+	bool readTextureChunk( const F4TexChunk & chunk, QByteArray & content );
 	
 	//! The %BSA file
 	QFile bsa;
@@ -386,6 +406,20 @@ class BSAModel : public QStandardItemModel
 public:
 	BSAModel( QObject * parent = nullptr );
 
+	enum Columns
+	{
+		FileCol,
+		PathCol,
+		SizeCol,
+		FormatCol,
+		DimensionsCol,
+		MipmapsCol,
+		NumColumns
+	};
+
+	//! Numeric sort key of a column, if it has one
+	static const int SortRole = Qt::UserRole + 1;
+
 	void init();
 
 	Qt::ItemFlags flags( const QModelIndex & index ) const override;
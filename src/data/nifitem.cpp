@@ -33,6 +33,158 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "nifitem.h"
 #include "model/basemodel.h"
 
+#include <algorithm>
+
+
+/*
+ *  NifFieldTable
+ */
+
+// FNV-1a over the UTF-16 code units, so both string forms hash alike
+uint NifFieldTable::hash( const QString & name )
+{
+	uint h = 2166136261u;
+	const ushort * c = name.utf16();
+	for ( int i = 0; i < name.size(); i++ ) {
+		h ^= c[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+uint NifFieldTable::hash( const QLatin1String & name )
+{
+	uint h = 2166136261u;
+	const char * c = name.data();
+	for ( int i = 0; i < name.size(); i++ ) {
+		h ^= uchar( c[i] );
+		h *= 16777619u;
+	}
+	return h;
+}
+
+void NifFieldTable::append( const Row & row )
+{
+	pending.append( row );
+
+	int i = building.value( row.name, -1 );
+	if ( i < 0 ) {
+		i = fields.count();
+		building.insert( row.name, i );
+
+		Field f;
+		f.hash = hash( row.name );
+		f.name = row.name;
+		fields.append( f );
+	}
+
+	fields[i].rows.append( ushort( count++ ) );
+}
+
+void NifFieldTable::finalize()
+{
+	const int numRows = pending.count();
+
+	// Rows referring to each name, and rows depending on every sibling
+	QHash<QString, QVector<ushort>> refBy;
+	QVector<ushort> outerRows;
+	for ( int i = 0; i < numRows; i++ ) {
+		for ( const QString & ref : pending[i].refs ) {
+			QVector<ushort> & rows = refBy[ref];
+			if ( rows.isEmpty() || rows.last() != i )
+				rows.append( ushort( i ) );
+		}
+		if ( pending[i].outer )
+			outerRows.append( ushort( i ) );
+	}
+
+	// The rows each row invalidates directly. Besides the parsed references these include
+	// what the substring scan of NifModel::invalidateDependentConditions invalidates, so
+	// that the table never invalidates less than the scan: the later rows whose cond or arg
+	// contains the name, and the later structs.
+	QVector<QVector<ushort>> direct( numRows );
+	for ( int i = 0; i < numRows; i++ ) {
+		const QString & name = pending[i].name;
+		QVector<ushort> & rows = direct[i];
+		rows = refBy.value( name ) + outerRows;
+		for ( int j = i + 1; j < numRows; j++ ) {
+			const Row & r = pending[j];
+			if ( r.compound || r.cond.contains( name ) || r.arg.contains( name ) )
+				rows.append( ushort( j ) );
+		}
+	}
+
+	// Follow them transitively, a row whose condition changes may hide or show
+	// a field that the conditions of further rows depend on in turn
+	rowDependents.resize( numRows );
+	QVector<bool> visited( numRows );
+	for ( int i = 0; i < numRows; i++ ) {
+		visited.fill( false );
+		visited[i] = true;
+
+		QVector<ushort> & deps = rowDependents[i];
+		QVector<ushort> queue { ushort( i ) };
+		while ( !queue.isEmpty() ) {
+			ushort q = queue.takeLast();
+			for ( ushort r : direct[q] ) {
+				if ( visited[r] )
+					continue;
+
+				visited[r] = true;
+				deps.append( r );
+				queue.append( r );
+			}
+		}
+
+		std::sort( deps.begin(), deps.end() );
+	}
+
+	pending.clear();
+	building.clear();
+	std::sort( fields.begin(), fields.end(), []( const Field & a, const Field & b ) {
+		return a.hash < b.hash;
+	} );
+}
+
+const QVector<ushort> & NifFieldTable::dependents( int row ) const
+{
+	static const QVector<ushort> none;
+	if ( row < 0 || row >= rowDependents.count() )
+		return none;
+
+	return rowDependents.at( row );
+}
+
+template <typename S> const NifFieldTable::Field * NifFieldTable::findImpl( const S & name ) const
+{
+	uint h = hash( name );
+	auto it = std::lower_bound( fields.cbegin(), fields.cend(), h, []( const Field & f, uint value ) {
+		return f.hash < value;
+	} );
+
+	for ( ; it != fields.cend() && it->hash == h; ++it ) {
+		if ( it->name == name )
+			return &(*it);
+	}
+
+	return nullptr;
+}
+
+const NifFieldTable::Field * NifFieldTable::find( const QString & name ) const
+{
+	return findImpl( name );
+}
+
+const NifFieldTable::Field * NifFieldTable::find( const QLatin1String & name ) const
+{
+	return findImpl( name );
+}
+
+
+/*
+ *  NifItem
+ */
+
 bool NifItem::isDescendantOf( const NifItem * testAncestor ) const
 {
 	if ( testAncestor ) {
@@ -175,6 +327,22 @@ void NifItem::updateLinkCache( int iStartChild, bool bDoCleanup )
 	}
 }
 
+NifItem * NifItem::clone( BaseModel * model, NifItem * parent ) const
+{
+	NifItem * item = new NifItem( model, itemData, parent );
+	item->linkRows = linkRows;
+	item->linkAncestorRows = linkAncestorRows;
+
+	item->childItems.reserve( childItems.count() );
+	for ( const NifItem * c : childItems ) {
+		NifItem * copy = c->clone( model, item );
+		copy->rowIdx = c->rowIdx;
+		item->childItems.append( copy );
+	}
+
+	return item;
+}
+
 void NifItem::onParentItemChange()
 {
 	parentModel     = parentItem->parentModel;
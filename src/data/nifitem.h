@@ -33,16 +33,92 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef NIFITEM_H
 #define NIFITEM_H
 
+#include "data/nifpool.h"
 #include "data/nifvalue.h"
 #include "xml/nifexpr.h"
 
 #include <QSharedData> // Inherited
+#include <QHash>
 #include <QPointer>
 #include <QString>
 #include <QVector>
 
+#include <memory>
 
-//! @file nifitem.h NifItem, NifBlock, NifData, NifSharedData
+
+//! @file nifitem.h NifItem, NifBlock, NifData, NifSharedData, NifFieldTable
+
+/*! Rows of the named fields of a block or compound type
+ *
+ * Built for every niobject and struct after nif.xml is parsed. Items of the type share
+ * the table through their NifData, so a child can be found by name with one hash lookup
+ * instead of a scan over its siblings.
+ *
+ * The table also records which rows have a cond or arg referring to each field, so that
+ * editing a field invalidates the conditions it may change without scanning its siblings.
+ */
+class NifFieldTable final
+{
+public:
+	//! A field name and its rows, a name repeats for fields of different versions
+	struct Field
+	{
+		uint hash = 0;
+		QString name;
+		QVector<ushort> rows;
+	};
+
+	//! A row as NifModel::insertType creates it
+	struct Row
+	{
+		QString name;
+		//! The cond and arg as written in nif.xml
+		QString cond, arg;
+		//! The sibling names the cond and arg refer to
+		QStringList refs;
+		//! Whether conditions inside the field may refer to its siblings
+		bool outer = false;
+		//! Whether the field is a struct, or a template that may be one
+		bool compound = false;
+	};
+
+	//! Add a field at the next row
+	void append( const Row & row );
+	//! Sort the fields for lookup and resolve the dependents, call after the last append()
+	void finalize();
+
+	//! The number of child rows an item of this type has
+	int rowCount() const { return count; }
+
+	//! Find a field by name, nullptr if the type has no such field
+	const Field * find( const QString & name ) const;
+	//! Find a field by name, nullptr if the type has no such field
+	const Field * find( const QLatin1String & name ) const;
+
+	//! Hash of a field name, equal for the QString and QLatin1String forms of a name
+	static uint hash( const QString & name );
+	//! Hash of a field name, equal for the QString and QLatin1String forms of a name
+	static uint hash( const QLatin1String & name );
+
+	//! Rows whose conditions may change when the field at @p row changes, directly or through other fields
+	const QVector<ushort> & dependents( int row ) const;
+
+private:
+	template <typename S> const Field * findImpl( const S & name ) const;
+
+	int count = 0;
+	//! Sorted by hash
+	QVector<Field> fields;
+	//! Dependent rows of each row, sorted
+	QVector<QVector<ushort>> rowDependents;
+
+	//! Index of each name in fields while the table is being built
+	QHash<QString, int> building;
+	//! The rows while the table is being built
+	QVector<Row> pending;
+};
+
+using NifFieldTablePtr = std::shared_ptr<const NifFieldTable>;
 
 /*! Shared data for NifData.
  *
@@ -117,6 +193,8 @@ private:
 	QString vercond;
 	//! Version condition as an expression.
 	NifExpr verexpr;
+	//! Fields of the block or compound type of the data.
+	NifFieldTablePtr fields;
 
 	DataFlags flags = None;
 };
@@ -169,6 +247,8 @@ public:
 	inline const QString & vercond() const { return d->vercond; }
 	//! Get the version condition attribute of the data, as an expression.
 	inline const NifExpr & verexpr() const { return d->verexpr; }
+	//! Get the field table of the data's block or compound type, if any.
+	inline const NifFieldTablePtr & fieldTable() const { return d->fields; }
 
 	//! Get the abstract attribute of the data.
 	inline bool isAbstract() const { return d->flags & NifSharedData::Abstract; }
@@ -227,6 +307,8 @@ public:
 		d->vercond = cond;
 		d->verexpr = NifExpr( cond );
 	}
+	//! Sets the field table of the data's block or compound type.
+	void setFieldTable( const NifFieldTablePtr & fields ) { d->fields = fields; }
 
 	inline void setFlag( NifSharedData::DataFlags flag, bool val )
 	{
@@ -314,6 +396,8 @@ struct NifBlock
 	bool abstract = false;
 	//! Data present.
 	QList<NifData> types;
+	//! Rows of the fields, including those of the ancestors.
+	NifFieldTablePtr fields;
 };
 
 //! An item which contains NifData
@@ -333,6 +417,10 @@ public:
 		qDeleteAll( childItems );
 	}
 
+	//! Items are allocated from NifPool
+	static void * operator new( size_t size ) { return NifPool::allocate( size ); }
+	static void operator delete( void * p, size_t size ) { NifPool::deallocate( p, size ); }
+
 	//! Return the parent model.
 	const BaseModel * model() const { return parentModel; }
 
@@ -473,6 +561,17 @@ public:
 		return -1;
 	}
 
+	/*! Copy the item and all its children
+	 *
+	 * The copies share the NifData of the originals and the implicitly shared parts of their
+	 * values, e.g. strings and byte arrays. Cached conditions are not copied.
+	 *
+	 * @param model		The model the copy belongs to
+	 * @param parent	The parent of the copy
+	 * @return			The copy, owned by the caller until it is inserted
+	 */
+	NifItem * clone( BaseModel * model, NifItem * parent ) const;
+
 	/*! Take child item at row
 	 *
 	 * @param row	The row to take the item from
@@ -583,6 +682,16 @@ public:
 		}
 	}
 
+	//! Invalidate the cached cond and vercond expressions in the item and all its children, cached or not
+	void resetConditions()
+	{
+		conditionStatus = -1;
+		vercondStatus = -1;
+
+		for ( NifItem * c : childItems )
+			c->resetConditions();
+	}
+
 private:
 	//! Invalidate the cached at index
 	void invalidateRow() { rowIdx = -1; }
@@ -630,6 +739,8 @@ public:
 	inline quint32 ver2() const { return itemData.ver2(); }
 	//! Return the description text of the data
 	inline const QString & text() const { return itemData.text(); }
+	//! Return the field table of the item's block or compound type, if any
+	inline const NifFieldTablePtr & fieldTable() const { return itemData.fieldTable(); }
 
 	//! Return the condition attribute of the data, as an expression
 	inline const NifExpr & argexpr() const { return itemData.argexpr(); }
@@ -677,6 +788,8 @@ public:
 
 	//! Set the name
 	inline void setName( const QString & name ) {   itemData.setName( name );   }
+	//! Set the field table of the item's type
+	inline void setFieldTable( const NifFieldTablePtr & fields ) { itemData.setFieldTable( fields ); }
 	//! Set the string type
 	inline void setStrType( const QString & type ) { itemData.setType( type ); }
 	//! Set the template type
@@ -0,0 +1,329 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#include "nifpool.h"
+
+#include <QMutex>
+
+#include <atomic>
+#include <new>
+
+
+//! @file nifpool.cpp NifPool
+
+namespace
+{
+	constexpr size_t granularity = 16;
+	constexpr int classCount = int( NifPool::maxPooledSize / granularity );
+	//! Slabs are aligned to their size, so a chunk finds its slab by masking its address
+	constexpr size_t slabSize = 64 * 1024;
+	//! Chunks moved between a thread and the shared lists at a time
+	constexpr int batchSize = 64;
+	//! Free chunks a thread may hold per class before handing them back
+	constexpr int maxCached = 8192;
+
+	struct FreeNode
+	{
+		FreeNode * next;
+	};
+
+	inline int sizeClass( size_t size )
+	{
+		return int( ( ( size ? size : 1 ) + granularity - 1 ) / granularity ) - 1;
+	}
+
+	inline size_t classSize( int c )
+	{
+		return size_t( c + 1 ) * granularity;
+	}
+
+	//! Header at the start of each slab; a slab serves one size class
+	struct alignas(64) Slab
+	{
+		//! Neighbors in the list of slabs with room, of the same class
+		Slab * prev = nullptr;
+		Slab * next = nullptr;
+		bool listed = false;
+		//! Chunks given back to the slab
+		FreeNode * free = nullptr;
+		//! Start of the part never handed out
+		char * cursor = nullptr;
+		char * end = nullptr;
+		//! Chunks handed out, including those waiting in thread lists
+		int used = 0;
+	};
+
+	inline Slab * slabOf( void * p )
+	{
+		return reinterpret_cast<Slab *>( quintptr( p ) & ~quintptr( slabSize - 1 ) );
+	}
+
+	//! Slabs with room, per class; guarded by mutex
+	struct Shared
+	{
+		QMutex mutex;
+		Slab * slabs[classCount] = {};
+	};
+
+	//! Intentionally never destroyed, items may still be freed during static destruction
+	Shared & shared()
+	{
+		static Shared * s = new Shared;
+		return *s;
+	}
+
+	std::atomic<qint64> allocCount{ 0 };
+	std::atomic<qint64> freeCount{ 0 };
+	std::atomic<qint64> inUse{ 0 };
+	std::atomic<qint64> reserved{ 0 };
+	std::atomic<qint64> largeCount{ 0 };
+
+	void link( Shared & s, int c, Slab * slab )
+	{
+		slab->prev = nullptr;
+		slab->next = s.slabs[c];
+		if ( slab->next )
+			slab->next->prev = slab;
+		s.slabs[c] = slab;
+		slab->listed = true;
+	}
+
+	void unlink( Shared & s, int c, Slab * slab )
+	{
+		if ( slab->prev )
+			slab->prev->next = slab->next;
+		else
+			s.slabs[c] = slab->next;
+		if ( slab->next )
+			slab->next->prev = slab->prev;
+		slab->prev = slab->next = nullptr;
+		slab->listed = false;
+	}
+
+	//! Take one chunk of class @p c from a slab, with the mutex held
+	FreeNode * takeLocked( Shared & s, int c )
+	{
+		const size_t size = classSize( c );
+
+		Slab * slab = s.slabs[c];
+		if ( !slab ) {
+			slab = new ( ::operator new( slabSize, std::align_val_t( slabSize ) ) ) Slab;
+			slab->cursor = reinterpret_cast<char *>( slab ) + sizeof( Slab );
+			slab->end = reinterpret_cast<char *>( slab ) + slabSize;
+			reserved.fetch_add( qint64( slabSize ), std::memory_order_relaxed );
+			link( s, c, slab );
+		}
+
+		FreeNode * node = slab->free;
+		if ( node ) {
+			slab->free = node->next;
+		} else {
+			node = reinterpret_cast<FreeNode *>( slab->cursor );
+			slab->cursor += size;
+		}
+		slab->used++;
+
+		// The tail of a slab smaller than one chunk is never used
+		if ( !slab->free && size_t( slab->end - slab->cursor ) < size )
+			unlink( s, c, slab );
+
+		return node;
+	}
+
+	//! Give a chunk back to its slab with the mutex held, freeing the slab once it is empty
+	void putLocked( Shared & s, int c, FreeNode * node )
+	{
+		Slab * slab = slabOf( node );
+		node->next = slab->free;
+		slab->free = node;
+		slab->used--;
+
+		if ( !slab->listed )
+			link( s, c, slab );
+
+		// Keep the last slab of a class around, so a single item does not map and unmap a slab
+		if ( slab->used == 0 && ( slab->prev || slab->next ) ) {
+			unlink( s, c, slab );
+			slab->~Slab();
+			::operator delete( slab, std::align_val_t( slabSize ) );
+			reserved.fetch_sub( qint64( slabSize ), std::memory_order_relaxed );
+		}
+	}
+
+	//! Per-thread free lists; trivially destructible so it stays usable until the thread ends
+	struct ThreadCache
+	{
+		FreeNode * lists[classCount];
+		int counts[classCount];
+		bool flushed;
+	};
+
+	thread_local ThreadCache cache = {};
+
+	//! Hand a null terminated list of chunks back to their slabs
+	void release( int c, FreeNode * head )
+	{
+		if ( !head )
+			return;
+
+		Shared & s = shared();
+		QMutexLocker lock( &s.mutex );
+		while ( head ) {
+			FreeNode * next = head->next;
+			putLocked( s, c, head );
+			head = next;
+		}
+	}
+
+	//! Returns the chunks of a thread to the slabs when the thread ends
+	struct ThreadFlusher
+	{
+		~ThreadFlusher()
+		{
+			for ( int c = 0; c < classCount; c++ ) {
+				release( c, cache.lists[c] );
+				cache.lists[c] = nullptr;
+				cache.counts[c] = 0;
+			}
+			cache.flushed = true;
+		}
+	};
+
+	thread_local ThreadFlusher flusher;
+
+	//! Fill the thread list of class @p c from the slabs
+	void refill( int c )
+	{
+		// Touch the flusher so it is registered for this thread
+		(void)&flusher;
+
+		Shared & s = shared();
+		QMutexLocker lock( &s.mutex );
+
+		FreeNode *& head = cache.lists[c];
+		for ( int n = 0; n < batchSize; n++ ) {
+			FreeNode * node = takeLocked( s, c );
+			node->next = head;
+			head = node;
+		}
+
+		cache.counts[c] += batchSize;
+	}
+}
+
+void * NifPool::allocate( size_t size )
+{
+	allocCount.fetch_add( 1, std::memory_order_relaxed );
+
+	if ( size > maxPooledSize ) {
+		largeCount.fetch_add( 1, std::memory_order_relaxed );
+		inUse.fetch_add( qint64( size ), std::memory_order_relaxed );
+		return ::operator new( size );
+	}
+
+	int c = sizeClass( size );
+	inUse.fetch_add( qint64( classSize( c ) ), std::memory_order_relaxed );
+
+	if ( cache.flushed ) {
+		// The thread is shutting down, go straight to the slabs
+		Shared & s = shared();
+		QMutexLocker lock( &s.mutex );
+		return takeLocked( s, c );
+	}
+
+	if ( !cache.lists[c] )
+		refill( c );
+
+	FreeNode * node = cache.lists[c];
+	cache.lists[c] = node->next;
+	cache.counts[c]--;
+	return node;
+}
+
+void NifPool::deallocate( void * p, size_t size )
+{
+	if ( !p )
+		return;
+
+	freeCount.fetch_add( 1, std::memory_order_relaxed );
+
+	if ( size > maxPooledSize ) {
+		inUse.fetch_sub( qint64( size ), std::memory_order_relaxed );
+		::operator delete( p );
+		return;
+	}
+
+	int c = sizeClass( size );
+	inUse.fetch_sub( qint64( classSize( c ) ), std::memory_order_relaxed );
+
+	FreeNode * node = static_cast<FreeNode *>( p );
+	if ( cache.flushed ) {
+		node->next = nullptr;
+		release( c, node );
+		return;
+	}
+
+	if ( !cache.lists[c] )
+		(void)&flusher;
+
+	node->next = cache.lists[c];
+	cache.lists[c] = node;
+
+	// Do not let one thread hoard everything a worker freed
+	if ( ++cache.counts[c] > maxCached ) {
+		release( c, cache.lists[c] );
+		cache.lists[c] = nullptr;
+		cache.counts[c] = 0;
+	}
+}
+
+NifPool::Stats NifPool::stats()
+{
+	Stats st;
+	st.allocations = allocCount.load( std::memory_order_relaxed );
+	st.frees = freeCount.load( std::memory_order_relaxed );
+	st.bytesInUse = inUse.load( std::memory_order_relaxed );
+	st.slabBytes = reserved.load( std::memory_order_relaxed );
+	st.largeAllocations = largeCount.load( std::memory_order_relaxed );
+	return st;
+}
+
+QString NifPool::summary()
+{
+	Stats st = stats();
+
+	return QString( "item pool: %1 MB in use, %2 MB in slabs, %3 allocations, %4 frees" )
+		.arg( double( st.bytesInUse ) / (1024 * 1024), 0, 'f', 1 )
+		.arg( double( st.slabBytes ) / (1024 * 1024), 0, 'f', 1 )
+		.arg( st.allocations )
+		.arg( st.frees );
+}
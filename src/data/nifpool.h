@@ -0,0 +1,113 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#ifndef NIFPOOL_H
+#define NIFPOOL_H
+
+#include <QString>
+
+#include <cstddef>
+#include <new>
+#include <utility>
+
+
+//! @file nifpool.h NifPool
+
+/*! Slab allocator for NifItem nodes and the fixed-size NifValue payloads
+ *
+ * A loaded file holds millions of small, equally sized objects. Allocating them one by
+ * one from the system heap makes loading and, even more so, closing a big file slow.
+ *
+ * Requests up to NifPool::maxPooledSize bytes are served from 64 KiB slabs, rounded up to
+ * a 16 byte size class. Freed chunks go to a per-thread free list and are reused for the
+ * next allocation of the same class, so freeing a whole tree is a pointer push per node.
+ * Larger requests fall through to the global operator new.
+ *
+ * The pool is shared by all models since items move freely between them (block copies,
+ * moving blocks to another model), so it cannot be split into per-model arenas. Instead
+ * each slab counts its chunks in use, and is returned to the system once the free lists
+ * of the threads have handed all of them back; only the last slab of each class is kept.
+ */
+namespace NifPool
+{
+	//! Largest request served from a slab
+	constexpr size_t maxPooledSize = 128;
+
+	//! Allocation counters, in bytes where applicable
+	struct Stats
+	{
+		//! Allocations served since startup
+		qint64 allocations = 0;
+		//! Deallocations since startup
+		qint64 frees = 0;
+		//! Bytes handed out and not yet freed
+		qint64 bytesInUse = 0;
+		//! Bytes reserved in slabs
+		qint64 slabBytes = 0;
+		//! Allocations too large for the slabs
+		qint64 largeAllocations = 0;
+	};
+
+	//! Allocate @p size bytes, aligned to 16 bytes
+	void * allocate( size_t size );
+	//! Free memory from allocate(); @p size must match the request
+	void deallocate( void * p, size_t size );
+
+	//! Current counters
+	Stats stats();
+	//! Summary for the Memory Statistics spell
+	QString summary();
+
+	//! Construct a T in pooled memory
+	template <typename T, typename... Args> T * create( Args &&... args )
+	{
+		static_assert( alignof(T) <= 16, "NifPool only guarantees 16 byte alignment" );
+		void * p = allocate( sizeof(T) );
+		try {
+			return new ( p ) T( std::forward<Args>( args )... );
+		} catch ( ... ) {
+			deallocate( p, sizeof(T) );
+			throw;
+		}
+	}
+
+	//! Destroy a T created with create(), null pointers are ignored
+	template <typename T> void destroy( T * p )
+	{
+		if ( p ) {
+			p->~T();
+			deallocate( p, sizeof(T) );
+		}
+	}
+}
+
+#endif
@@ -38,8 +38,16 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QSettings>
 
 
+
 //! @file nifvalue.cpp NifValue
 
+// Derived types share the storage of their base type
+static_assert( sizeof(HalfVector3) == sizeof(Vector3) && sizeof(UshortVector3) == sizeof(Vector3)
+	&& sizeof(ByteVector3) == sizeof(Vector3), "Vector3 variants must not add members" );
+static_assert( sizeof(HalfVector2) == sizeof(Vector2), "HalfVector2 must not add members" );
+static_assert( sizeof(ByteColor4) == sizeof(Color4), "ByteColor4 must not add members" );
+
+
 QHash<QString, NifValue::Type>        NifValue::typeMap;
 QHash<QString, QString>               NifValue::typeTxt;
 QHash<QString, NifValue::EnumOptions> NifValue::enumMap;
@@ -62,6 +70,13 @@ NifValue::NifValue( const NifValue & other )
 	operator=(other);
 }
 
+NifValue::NifValue( NifValue && other ) noexcept
+	: typ( other.typ ), val( other.val )
+{
+	other.typ = tNone;
+	other.val.u64 = 0;
+}
+
 NifValue::~NifValue()
 {
 	clear();
@@ -360,37 +375,37 @@ void NifValue::clear()
 {
 	switch ( typ ) {
 	case tVector4:
-		delete static_cast<Vector4 *>( val.data );
+		destroyPayload<Vector4>();
 		break;
 	case tVector3:
 	case tHalfVector3:
 	case tUshortVector3:
 	case tByteVector3:
-		delete static_cast<Vector3 *>( val.data );
+		destroyPayload<Vector3>();
 		break;
 	case tVector2:
 	case tHalfVector2:
-		delete static_cast<Vector2 *>( val.data );
+		destroyPayload<Vector2>();
 		break;
 	case tMatrix:
-		delete static_cast<Matrix *>( val.data );
+		destroyPayload<Matrix>();
 		break;
 	case tMatrix4:
-		delete static_cast<Matrix4 *>( val.data );
+		destroyPayload<Matrix4>();
 		break;
 	case tQuat:
 	case tQuatXYZW:
-		delete static_cast<Quat *>( val.data );
+		destroyPayload<Quat>();
 		break;
 	case tByteMatrix:
-		delete static_cast<ByteMatrix *>( val.data );
+		destroyPayload<ByteMatrix>();
 		break;
 	case tByteArray:
 	case tStringPalette:
-		delete static_cast<QByteArray *>( val.data );
+		destroyPayload<QByteArray>();
 		break;
 	case tTriangle:
-		delete static_cast<Triangle *>( val.data );
+		destroyPayload<Triangle>();
 		break;
 	case tString:
 	case tSizedString:
@@ -399,20 +414,20 @@ void NifValue::clear()
 	case tHeaderString:
 	case tLineString:
 	case tChar8String:
-		delete static_cast<QString *>( val.data );
+		destroyPayload<QString>();
 		break;
 	case tColor3:
-		delete static_cast<Color3 *>( val.data );
+		destroyPayload<Color3>();
 		break;
 	case tColor4:
 	case tByteColor4:
-		delete static_cast<Color4 *>( val.data );
+		destroyPayload<Color4>();
 		break;
 	case tBSVertexDesc:
-		delete static_cast<BSVertexDesc *>(val.data);
+		destroyPayload<BSVertexDesc>();
 		break;
 	case tBlob:
-		delete static_cast<QByteArray *>( val.data );
+		destroyPayload<QByteArray>();
 		break;
 	default:
 		break;
@@ -422,6 +437,54 @@ void NifValue::clear()
 	val.u64 = 0;
 }
 
+size_t NifValue::payloadSize() const
+{
+	switch ( typ ) {
+	case tVector4:
+		return heapSize<Vector4>();
+	case tVector3:
+	case tHalfVector3:
+	case tUshortVector3:
+	case tByteVector3:
+		return heapSize<Vector3>();
+	case tVector2:
+	case tHalfVector2:
+		return heapSize<Vector2>();
+	case tMatrix:
+		return heapSize<Matrix>();
+	case tMatrix4:
+		return heapSize<Matrix4>();
+	case tQuat:
+	case tQuatXYZW:
+		return heapSize<Quat>();
+	case tByteMatrix:
+		return heapSize<ByteMatrix>();
+	case tByteArray:
+	case tStringPalette:
+	case tBlob:
+		return heapSize<QByteArray>();
+	case tTriangle:
+		return heapSize<Triangle>();
+	case tString:
+	case tSizedString:
+	case tText:
+	case tShortString:
+	case tHeaderString:
+	case tLineString:
+	case tChar8String:
+		return val.data ? heapSize<QString>() : 0;
+	case tColor3:
+		return heapSize<Color3>();
+	case tColor4:
+	case tByteColor4:
+		return heapSize<Color4>();
+	case tBSVertexDesc:
+		return heapSize<BSVertexDesc>();
+	default:
+		return 0;
+	}
+}
+
 void NifValue::changeType( Type t )
 {
 	if ( typ == t )
@@ -439,27 +502,27 @@ void NifValue::changeType( Type t )
 	case tHalfVector3:
 	case tUshortVector3:
 	case tByteVector3:
-		val.data = new Vector3();
+		createPayload<Vector3>();
 		break;
 	case tVector4:
-		val.data = new Vector4();
+		createPayload<Vector4>();
 		return;
 	case tMatrix:
-		val.data = new Matrix();
+		createPayload<Matrix>();
 		return;
 	case tMatrix4:
-		val.data = new Matrix4();
+		createPayload<Matrix4>();
 		return;
 	case tQuat:
 	case tQuatXYZW:
-		val.data = new Quat();
+		createPayload<Quat>();
 		return;
 	case tVector2:
 	case tHalfVector2:
-		val.data = new Vector2();
+		createPayload<Vector2>();
 		return;
 	case tTriangle:
-		val.data = new Triangle();
+		createPayload<Triangle>();
 		return;
 	case tString:
 	case tSizedString:
@@ -468,31 +531,31 @@ void NifValue::changeType( Type t )
 	case tHeaderString:
 	case tLineString:
 	case tChar8String:
-		val.data = new QString();
+		createPayload<QString>();
 		return;
 	case tColor3:
-		val.data = new Color3();
+		createPayload<Color3>();
 		return;
 	case tColor4:
 	case tByteColor4:
-		val.data = new Color4();
+		createPayload<Color4>();
 		return;
 	case tByteArray:
 	case tStringPalette:
-		val.data = new QByteArray();
+		createPayload<QByteArray>();
 		return;
 	case tByteMatrix:
-		val.data = new ByteMatrix();
+		createPayload<ByteMatrix>();
 		return;
 	case tStringOffset:
 	case tStringIndex:
 		val.u32 = 0xffffffff;
 		return;
 	case tBSVertexDesc:
-		val.data = new BSVertexDesc();
+		createPayload<BSVertexDesc>();
 		return;
 	case tBlob:
-		val.data = new QByteArray();
+		createPayload<QByteArray>();
 		return;
 	default:
 		val.u64 = 0;
@@ -510,24 +573,24 @@ void NifValue::operator=( const NifValue & other )
 	case tHalfVector3:
 	case tUshortVector3:
 	case tByteVector3:
-		*static_cast<Vector3 *>( val.data ) = *static_cast<Vector3 *>( other.val.data );
+		*payload<Vector3>() = *other.payload<Vector3>();
 		return;
 	case tVector4:
-		*static_cast<Vector4 *>( val.data ) = *static_cast<Vector4 *>( other.val.data );
+		*payload<Vector4>() = *other.payload<Vector4>();
 		return;
 	case tMatrix:
-		*static_cast<Matrix *>( val.data ) = *static_cast<Matrix *>( other.val.data );
+		*payload<Matrix>() = *other.payload<Matrix>();
 		return;
 	case tMatrix4:
-		*static_cast<Matrix4 *>( val.data ) = *static_cast<Matrix4 *>( other.val.data );
+		*payload<Matrix4>() = *other.payload<Matrix4>();
 		return;
 	case tQuat:
 	case tQuatXYZW:
-		*static_cast<Quat *>( val.data ) = *static_cast<Quat *>( other.val.data );
+		*payload<Quat>() = *other.payload<Quat>();
 		return;
 	case tVector2:
 	case tHalfVector2:
-		*static_cast<Vector2 *>( val.data ) = *static_cast<Vector2 *>( other.val.data );
+		*payload<Vector2>() = *other.payload<Vector2>();
 		return;
 	case tString:
 	case tSizedString:
@@ -536,30 +599,30 @@ void NifValue::operator=( const NifValue & other )
 	case tHeaderString:
 	case tLineString:
 	case tChar8String:
-		*static_cast<QString *>( val.data ) = *static_cast<QString *>( other.val.data );
+		*payload<QString>() = *other.payload<QString>();
 		return;
 	case tColor3:
-		*static_cast<Color3 *>( val.data ) = *static_cast<Color3 *>( other.val.data );
+		*payload<Color3>() = *other.payload<Color3>();
 		return;
 	case tColor4:
 	case tByteColor4:
-		*static_cast<Color4 *>( val.data ) = *static_cast<Color4 *>( other.val.data );
+		*payload<Color4>() = *other.payload<Color4>();
 		return;
 	case tByteArray:
 	case tStringPalette:
-		*static_cast<QByteArray *>( val.data ) = *static_cast<QByteArray *>( other.val.data );
+		*payload<QByteArray>() = *other.payload<QByteArray>();
 		return;
 	case tByteMatrix:
-		*static_cast<ByteMatrix *>( val.data ) = *static_cast<ByteMatrix *>( other.val.data );
+		*payload<ByteMatrix>() = *other.payload<ByteMatrix>();
 		return;
 	case tTriangle:
-		*static_cast<Triangle *>( val.data ) = *static_cast<Triangle *>( other.val.data );
+		*payload<Triangle>() = *other.payload<Triangle>();
 		return;
 	case tBlob:
-		*static_cast<QByteArray *>( val.data ) = *static_cast<QByteArray *>( other.val.data );
+		*payload<QByteArray>() = *other.payload<QByteArray>();
 		return;
 	case tBSVertexDesc:
-		*static_cast<BSVertexDesc *>(val.data) = *static_cast<BSVertexDesc *>(other.val.data);
+		*payload<BSVertexDesc>() = *other.payload<BSVertexDesc>();
 		return;
 	default:
 		val = other.val;
@@ -567,6 +630,20 @@ void NifValue::operator=( const NifValue & other )
 	}
 }
 
+void NifValue::operator=( NifValue && other ) noexcept
+{
+	if ( this == &other )
+		return;
+
+	// Inline payloads are trivially copyable and heap payloads are owned through val.data,
+	// so taking over the raw union moves either kind.
+	clear();
+	typ = other.typ;
+	val = other.val;
+	other.typ = tNone;
+	other.val.u64 = 0;
+}
+
 bool NifValue::operator==( const NifValue & other ) const
 {
 	switch ( typ ) {
@@ -610,8 +687,8 @@ bool NifValue::operator==( const NifValue & other ) const
 	case tChar8String:
 	case tFilePath:
 	{
-		QString * s1 = static_cast<QString *>(val.data);
-		QString * s2 = static_cast<QString *>(other.val.data);
+		const QString * s1 = payload<QString>();
+		const QString * s2 = other.payload<QString>();
 
 		if ( !s1 || !s2 )
 			return false;
@@ -621,8 +698,8 @@ bool NifValue::operator==( const NifValue & other ) const
 
 	case tColor3:
 	{
-		Color3 * c1 = static_cast<Color3 *>(val.data);
-		Color3 * c2 = static_cast<Color3 *>(other.val.data);
+		const Color3 * c1 = payload<Color3>();
+		const Color3 * c2 = other.payload<Color3>();
 
 		if ( !c1 || !c2 )
 			return false;
@@ -633,8 +710,8 @@ bool NifValue::operator==( const NifValue & other ) const
 	case tColor4:
 	case tByteColor4:
 	{
-		Color4 * c1 = static_cast<Color4 *>(val.data);
-		Color4 * c2 = static_cast<Color4 *>(other.val.data);
+		const Color4 * c1 = payload<Color4>();
+		const Color4 * c2 = other.payload<Color4>();
 
 		if ( !c1 || !c2 )
 			return false;
@@ -645,8 +722,8 @@ bool NifValue::operator==( const NifValue & other ) const
 	case tVector2:
 	case tHalfVector2:
 	{
-		Vector2 * vec1 = static_cast<Vector2 *>(val.data);
-		Vector2 * vec2 = static_cast<Vector2 *>(other.val.data);
+		const Vector2 * vec1 = payload<Vector2>();
+		const Vector2 * vec2 = other.payload<Vector2>();
 
 		if ( !vec1 || !vec2 )
 			return false;
@@ -659,8 +736,8 @@ bool NifValue::operator==( const NifValue & other ) const
 	case tUshortVector3:
 	case tByteVector3:
 	{
-		Vector3 * vec1 = static_cast<Vector3 *>(val.data);
-		Vector3 * vec2 = static_cast<Vector3 *>(other.val.data);
+		const Vector3 * vec1 = payload<Vector3>();
+		const Vector3 * vec2 = other.payload<Vector3>();
 
 		if ( !vec1 || !vec2 )
 			return false;
@@ -670,8 +747,8 @@ bool NifValue::operator==( const NifValue & other ) const
 
 	case tVector4:
 	{
-		Vector4 * vec1 = static_cast<Vector4 *>(val.data);
-		Vector4 * vec2 = static_cast<Vector4 *>(other.val.data);
+		const Vector4 * vec1 = payload<Vector4>();
+		const Vector4 * vec2 = other.payload<Vector4>();
 
 		if ( !vec1 || !vec2 )
 			return false;
@@ -682,8 +759,8 @@ bool NifValue::operator==( const NifValue & other ) const
 	case tQuat:
 	case tQuatXYZW:
 	{
-		Quat * quat1 = static_cast<Quat *>(val.data);
-		Quat * quat2 = static_cast<Quat *>(other.val.data);
+		const Quat * quat1 = payload<Quat>();
+		const Quat * quat2 = other.payload<Quat>();
 
 		if ( !quat1 || !quat2 )
 			return false;
@@ -693,8 +770,8 @@ bool NifValue::operator==( const NifValue & other ) const
 
 	case tTriangle:
 	{
-		Triangle * tri1 = static_cast<Triangle *>(val.data);
-		Triangle * tri2 = static_cast<Triangle *>(other.val.data);
+		const Triangle * tri1 = payload<Triangle>();
+		const Triangle * tri2 = other.payload<Triangle>();
 
 		if ( !tri1 || !tri2 )
 			return false;
@@ -707,8 +784,8 @@ bool NifValue::operator==( const NifValue & other ) const
 	case tStringPalette:
 	case tBlob:
 	{
-		QByteArray * a1 = static_cast<QByteArray *>(val.data);
-		QByteArray * a2 = static_cast<QByteArray *>(other.val.data);
+		const QByteArray * a1 = payload<QByteArray>();
+		const QByteArray * a2 = other.payload<QByteArray>();
 
 		if ( a1->isNull() || a2->isNull() )
 			return false;
@@ -718,8 +795,8 @@ bool NifValue::operator==( const NifValue & other ) const
 
 	case tMatrix:
 	{
-		Matrix * m1 = static_cast<Matrix *>(val.data);
-		Matrix * m2 = static_cast<Matrix *>(other.val.data);
+		const Matrix * m1 = payload<Matrix>();
+		const Matrix * m2 = other.payload<Matrix>();
 
 		if ( !m1 || !m2 )
 			return false;
@@ -728,8 +805,8 @@ bool NifValue::operator==( const NifValue & other ) const
 	}
 	case tMatrix4:
 	{
-		Matrix4 * m1 = static_cast<Matrix4 *>(val.data);
-		Matrix4 * m2 = static_cast<Matrix4 *>(other.val.data);
+		const Matrix4 * m1 = payload<Matrix4>();
+		const Matrix4 * m2 = other.payload<Matrix4>();
 
 		if ( !m1 || !m2 )
 			return false;
@@ -738,8 +815,8 @@ bool NifValue::operator==( const NifValue & other ) const
 	}
 	case tBSVertexDesc:
 	{
-		auto d1 = static_cast<BSVertexDesc *>(val.data);
-		auto d2 = static_cast<BSVertexDesc *>(other.val.data);
+		const auto * d1 = payload<BSVertexDesc>();
+		const auto * d2 = other.payload<BSVertexDesc>();
 
 		if ( !d1 || !d2 )
 			return false;
@@ -850,16 +927,16 @@ bool NifValue::setFromString( const QString & s, const BaseModel * model, const
 	case tHeaderString:
 	case tLineString:
 	case tChar8String:
-		*static_cast<QString *>( val.data ) = s;
+		*payload<QString>() = s;
 		ok = true;
 		break;
 	case tColor3:
-		static_cast<Color3 *>( val.data )->fromQColor( QColor( s ) );
+		payload<Color3>()->fromQColor( QColor( s ) );
 		ok = true;
 		break;
 	case tColor4:
 	case tByteColor4:
-		static_cast<Color4 *>( val.data )->fromQColor( QColor( s ) );
+		payload<Color4>()->fromQColor( QColor( s ) );
 		ok = true;
 		break;
 	case tFileVersion:
@@ -868,20 +945,20 @@ bool NifValue::setFromString( const QString & s, const BaseModel * model, const
 		ok = (val.u32 != 0);
 		break;
 	case tVector2:
-		static_cast<Vector2 *>( val.data )->fromString( s );
+		payload<Vector2>()->fromString( s );
 		ok = true;
 		break;
 	case tVector3:
-		static_cast<Vector3 *>( val.data )->fromString( s );
+		payload<Vector3>()->fromString( s );
 		ok = true;
 		break;
 	case tVector4:
-		static_cast<Vector4 *>( val.data )->fromString( s );
+		payload<Vector4>()->fromString( s );
 		ok = true;
 		break;
 	case tQuat:
 	case tQuatXYZW:
-		static_cast<Quat *>( val.data )->fromString( s );
+		payload<Quat>()->fromString( s );
 		ok = true;
 		break;
 	}
@@ -931,10 +1008,10 @@ QString NifValue::toString() const
 	case tHeaderString:
 	case tLineString:
 	case tChar8String:
-		return *static_cast<QString *>( val.data );
+		return *payload<QString>();
 	case tColor3:
 		{
-			Color3 * col = static_cast<Color3 *>( val.data );
+			const Color3 * col = payload<Color3>();
 			float r = col->red(), g = col->green(), b = col->blue();
 
 			// HDR Colors
@@ -949,7 +1026,7 @@ QString NifValue::toString() const
 	case tColor4:
 	case tByteColor4:
 		{
-			Color4 * col = static_cast<Color4 *>( val.data );
+			const Color4 * col = payload<Color4>();
 			float r = col->red(), g = col->green(), b = col->blue(), a = col->alpha();
 
 			// HDR Colors
@@ -968,7 +1045,7 @@ QString NifValue::toString() const
 	case tVector2:
 	case tHalfVector2:
 		{
-			Vector2 * v = static_cast<Vector2 *>( val.data );
+			const Vector2 * v = payload<Vector2>();
 
 			return QString( "X %1 Y %2" )
 			       .arg( NumOrMinMax( (*v)[0], 'f', VECTOR_DECIMALS ) )
@@ -979,7 +1056,7 @@ QString NifValue::toString() const
 	case tUshortVector3:
 	case tByteVector3:
 		{
-			Vector3 * v = static_cast<Vector3 *>( val.data );
+			const Vector3 * v = payload<Vector3>();
 
 			return QString( "X %1 Y %2 Z %3" )
 			       .arg( NumOrMinMax( (*v)[0], 'f', VECTOR_DECIMALS ) )
@@ -988,7 +1065,7 @@ QString NifValue::toString() const
 		}
 	case tVector4:
 		{
-			Vector4 * v = static_cast<Vector4 *>( val.data );
+			const Vector4 * v = payload<Vector4>();
 
 			return QString( "X %1 Y %2 Z %3 W %4" )
 			       .arg( NumOrMinMax( (*v)[0], 'f', VECTOR_DECIMALS ) )
@@ -1003,9 +1080,9 @@ QString NifValue::toString() const
 			Matrix m;
 
 			if ( typ == tMatrix )
-				m = *( static_cast<Matrix *>( val.data ) );
+				m = *( payload<Matrix>() );
 			else
-				m.fromQuat( *( static_cast<Quat *>( val.data ) ) );
+				m.fromQuat( *( payload<Quat>() ) );
 
 			float x, y, z;
 			QString pre, suf;
@@ -1022,7 +1099,7 @@ QString NifValue::toString() const
 		}
 	case tMatrix4:
 		{
-			Matrix4 * m = static_cast<Matrix4 *>( val.data );
+			const Matrix4 * m = payload<Matrix4>();
 			Matrix r; Vector3 t, s;
 			m->decompose( t, r, s );
 			float xr, yr, zr;
@@ -1040,10 +1117,10 @@ QString NifValue::toString() const
 		}
 	case tByteArray:
 		return QString( "%1 bytes" )
-		       .arg( static_cast<QByteArray *>( val.data )->count() );
+		       .arg( payload<QByteArray>()->count() );
 	case tStringPalette:
 		{
-			QByteArray * array = static_cast<QByteArray *>( val.data );
+			const QByteArray * array = payload<QByteArray>();
 			QString s;
 
 			while ( s.length() < array->count() ) {
@@ -1055,7 +1132,7 @@ QString NifValue::toString() const
 		}
 	case tByteMatrix:
 		{
-			ByteMatrix * array = static_cast<ByteMatrix *>( val.data );
+			const ByteMatrix * array = payload<ByteMatrix>();
 			return QString( "%1 bytes  [%2 x %3]" )
 			       .arg( array->count() )
 			       .arg( array->count( 0 ) )
@@ -1065,7 +1142,7 @@ QString NifValue::toString() const
 		return NifModel::version2string( val.u32 );
 	case tTriangle:
 		{
-			Triangle * tri = static_cast<Triangle *>( val.data );
+			const Triangle * tri = payload<Triangle>();
 			return QString( "%1 %2 %3" )
 			       .arg( tri->v1() )
 			       .arg( tri->v2() )
@@ -1073,13 +1150,13 @@ QString NifValue::toString() const
 		}
 	case tFilePath:
 		{
-			return *static_cast<QString *>( val.data );
+			return *payload<QString>();
 		}
 	case tBSVertexDesc:
-		return static_cast<BSVertexDesc *>(val.data)->toString();
+		return payload<BSVertexDesc>()->toString();
 	case tBlob:
 		{
-			QByteArray * array = static_cast<QByteArray *>( val.data );
+			const QByteArray * array = payload<QByteArray>();
 			return QString( "%1 bytes" )
 				   .arg( array->size() );
 		}
@@ -1167,10 +1244,10 @@ QColor NifValue::toColor( const BaseModel * model, const NifItem * item ) const
 {
 	switch ( type() ) {
 	case tColor3:
-		return static_cast<Color3 *>( val.data )->toQColor();
+		return payload<Color3>()->toQColor();
 	case tColor4:
 	case tByteColor4:
-		return static_cast<Color4 *>( val.data )->toQColor();
+		return payload<Color4>()->toQColor();
 	default:
 		if ( model )
 			reportConvertToError(model, item, "a color");
@@ -33,6 +33,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef NIFVALUE_H
 #define NIFVALUE_H
 
+#include "data/nifpool.h"
 #include "data/niftypes.h"
 
 #include <QByteArray>
@@ -41,6 +42,9 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QString>
 #include <QVariant>
 
+#include <new>
+#include <type_traits>
+
 
 //! @file nifvalue.h NifValue
 
@@ -148,12 +152,16 @@ public:
 	NifValue( Type t );
 	//! Copy constructor.
 	NifValue( const NifValue & other );
+	//! Move constructor. Leaves @p other with type tNone.
+	NifValue( NifValue && other ) noexcept;
 	//! Destructor.
 	~NifValue();
 
 
 	//! Assignment. Performs a deep copy of the data.
 	void operator=(const NifValue & other);
+	//! Move assignment. Takes over the data of @p other, which is left with type tNone.
+	void operator=(NifValue && other) noexcept;
 	//! Custom comparator for QVariant::operator==()
 	bool operator==(const NifValue & other) const;
 	//! Necessary for QMetaType::registerComparators(), but unused
@@ -162,6 +170,9 @@ public:
 	//! Clear the data, setting its type to tNone.
 	void clear();
 
+	//! Bytes allocated for the data outside of the value itself, excluding string and array contents.
+	size_t payloadSize() const;
+
 	//! Get the type.
 	Type type() const { return typ; }
 
@@ -359,11 +370,64 @@ protected:
 		qint64 i64;
 		float f32;
 		void * data;
+		//! Storage for payloads small enough to avoid the heap, see storedInline()
+		char raw[16];
 	};
 
 	//! The data value.
 	Value val = {0};
 
+	/*! Whether a payload of type T lives in val.raw instead of behind val.data
+	 *
+	 * True for the vector, quaternion, color and triangle types. Matrices, strings and
+	 * byte arrays are too large or not trivially copyable and stay on the heap.
+	 */
+	template <typename T> static constexpr bool storedInline()
+	{
+		return sizeof(T) <= sizeof(Value::raw) && alignof(T) <= alignof(Value)
+			&& std::is_trivially_copyable<T>::value && std::is_trivially_destructible<T>::value;
+	}
+
+	//! Get the payload of type T, wherever it is stored
+	template <typename T> T * payload()
+	{
+		if constexpr ( storedInline<T>() )
+			return reinterpret_cast<T *>( val.raw );
+		else
+			return static_cast<T *>( val.data );
+	}
+
+	//! Get the payload of type T, wherever it is stored
+	template <typename T> const T * payload() const
+	{
+		if constexpr ( storedInline<T>() )
+			return reinterpret_cast<const T *>( val.raw );
+		else
+			return static_cast<const T *>( val.data );
+	}
+
+	//! Default construct the payload of type T
+	template <typename T> void createPayload()
+	{
+		if constexpr ( storedInline<T>() )
+			new ( val.raw ) T();
+		else
+			val.data = NifPool::create<T>();
+	}
+
+	//! Destroy the payload of type T
+	template <typename T> void destroyPayload()
+	{
+		if constexpr ( !storedInline<T>() )
+			NifPool::destroy( payload<T>() );
+	}
+
+	//! Bytes allocated outside of the value for a payload of type T
+	template <typename T> static constexpr size_t heapSize()
+	{
+		return storedInline<T>() ? 0 : sizeof(T);
+	}
+
 	/*! Get the data as an object of type T.
 	 *
 	 * If the type t is not equal to the actual type of the data, then return T(). Serves
@@ -506,7 +570,7 @@ inline bool NifValue::setFileVersion( quint32 v, const BaseModel * model, const
 template <typename T> inline T NifValue::getType( Type t, const BaseModel * model, const NifItem * item ) const
 {
 	if ( typ == t )
-		return *static_cast<T *>( val.data ); // WARNING: this throws an exception if the type of v is not the original type by which val.data was initialized; the programmer must make sure that T matches t.
+		return *payload<T>(); // WARNING: this throws an exception if the type of v is not the original type by which val.data was initialized; the programmer must make sure that T matches t.
 
 	if ( model )
 		reportConvertToError( model, item, getTypeDebugStr( t ) );
@@ -516,7 +580,7 @@ template <typename T> inline T NifValue::getType( Type t, const BaseModel * mode
 template <typename T> inline bool NifValue::setType( Type t, T v, const BaseModel * model, const NifItem * item )
 {
 	if ( typ == t ) {
-		*static_cast<T *>( val.data ) = v; // WARNING: this throws an exception if the type of v is not the original type by which val.data was initialized; the programmer must make sure that T matches t.
+		*payload<T>() = v; // WARNING: this throws an exception if the type of v is not the original type by which val.data was initialized; the programmer must make sure that T matches t.
 		return true;
 	}
 
@@ -584,7 +648,7 @@ template <> inline Vector4 NifValue::get( const BaseModel * model, const NifItem
 template <> inline Vector3 NifValue::get( const BaseModel * model, const NifItem * item ) const
 {
 	if ( typ == tVector3 || typ == tHalfVector3 )
-		return *static_cast<Vector3 *>(val.data);
+		return *payload<Vector3>();
 
 	if ( model )
 		reportConvertToError( model, item, "a Vector3" );
@@ -609,7 +673,7 @@ template <> inline HalfVector2 NifValue::get( const BaseModel * model, const Nif
 template <> inline Vector2 NifValue::get( const BaseModel * model, const NifItem * item ) const
 {
 	if ( typ == tVector2 || typ == tHalfVector2 )
-		return *static_cast<Vector2 *>(val.data);
+		return *payload<Vector2>();
 
 	if ( model )
 		reportConvertToError( model, item, "a Vector2" );
@@ -634,7 +698,7 @@ template <> inline Triangle NifValue::get( const BaseModel * model, const NifIte
 template <> inline QString NifValue::get( const BaseModel * model, const NifItem * item ) const
 {
 	if ( isString() )
-		return *static_cast<QString *>( val.data );
+		return *payload<QString>();
 
 	if ( model )
 		reportConvertToError( model, item, "a string" );
@@ -643,7 +707,7 @@ template <> inline QString NifValue::get( const BaseModel * model, const NifItem
 template <> inline QByteArray NifValue::get( const BaseModel * model, const NifItem * item ) const
 {
 	if ( isByteArray() )
-		return *static_cast<QByteArray *>( val.data );
+		return *payload<QByteArray>();
 
 	if ( model )
 		reportConvertToError( model, item, "a byte array" );
@@ -651,6 +715,8 @@ template <> inline QByteArray NifValue::get( const BaseModel * model, const NifI
 }
 template <> inline QByteArray * NifValue::get( const BaseModel * model, const NifItem * item ) const
 {
+	// Callers edit the array in place, so it must not move
+	static_assert( !storedInline<QByteArray>(), "QByteArray payloads live on the heap" );
 	if ( isByteArray() )
 		return static_cast<QByteArray *>( val.data );
 
@@ -661,7 +727,7 @@ template <> inline QByteArray * NifValue::get( const BaseModel * model, const Ni
 template <> inline Quat NifValue::get( const BaseModel * model, const NifItem * item ) const
 {
 	if ( isQuat() )
-		return *static_cast<Quat *>( val.data );
+		return *payload<Quat>();
 
 	if ( model )
 		reportConvertToError( model, item, "Quat" );
@@ -669,6 +735,7 @@ template <> inline Quat NifValue::get( const BaseModel * model, const NifItem *
 }
 template <> inline ByteMatrix * NifValue::get( const BaseModel * model, const NifItem * item ) const
 {
+	static_assert( !storedInline<ByteMatrix>(), "ByteMatrix payloads live on the heap" );
 	if ( isByteMatrix() )
 		return static_cast<ByteMatrix *>( val.data );
 
@@ -791,10 +858,10 @@ template <> inline bool NifValue::set( const QString & x, const BaseModel * mode
 {
 	if ( isString() ) {
 		if ( !val.data ) {
-			val.data = new QString;
+			createPayload<QString>();
 		}
 
-		*static_cast<QString *>( val.data ) = x;
+		*payload<QString>() = x;
 		return true;
 	}
 
@@ -806,7 +873,7 @@ template <> inline bool NifValue::set( const QString & x, const BaseModel * mode
 template <> inline bool NifValue::set( const QByteArray & x, const BaseModel * model, const NifItem * item )
 {
 	if ( isByteArray() ) {
-		*static_cast<QByteArray *>( val.data ) = x;
+		*payload<QByteArray>() = x;
 		return true;
 	}
 
@@ -818,7 +885,7 @@ template <> inline bool NifValue::set( const QByteArray & x, const BaseModel * m
 template <> inline bool NifValue::set( const Quat & x, const BaseModel * model, const NifItem * item )
 {
 	if ( isQuat() ) {
-		*static_cast<Quat *>( val.data ) = x;
+		*payload<Quat>() = x;
 		return true;
 	}
 
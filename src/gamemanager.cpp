@@ -349,6 +349,11 @@ QStringList GameManager::filter_archives( const QStringList& list, const QString
 	return filtered;
 }
 
+int GameManager::generation()
+{
+	return get()->changes.load();
+}
+
 void GameManager::save() const
 {
 	QSettings settings;
@@ -374,6 +379,7 @@ void GameManager::save() const
 void GameManager::load()
 {
 	QMutexLocker locker(&mutex);
+	changes.ref();
 	QSettings settings;
 	for ( const auto& p : settings.value(GAME_PATHS).toMap().toStdMap() )
 		game_paths[ModeForString(p.first)] = p.second.toString();
@@ -391,6 +397,7 @@ void GameManager::load()
 void GameManager::load_archives()
 {
 	QMutexLocker locker(&mutex);
+	changes.ref();
 	// Reset the currently open archive handles
 	handles.clear();
 	for ( const auto ar : game_archives.toStdMap() ) {
@@ -407,6 +414,7 @@ void GameManager::load_archives()
 void GameManager::clear()
 {
 	QMutexLocker locker(&mutex);
+	changes.ref();
 	game_paths.clear();
 	game_folders.clear();
 	game_archives.clear();
@@ -416,24 +424,28 @@ void GameManager::clear()
 void GameManager::insert_game( const GameMode game, const QString& path )
 {
 	QMutexLocker locker(&mutex);
+	changes.ref();
 	game_paths.insert(game, path);
 }
 
 void GameManager::insert_folders( const GameMode game, const QStringList& list )
 {
 	QMutexLocker locker(&mutex);
+	changes.ref();
 	game_folders.insert(game, list);
 }
 
 void GameManager::insert_archives( const GameMode game, const QStringList& list )
 {
 	QMutexLocker locker(&mutex);
+	changes.ref();
 	game_archives.insert(game, list);
 }
 
 void GameManager::insert_status( const GameMode game, bool status )
 {
 	QMutexLocker locker(&mutex);
+	changes.ref();
 	game_status.insert(game, status);
 }
 
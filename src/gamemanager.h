@@ -4,6 +4,7 @@
 #include <cstdint>
 #include <memory>
 
+#include <QAtomicInt>
 #include <QMap>
 #include <QString>
 #include <QStringBuilder>
@@ -240,6 +241,8 @@ public:
 	static QStringList find_archives(const GameMode game);
 	//! Given an archive list, returns a sublist of archives that contain the given folder
 	static QStringList filter_archives(const QStringList& list, const QString& folder);
+	//! Changes whenever the folders, archives or enabled games change, for caching resource lookups
+	static int generation();
 
 	//! Game installation path
 	static inline QString path(const QString& game);
@@ -292,6 +295,7 @@ private:
 	void insert_status(const GameMode game, bool status);
 
 	mutable QMutex mutex;
+	QAtomicInt changes;
 
 	GameMap game_paths;
 	GameEnabledMap game_status;
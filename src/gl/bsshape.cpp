@@ -4,6 +4,7 @@
 #include "gl/glscene.h"
 #include "gl/renderer.h"
 #include "io/material.h"
+#include "model/meshstreams.h"
 #include "model/nifmodel.h"
 
 
@@ -67,8 +68,6 @@ void BSShape::updateData( const NifModel * nif )
 			numVerts = nif->rowCount( iData );
 	}
 
-	TexCoords coordset; // For compatibility with coords list
-
 	QVector<Vector4> dynVerts;
 	if ( isDynamic ) {
 		dynVerts = nif->getArray<Vector4>( iBlock, "Vertices" );
@@ -77,34 +76,26 @@ void BSShape::updateData( const NifModel * nif )
 			numVerts = nDynVerts;
 	}
 
-	for ( int i = 0; i < numVerts; i++ ) {
-		auto idx = nif->index( i, 0, iData );
-		float bitX;
+	MeshStreams streams( nif, iData, numVerts );
 
-		if ( isDynamic ) {
-			auto& dynv = dynVerts.at(i);
-			verts << Vector3( dynv );
-			bitX = dynv[3];
-		} else {
-			verts << nif->get<Vector3>( idx, "Vertex" );
-			bitX = nif->get<float>( idx, "Bitangent X" );
+	bitangents = streams.bitangents();
+	if ( isDynamic ) {
+		verts.resize( numVerts );
+		for ( int i = 0; i < numVerts; i++ ) {
+			auto & dynv = dynVerts.at(i);
+			verts[i] = Vector3( dynv );
+			bitangents[i][0] = dynv[3];
 		}
-
-		// Bitangent Y/Z
-		auto bitY = nif->get<float>( idx, "Bitangent Y" );
-		auto bitZ = nif->get<float>( idx, "Bitangent Z" );
-
-		coordset << nif->get<HalfVector2>( idx, "UV" );
-		norms += nif->get<ByteVector3>( idx, "Normal" );
-		tangents += nif->get<ByteVector3>( idx, "Tangent" );
-		bitangents += Vector3( bitX, bitY, bitZ );
-
-		auto vcIdx = nif->getIndex( idx, "Vertex Colors" );
-		colors += vcIdx.isValid() ? nif->get<ByteColor4>( vcIdx ) : Color4(0, 0, 0, 1);
+	} else {
+		verts = streams.positions();
 	}
 
+	norms = streams.normals();
+	tangents = streams.tangents();
+	colors = streams.colors();
+
 	// Add coords as the first set of QList
-	coords.append( coordset );
+	coords.append( streams.uvs() );
 
 	numVerts = verts.count();
 
@@ -138,14 +129,10 @@ void BSShape::updateData( const NifModel * nif )
 			weights[i].bone = bones[i];
 		auto nTotalWeights = weights.count();
 
+		QVector<float> wts = streams.boneWeights();
+		QVector<quint8> bns = streams.boneIndices();
 		for ( int i = 0; i < numVerts; i++ ) {
-			auto idx = nif->index( i, 0, iData );
-			auto wts = nif->getArray<float>( idx, "Bone Weights" );
-			auto bns = nif->getArray<quint8>( idx, "Bone Indices" );
-			if ( wts.count() < 4 || bns.count() < 4 )
-				continue;
-
-			for ( int j = 0; j < 4; j++ ) {
+			for ( int j = i * 4; j < i * 4 + 4; j++ ) {
 				if ( bns[j] >= nTotalWeights )
 					continue;
 
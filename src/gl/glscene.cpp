@@ -199,8 +199,9 @@ void Scene::updateSelectMode( QAction * action )
 
 void Scene::updateLodLevel( int level )
 {
+	// BSLODTriShape and BSMeshLODTriShape have three levels
 	if ( game != Game::STARFIELD )
-		level = std::max(level, 2);
+		level = std::min(level, 2);
 	lodLevel = LodLevel( level );
 }
 
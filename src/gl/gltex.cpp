@@ -34,6 +34,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "message.h"
 #include "gl/glscene.h"
+#include "gl/gltexdiskcache.h"
 #include "gl/gltexloaders.h"
 #include "model/nifmodel.h"
 
@@ -41,13 +42,17 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "gamemanager.h"
 
+#include <QDateTime>
 #include <QDebug>
 #include <QDir>
+#include <QFileInfo>
 #include <QFileSystemWatcher>
 #include <QListView>
 #include <QOpenGLContext>
 #include <QOpenGLFunctions>
+#include <QSet>
 #include <QSettings>
+#include <QtConcurrent/QtConcurrentMap>
 
 #include <algorithm>
 
@@ -156,132 +161,362 @@ TexCache::~TexCache()
 	//flush();
 }
 
-QString TexCache::find( const QString & file, const QString & nifdir, Game::GameMode game )
-{
-	return find( file, nifdir, *(new QByteArray()), game );
-}
+/*
+ *  Texture path lookup
+ */
 
-QString TexCache::find( const QString & file, const QString & nifdir, QByteArray & data, Game::GameMode game )
+namespace
 {
-	if ( file.isEmpty() )
-		return QString();
-
-	if ( QFile( file ).exists() )
-		return file;
-
-	QSettings settings;
+	//! Where TexCache::find located a texture
+	struct TexLocation
+	{
+		//! Resolved path, or the normalized input path if not found
+		QString path;
+		//! Archive holding the texture, null for loose files
+		FSArchiveFile * archive = nullptr;
+		//! Entry name inside the archive
+		QString entry;
+		bool found = false;
+	};
+
+	//! Search settings, read once instead of on every lookup
+	struct TexFindSettings
+	{
+		bool alternateExtensions = false;
+		bool otherGamesFallback = true;
+	};
+
+	/*! Results of TexCache::find per game, NIF folder and texture path
+	 *
+	 * Missing textures are remembered as well, so shapes rebuilt after an edit do not
+	 * search every folder and archive again. Found loose files are checked for existence
+	 * on every hit. Missing ones are searched again when a NIF is opened (see
+	 * TexCache::prefetch) or the NIF folder changes. Everything is dropped when the game
+	 * folders, archives or resource settings change.
+	 */
+	struct TexFindCache
+	{
+		QMutex mutex;
+		QHash<QString, TexLocation> entries;
+		int generation = -1;
 
-	QString filename = QDir::toNativeSeparators( file );
+		TexFindSettings settings;
+		bool settingsLoaded = false;
 
-	QStringList extensions;
-	extensions << ".dds";
-	bool replaceExt = false;
+		//! Path and time of the file last passed to TexCache::prefetch
+		QString lastLoaded;
 
-	bool textureAlternatives = settings.value( "Settings/Resources/Alternate Extensions", false ).toBool();
-	if ( textureAlternatives ) {
-		extensions << ".tga" << ".png" << ".bmp" << ".nif" << ".texcache";
-		for ( const QString ext : QStringList{ extensions } )
+		//! Drop the entries if GameManager changed since they were resolved, the caller holds mutex
+		void sync()
 		{
-			if ( filename.endsWith( ext, Qt::CaseInsensitive ) ) {
-				extensions.removeAll( ext );
-				extensions.prepend( ext );
-				filename = filename.left( filename.length() - ext.length() );
-				replaceExt = true;
-				break;
+			int current = Game::GameManager::generation();
+			if ( generation != current ) {
+				entries.clear();
+				generation = current;
 			}
-		}
-	}
 
-	// attempt to find the texture in one of the folders
-	QDir dir;
-	for ( const QString& ext : extensions ) {
-		if ( replaceExt ) {
-			filename += ext;
+			if ( !settingsLoaded ) {
+				QSettings cfg;
+				settings.alternateExtensions = cfg.value( "Settings/Resources/Alternate Extensions", false ).toBool();
+				settings.otherGamesFallback = cfg.value( "Settings/Resources/Other Games Fallback", true ).toBool();
+				settingsLoaded = true;
+			}
 		}
+	};
 
-		auto appdir = QDir::currentPath();
-		
-		// First search NIF root
-		dir.setPath( nifdir );
-		if ( dir.exists( filename ) ) {
-			return dir.filePath( filename );
-		}
+	TexFindCache & findCache()
+	{
+		static TexFindCache cache;
+		return cache;
+	}
+
+	QString findKey( const QString & file, const QString & nifdir, Game::GameMode game )
+	{
+		return QString( "%1|%2|%3" ).arg( int( game ) ).arg( nifdir, file );
+	}
 
-		// Next search NifSkope dir
-		dir.setPath( appdir );
-		if ( dir.exists( filename ) ) {
-			return dir.filePath( filename );
+	//! The uncached search behind TexCache::find
+	TexLocation search( const QString & file, const QString & nifdir, Game::GameMode game, const TexFindSettings & cfg )
+	{
+		TexLocation loc;
+
+		QString filename = QDir::toNativeSeparators( file );
+
+		QStringList extensions;
+		extensions << ".dds";
+		bool replaceExt = false;
+
+		if ( cfg.alternateExtensions ) {
+			extensions << ".tga" << ".png" << ".bmp" << ".nif" << ".texcache";
+			for ( const QString ext : QStringList{ extensions } )
+			{
+				if ( filename.endsWith( ext, Qt::CaseInsensitive ) ) {
+					extensions.removeAll( ext );
+					extensions.prepend( ext );
+					filename = filename.left( filename.length() - ext.length() );
+					replaceExt = true;
+					break;
+				}
+			}
 		}
 
-		for ( QString folder : Game::GameManager::folders(game) ) {
-			// TODO: Always search nifdir without requiring a relative entry
-			// in folders?  Not too intuitive to require ".\" in your texture folder list
-			// even if it is added by default.
-			if ( folder.startsWith( "./" ) || folder.startsWith( ".\\" ) ) {
-				folder = nifdir + "/" + folder;
+		// attempt to find the texture in one of the folders
+		QDir dir;
+		for ( const QString& ext : extensions ) {
+			if ( replaceExt ) {
+				filename += ext;
 			}
 
-			dir.setPath( folder );
+			auto appdir = QDir::currentPath();
 
+			// First search NIF root
+			dir.setPath( nifdir );
 			if ( dir.exists( filename ) ) {
-				filename = dir.filePath( filename );
-				filename = QDir::toNativeSeparators( filename );
-				return filename;
+				loc.path = dir.filePath( filename );
+				loc.found = true;
+				return loc;
 			}
-		}
 
-		// Search through archives last, and load any requested textures into memory.
-		for ( FSArchiveFile * archive : Game::GameManager::opened_archives(game) ) {
-			if ( archive ) {
-				filename = QDir::fromNativeSeparators( filename.toLower() );
-				if ( archive->hasFile( filename ) ) {
-					QByteArray outData;
-					archive->fileContents( filename, outData );
-
-					if ( !outData.isEmpty() ) {
-						data = outData;
-						filename = QDir::toNativeSeparators( filename );
-						return filename;
+			// Next search NifSkope dir
+			dir.setPath( appdir );
+			if ( dir.exists( filename ) ) {
+				loc.path = dir.filePath( filename );
+				loc.found = true;
+				return loc;
+			}
+
+			for ( QString folder : Game::GameManager::folders(game) ) {
+				// TODO: Always search nifdir without requiring a relative entry
+				// in folders?  Not too intuitive to require ".\" in your texture folder list
+				// even if it is added by default.
+				if ( folder.startsWith( "./" ) || folder.startsWith( ".\\" ) ) {
+					folder = nifdir + "/" + folder;
+				}
+
+				dir.setPath( folder );
+
+				if ( dir.exists( filename ) ) {
+					loc.path = QDir::toNativeSeparators( dir.filePath( filename ) );
+					loc.found = true;
+					return loc;
+				}
+			}
+
+			// Search through archives last, the contents are read by TexCache::find
+			for ( FSArchiveFile * archive : Game::GameManager::opened_archives(game) ) {
+				if ( archive ) {
+					filename = QDir::fromNativeSeparators( filename.toLower() );
+					if ( archive->hasFile( filename ) ) {
+						loc.archive = archive;
+						loc.entry = filename;
+						loc.path = QDir::toNativeSeparators( filename );
+						loc.found = true;
+						return loc;
 					}
 				}
 			}
-		}
 
-		// For Skyrim and FO4 which occasionally leave the textures off
-		if ( !filename.startsWith( "textures", Qt::CaseInsensitive ) ) {
-			QRegularExpression re( "textures[\\\\/]", QRegularExpression::CaseInsensitiveOption );
-			int texIdx = filename.indexOf( re );
-			if ( texIdx > 0 ) {
-				filename.remove( 0, texIdx );
-			} else {
-				while ( filename.startsWith( "/" ) || filename.startsWith( "\\" ) )
-					filename.remove( 0, 1 );
+			// For Skyrim and FO4 which occasionally leave the textures off
+			if ( !filename.startsWith( "textures", Qt::CaseInsensitive ) ) {
+				QRegularExpression re( "textures[\\\\/]", QRegularExpression::CaseInsensitiveOption );
+				int texIdx = filename.indexOf( re );
+				if ( texIdx > 0 ) {
+					filename.remove( 0, texIdx );
+				} else {
+					while ( filename.startsWith( "/" ) || filename.startsWith( "\\" ) )
+						filename.remove( 0, 1 );
+
+					if ( !filename.startsWith( "textures", Qt::CaseInsensitive ) && !filename.startsWith( "shaders", Qt::CaseInsensitive ) )
+						filename.prepend( "textures\\" );
+				}
 
-				if ( !filename.startsWith( "textures", Qt::CaseInsensitive ) && !filename.startsWith( "shaders", Qt::CaseInsensitive ) )
-					filename.prepend( "textures\\" );
+				return search( filename, nifdir, game, cfg );
 			}
 
-			return find( filename, nifdir, data, game );
+			if ( !replaceExt )
+				break;
+
+			// Remove file extension
+			filename = filename.left( filename.length() - ext.length() );
 		}
 
-		if ( !replaceExt )
-			break;
+		if ( cfg.otherGamesFallback && game != Game::OTHER )
+			return search( file, nifdir, Game::OTHER, cfg );
+
+		// Fix separators
+		filename = QDir::toNativeSeparators( filename );
+
+		if ( replaceExt )
+			loc.path = filename + extensions.value( 0 ); // Restore original file extension
+		else
+			loc.path = filename;
+
+		return loc;
+	}
+
+	//! Search for a texture through the lookup cache
+	TexLocation locate( const QString & file, const QString & nifdir, Game::GameMode game )
+	{
+		TexFindCache & cache = findCache();
+		QString key = findKey( file, nifdir, game );
+
+		TexFindSettings cfg;
+		int generation;
+		{
+			QMutexLocker lock( &cache.mutex );
+			cache.sync();
+
+			auto it = cache.entries.constFind( key );
+			// Loose files may have been removed without the watcher noticing, e.g. read-only ones
+			if ( it != cache.entries.constEnd() && (!it->found || it->archive || QFile::exists( it->path )) )
+				return it.value();
+
+			cfg = cache.settings;
+			generation = cache.generation;
+		}
+
+		TexLocation loc = search( file, nifdir, game, cfg );
+
+		QMutexLocker lock( &cache.mutex );
+		if ( cache.generation == generation )
+			cache.entries.insert( key, loc );
+
+		return loc;
+	}
+
+	//! Drop the textures that were not found, so they are searched again
+	void forgetMissing()
+	{
+		TexFindCache & cache = findCache();
+
+		QMutexLocker lock( &cache.mutex );
+		for ( auto it = cache.entries.begin(); it != cache.entries.end(); ) {
+			if ( !it->found )
+				it = cache.entries.erase( it );
+			else
+				++it;
+		}
+	}
+
+	//! Drop the cached locations of a loose file that was removed
+	void forget( const QString & filepath )
+	{
+		TexFindCache & cache = findCache();
+
+		QMutexLocker lock( &cache.mutex );
+		for ( auto it = cache.entries.begin(); it != cache.entries.end(); ) {
+			if ( it->found && !it->archive && it->path == filepath )
+				it = cache.entries.erase( it );
+			else
+				++it;
+		}
+	}
+}
+
+QString TexCache::find( const QString & file, const QString & nifdir, Game::GameMode game )
+{
+	QByteArray data;
+	return find( file, nifdir, data, game );
+}
+
+QString TexCache::find( const QString & file, const QString & nifdir, QByteArray & data, Game::GameMode game )
+{
+	if ( file.isEmpty() )
+		return QString();
+
+	if ( QFile( file ).exists() )
+		return file;
+
+	TexLocation loc = locate( file, nifdir, game );
+
+	// Load textures found in archives into memory
+	if ( loc.archive ) {
+		QByteArray outData;
+		TexDiskCache::get()->fileContents( loc.archive, loc.entry, outData );
 
-		// Remove file extension
-		filename = filename.left( filename.length() - ext.length() );
+		if ( !outData.isEmpty() )
+			data = outData;
 	}
 
-	bool searchFallback = settings.value("Settings/Resources/Other Games Fallback", true).toBool();
-	if ( searchFallback && game != Game::OTHER )
-		return find(file, nifdir, data, Game::OTHER);
+	return loc.path;
+}
 
-	// Fix separators
-	filename = QDir::toNativeSeparators( filename );
+void TexCache::loadSettings()
+{
+	TexFindCache & cache = findCache();
 
-	if ( replaceExt )
-		return filename + extensions.value( 0 ); // Restore original file extension
+	QMutexLocker lock( &cache.mutex );
+	cache.settingsLoaded = false;
+	cache.entries.clear();
+}
 
-	return filename;
+//! Collect the texture paths referenced by the string values below an item
+static void collectTextures( const NifModel * nif, const NifItem * item, QSet<QString> & files )
+{
+	for ( const NifItem * child : item->childIter() ) {
+		if ( child->childCount() ) {
+			// Skip arrays of plain values such as vertex data
+			const NifItem * first = child->child( 0 );
+			if ( child->isArray() && !first->childCount() && !first->isString() )
+				continue;
+
+			collectTextures( nif, child, files );
+		} else if ( child->isString() ) {
+			QString file = nif->resolveString( child );
+			if ( !file.isEmpty() && TexCache::isSupported( file ) )
+				files.insert( file );
+		}
+	}
+}
+
+void TexCache::prefetch( const NifModel * nif )
+{
+	if ( !nif )
+		return;
+
+	// Only these blocks name texture files, the rest are not decoded or walked
+	static const QStringList textureBlocks = {
+		"NiSourceTexture", "NiImage", "BSShaderTextureSet", "BSShaderLightingProperty",
+		"TallGrassShaderProperty", "BSEffectShaderProperty", "BSSkyShaderProperty"
+	};
+
+	Game::GameMode game = Game::GameManager::get_game( nif->getVersionNumber(), nif->getUserVersion(), nif->getBSVersion() );
+	QString nifdir = nif->getFolder();
+
+	QSet<QString> files;
+	for ( int b = 0; b < nif->getBlockCount(); b++ ) {
+		if ( !nif->inherits( nif->getBlockType( b ), textureBlocks ) )
+			continue;
+
+		if ( const NifItem * block = nif->getBlockItem( b ) )
+			collectTextures( nif, block, files );
+	}
+
+	TexFindCache & cache = findCache();
+	{
+		QMutexLocker lock( &cache.mutex );
+		cache.sync();
+
+		// A newly opened or saved file gets another chance at the textures that were missing,
+		// other model resets keep the misses
+		QFileInfo info = nif->getFileInfo();
+		QString loaded = info.absoluteFilePath() + "|" + info.lastModified().toString( Qt::ISODate );
+		if ( cache.lastLoaded != loaded ) {
+			cache.lastLoaded = loaded;
+			for ( const QString & file : files ) {
+				auto it = cache.entries.find( findKey( file, nifdir, game ) );
+				if ( it != cache.entries.end() && !it->found )
+					cache.entries.erase( it );
+			}
+		}
+	}
+
+	// The folder and archive lookups are independent, resolve them all at once
+	QStringList pending = files.toList();
+	QtConcurrent::blockingMap( pending, [&nifdir, game]( const QString & file ) {
+		if ( !QFile( file ).exists() )
+			locate( file, nifdir, game );
+	} );
 }
 
 /*!
@@ -352,6 +587,8 @@ void TexCache::fileChanged( const QString & filepath )
 				tx->reload = true;
 				emit sigRefresh();
 			} else {
+				forget( tx->filepath );
+
 				it.remove();
 
 				if ( tx->id )
@@ -469,6 +706,10 @@ void TexCache::flush()
 
 void TexCache::setNifFolder( const QString & folder )
 {
+	// The relative texture folders now point elsewhere
+	if ( folder != nifFolder )
+		forgetMissing();
+
 	nifFolder = folder;
 	flush();
 	emit sigRefresh();
@@ -121,6 +121,16 @@ public:
 	//! Checks whether the extension is supported
 	static bool isSupported( const QString & file );
 
+	/*! Resolve all texture paths referenced by a NIF in one pass
+	 *
+	 * Fills the lookup cache used by find() so the first draw does not search the folders
+	 * and archives texture by texture. Only the blocks that name textures are read. Textures
+	 * that were missing are searched again the first time a file is seen.
+	 */
+	static void prefetch( const NifModel * nif );
+	//! Reread the texture search settings and drop the lookup cache
+	static void loadSettings();
+
 signals:
 	void sigRefresh();
 
@@ -0,0 +1,1573 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+
+#include "gltexdecode.h"
+
+#include "dxgiformat.h"
+#include "half.h"
+
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentMap>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+
+//! @file gltexdecode.cpp TexDecode
+
+//! Images with fewer pixels are always decoded on the calling thread
+static const qint64 PARALLEL_MIN_PIXELS = 256 * 256;
+//! Rows of blocks, or of pixels for uncompressed formats, per worker task
+static const int ROWS_PER_TASK_BLOCKS = 16;
+static const int ROWS_PER_TASK_PIXELS = 64;
+//! Largest decoded image, well under the QByteArray size limit
+static const qint64 MAX_IMAGE_BYTES = qint64( 1 ) << 30;
+
+namespace
+{
+	inline quint16 readU16( const quint8 * p )
+	{
+		return quint16( p[0] | (p[1] << 8) );
+	}
+
+	inline quint32 readU32( const quint8 * p )
+	{
+		return quint32( p[0] ) | (quint32( p[1] ) << 8) | (quint32( p[2] ) << 16) | (quint32( p[3] ) << 24);
+	}
+
+	inline float readF32( const quint8 * p )
+	{
+		quint32 u = readU32( p );
+		float f;
+		memcpy( &f, &u, sizeof(f) );
+		return f;
+	}
+
+	inline float halfToFloat( quint16 h )
+	{
+		quint32 u = half_to_float( h );
+		float f;
+		memcpy( &f, &u, sizeof(f) );
+		return f;
+	}
+
+	inline quint16 floatToHalf( float f )
+	{
+		quint32 u;
+		memcpy( &u, &f, sizeof(u) );
+		return half_from_float( u );
+	}
+
+	inline quint8 unorm8( float f )
+	{
+		if ( !(f > 0.0f) )
+			return 0;
+		if ( f >= 1.0f )
+			return 255;
+		return quint8( f * 255.0f + 0.5f );
+	}
+
+	//! Scale an n-bit unsigned value to 8 bits
+	inline quint8 expandBits( quint32 v, int bits )
+	{
+		quint32 max = (1u << bits) - 1;
+		return quint8( (v * 255 + max / 2) / max );
+	}
+
+	//! Half float of every 8-bit unorm value, for writing LDR formats to RGBA16F
+	struct HalfTable
+	{
+		HalfTable()
+		{
+			for ( int i = 0; i < 256; i++ )
+				v[i] = floatToHalf( i / 255.0f );
+		}
+
+		quint16 v[256];
+	};
+
+	const HalfTable & halfTable()
+	{
+		static const HalfTable table;
+		return table;
+	}
+
+	//! Reads a 128-bit block LSB first, as BC6H and BC7 are laid out
+	class BlockBits
+	{
+	public:
+		explicit BlockBits( const quint8 * b )
+		{
+			for ( int i = 7; i >= 0; i-- ) {
+				lo = (lo << 8) | b[i];
+				hi = (hi << 8) | b[i + 8];
+			}
+		}
+
+		quint32 read( int n )
+		{
+			if ( n <= 0 )
+				return 0;
+
+			quint64 v;
+			if ( pos >= 64 )
+				v = hi >> (pos - 64);
+			else if ( pos + n <= 64 )
+				v = lo >> pos;
+			else
+				v = (lo >> pos) | (hi << (64 - pos));
+
+			pos += n;
+			return quint32( v ) & ((1u << n) - 1);
+		}
+
+	private:
+		quint64 lo = 0;
+		quint64 hi = 0;
+		int pos = 0;
+	};
+
+
+	/*
+	 * BC1-BC5
+	 */
+
+	inline void expand565( quint16 c, quint8 * out )
+	{
+		int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+		out[0] = quint8( (r << 3) | (r >> 2) );
+		out[1] = quint8( (g << 2) | (g >> 4) );
+		out[2] = quint8( (b << 3) | (b >> 2) );
+		out[3] = 255;
+	}
+
+	//! Decode the color half of a BC1-BC3 block, BC1 allows the 3 color + transparent mode
+	void decodeColorBlock( const quint8 * b, quint8 * out, bool bc1 )
+	{
+		quint16 c0 = readU16( b ), c1 = readU16( b + 2 );
+		quint8 pal[4][4];
+		expand565( c0, pal[0] );
+		expand565( c1, pal[1] );
+
+		if ( c0 > c1 || !bc1 ) {
+			for ( int c = 0; c < 3; c++ ) {
+				pal[2][c] = quint8( (2 * pal[0][c] + pal[1][c] + 1) / 3 );
+				pal[3][c] = quint8( (pal[0][c] + 2 * pal[1][c] + 1) / 3 );
+			}
+			pal[2][3] = pal[3][3] = 255;
+		} else {
+			for ( int c = 0; c < 3; c++ ) {
+				pal[2][c] = quint8( (pal[0][c] + pal[1][c] + 1) / 2 );
+				pal[3][c] = 0;
+			}
+			pal[2][3] = 255;
+			pal[3][3] = 0;
+		}
+
+		quint32 idx = readU32( b + 4 );
+		for ( int i = 0; i < 16; i++, idx >>= 2 )
+			memcpy( out + i * 4, pal[idx & 3], 4 );
+	}
+
+	//! Decode a BC3 alpha or BC4 channel into every 4th byte of @p out
+	void decodeUnormChannel( const quint8 * b, quint8 * out )
+	{
+		int a0 = b[0], a1 = b[1];
+		quint8 pal[8] = { quint8( a0 ), quint8( a1 ) };
+		if ( a0 > a1 ) {
+			for ( int k = 1; k < 7; k++ )
+				pal[1 + k] = quint8( ((7 - k) * a0 + k * a1 + 3) / 7 );
+		} else {
+			for ( int k = 1; k < 5; k++ )
+				pal[1 + k] = quint8( ((5 - k) * a0 + k * a1 + 2) / 5 );
+			pal[6] = 0;
+			pal[7] = 255;
+		}
+
+		quint64 idx = 0;
+		for ( int i = 7; i >= 2; i-- )
+			idx = (idx << 8) | b[i];
+		for ( int i = 0; i < 16; i++, idx >>= 3 )
+			out[i * 4] = pal[idx & 7];
+	}
+
+	//! Decode a signed BC4 channel, remapped from [-1, 1] to [0, 255]
+	void decodeSnormChannel( const quint8 * b, quint8 * out )
+	{
+		// -128 and -127 both map to -1.0
+		float a0 = std::max<int>( qint8( b[0] ), -127 ) / 127.0f;
+		float a1 = std::max<int>( qint8( b[1] ), -127 ) / 127.0f;
+		float pal[8] = { a0, a1 };
+		if ( qint8( b[0] ) > qint8( b[1] ) ) {
+			for ( int k = 1; k < 7; k++ )
+				pal[1 + k] = ((7 - k) * a0 + k * a1) / 7.0f;
+		} else {
+			for ( int k = 1; k < 5; k++ )
+				pal[1 + k] = ((5 - k) * a0 + k * a1) / 5.0f;
+			pal[6] = -1.0f;
+			pal[7] = 1.0f;
+		}
+
+		quint8 pal8[8];
+		for ( int k = 0; k < 8; k++ )
+			pal8[k] = unorm8( pal[k] * 0.5f + 0.5f );
+
+		quint64 idx = 0;
+		for ( int i = 7; i >= 2; i-- )
+			idx = (idx << 8) | b[i];
+		for ( int i = 0; i < 16; i++, idx >>= 3 )
+			out[i * 4] = pal8[idx & 7];
+	}
+
+	void decodeBC1( const quint8 * b, quint8 * out )
+	{
+		decodeColorBlock( b, out, true );
+	}
+
+	void decodeBC2( const quint8 * b, quint8 * out )
+	{
+		decodeColorBlock( b + 8, out, false );
+		for ( int i = 0; i < 16; i++ )
+			out[i * 4 + 3] = quint8( ((b[i / 2] >> (4 * (i & 1))) & 15) * 17 );
+	}
+
+	void decodeBC3( const quint8 * b, quint8 * out )
+	{
+		decodeColorBlock( b + 8, out, false );
+		decodeUnormChannel( b, out + 3 );
+	}
+
+	void clearGBA( quint8 * out, bool keepGreen )
+	{
+		for ( int i = 0; i < 16; i++ ) {
+			if ( !keepGreen )
+				out[i * 4 + 1] = 0;
+			out[i * 4 + 2] = 0;
+			out[i * 4 + 3] = 255;
+		}
+	}
+
+	void decodeBC4U( const quint8 * b, quint8 * out )
+	{
+		decodeUnormChannel( b, out );
+		clearGBA( out, false );
+	}
+
+	void decodeBC4S( const quint8 * b, quint8 * out )
+	{
+		decodeSnormChannel( b, out );
+		clearGBA( out, false );
+	}
+
+	void decodeBC5U( const quint8 * b, quint8 * out )
+	{
+		decodeUnormChannel( b, out );
+		decodeUnormChannel( b + 8, out + 1 );
+		clearGBA( out, true );
+	}
+
+	void decodeBC5S( const quint8 * b, quint8 * out )
+	{
+		decodeSnormChannel( b, out );
+		decodeSnormChannel( b + 8, out + 1 );
+		clearGBA( out, true );
+	}
+
+
+	/*
+	 * BC6H and BC7 shared tables
+	 */
+
+	//! Subset of each pixel for the 64 two-subset partitions, one bit per pixel
+	const quint16 partitions2[64] = {
+		0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+		0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+		0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+		0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+		0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+		0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+		0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+		0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22
+	};
+
+	//! Subset of each pixel for the 64 three-subset partitions, two bits per pixel
+	const quint32 partitions3[64] = {
+		0xAA685050, 0x6A5A5040, 0x5A5A4200, 0x5450A0A8, 0xA5A50000, 0xA0A05050, 0x5555A0A0, 0x5A5A5050,
+		0xAA550000, 0xAA555500, 0xAAAA5500, 0x90909090, 0x94949494, 0xA4A4A4A4, 0xA9A59450, 0x2A0A4250,
+		0xA5945040, 0x0A425054, 0xA5A5A500, 0x55A0A0A0, 0xA8A85454, 0x6A6A4040, 0xA4A45000, 0x1A1A0500,
+		0x0050A4A4, 0xAAA59090, 0x14696914, 0x69691400, 0xA08585A0, 0xAA821414, 0x50A4A450, 0x6A5A0200,
+		0xA9A58000, 0x5090A0A8, 0xA8A09050, 0x24242424, 0x00AA5500, 0x24924924, 0x24499224, 0x50A50A50,
+		0x500AA550, 0xAAAA4444, 0x66660000, 0xA5A0A5A0, 0x50A050A0, 0x69286928, 0x44AAAA44, 0x66666600,
+		0xAA444444, 0x54A854A8, 0x95809580, 0x96969600, 0xA85454A8, 0x80959580, 0xAA141414, 0x96960000,
+		0xAAAA1414, 0xA05050A0, 0xA0A5A5A0, 0x96000000, 0x40804080, 0xA9A8A9A8, 0xAAAAAA44, 0x2A4A5254
+	};
+
+	//! Anchor pixel of the second subset of the two-subset partitions
+	const quint8 anchors2[64] = {
+		15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+		15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+		15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+		 6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15
+	};
+
+	//! Anchor pixels of the second and third subsets of the three-subset partitions
+	const quint8 anchors3[2][64] = {
+		{
+			 3,  3, 15, 15,  8,  3, 15, 15,  8,  8,  6,  6,  6,  5,  3,  3,
+			 3,  3,  8, 15,  3,  3,  6, 10,  5,  8,  8,  6,  8,  5, 15, 15,
+			 8, 15,  3,  5,  6, 10,  8, 15, 15,  3, 15,  5, 15, 15, 15, 15,
+			 3, 15,  5,  5,  5,  8,  5, 10,  5, 10,  8, 13, 15, 12,  3,  3
+		},
+		{
+			15,  8,  8,  3, 15, 15,  3,  8, 15, 15, 15, 15, 15, 15, 15,  8,
+			15,  8, 15,  3, 15,  8, 15,  8,  3, 15,  6, 10, 15, 15, 10,  8,
+			15,  3, 15, 10, 10,  8,  9, 10,  6, 15,  8, 15,  3,  6,  6,  8,
+			15,  3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,  3, 15, 15,  8
+		}
+	};
+
+	const int weights2[4] = { 0, 21, 43, 64 };
+	const int weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+	const int weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	inline const int * weightsFor( int bits )
+	{
+		return bits == 2 ? weights2 : (bits == 3 ? weights3 : weights4);
+	}
+
+	inline int interpolate( int a, int b, int w )
+	{
+		return ((64 - w) * a + w * b + 32) >> 6;
+	}
+
+
+	/*
+	 * BC7
+	 */
+
+	struct BC7Mode
+	{
+		int subsets;
+		int partitionBits;
+		int rotationBits;
+		int selectorBits;
+		int colorBits;
+		int alphaBits;
+		int endpointPBits;
+		int sharedPBits;
+		int indexBits;
+		int index2Bits;
+	};
+
+	const BC7Mode bc7Modes[8] = {
+		{ 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+		{ 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+		{ 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+		{ 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+		{ 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+		{ 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+		{ 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+		{ 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 }
+	};
+
+	void decodeBC7( const quint8 * block, quint8 * out )
+	{
+		BlockBits bits( block );
+
+		int mode = 0;
+		while ( mode < 8 && !bits.read( 1 ) )
+			mode++;
+
+		if ( mode == 8 ) {
+			// Reserved mode
+			memset( out, 0, 64 );
+			return;
+		}
+
+		const BC7Mode & m = bc7Modes[mode];
+		int partition = bits.read( m.partitionBits );
+		int rotation = bits.read( m.rotationBits );
+		int selector = bits.read( m.selectorBits );
+
+		int ep[3][2][4] = {};
+		for ( int c = 0; c < 3; c++ )
+			for ( int s = 0; s < m.subsets; s++ )
+				for ( int e = 0; e < 2; e++ )
+					ep[s][e][c] = bits.read( m.colorBits );
+
+		for ( int s = 0; s < m.subsets; s++ )
+			for ( int e = 0; e < 2; e++ )
+				ep[s][e][3] = bits.read( m.alphaBits );
+
+		int colorBits = m.colorBits, alphaBits = m.alphaBits;
+		if ( m.endpointPBits || m.sharedPBits ) {
+			for ( int s = 0; s < m.subsets; s++ ) {
+				int p[2];
+				p[0] = bits.read( 1 );
+				p[1] = m.endpointPBits ? bits.read( 1 ) : p[0];
+				for ( int e = 0; e < 2; e++ )
+					for ( int c = 0; c < 4; c++ )
+						ep[s][e][c] = (ep[s][e][c] << 1) | p[e];
+			}
+			colorBits++;
+			if ( alphaBits )
+				alphaBits++;
+		}
+
+		for ( int s = 0; s < m.subsets; s++ ) {
+			for ( int e = 0; e < 2; e++ ) {
+				for ( int c = 0; c < 3; c++ )
+					ep[s][e][c] = (ep[s][e][c] << (8 - colorBits)) | (ep[s][e][c] >> (2 * colorBits - 8));
+				if ( alphaBits )
+					ep[s][e][3] = (ep[s][e][3] << (8 - alphaBits)) | (ep[s][e][3] >> (2 * alphaBits - 8));
+				else
+					ep[s][e][3] = 255;
+			}
+		}
+
+		int subset[16];
+		for ( int i = 0; i < 16; i++ ) {
+			if ( m.subsets == 2 )
+				subset[i] = (partitions2[partition] >> i) & 1;
+			else if ( m.subsets == 3 )
+				subset[i] = (partitions3[partition] >> (2 * i)) & 3;
+			else
+				subset[i] = 0;
+		}
+
+		int anchor[3] = { 0, 0, 0 };
+		if ( m.subsets == 2 ) {
+			anchor[1] = anchors2[partition];
+		} else if ( m.subsets == 3 ) {
+			anchor[1] = anchors3[0][partition];
+			anchor[2] = anchors3[1][partition];
+		}
+
+		// The most significant bit of each anchor index is implicitly 0
+		int index[16], index2[16] = {};
+		for ( int i = 0; i < 16; i++ )
+			index[i] = bits.read( m.indexBits - (i == anchor[subset[i]] ? 1 : 0) );
+		if ( m.index2Bits ) {
+			for ( int i = 0; i < 16; i++ )
+				index2[i] = bits.read( m.index2Bits - (i == 0 ? 1 : 0) );
+		}
+
+		const int * cw = weightsFor( m.indexBits );
+		const int * aw = cw;
+		const int * ci = index;
+		const int * ai = index;
+		if ( m.index2Bits ) {
+			aw = weightsFor( m.index2Bits );
+			ai = index2;
+			if ( selector ) {
+				std::swap( cw, aw );
+				std::swap( ci, ai );
+			}
+		}
+
+		for ( int i = 0; i < 16; i++ ) {
+			const int * e0 = ep[subset[i]][0];
+			const int * e1 = ep[subset[i]][1];
+			quint8 * px = out + i * 4;
+
+			for ( int c = 0; c < 3; c++ )
+				px[c] = quint8( interpolate( e0[c], e1[c], cw[ci[i]] ) );
+			px[3] = quint8( interpolate( e0[3], e1[3], aw[ai[i]] ) );
+
+			if ( rotation )
+				std::swap( px[3], px[rotation - 1] );
+		}
+	}
+
+
+	/*
+	 * BC6H
+	 */
+
+	//! Endpoint fields of a BC6H block, W/X for the first subset and Y/Z for the second
+	enum BC6Field : quint8
+	{
+		RW, RX, RY, RZ, GW, GX, GY, GZ, BW, BX, BY, BZ, PART, BC6_END
+	};
+
+	/*! A run of bits of one field
+	 *
+	 * Bits are stored from @c lo to @c hi. When @c hi is less than @c lo the run is
+	 * stored reversed, most significant bit first.
+	 */
+	struct BC6Bits
+	{
+		quint8 field;
+		quint8 hi;
+		quint8 lo;
+	};
+
+	struct BC6Mode
+	{
+		int precision;
+		int delta[3];
+		bool transformed;
+		int subsets;
+		BC6Bits layout[24];
+	};
+
+	// Header layouts following the mode bits, from the BC6H format specification
+	const BC6Mode bc6Modes[14] = {
+		// 0x00
+		{ 10, { 5, 5, 5 }, true, 2, {
+			{ GY, 4, 4 }, { BY, 4, 4 }, { BZ, 4, 4 }, { RW, 9, 0 }, { GW, 9, 0 }, { BW, 9, 0 },
+			{ RX, 4, 0 }, { GZ, 4, 4 }, { GY, 3, 0 }, { GX, 4, 0 }, { BZ, 0, 0 }, { GZ, 3, 0 },
+			{ BX, 4, 0 }, { BZ, 1, 1 }, { BY, 3, 0 }, { RY, 4, 0 }, { BZ, 2, 2 }, { RZ, 4, 0 },
+			{ BZ, 3, 3 }, { PART, 4, 0 }, { BC6_END } } },
+		// 0x01
+		{ 7, { 6, 6, 6 }, true, 2, {
+			{ GY, 5, 5 }, { GZ, 4, 4 }, { GZ, 5, 5 }, { RW, 6, 0 }, { BZ, 0, 0 }, { BZ, 1, 1 },
+			{ BY, 4, 4 }, { GW, 6, 0 }, { BY, 5, 5 }, { BZ, 2, 2 }, { GY, 4, 4 }, { BW, 6, 0 },
+			{ BZ, 3, 3 }, { BZ, 5, 5 }, { BZ, 4, 4 }, { RX, 5, 0 }, { GY, 3, 0 }, { GX, 5, 0 },
+			{ GZ, 3, 0 }, { BX, 5, 0 }, { BY, 3, 0 }, { RY, 5, 0 }, { RZ, 5, 0 }, { PART, 4, 0 } } },
+		// 0x02
+		{ 11, { 5, 4, 4 }, true, 2, {
+			{ RW, 9, 0 }, { GW, 9, 0 }, { BW, 9, 0 }, { RX, 4, 0 }, { RW, 10, 10 }, { GY, 3, 0 },
+			{ GX, 3, 0 }, { GW, 10, 10 }, { BZ, 0, 0 }, { GZ, 3, 0 }, { BX, 3, 0 }, { BW, 10, 10 },
+			{ BZ, 1, 1 }, { BY, 3, 0 }, { RY, 4, 0 }, { BZ, 2, 2 }, { RZ, 4, 0 }, { BZ, 3, 3 },
+			{ PART, 4, 0 }, { BC6_END } } },
+		// 0x06
+		{ 11, { 4, 5, 4 }, true, 2, {
+			{ RW, 9, 0 }, { GW, 9, 0 }, { BW, 9, 0 }, { RX, 3, 0 }, { RW, 10, 10 }, { GZ, 4, 4 },
+			{ GY, 3, 0 }, { GX, 4, 0 }, { GW, 10, 10 }, { GZ, 3, 0 }, { BX, 3, 0 }, { BW, 10, 10 },
+			{ BZ, 1, 1 }, { BY, 3, 0 }, { RY, 3, 0 }, { BZ, 0, 0 }, { BZ, 2, 2 }, { RZ, 3, 0 },
+			{ GY, 4, 4 }, { BZ, 3, 3 }, { PART, 4, 0 }, { BC6_END } } },
+		// 0x0A
+		{ 11, { 4, 4, 5 }, true, 2, {
+			{ RW, 9, 0 }, { GW, 9, 0 }, { BW, 9, 0 }, { RX, 3, 0 }, { RW, 10, 10 }, { BY, 4, 4 },
+			{ GY, 3, 0 }, { GX, 3, 0 }, { GW, 10, 10 }, { BZ, 0, 0 }, { GZ, 3, 0 }, { BX, 4, 0 },
+			{ BW, 10, 10 }, { BY, 3, 0 }, { RY, 3, 0 }, { BZ, 1, 1 }, { BZ, 2, 2 }, { RZ, 3, 0 },
+			{ BZ, 4, 4 }, { BZ, 3, 3 }, { PART, 4, 0 }, { BC6_END } } },
+		// 0x0E
+		{ 9, { 5, 5, 5 }, true, 2, {
+			{ RW, 8, 0 }, { BY, 4, 4 }, { GW, 8, 0 }, { GY, 4, 4 }, { BW, 8, 0 }, { BZ, 4, 4 },
+			{ RX, 4, 0 }, { GZ, 4, 4 }, { GY, 3, 0 }, { GX, 4, 0 }, { BZ, 0, 0 }, { GZ, 3, 0 },
+			{ BX, 4, 0 }, { BZ, 1, 1 }, { BY, 3, 0 }, { RY, 4, 0 }, { BZ, 2, 2 }, { RZ, 4, 0 },
+			{ BZ, 3, 3 }, { PART, 4, 0 }, { BC6_END } } },
+		// 0x12
+		{ 8, { 6, 5, 5 }, true, 2, {
+			{ RW, 7, 0 }, { GZ, 4, 4 }, { BY, 4, 4 }, { GW, 7, 0 }, { BZ, 2, 2 }, { GY, 4, 4 },
+			{ BW, 7, 0 }, { BZ, 3, 3 }, { BZ, 4, 4 }, { RX, 5, 0 }, { GY, 3, 0 }, { GX, 4, 0 },
+			{ BZ, 0, 0 }, { GZ, 3, 0 }, { BX, 4, 0 }, { BZ, 1, 1 }, { BY, 3, 0 }, { RY, 5, 0 },
+			{ RZ, 5, 0 }, { PART, 4, 0 }, { BC6_END } } },
+		// 0x16
+		{ 8, { 5, 6, 5 }, true, 2, {
+			{ RW, 7, 0 }, { BZ, 0, 0 }, { BY, 4, 4 }, { GW, 7, 0 }, { GY, 5, 5 }, { GY, 4, 4 },
+			{ BW, 7, 0 }, { GZ, 5, 5 }, { BZ, 4, 4 }, { RX, 4, 0 }, { GZ, 4, 4 }, { GY, 3, 0 },
+			{ GX, 5, 0 }, { GZ, 3, 0 }, { BX, 4, 0 }, { BZ, 1, 1 }, { BY, 3, 0 }, { RY, 4, 0 },
+			{ BZ, 2, 2 }, { RZ, 4, 0 }, { BZ, 3, 3 }, { PART, 4, 0 }, { BC6_END } } },
+		// 0x1A
+		{ 8, { 5, 5, 6 }, true, 2, {
+			{ RW, 7, 0 }, { BZ, 1, 1 }, { BY, 4, 4 }, { GW, 7, 0 }, { BY, 5, 5 }, { GY, 4, 4 },
+			{ BW, 7, 0 }, { BZ, 5, 5 }, { BZ, 4, 4 }, { RX, 4, 0 }, { GZ, 4, 4 }, { GY, 3, 0 },
+			{ GX, 4, 0 }, { BZ, 0, 0 }, { GZ, 3, 0 }, { BX, 5, 0 }, { BY, 3, 0 }, { RY, 4, 0 },
+			{ BZ, 2, 2 }, { RZ, 4, 0 }, { BZ, 3, 3 }, { PART, 4, 0 }, { BC6_END } } },
+		// 0x1E
+		{ 6, { 6, 6, 6 }, false, 2, {
+			{ RW, 5, 0 }, { GZ, 4, 4 }, { BZ, 0, 0 }, { BZ, 1, 1 }, { BY, 4, 4 }, { GW, 5, 0 },
+			{ GY, 5, 5 }, { BY, 5, 5 }, { BZ, 2, 2 }, { GY, 4, 4 }, { BW, 5, 0 }, { GZ, 5, 5 },
+			{ BZ, 3, 3 }, { BZ, 5, 5 }, { BZ, 4, 4 }, { RX, 5, 0 }, { GY, 3, 0 }, { GX, 5, 0 },
+			{ GZ, 3, 0 }, { BX, 5, 0 }, { BY, 3, 0 }, { RY, 5, 0 }, { RZ, 5, 0 }, { PART, 4, 0 } } },
+		// 0x03
+		{ 10, { 10, 10, 10 }, false, 1, {
+			{ RW, 9, 0 }, { GW, 9, 0 }, { BW, 9, 0 }, { RX, 9, 0 }, { GX, 9, 0 }, { BX, 9, 0 },
+			{ BC6_END } } },
+		// 0x07
+		{ 11, { 9, 9, 9 }, true, 1, {
+			{ RW, 9, 0 }, { GW, 9, 0 }, { BW, 9, 0 }, { RX, 8, 0 }, { RW, 10, 10 }, { GX, 8, 0 },
+			{ GW, 10, 10 }, { BX, 8, 0 }, { BW, 10, 10 }, { BC6_END } } },
+		// 0x0B
+		{ 12, { 8, 8, 8 }, true, 1, {
+			{ RW, 9, 0 }, { GW, 9, 0 }, { BW, 9, 0 }, { RX, 7, 0 }, { RW, 10, 11 }, { GX, 7, 0 },
+			{ GW, 10, 11 }, { BX, 7, 0 }, { BW, 10, 11 }, { BC6_END } } },
+		// 0x0F
+		{ 16, { 4, 4, 4 }, true, 1, {
+			{ RW, 9, 0 }, { GW, 9, 0 }, { BW, 9, 0 }, { RX, 3, 0 }, { RW, 10, 15 }, { GX, 3, 0 },
+			{ GW, 10, 15 }, { BX, 3, 0 }, { BW, 10, 15 }, { BC6_END } } }
+	};
+
+	//! Index into bc6Modes for each 5-bit mode value, -1 for reserved modes
+	int bc6ModeIndex( int modeBits )
+	{
+		switch ( modeBits ) {
+		case 0x00: return 0;
+		case 0x01: return 1;
+		case 0x02: return 2;
+		case 0x06: return 3;
+		case 0x0A: return 4;
+		case 0x0E: return 5;
+		case 0x12: return 6;
+		case 0x16: return 7;
+		case 0x1A: return 8;
+		case 0x1E: return 9;
+		case 0x03: return 10;
+		case 0x07: return 11;
+		case 0x0B: return 12;
+		case 0x0F: return 13;
+		default:   return -1;
+		}
+	}
+
+	inline int signExtend( int v, int bits )
+	{
+		return int( quint32( v ) << (32 - bits) ) >> (32 - bits);
+	}
+
+	int bc6Unquantize( int v, int bits, bool isSigned )
+	{
+		if ( !isSigned ) {
+			if ( bits >= 15 || v == 0 )
+				return v;
+			if ( v == (1 << bits) - 1 )
+				return 0xFFFF;
+			return ((v << 15) + 0x4000) >> (bits - 1);
+		}
+
+		if ( bits >= 16 )
+			return v;
+
+		bool negative = v < 0;
+		if ( negative )
+			v = -v;
+
+		int u;
+		if ( v == 0 )
+			u = 0;
+		else if ( v >= (1 << (bits - 1)) - 1 )
+			u = 0x7FFF;
+		else
+			u = ((v << 15) + 0x4000) >> (bits - 1);
+
+		return negative ? -u : u;
+	}
+
+	inline float bc6Finish( int v, bool isSigned )
+	{
+		quint16 h;
+		if ( !isSigned )
+			h = quint16( (v * 31) >> 6 );
+		else if ( v < 0 )
+			h = quint16( (((-v) * 31) >> 5) | 0x8000 );
+		else
+			h = quint16( (v * 31) >> 5 );
+
+		return halfToFloat( h );
+	}
+
+	void decodeBC6H( const quint8 * block, float * out, bool isSigned )
+	{
+		BlockBits bits( block );
+
+		int modeBits = bits.read( 2 );
+		if ( modeBits > 1 )
+			modeBits |= bits.read( 3 ) << 2;
+
+		int modeIndex = bc6ModeIndex( modeBits );
+		if ( modeIndex < 0 ) {
+			memset( out, 0, 64 * sizeof(float) );
+			for ( int i = 0; i < 16; i++ )
+				out[i * 4 + 3] = 1.0f;
+			return;
+		}
+
+		const BC6Mode & m = bc6Modes[modeIndex];
+
+		int fields[BC6_END] = {};
+		for ( const BC6Bits & run : m.layout ) {
+			if ( run.field == BC6_END )
+				break;
+
+			if ( run.hi >= run.lo ) {
+				for ( int b = run.lo; b <= run.hi; b++ )
+					fields[run.field] |= bits.read( 1 ) << b;
+			} else {
+				for ( int b = run.lo; b >= run.hi; b-- )
+					fields[run.field] |= bits.read( 1 ) << b;
+			}
+		}
+
+		// Endpoints W, X, Y, Z by channel
+		const int endpoints = m.subsets * 2;
+		int ep[4][3];
+		for ( int e = 0; e < endpoints; e++ ) {
+			ep[e][0] = fields[RW + e];
+			ep[e][1] = fields[GW + e];
+			ep[e][2] = fields[BW + e];
+		}
+
+		const int mask = (1 << m.precision) - 1;
+		for ( int c = 0; c < 3; c++ ) {
+			if ( isSigned )
+				ep[0][c] = signExtend( ep[0][c], m.precision );
+
+			for ( int e = 1; e < endpoints; e++ ) {
+				if ( m.transformed ) {
+					ep[e][c] = (ep[0][c] + signExtend( ep[e][c], m.delta[c] )) & mask;
+					if ( isSigned )
+						ep[e][c] = signExtend( ep[e][c], m.precision );
+				} else if ( isSigned ) {
+					ep[e][c] = signExtend( ep[e][c], m.precision );
+				}
+			}
+		}
+
+		for ( int e = 0; e < endpoints; e++ )
+			for ( int c = 0; c < 3; c++ )
+				ep[e][c] = bc6Unquantize( ep[e][c], m.precision, isSigned );
+
+		int partition = fields[PART];
+		int anchor = m.subsets == 2 ? anchors2[partition] : 0;
+		int indexBits = m.subsets == 2 ? 3 : 4;
+		const int * w = weightsFor( indexBits );
+
+		for ( int i = 0; i < 16; i++ ) {
+			int s = m.subsets == 2 ? ((partitions2[partition] >> i) & 1) : 0;
+			int idx = bits.read( indexBits - ((i == 0 || (s == 1 && i == anchor)) ? 1 : 0) );
+
+			for ( int c = 0; c < 3; c++ )
+				out[i * 4 + c] = bc6Finish( interpolate( ep[s * 2][c], ep[s * 2 + 1][c], w[idx] ), isSigned );
+			out[i * 4 + 3] = 1.0f;
+		}
+	}
+
+	void decodeBC6HU( const quint8 * b, float * out )
+	{
+		decodeBC6H( b, out, false );
+	}
+
+	void decodeBC6HS( const quint8 * b, float * out )
+	{
+		decodeBC6H( b, out, true );
+	}
+
+
+	/*
+	 * Uncompressed formats
+	 */
+
+	void pixelRGBA8( const quint8 * p, quint8 * out )
+	{
+		memcpy( out, p, 4 );
+	}
+
+	void pixelBGRA8( const quint8 * p, quint8 * out )
+	{
+		out[0] = p[2]; out[1] = p[1]; out[2] = p[0]; out[3] = p[3];
+	}
+
+	void pixelBGRX8( const quint8 * p, quint8 * out )
+	{
+		out[0] = p[2]; out[1] = p[1]; out[2] = p[0]; out[3] = 255;
+	}
+
+	void pixelRG8( const quint8 * p, quint8 * out )
+	{
+		out[0] = p[0]; out[1] = p[1]; out[2] = 0; out[3] = 255;
+	}
+
+	void pixelR8( const quint8 * p, quint8 * out )
+	{
+		out[0] = p[0]; out[1] = 0; out[2] = 0; out[3] = 255;
+	}
+
+	void pixelA8( const quint8 * p, quint8 * out )
+	{
+		out[0] = 0; out[1] = 0; out[2] = 0; out[3] = p[0];
+	}
+
+	void pixelB5G6R5( const quint8 * p, quint8 * out )
+	{
+		expand565( readU16( p ), out );
+	}
+
+	void pixelB5G5R5A1( const quint8 * p, quint8 * out )
+	{
+		quint16 v = readU16( p );
+		out[0] = expandBits( (v >> 10) & 31, 5 );
+		out[1] = expandBits( (v >> 5) & 31, 5 );
+		out[2] = expandBits( v & 31, 5 );
+		out[3] = (v & 0x8000) ? 255 : 0;
+	}
+
+	void pixelB4G4R4A4( const quint8 * p, quint8 * out )
+	{
+		quint16 v = readU16( p );
+		out[0] = quint8( ((v >> 8) & 15) * 17 );
+		out[1] = quint8( ((v >> 4) & 15) * 17 );
+		out[2] = quint8( (v & 15) * 17 );
+		out[3] = quint8( ((v >> 12) & 15) * 17 );
+	}
+
+	void pixelRGBA32F( const quint8 * p, float * out )
+	{
+		for ( int c = 0; c < 4; c++ )
+			out[c] = readF32( p + c * 4 );
+	}
+
+	void pixelRGB32F( const quint8 * p, float * out )
+	{
+		for ( int c = 0; c < 3; c++ )
+			out[c] = readF32( p + c * 4 );
+		out[3] = 1.0f;
+	}
+
+	void pixelRG32F( const quint8 * p, float * out )
+	{
+		out[0] = readF32( p );
+		out[1] = readF32( p + 4 );
+		out[2] = 0.0f;
+		out[3] = 1.0f;
+	}
+
+	void pixelR32F( const quint8 * p, float * out )
+	{
+		out[0] = readF32( p );
+		out[1] = out[2] = 0.0f;
+		out[3] = 1.0f;
+	}
+
+	void pixelRGBA16F( const quint8 * p, float * out )
+	{
+		for ( int c = 0; c < 4; c++ )
+			out[c] = halfToFloat( readU16( p + c * 2 ) );
+	}
+
+	void pixelRG16F( const quint8 * p, float * out )
+	{
+		out[0] = halfToFloat( readU16( p ) );
+		out[1] = halfToFloat( readU16( p + 2 ) );
+		out[2] = 0.0f;
+		out[3] = 1.0f;
+	}
+
+	void pixelR16F( const quint8 * p, float * out )
+	{
+		out[0] = halfToFloat( readU16( p ) );
+		out[1] = out[2] = 0.0f;
+		out[3] = 1.0f;
+	}
+
+	void pixelRGBA16( const quint8 * p, float * out )
+	{
+		for ( int c = 0; c < 4; c++ )
+			out[c] = readU16( p + c * 2 ) / 65535.0f;
+	}
+
+	void pixelRG16( const quint8 * p, float * out )
+	{
+		out[0] = readU16( p ) / 65535.0f;
+		out[1] = readU16( p + 2 ) / 65535.0f;
+		out[2] = 0.0f;
+		out[3] = 1.0f;
+	}
+
+	void pixelR16( const quint8 * p, float * out )
+	{
+		out[0] = readU16( p ) / 65535.0f;
+		out[1] = out[2] = 0.0f;
+		out[3] = 1.0f;
+	}
+
+	void pixelRGB10A2( const quint8 * p, float * out )
+	{
+		quint32 v = readU32( p );
+		out[0] = (v & 1023) / 1023.0f;
+		out[1] = ((v >> 10) & 1023) / 1023.0f;
+		out[2] = ((v >> 20) & 1023) / 1023.0f;
+		out[3] = (v >> 30) / 3.0f;
+	}
+
+	void pixelRG11B10F( const quint8 * p, float * out )
+	{
+		// Same exponent bias as half floats, without the sign and with a shorter mantissa
+		quint32 v = readU32( p );
+		out[0] = halfToFloat( quint16( (v & 0x7FF) << 4 ) );
+		out[1] = halfToFloat( quint16( ((v >> 11) & 0x7FF) << 4 ) );
+		out[2] = halfToFloat( quint16( ((v >> 22) & 0x3FF) << 5 ) );
+		out[3] = 1.0f;
+	}
+
+	void pixelRGB9E5( const quint8 * p, float * out )
+	{
+		quint32 v = readU32( p );
+		float scale = std::ldexp( 1.0f, int( v >> 27 ) - 15 - 9 );
+		out[0] = (v & 511) * scale;
+		out[1] = ((v >> 9) & 511) * scale;
+		out[2] = ((v >> 18) & 511) * scale;
+		out[3] = 1.0f;
+	}
+
+
+	//! How to decode a DXGI_FORMAT, either per 4x4 block or per pixel
+	struct Decoder
+	{
+		//! Bytes per block, or per pixel
+		int bytes = 0;
+		bool compressed = false;
+		bool hdr = false;
+
+		void (*blockLDR)(const quint8 *, quint8 *) = nullptr;
+		void (*blockHDR)(const quint8 *, float *) = nullptr;
+		void (*pixelLDR)(const quint8 *, quint8 *) = nullptr;
+		void (*pixelHDR)(const quint8 *, float *) = nullptr;
+
+		bool isValid() const { return bytes > 0; }
+	};
+
+	Decoder block( int bytes, void (*fn)(const quint8 *, quint8 *) )
+	{
+		Decoder d;
+		d.bytes = bytes;
+		d.compressed = true;
+		d.blockLDR = fn;
+		return d;
+	}
+
+	Decoder block( int bytes, void (*fn)(const quint8 *, float *) )
+	{
+		Decoder d;
+		d.bytes = bytes;
+		d.compressed = true;
+		d.hdr = true;
+		d.blockHDR = fn;
+		return d;
+	}
+
+	Decoder pixel( int bytes, void (*fn)(const quint8 *, quint8 *) )
+	{
+		Decoder d;
+		d.bytes = bytes;
+		d.pixelLDR = fn;
+		return d;
+	}
+
+	Decoder pixel( int bytes, void (*fn)(const quint8 *, float *), bool hdr )
+	{
+		Decoder d;
+		d.bytes = bytes;
+		d.hdr = hdr;
+		d.pixelHDR = fn;
+		return d;
+	}
+
+	Decoder decoderFor( quint32 format )
+	{
+		switch ( format ) {
+		case DXGI_FORMAT_BC1_TYPELESS:
+		case DXGI_FORMAT_BC1_UNORM:
+		case DXGI_FORMAT_BC1_UNORM_SRGB:
+			return block( 8, decodeBC1 );
+		case DXGI_FORMAT_BC2_TYPELESS:
+		case DXGI_FORMAT_BC2_UNORM:
+		case DXGI_FORMAT_BC2_UNORM_SRGB:
+			return block( 16, decodeBC2 );
+		case DXGI_FORMAT_BC3_TYPELESS:
+		case DXGI_FORMAT_BC3_UNORM:
+		case DXGI_FORMAT_BC3_UNORM_SRGB:
+			return block( 16, decodeBC3 );
+		case DXGI_FORMAT_BC4_TYPELESS:
+		case DXGI_FORMAT_BC4_UNORM:
+			return block( 8, decodeBC4U );
+		case DXGI_FORMAT_BC4_SNORM:
+			return block( 8, decodeBC4S );
+		case DXGI_FORMAT_BC5_TYPELESS:
+		case DXGI_FORMAT_BC5_UNORM:
+			return block( 16, decodeBC5U );
+		case DXGI_FORMAT_BC5_SNORM:
+			return block( 16, decodeBC5S );
+		case DXGI_FORMAT_BC6H_TYPELESS:
+		case DXGI_FORMAT_BC6H_UF16:
+			return block( 16, decodeBC6HU );
+		case DXGI_FORMAT_BC6H_SF16:
+			return block( 16, decodeBC6HS );
+		case DXGI_FORMAT_BC7_TYPELESS:
+		case DXGI_FORMAT_BC7_UNORM:
+		case DXGI_FORMAT_BC7_UNORM_SRGB:
+			return block( 16, decodeBC7 );
+
+		case DXGI_FORMAT_R8G8B8A8_TYPELESS:
+		case DXGI_FORMAT_R8G8B8A8_UNORM:
+		case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+			return pixel( 4, pixelRGBA8 );
+		case DXGI_FORMAT_B8G8R8A8_TYPELESS:
+		case DXGI_FORMAT_B8G8R8A8_UNORM:
+		case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+			return pixel( 4, pixelBGRA8 );
+		case DXGI_FORMAT_B8G8R8X8_TYPELESS:
+		case DXGI_FORMAT_B8G8R8X8_UNORM:
+		case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+			return pixel( 4, pixelBGRX8 );
+		case DXGI_FORMAT_R8G8_TYPELESS:
+		case DXGI_FORMAT_R8G8_UNORM:
+			return pixel( 2, pixelRG8 );
+		case DXGI_FORMAT_R8_TYPELESS:
+		case DXGI_FORMAT_R8_UNORM:
+			return pixel( 1, pixelR8 );
+		case DXGI_FORMAT_A8_UNORM:
+			return pixel( 1, pixelA8 );
+		case DXGI_FORMAT_B5G6R5_UNORM:
+			return pixel( 2, pixelB5G6R5 );
+		case DXGI_FORMAT_B5G5R5A1_UNORM:
+			return pixel( 2, pixelB5G5R5A1 );
+		case DXGI_FORMAT_B4G4R4A4_UNORM:
+			return pixel( 2, pixelB4G4R4A4 );
+
+		case DXGI_FORMAT_R32G32B32A32_FLOAT:
+			return pixel( 16, pixelRGBA32F, true );
+		case DXGI_FORMAT_R32G32B32_FLOAT:
+			return pixel( 12, pixelRGB32F, true );
+		case DXGI_FORMAT_R32G32_FLOAT:
+			return pixel( 8, pixelRG32F, true );
+		case DXGI_FORMAT_R32_FLOAT:
+			return pixel( 4, pixelR32F, true );
+		case DXGI_FORMAT_R16G16B16A16_FLOAT:
+			return pixel( 8, pixelRGBA16F, true );
+		case DXGI_FORMAT_R16G16_FLOAT:
+			return pixel( 4, pixelRG16F, true );
+		case DXGI_FORMAT_R16_FLOAT:
+			return pixel( 2, pixelR16F, true );
+		case DXGI_FORMAT_R11G11B10_FLOAT:
+			return pixel( 4, pixelRG11B10F, true );
+		case DXGI_FORMAT_R9G9B9E5_SHAREDEXP:
+			return pixel( 4, pixelRGB9E5, true );
+		case DXGI_FORMAT_R16G16B16A16_UNORM:
+			return pixel( 8, pixelRGBA16, false );
+		case DXGI_FORMAT_R16G16_UNORM:
+			return pixel( 4, pixelRG16, false );
+		case DXGI_FORMAT_R16_UNORM:
+			return pixel( 2, pixelR16, false );
+		case DXGI_FORMAT_R10G10B10A2_UNORM:
+			return pixel( 4, pixelRGB10A2, false );
+
+		default:
+			return Decoder();
+		}
+	}
+
+
+	/*
+	 * Output
+	 */
+
+	inline void store( const quint8 * rgba, char * dst, TexDecode::Target target )
+	{
+		if ( target == TexDecode::RGBA8 ) {
+			memcpy( dst, rgba, 4 );
+		} else {
+			const quint16 * t = halfTable().v;
+			quint16 h[4] = { t[rgba[0]], t[rgba[1]], t[rgba[2]], t[rgba[3]] };
+			memcpy( dst, h, sizeof(h) );
+		}
+	}
+
+	inline void store( const float * rgba, char * dst, TexDecode::Target target )
+	{
+		if ( target == TexDecode::RGBA8 ) {
+			for ( int c = 0; c < 4; c++ )
+				dst[c] = char( unorm8( rgba[c] ) );
+		} else {
+			quint16 h[4] = { floatToHalf( rgba[0] ), floatToHalf( rgba[1] ), floatToHalf( rgba[2] ), floatToHalf( rgba[3] ) };
+			memcpy( dst, h, sizeof(h) );
+		}
+	}
+
+	inline int bytesPerPixel( TexDecode::Target target )
+	{
+		return target == TexDecode::RGBA8 ? 4 : 8;
+	}
+
+	//! Size the pixels of @p out for its dimensions and target, false if the image is too large
+	bool allocPixels( TexDecode::Image & out )
+	{
+		qint64 bytes = qint64( out.width ) * out.height * bytesPerPixel( out.target );
+		if ( out.width <= 0 || out.height <= 0 || bytes > MAX_IMAGE_BYTES )
+			return false;
+
+		out.pixels.resize( int( bytes ) );
+		return true;
+	}
+
+	//! Run @p fn( firstRow, endRow ) over @p rows, split across the global thread pool when @p parallel
+	template <typename Fn> void forRows( int rows, int rowsPerTask, bool parallel, Fn fn )
+	{
+		if ( !parallel || rows <= rowsPerTask || QThreadPool::globalInstance()->maxThreadCount() < 2 ) {
+			fn( 0, rows );
+			return;
+		}
+
+		QVector<int> tasks;
+		for ( int r = 0; r < rows; r += rowsPerTask )
+			tasks.append( r );
+
+		QtConcurrent::blockingMap( tasks, [&]( const int & first ) {
+			fn( first, std::min( first + rowsPerTask, rows ) );
+		} );
+	}
+
+	//! Decode a legacy DDS bitmask format, luminance is replicated to RGB
+	void decodeMasked( const TexDecode::DDSInfo & info, const quint8 * src, int width, int height,
+	                   TexDecode::Image & out, bool parallel )
+	{
+		int shift[4], bits[4];
+		for ( int c = 0; c < 4; c++ ) {
+			quint32 m = info.masks[c];
+			shift[c] = bits[c] = 0;
+			if ( !m )
+				continue;
+			while ( !(m & 1) ) {
+				m >>= 1;
+				shift[c]++;
+			}
+			while ( m & 1 ) {
+				m >>= 1;
+				bits[c]++;
+			}
+		}
+
+		const int bpp = info.bitCount / 8;
+		const int stride = bytesPerPixel( out.target );
+		char * dst = out.pixels.data();
+
+		forRows( height, ROWS_PER_TASK_PIXELS, parallel, [&]( int first, int last ) {
+			for ( int y = first; y < last; y++ ) {
+				const quint8 * p = src + qint64( y ) * width * bpp;
+				char * d = dst + qint64( y ) * width * stride;
+				for ( int x = 0; x < width; x++, p += bpp, d += stride ) {
+					quint32 v = 0;
+					for ( int i = bpp - 1; i >= 0; i-- )
+						v = (v << 8) | p[i];
+
+					quint8 ch[4];
+					for ( int c = 0; c < 4; c++ ) {
+						quint32 x = (v >> shift[c]) & quint32( (quint64( 1 ) << bits[c]) - 1 );
+						// Keep the top 8 bits of wider channels
+						if ( bits[c] > 8 )
+							ch[c] = quint8( x >> (bits[c] - 8) );
+						else
+							ch[c] = bits[c] ? expandBits( x, bits[c] ) : 0;
+					}
+
+					quint8 rgba[4];
+					if ( info.luminance )
+						rgba[0] = rgba[1] = rgba[2] = ch[0];
+					else
+						memcpy( rgba, ch, 3 );
+					rgba[3] = bits[3] ? ch[3] : 255;
+
+					store( rgba, d, out.target );
+				}
+			}
+		} );
+	}
+}
+
+
+QImage TexDecode::Image::toImage() const
+{
+	if ( isNull() )
+		return QImage();
+
+	QImage img( width, height, QImage::Format_RGBA8888 );
+	if ( img.isNull() )
+		return img;
+
+	for ( int y = 0; y < height; y++ ) {
+		uchar * line = img.scanLine( y );
+		if ( target == RGBA8 ) {
+			memcpy( line, pixels.constData() + qint64( y ) * width * 4, size_t( width ) * 4 );
+		} else {
+			const quint8 * src = reinterpret_cast<const quint8 *>(pixels.constData()) + qint64( y ) * width * 8;
+			for ( int i = 0; i < width * 4; i++ )
+				line[i] = unorm8( halfToFloat( readU16( src + i * 2 ) ) );
+		}
+	}
+
+	return img;
+}
+
+bool TexDecode::isSupported( quint32 format )
+{
+	return decoderFor( format ).isValid();
+}
+
+bool TexDecode::isCompressed( quint32 format )
+{
+	return decoderFor( format ).compressed;
+}
+
+bool TexDecode::isHDR( quint32 format )
+{
+	return decoderFor( format ).hdr;
+}
+
+qint64 TexDecode::levelSize( quint32 format, int width, int height )
+{
+	Decoder d = decoderFor( format );
+	if ( !d.isValid() || width <= 0 || height <= 0 )
+		return 0;
+
+	if ( d.compressed )
+		return qint64( (width + 3) / 4 ) * ((height + 3) / 4) * d.bytes;
+
+	return qint64( width ) * height * d.bytes;
+}
+
+bool TexDecode::decode( quint32 format, const char * src, qint64 size, int width, int height,
+                        Image & out, Target target, bool parallel )
+{
+	out = Image();
+
+	Decoder d = decoderFor( format );
+	qint64 needed = levelSize( format, width, height );
+	if ( !d.isValid() || !src || needed == 0 || size < needed )
+		return false;
+
+	const int stride = bytesPerPixel( target );
+	out.width = width;
+	out.height = height;
+	out.target = target;
+	if ( !allocPixels( out ) ) {
+		out = Image();
+		return false;
+	}
+
+	const quint8 * in = reinterpret_cast<const quint8 *>(src);
+	char * dst = out.pixels.data();
+	parallel = parallel && qint64( width ) * height >= PARALLEL_MIN_PIXELS;
+
+	if ( d.compressed ) {
+		const int blocksX = (width + 3) / 4;
+		const int blocksY = (height + 3) / 4;
+
+		forRows( blocksY, ROWS_PER_TASK_BLOCKS, parallel, [&]( int first, int last ) {
+			quint8 ldr[64];
+			float hdr[64];
+
+			for ( int by = first; by < last; by++ ) {
+				for ( int bx = 0; bx < blocksX; bx++ ) {
+					const quint8 * b = in + (qint64( by ) * blocksX + bx) * d.bytes;
+					if ( d.blockLDR )
+						d.blockLDR( b, ldr );
+					else
+						d.blockHDR( b, hdr );
+
+					// Clip blocks on the right and bottom edges of non-multiple of 4 sizes
+					const int w = std::min( 4, width - bx * 4 );
+					const int h = std::min( 4, height - by * 4 );
+					for ( int y = 0; y < h; y++ ) {
+						char * row = dst + (qint64( by * 4 + y ) * width + bx * 4) * stride;
+						for ( int x = 0; x < w; x++ ) {
+							if ( d.blockLDR )
+								store( ldr + (y * 4 + x) * 4, row + x * stride, target );
+							else
+								store( hdr + (y * 4 + x) * 4, row + x * stride, target );
+						}
+					}
+				}
+			}
+		} );
+	} else {
+		forRows( height, ROWS_PER_TASK_PIXELS, parallel, [&]( int first, int last ) {
+			quint8 ldr[4];
+			float hdr[4];
+
+			for ( int y = first; y < last; y++ ) {
+				const quint8 * p = in + qint64( y ) * width * d.bytes;
+				char * row = dst + qint64( y ) * width * stride;
+				for ( int x = 0; x < width; x++, p += d.bytes, row += stride ) {
+					if ( d.pixelLDR ) {
+						d.pixelLDR( p, ldr );
+						store( ldr, row, target );
+					} else {
+						d.pixelHDR( p, hdr );
+						store( hdr, row, target );
+					}
+				}
+			}
+		} );
+	}
+
+	return true;
+}
+
+//! Map a legacy DDS FourCC to its DXGI_FORMAT
+static quint32 formatFromFourCC( quint32 fourCC )
+{
+	switch ( fourCC ) {
+	case 0x31545844: // DXT1
+		return DXGI_FORMAT_BC1_UNORM;
+	case 0x32545844: // DXT2
+	case 0x33545844: // DXT3
+		return DXGI_FORMAT_BC2_UNORM;
+	case 0x34545844: // DXT4
+	case 0x35545844: // DXT5
+		return DXGI_FORMAT_BC3_UNORM;
+	case 0x31495441: // ATI1
+	case 0x55344342: // BC4U
+		return DXGI_FORMAT_BC4_UNORM;
+	case 0x53344342: // BC4S
+		return DXGI_FORMAT_BC4_SNORM;
+	case 0x32495441: // ATI2
+	case 0x55354342: // BC5U
+		return DXGI_FORMAT_BC5_UNORM;
+	case 0x53354342: // BC5S
+		return DXGI_FORMAT_BC5_SNORM;
+	// D3DFORMAT values
+	case 36:  // D3DFMT_A16B16G16R16
+		return DXGI_FORMAT_R16G16B16A16_UNORM;
+	case 111: // D3DFMT_R16F
+		return DXGI_FORMAT_R16_FLOAT;
+	case 112: // D3DFMT_G16R16F
+		return DXGI_FORMAT_R16G16_FLOAT;
+	case 113: // D3DFMT_A16B16G16R16F
+		return DXGI_FORMAT_R16G16B16A16_FLOAT;
+	case 114: // D3DFMT_R32F
+		return DXGI_FORMAT_R32_FLOAT;
+	case 115: // D3DFMT_G32R32F
+		return DXGI_FORMAT_R32G32_FLOAT;
+	case 116: // D3DFMT_A32B32G32R32F
+		return DXGI_FORMAT_R32G32B32A32_FLOAT;
+	default:
+		return DXGI_FORMAT_UNKNOWN;
+	}
+}
+
+QString TexDecode::formatName( quint32 format )
+{
+	switch ( format ) {
+	case DXGI_FORMAT_UNKNOWN: return QStringLiteral( "Legacy" );
+	case DXGI_FORMAT_BC1_TYPELESS: return QStringLiteral( "BC1_TYPELESS" );
+	case DXGI_FORMAT_BC1_UNORM: return QStringLiteral( "BC1_UNORM" );
+	case DXGI_FORMAT_BC1_UNORM_SRGB: return QStringLiteral( "BC1_UNORM_SRGB" );
+	case DXGI_FORMAT_BC2_TYPELESS: return QStringLiteral( "BC2_TYPELESS" );
+	case DXGI_FORMAT_BC2_UNORM: return QStringLiteral( "BC2_UNORM" );
+	case DXGI_FORMAT_BC2_UNORM_SRGB: return QStringLiteral( "BC2_UNORM_SRGB" );
+	case DXGI_FORMAT_BC3_TYPELESS: return QStringLiteral( "BC3_TYPELESS" );
+	case DXGI_FORMAT_BC3_UNORM: return QStringLiteral( "BC3_UNORM" );
+	case DXGI_FORMAT_BC3_UNORM_SRGB: return QStringLiteral( "BC3_UNORM_SRGB" );
+	case DXGI_FORMAT_BC4_TYPELESS: return QStringLiteral( "BC4_TYPELESS" );
+	case DXGI_FORMAT_BC4_UNORM: return QStringLiteral( "BC4_UNORM" );
+	case DXGI_FORMAT_BC4_SNORM: return QStringLiteral( "BC4_SNORM" );
+	case DXGI_FORMAT_BC5_TYPELESS: return QStringLiteral( "BC5_TYPELESS" );
+	case DXGI_FORMAT_BC5_UNORM: return QStringLiteral( "BC5_UNORM" );
+	case DXGI_FORMAT_BC5_SNORM: return QStringLiteral( "BC5_SNORM" );
+	case DXGI_FORMAT_BC6H_TYPELESS: return QStringLiteral( "BC6H_TYPELESS" );
+	case DXGI_FORMAT_BC6H_UF16: return QStringLiteral( "BC6H_UF16" );
+	case DXGI_FORMAT_BC6H_SF16: return QStringLiteral( "BC6H_SF16" );
+	case DXGI_FORMAT_BC7_TYPELESS: return QStringLiteral( "BC7_TYPELESS" );
+	case DXGI_FORMAT_BC7_UNORM: return QStringLiteral( "BC7_UNORM" );
+	case DXGI_FORMAT_BC7_UNORM_SRGB: return QStringLiteral( "BC7_UNORM_SRGB" );
+	case DXGI_FORMAT_R8G8B8A8_TYPELESS: return QStringLiteral( "R8G8B8A8_TYPELESS" );
+	case DXGI_FORMAT_R8G8B8A8_UNORM: return QStringLiteral( "R8G8B8A8_UNORM" );
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB: return QStringLiteral( "R8G8B8A8_UNORM_SRGB" );
+	case DXGI_FORMAT_B8G8R8A8_TYPELESS: return QStringLiteral( "B8G8R8A8_TYPELESS" );
+	case DXGI_FORMAT_B8G8R8A8_UNORM: return QStringLiteral( "B8G8R8A8_UNORM" );
+	case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB: return QStringLiteral( "B8G8R8A8_UNORM_SRGB" );
+	case DXGI_FORMAT_B8G8R8X8_TYPELESS: return QStringLiteral( "B8G8R8X8_TYPELESS" );
+	case DXGI_FORMAT_B8G8R8X8_UNORM: return QStringLiteral( "B8G8R8X8_UNORM" );
+	case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB: return QStringLiteral( "B8G8R8X8_UNORM_SRGB" );
+	case DXGI_FORMAT_R8G8_TYPELESS: return QStringLiteral( "R8G8_TYPELESS" );
+	case DXGI_FORMAT_R8G8_UNORM: return QStringLiteral( "R8G8_UNORM" );
+	case DXGI_FORMAT_R8_TYPELESS: return QStringLiteral( "R8_TYPELESS" );
+	case DXGI_FORMAT_R8_UNORM: return QStringLiteral( "R8_UNORM" );
+	case DXGI_FORMAT_A8_UNORM: return QStringLiteral( "A8_UNORM" );
+	case DXGI_FORMAT_B5G6R5_UNORM: return QStringLiteral( "B5G6R5_UNORM" );
+	case DXGI_FORMAT_B5G5R5A1_UNORM: return QStringLiteral( "B5G5R5A1_UNORM" );
+	case DXGI_FORMAT_B4G4R4A4_UNORM: return QStringLiteral( "B4G4R4A4_UNORM" );
+	case DXGI_FORMAT_R32G32B32A32_FLOAT: return QStringLiteral( "R32G32B32A32_FLOAT" );
+	case DXGI_FORMAT_R32G32B32_FLOAT: return QStringLiteral( "R32G32B32_FLOAT" );
+	case DXGI_FORMAT_R32G32_FLOAT: return QStringLiteral( "R32G32_FLOAT" );
+	case DXGI_FORMAT_R32_FLOAT: return QStringLiteral( "R32_FLOAT" );
+	case DXGI_FORMAT_R16G16B16A16_FLOAT: return QStringLiteral( "R16G16B16A16_FLOAT" );
+	case DXGI_FORMAT_R16G16_FLOAT: return QStringLiteral( "R16G16_FLOAT" );
+	case DXGI_FORMAT_R16_FLOAT: return QStringLiteral( "R16_FLOAT" );
+	case DXGI_FORMAT_R11G11B10_FLOAT: return QStringLiteral( "R11G11B10_FLOAT" );
+	case DXGI_FORMAT_R9G9B9E5_SHAREDEXP: return QStringLiteral( "R9G9B9E5_SHAREDEXP" );
+	case DXGI_FORMAT_R16G16B16A16_UNORM: return QStringLiteral( "R16G16B16A16_UNORM" );
+	case DXGI_FORMAT_R16G16_UNORM: return QStringLiteral( "R16G16_UNORM" );
+	case DXGI_FORMAT_R16_UNORM: return QStringLiteral( "R16_UNORM" );
+	case DXGI_FORMAT_R10G10B10A2_UNORM: return QStringLiteral( "R10G10B10A2_UNORM" );
+	default: return QString( "DXGI %1" ).arg( format );
+	}
+}
+
+bool TexDecode::parseDDS( const QByteArray & data, DDSInfo & info )
+{
+	if ( !parseDDSHeader( data.constData(), data.size(), info ) )
+		return false;
+
+	// Tolerate missing trailing mipmaps, but not a missing top level
+	return data.size() >= info.dataOffset + info.levelSizes.at( 0 );
+}
+
+bool TexDecode::parseDDSHeader( const char * data, qint64 size, DDSInfo & info )
+{
+	info = DDSInfo();
+
+	// Magic, 124 byte header
+	const qint64 headerEnd = 4 + 124;
+	if ( !data || size < headerEnd || memcmp( data, "DDS ", 4 ) != 0 )
+		return false;
+
+	const quint8 * h = reinterpret_cast<const quint8 *>(data);
+	auto dword = [h]( int offset ) { return readU32( h + offset ); };
+
+	info.height = int( dword( 12 ) );
+	info.width = int( dword( 16 ) );
+	info.levels = std::max( 1, int( dword( 28 ) ) );
+
+	const quint32 pfFlags = dword( 80 );
+	const quint32 fourCC = dword( 84 );
+	const quint32 caps2 = dword( 112 );
+
+	// DDSCAPS2_VOLUME
+	if ( (caps2 & 0x200000) && dword( 24 ) > 1 )
+		return false;
+
+	info.dataOffset = headerEnd;
+
+	if ( (pfFlags & 0x4) && fourCC == 0x30315844 ) {
+		// DX10 extended header
+		info.dataOffset += 20;
+		if ( size < info.dataOffset )
+			return false;
+
+		info.format = dword( 128 );
+		// D3D10_RESOURCE_DIMENSION_TEXTURE3D
+		if ( dword( 132 ) == 4 )
+			return false;
+
+		info.cube = dword( 136 ) & 0x4;
+		info.faces = std::max( 1, int( dword( 140 ) ) ) * (info.cube ? 6 : 1);
+	} else {
+		if ( pfFlags & 0x4 ) {
+			info.format = formatFromFourCC( fourCC );
+			if ( info.format == DXGI_FORMAT_UNKNOWN )
+				return false;
+		} else if ( pfFlags & (0x40 | 0x20000 | 0x2) ) {
+			// DDPF_RGB, DDPF_LUMINANCE, DDPF_ALPHA
+			info.bitCount = int( dword( 88 ) );
+			if ( info.bitCount != 8 && info.bitCount != 16 && info.bitCount != 24 && info.bitCount != 32 )
+				return false;
+
+			info.luminance = pfFlags & 0x20000;
+			info.masks[0] = dword( 92 );
+			info.masks[1] = dword( 96 );
+			info.masks[2] = dword( 100 );
+			// DDPF_ALPHAPIXELS or DDPF_ALPHA
+			info.masks[3] = (pfFlags & (0x1 | 0x2)) ? dword( 104 ) : 0;
+		} else {
+			return false;
+		}
+
+		// DDSCAPS2_CUBEMAP, counting the faces present
+		if ( caps2 & 0x200 ) {
+			info.cube = true;
+			info.faces = 0;
+			for ( quint32 face = 0x400; face <= 0x8000; face <<= 1 )
+				info.faces += (caps2 & face) ? 1 : 0;
+			info.faces = std::max( 1, info.faces );
+		}
+	}
+
+	if ( info.width <= 0 || info.height <= 0 )
+		return false;
+
+	// Ignore a mipmap count beyond 1x1
+	int maxLevels = 1;
+	while ( (std::max( info.width, info.height ) >> maxLevels) > 0 )
+		maxLevels++;
+	info.levels = std::min( info.levels, maxLevels );
+	if ( info.format != DXGI_FORMAT_UNKNOWN && !isSupported( info.format ) )
+		return false;
+
+	qint64 offset = 0;
+	for ( int level = 0; level < info.levels; level++ ) {
+		int w = std::max( 1, info.width >> level );
+		int h = std::max( 1, info.height >> level );
+		qint64 size = info.format != DXGI_FORMAT_UNKNOWN ? levelSize( info.format, w, h ) : qint64( w ) * h * (info.bitCount / 8);
+
+		info.levelOffsets.append( offset );
+		info.levelSizes.append( size );
+		offset += size;
+	}
+	info.faceSize = offset;
+
+	return true;
+}
+
+bool TexDecode::decodeDDS( const QByteArray & data, const DDSInfo & info, int face, int level,
+                           Image & out, Target target, bool parallel )
+{
+	out = Image();
+	if ( face < 0 || face >= info.faces || level < 0 || level >= info.levels )
+		return false;
+
+	qint64 offset = info.dataOffset + face * info.faceSize + info.levelOffsets.at( level );
+	qint64 size = info.levelSizes.at( level );
+	if ( offset + size > data.size() )
+		return false;
+
+	int w = std::max( 1, info.width >> level );
+	int h = std::max( 1, info.height >> level );
+
+	if ( info.format != DXGI_FORMAT_UNKNOWN )
+		return decode( info.format, data.constData() + offset, size, w, h, out, target, parallel );
+
+	out.width = w;
+	out.height = h;
+	out.target = target;
+	if ( !allocPixels( out ) ) {
+		out = Image();
+		return false;
+	}
+	decodeMasked( info, reinterpret_cast<const quint8 *>(data.constData() + offset), w, h, out,
+	              parallel && qint64( w ) * h >= PARALLEL_MIN_PIXELS );
+	return true;
+}
+
+bool TexDecode::decodeDDS( const QByteArray & data, int level, Image & out, bool parallel )
+{
+	DDSInfo info;
+	if ( !parseDDS( data, info ) )
+		return false;
+
+	return decodeDDS( data, info, 0, level, out, isHDR( info.format ) ? RGBA16F : RGBA8, parallel );
+}
@@ -0,0 +1,144 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+
+#ifndef GLTEXDECODE_H
+#define GLTEXDECODE_H
+
+#include <QByteArray>
+#include <QImage>
+#include <QString>
+#include <QVector>
+
+
+//! @file gltexdecode.h TexDecode, CPU decoding of DDS textures
+
+/*! CPU decoding of block compressed and uncompressed DDS textures
+ *
+ * Decodes BC1-BC7 and the common uncompressed DXGI formats to RGBA8 or RGBA16F
+ * without a GL context, so it can be used for thumbnails, exports or as a fallback
+ * when the driver cannot upload a format. Formats are identified by their DXGI_FORMAT
+ * value; legacy DDS headers are mapped to it by parseDDS.
+ *
+ * Channels follow the GL conventions for the format, e.g. BC5 decodes to (R, G, 0, 1)
+ * and A8 to (0, 0, 0, A). sRGB formats are returned as stored, without linearization.
+ */
+namespace TexDecode
+{
+	//! Pixel format of a decoded image
+	enum Target
+	{
+		RGBA8,  //!< 8 bits per channel unsigned normalized
+		RGBA16F //!< 16 bits per channel half float
+	};
+
+	//! A decoded image, tightly packed rows from top to bottom
+	struct Image
+	{
+		int width = 0;
+		int height = 0;
+		Target target = RGBA8;
+		QByteArray pixels;
+
+		bool isNull() const { return pixels.isEmpty(); }
+		//! Convert to a QImage, clamping HDR values to [0, 1]
+		QImage toImage() const;
+	};
+
+	//! Layout of a DDS file, as read by parseDDS
+	struct DDSInfo
+	{
+		//! DXGI_FORMAT of the data, DXGI_FORMAT_UNKNOWN for legacy bitmask formats
+		quint32 format = 0;
+		int width = 0;
+		int height = 0;
+		int levels = 1;
+		//! Number of images, i.e. the array size times 6 for cube maps
+		int faces = 1;
+		bool cube = false;
+
+		//! Legacy bitmask layout, used when format is DXGI_FORMAT_UNKNOWN
+		int bitCount = 0;
+		quint32 masks[4] = { 0, 0, 0, 0 };
+		bool luminance = false;
+
+		//! Offset of the first image in the file
+		qint64 dataOffset = 0;
+		//! Size of one image including all of its mipmaps
+		qint64 faceSize = 0;
+		//! Offsets of each mipmap relative to the start of its image
+		QVector<qint64> levelOffsets;
+		QVector<qint64> levelSizes;
+	};
+
+	//! Whether @p format can be decoded
+	bool isSupported( quint32 format );
+	//! Whether @p format is block compressed
+	bool isCompressed( quint32 format );
+	//! Whether @p format can hold values outside [0, 1], and is best decoded to RGBA16F
+	bool isHDR( quint32 format );
+	//! The size in bytes of a @p width x @p height image of @p format, or 0 if unsupported
+	qint64 levelSize( quint32 format, int width, int height );
+
+	/*! Decode a single image
+	 *
+	 * @param format	The DXGI_FORMAT of @p src
+	 * @param src		Image data of at least levelSize( format, width, height ) bytes
+	 * @param size		Size of @p src in bytes
+	 * @param out		Receives the decoded image
+	 * @param target	Pixel format of @p out
+	 * @param parallel	Split large images across the global thread pool
+	 * @return			False if the format is unsupported or @p src is too small
+	 */
+	bool decode( quint32 format, const char * src, qint64 size, int width, int height,
+	             Image & out, Target target, bool parallel = true );
+
+	//! A short name for @p format, e.g. "BC7_UNORM"
+	QString formatName( quint32 format );
+
+	//! Read the header of a DDS file, false if it is invalid, truncated or a volume texture
+	bool parseDDS( const QByteArray & data, DDSInfo & info );
+	/*! Read only the header of a DDS file
+	 *
+	 * Unlike parseDDS the image data does not need to be present, so @p size only has to
+	 * cover the header. Returns the header size in DDSInfo::dataOffset.
+	 */
+	bool parseDDSHeader( const char * data, qint64 size, DDSInfo & info );
+
+	//! Decode mipmap @p level of image @p face of a DDS file parsed by parseDDS
+	bool decodeDDS( const QByteArray & data, const DDSInfo & info, int face, int level,
+	                Image & out, Target target, bool parallel = true );
+	//! Decode mipmap @p level of the first image of a DDS file, to RGBA16F for HDR formats and RGBA8 otherwise
+	bool decodeDDS( const QByteArray & data, int level, Image & out, bool parallel = true );
+}
+
+#endif
@@ -0,0 +1,334 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#include "gltexdiskcache.h"
+
+#include <fsengine/fsengine.h>
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QPair>
+#include <QSaveFile>
+#include <QSet>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QVector>
+
+#include <algorithm>
+
+
+//! @file gltexdiskcache.cpp TexDiskCache
+
+//! Magic of a cached texture file, the literal string "NSTC"
+static const quint32 TEXCACHE_MAGIC = 0x4354534E;
+//! Magic of the LRU index file, the literal string "NSTI"
+static const quint32 TEXCACHE_INDEX_MAGIC = 0x4954534E;
+//! Bump when the payload produced by the archive readers changes
+static const quint32 TEXCACHE_VERSION = 1;
+//! Number of LRU updates between index saves
+static const int TEXCACHE_SAVE_INTERVAL = 64;
+
+static const QString indexName = QStringLiteral( "index.dat" );
+static const QString entrySuffix = QStringLiteral( ".tex" );
+
+
+TexDiskCache::TexDiskCache()
+{
+	cacheDir = QStandardPaths::writableLocation( QStandardPaths::CacheLocation ) + QStringLiteral( "/textures" );
+	loadSettings();
+}
+
+TexDiskCache::~TexDiskCache()
+{
+	QMutexLocker lock( &mutex );
+	if ( indexLoaded && changesSinceSave > 0 )
+		saveIndex();
+}
+
+TexDiskCache * TexDiskCache::get()
+{
+	static TexDiskCache cache;
+	return &cache;
+}
+
+void TexDiskCache::loadSettings()
+{
+	QSettings settings;
+	bool on = settings.value( "Settings/Resources/Texture Disk Cache", false ).toBool();
+	qint64 limit = settings.value( "Settings/Resources/Texture Disk Cache Size", 1024 ).toLongLong() * 1024 * 1024;
+
+	QMutexLocker lock( &mutex );
+	enabled = on;
+	maxBytes = std::max<qint64>( limit, 0 );
+
+	if ( enabled && indexLoaded )
+		evict( maxBytes );
+}
+
+QString TexDiskCache::keyFor( FSArchiveFile * archive, const QString & entry ) const
+{
+	QFileInfo info( archive->path() );
+
+	return QString( "%1|%2|%3|%4" )
+		.arg( QDir::fromNativeSeparators( info.absoluteFilePath() ).toLower() )
+		.arg( info.size() )
+		.arg( info.lastModified().toMSecsSinceEpoch() )
+		.arg( QDir::fromNativeSeparators( entry ).toLower() );
+}
+
+bool TexDiskCache::fileContents( FSArchiveFile * archive, const QString & entry, QByteArray & data )
+{
+	if ( !archive )
+		return false;
+
+	if ( !enabled )
+		return archive->fileContents( entry, data );
+
+	QString key = keyFor( archive, entry );
+	if ( read( key, data ) ) {
+		hitCount.ref();
+		return true;
+	}
+
+	missCount.ref();
+	if ( !archive->fileContents( entry, data ) || data.isEmpty() )
+		return false;
+
+	write( key, data );
+	return true;
+}
+
+static QString entryName( const QString & key )
+{
+	return QString::fromLatin1( QCryptographicHash::hash( key.toUtf8(), QCryptographicHash::Sha1 ).toHex() ) + entrySuffix;
+}
+
+bool TexDiskCache::read( const QString & key, QByteArray & data )
+{
+	QMutexLocker lock( &mutex );
+	loadIndex();
+
+	QString name = entryName( key );
+	auto it = entries.find( name );
+	if ( it == entries.end() )
+		return false;
+
+	QFile f( cacheDir + "/" + name );
+	if ( f.open( QIODevice::ReadOnly ) ) {
+		QDataStream in( &f );
+		quint32 magic, version;
+		QString storedKey;
+		QByteArray payload;
+		in >> magic >> version >> storedKey >> payload;
+
+		// Reject a hash collision or a file from an older payload layout
+		if ( in.status() == QDataStream::Ok && magic == TEXCACHE_MAGIC && version == TEXCACHE_VERSION && storedKey == key ) {
+			data = payload;
+			it->lastUsed = ++useCounter;
+			if ( ++changesSinceSave >= TEXCACHE_SAVE_INTERVAL )
+				saveIndex();
+			return true;
+		}
+		f.close();
+	}
+
+	// Unreadable or stale
+	totalBytes -= it->size;
+	entries.erase( it );
+	QFile::remove( cacheDir + "/" + name );
+	changesSinceSave++;
+	return false;
+}
+
+void TexDiskCache::write( const QString & key, const QByteArray & data )
+{
+	QMutexLocker lock( &mutex );
+	loadIndex();
+
+	if ( qint64( data.size() ) > maxBytes )
+		return;
+
+	if ( !QDir().mkpath( cacheDir ) )
+		return;
+
+	QString name = entryName( key );
+	QSaveFile f( cacheDir + "/" + name );
+	if ( !f.open( QIODevice::WriteOnly ) )
+		return;
+
+	QDataStream out( &f );
+	out << TEXCACHE_MAGIC << TEXCACHE_VERSION << key << data;
+	if ( out.status() != QDataStream::Ok || !f.commit() ) {
+		qWarning() << "TexDiskCache: could not write" << f.fileName();
+		return;
+	}
+
+	qint64 size = QFileInfo( f.fileName() ).size();
+	Entry & e = entries[name];
+	totalBytes += size - e.size;
+	e.size = size;
+	e.lastUsed = ++useCounter;
+	changesSinceSave++;
+
+	evict( maxBytes );
+	if ( changesSinceSave >= TEXCACHE_SAVE_INTERVAL )
+		saveIndex();
+}
+
+void TexDiskCache::clear()
+{
+	QMutexLocker lock( &mutex );
+
+	QDir dir( cacheDir );
+	for ( const QString & name : dir.entryList( { "*" + entrySuffix, indexName }, QDir::Files ) )
+		dir.remove( name );
+
+	entries.clear();
+	totalBytes = 0;
+	useCounter = 0;
+	changesSinceSave = 0;
+	indexLoaded = true;
+}
+
+QString TexDiskCache::stats() const
+{
+	QMutexLocker lock( &mutex );
+	if ( !enabled )
+		return QString();
+
+	return QString( "texture disk cache: %1 hits, %2 misses, %3 MB in %4 files" )
+		.arg( hitCount.load() )
+		.arg( missCount.load() )
+		.arg( double( totalBytes ) / (1024 * 1024), 0, 'f', 1 )
+		.arg( entries.count() );
+}
+
+void TexDiskCache::loadIndex()
+{
+	if ( indexLoaded )
+		return;
+	indexLoaded = true;
+
+	QDir dir( cacheDir );
+	QStringList onDisk = dir.entryList( { "*" + entrySuffix }, QDir::Files, QDir::Time | QDir::Reversed );
+
+	QFile f( dir.filePath( indexName ) );
+	if ( f.open( QIODevice::ReadOnly ) ) {
+		QDataStream in( &f );
+		quint32 magic, version, count;
+		in >> magic >> version >> count;
+		if ( magic == TEXCACHE_INDEX_MAGIC && version == TEXCACHE_VERSION ) {
+			for ( quint32 i = 0; i < count && in.status() == QDataStream::Ok; i++ ) {
+				QString name;
+				Entry e;
+				in >> name >> e.size >> e.lastUsed;
+				entries.insert( name, e );
+				useCounter = std::max( useCounter, e.lastUsed );
+			}
+		}
+	}
+
+	// Drop index entries whose files are gone, and pick up files missing from the index
+	// (e.g. after a crash) as the least recently used ones, oldest first.
+	QSet<QString> present = onDisk.toSet();
+	for ( auto it = entries.begin(); it != entries.end(); ) {
+		if ( present.contains( it.key() ) )
+			++it;
+		else
+			it = entries.erase( it );
+	}
+
+	quint64 order = 0;
+	for ( const QString & name : onDisk ) {
+		order++;
+		if ( !entries.contains( name ) ) {
+			Entry e;
+			e.size = QFileInfo( dir.filePath( name ) ).size();
+			e.lastUsed = order;
+			entries.insert( name, e );
+		}
+	}
+	useCounter += order;
+
+	totalBytes = 0;
+	for ( const Entry & e : entries )
+		totalBytes += e.size;
+
+	if ( enabled )
+		evict( maxBytes );
+}
+
+void TexDiskCache::saveIndex()
+{
+	changesSinceSave = 0;
+	if ( !QDir().mkpath( cacheDir ) )
+		return;
+
+	QSaveFile f( cacheDir + "/" + indexName );
+	if ( !f.open( QIODevice::WriteOnly ) )
+		return;
+
+	QDataStream out( &f );
+	out << TEXCACHE_INDEX_MAGIC << TEXCACHE_VERSION << quint32( entries.count() );
+	for ( auto it = entries.cbegin(); it != entries.cend(); ++it )
+		out << it.key() << it->size << it->lastUsed;
+
+	f.commit();
+}
+
+void TexDiskCache::evict( qint64 limit )
+{
+	if ( totalBytes <= limit )
+		return;
+
+	QVector<QPair<quint64, QString>> lru;
+	lru.reserve( entries.count() );
+	for ( auto it = entries.cbegin(); it != entries.cend(); ++it )
+		lru.append( { it->lastUsed, it.key() } );
+	std::sort( lru.begin(), lru.end() );
+
+	for ( const auto & p : lru ) {
+		if ( totalBytes <= limit )
+			break;
+
+		totalBytes -= entries.value( p.second ).size;
+		entries.remove( p.second );
+		QFile::remove( cacheDir + "/" + p.second );
+	}
+
+	saveIndex();
+}
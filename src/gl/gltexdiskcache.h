@@ -0,0 +1,120 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#ifndef GLTEXDISKCACHE_H
+#define GLTEXDISKCACHE_H
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+
+
+//! @file gltexdiskcache.h TexDiskCache
+
+class FSArchiveFile;
+
+/*! A persistent on-disk cache of texture files extracted from archives.
+ *
+ * Entries hold the payload returned by FSArchiveFile::fileContents, i.e. already
+ * decompressed and, for BA2 textures, with the DDS header rebuilt. They are keyed by
+ * the archive path, size and modification time plus the entry path, so replacing or
+ * updating an archive never returns stale data.
+ *
+ * The cache is bounded in size and evicts the least recently used entries first.
+ */
+class TexDiskCache final
+{
+	TexDiskCache();
+public:
+	TexDiskCache( const TexDiskCache & ) = delete;
+	TexDiskCache & operator=( const TexDiskCache & ) = delete;
+	~TexDiskCache();
+
+	static TexDiskCache * get();
+
+	//! Read "Settings/Resources/Texture Disk Cache" and the size limit
+	void loadSettings();
+	//! Whether the cache is enabled in the settings
+	bool isEnabled() const { return enabled; }
+
+	/*! Get the contents of an archive entry, from the cache when possible
+	 *
+	 * On a miss the entry is extracted from @p archive and stored in the cache.
+	 * When the cache is disabled this is equivalent to FSArchiveFile::fileContents.
+	 */
+	bool fileContents( FSArchiveFile * archive, const QString & entry, QByteArray & data );
+
+	//! Remove all cached files
+	void clear();
+
+	//! Number of lookups served from the cache this session
+	int hits() const { return hitCount.load(); }
+	//! Number of lookups that had to extract from the archive this session
+	int misses() const { return missCount.load(); }
+	//! Summary for the Memory Statistics spell, empty when the cache is disabled
+	QString stats() const;
+
+private:
+	//! A cached file
+	struct Entry
+	{
+		qint64 size = 0;
+		//! Monotonic use counter for LRU ordering
+		quint64 lastUsed = 0;
+	};
+
+	QString keyFor( FSArchiveFile * archive, const QString & entry ) const;
+	bool read( const QString & key, QByteArray & data );
+	void write( const QString & key, const QByteArray & data );
+	void loadIndex();
+	void saveIndex();
+	//! Evict least recently used entries until the cache fits in @p limit bytes
+	void evict( qint64 limit );
+
+	QString cacheDir;
+	bool enabled = false;
+	qint64 maxBytes = 0;
+
+	mutable QMutex mutex;
+	QHash<QString, Entry> entries;
+	qint64 totalBytes = 0;
+	quint64 useCounter = 0;
+	int changesSinceSave = 0;
+	bool indexLoaded = false;
+
+	QAtomicInt hitCount;
+	QAtomicInt missCount;
+};
+
+#endif
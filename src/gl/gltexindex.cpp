@@ -0,0 +1,451 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+
+#include "gltexindex.h"
+
+#include "gltexdecode.h"
+
+#include <fsengine/bsa.h>
+
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QIcon>
+#include <QImage>
+#include <QPixmap>
+#include <QSaveFile>
+#include <QStandardItem>
+#include <QStandardPaths>
+
+#include <algorithm>
+
+
+//! @file gltexindex.cpp TexIndex, TexIndexThread, TexIndexer
+
+//! Magic of an index file, the literal string "NSTX"
+static const quint32 TEXINDEX_MAGIC = 0x5854534E;
+//! Bump when TexIndexEntry or the thumbnails change
+static const quint32 TEXINDEX_VERSION = 1;
+//! Maximum thumbnail width and height
+static const int THUMBNAIL_SIZE = 64;
+//! Pause between two textures, in milliseconds
+static const int THROTTLE_MS = 10;
+//! Number of textures between index saves
+static const int SAVE_INTERVAL = 256;
+
+
+/*
+ * TexIndex
+ */
+
+TexIndex::TexIndex( const QString & archivePath )
+{
+	QFileInfo info( archivePath );
+	QString path = QDir::fromNativeSeparators( info.absoluteFilePath() ).toLower();
+
+	key = QString( "%1|%2|%3" ).arg( path ).arg( info.size() ).arg( info.lastModified().toMSecsSinceEpoch() );
+	// Named by path alone so the index of a changed archive is replaced, not kept alongside
+	filename = cacheDir() + "/"
+		+ QString::fromLatin1( QCryptographicHash::hash( path.toUtf8(), QCryptographicHash::Sha1 ).toHex() ) + ".idx";
+}
+
+QString TexIndex::cacheDir()
+{
+	return QStandardPaths::writableLocation( QStandardPaths::CacheLocation ) + QStringLiteral( "/texindex" );
+}
+
+bool TexIndex::load()
+{
+	QFile f( filename );
+	if ( !f.open( QIODevice::ReadOnly ) )
+		return false;
+
+	QDataStream in( &f );
+	quint32 magic, version, count;
+	QString storedKey;
+	in >> magic >> version >> storedKey >> count;
+	if ( in.status() != QDataStream::Ok || magic != TEXINDEX_MAGIC || version != TEXINDEX_VERSION || storedKey != key )
+		return false;
+
+	QHash<QString, TexIndexEntry> loaded;
+	for ( quint32 i = 0; i < count && in.status() == QDataStream::Ok; i++ ) {
+		QString path;
+		TexIndexEntry e;
+		in >> path >> e.format >> e.width >> e.height >> e.mipmaps >> e.faces >> e.cube >> e.valid >> e.thumbnail;
+		loaded.insert( path, e );
+	}
+
+	if ( in.status() != QDataStream::Ok )
+		return false;
+
+	QMutexLocker lock( &mutex );
+	entries = loaded;
+	modified = false;
+	return true;
+}
+
+bool TexIndex::save()
+{
+	QHash<QString, TexIndexEntry> copy;
+	{
+		QMutexLocker lock( &mutex );
+		if ( !modified )
+			return true;
+		copy = entries;
+		modified = false;
+	}
+
+	if ( !QDir().mkpath( cacheDir() ) )
+		return false;
+
+	QSaveFile f( filename );
+	if ( !f.open( QIODevice::WriteOnly ) )
+		return false;
+
+	QDataStream out( &f );
+	out << TEXINDEX_MAGIC << TEXINDEX_VERSION << key << quint32( copy.count() );
+	for ( auto it = copy.cbegin(); it != copy.cend(); ++it ) {
+		const TexIndexEntry & e = it.value();
+		out << it.key() << e.format << e.width << e.height << e.mipmaps << e.faces << e.cube << e.valid << e.thumbnail;
+	}
+
+	return out.status() == QDataStream::Ok && f.commit();
+}
+
+bool TexIndex::contains( const QString & path ) const
+{
+	QMutexLocker lock( &mutex );
+	return entries.contains( path );
+}
+
+TexIndexEntry TexIndex::value( const QString & path ) const
+{
+	QMutexLocker lock( &mutex );
+	return entries.value( path );
+}
+
+void TexIndex::insert( const QString & path, const TexIndexEntry & entry )
+{
+	QMutexLocker lock( &mutex );
+	entries.insert( path, entry );
+	modified = true;
+}
+
+
+/*
+ * TexIndexThread
+ */
+
+TexIndexThread::TexIndexThread( QObject * parent, BSA * archive, TexIndex * index, const QStringList & paths )
+	: QThread( parent ), archive( archive ), index( index ), queue( paths )
+{
+}
+
+TexIndexThread::~TexIndexThread()
+{
+	abort();
+	wait();
+}
+
+void TexIndexThread::setPaused( bool p )
+{
+	paused.store( p ? 1 : 0 );
+}
+
+void TexIndexThread::abort()
+{
+	aborted.store( 1 );
+}
+
+void TexIndexThread::run()
+{
+	int sinceSave = 0;
+
+	for ( const QString & path : queue ) {
+		while ( paused.load() && !aborted.load() )
+			msleep( 100 );
+
+		if ( aborted.load() )
+			break;
+
+		index->insert( path, indexTexture( archive, path ) );
+		emit indexed( path );
+
+		if ( ++sinceSave >= SAVE_INTERVAL ) {
+			index->save();
+			sinceSave = 0;
+		}
+
+		msleep( THROTTLE_MS );
+	}
+
+	index->save();
+}
+
+//! The smallest mipmap that still covers a thumbnail, or the top level of smaller textures
+static int thumbnailLevel( const TexDecode::DDSInfo & info )
+{
+	int level = 0;
+	while ( level + 1 < info.levels
+	        && std::max( info.width >> (level + 1), info.height >> (level + 1) ) >= THUMBNAIL_SIZE )
+		level++;
+
+	return level;
+}
+
+//! Encode a decoded mipmap as an opaque PNG thumbnail
+static QByteArray makeThumbnail( TexDecode::Image & img )
+{
+	// Alpha usually holds gloss or masks rather than transparency
+	char * px = img.pixels.data();
+	for ( int i = 3; i < img.pixels.size(); i += 4 )
+		px[i] = char( 255 );
+
+	QImage thumb = img.toImage();
+	if ( thumb.width() > THUMBNAIL_SIZE || thumb.height() > THUMBNAIL_SIZE )
+		thumb = thumb.scaled( THUMBNAIL_SIZE, THUMBNAIL_SIZE, Qt::KeepAspectRatio, Qt::SmoothTransformation );
+
+	QByteArray png;
+	QBuffer buf( &png );
+	if ( buf.open( QIODevice::WriteOnly ) )
+		thumb.save( &buf, "PNG" );
+
+	return png;
+}
+
+TexIndexEntry TexIndexThread::indexTexture( BSA * archive, const QString & path )
+{
+	TexIndexEntry e;
+
+	const BSA::BSAFile * file = archive->getFile( path );
+	if ( !file )
+		return e;
+
+	TexDecode::DDSInfo info;
+	QByteArray levelData;
+	int level = 0;
+
+	if ( file->tex.chunks.count() ) {
+		// Fallout 4 textures: the header is in the archive index, and only the chunk
+		// holding the thumbnail mipmap needs to be read
+		const F4TexInfo & h = file->tex.header;
+		info.format = h.format;
+		info.width = h.width;
+		info.height = h.height;
+		info.levels = std::max<int>( h.numMips, 1 );
+		info.cube = h.unk16 == 2049;
+		info.faces = info.cube ? 6 : 1;
+
+		// The face layout of cube map chunks is not known, index those without a thumbnail
+		if ( !info.cube && TexDecode::isSupported( info.format ) && info.width > 0 && info.height > 0 ) {
+			level = thumbnailLevel( info );
+
+			for ( int c = 0; c < file->tex.chunks.count(); c++ ) {
+				const F4TexChunk & chunk = file->tex.chunks.at( c );
+				if ( level < chunk.startMip || level > chunk.endMip )
+					continue;
+
+				QByteArray chunkData;
+				if ( archive->textureChunk( path, c, chunkData ) ) {
+					qint64 offset = 0;
+					for ( int m = chunk.startMip; m < level; m++ )
+						offset += TexDecode::levelSize( info.format, std::max( 1, info.width >> m ), std::max( 1, info.height >> m ) );
+
+					levelData = chunkData.mid( int( offset ),
+						int( TexDecode::levelSize( info.format, std::max( 1, info.width >> level ), std::max( 1, info.height >> level ) ) ) );
+				}
+				break;
+			}
+		}
+	} else {
+		// Read just the header and the thumbnail mipmap when the file is stored uncompressed
+		const qint64 maxHeader = 4 + 124 + 20;
+		QByteArray data;
+		bool partial = archive->fileRange( path, 0, std::min( maxHeader, archive->fileSize( path ) ), data );
+		if ( !partial && !archive->fileContents( path, data ) )
+			return e;
+
+		if ( !TexDecode::parseDDSHeader( data.constData(), data.size(), info ) )
+			return e;
+
+		level = thumbnailLevel( info );
+
+		// First image only, e.g. +X of cube maps
+		qint64 offset = info.dataOffset + info.levelOffsets.at( level );
+		qint64 size = info.levelSizes.at( level );
+		if ( partial )
+			archive->fileRange( path, offset, size, levelData );
+		else if ( offset + size <= data.size() )
+			levelData = data.mid( int( offset ), int( size ) );
+	}
+
+	e.format = info.format;
+	e.width = quint32( info.width );
+	e.height = quint32( info.height );
+	e.mipmaps = quint32( info.levels );
+	e.faces = quint32( info.faces );
+	e.cube = info.cube;
+	e.valid = true;
+
+	if ( levelData.isEmpty() )
+		return e;
+
+	// Describe the single mipmap held by levelData
+	TexDecode::DDSInfo mip = info;
+	mip.width = std::max( 1, info.width >> level );
+	mip.height = std::max( 1, info.height >> level );
+	mip.levels = 1;
+	mip.faces = 1;
+	mip.dataOffset = 0;
+	mip.faceSize = levelData.size();
+	mip.levelOffsets = { 0 };
+	mip.levelSizes = { levelData.size() };
+
+	TexDecode::Image img;
+	if ( TexDecode::decodeDDS( levelData, mip, 0, 0, img, TexDecode::RGBA8, false ) )
+		e.thumbnail = makeThumbnail( img );
+
+	return e;
+}
+
+
+/*
+ * TexIndexer
+ */
+
+TexIndexer::TexIndexer( BSA * archive, BSAModel * model, QObject * parent )
+	: QObject( parent ), index( archive->path() ), model( model )
+{
+	index.load();
+	collect( model->invisibleRootItem() );
+
+	QStringList pending;
+	for ( auto it = rows.cbegin(); it != rows.cend(); ++it ) {
+		if ( index.contains( it.key() ) )
+			fillRow( it.value(), index.value( it.key() ) );
+		else
+			pending.append( it.key() );
+	}
+
+	if ( pending.count() ) {
+		pending.sort();
+
+		thread = new TexIndexThread( this, archive, &index, pending );
+		connect( thread, &TexIndexThread::indexed, this, &TexIndexer::updateRow );
+		thread->start( QThread::LowestPriority );
+	}
+}
+
+TexIndexer::~TexIndexer()
+{
+	// The thread uses the index and the archive, stop it before either goes away
+	if ( thread ) {
+		thread->abort();
+		thread->wait();
+	}
+
+	index.save();
+}
+
+void TexIndexer::setPaused( bool paused )
+{
+	if ( thread )
+		thread->setPaused( paused );
+}
+
+bool TexIndexer::isTexture( const QString & path )
+{
+	return path.endsWith( ".dds", Qt::CaseInsensitive );
+}
+
+void TexIndexer::updateRow( const QString & path )
+{
+	if ( QStandardItem * item = rows.value( path ) )
+		fillRow( item, index.value( path ) );
+}
+
+void TexIndexer::collect( QStandardItem * parent )
+{
+	for ( int r = 0; r < parent->rowCount(); r++ ) {
+		QStandardItem * item = parent->child( r, BSAModel::FileCol );
+		QStandardItem * pathItem = parent->child( r, BSAModel::PathCol );
+		if ( !item )
+			continue;
+
+		if ( item->hasChildren() )
+			collect( item );
+		else if ( pathItem && isTexture( pathItem->text() ) )
+			rows.insert( pathItem->text(), item );
+	}
+}
+
+void TexIndexer::fillRow( QStandardItem * fileItem, const TexIndexEntry & entry )
+{
+	QStandardItem * parent = fileItem->parent() ? fileItem->parent() : model->invisibleRootItem();
+	int row = fileItem->row();
+
+	if ( !entry.valid ) {
+		parent->setChild( row, BSAModel::FormatCol, new QStandardItem( tr( "Unreadable" ) ) );
+		return;
+	}
+
+	QString format = TexDecode::formatName( entry.format );
+	if ( entry.cube )
+		format += tr( " (Cube)" );
+	else if ( entry.faces > 1 )
+		format += tr( " (Array %1)" ).arg( entry.faces );
+
+	auto formatItem = new QStandardItem( format );
+
+	auto dimItem = new QStandardItem( QString( "%1 x %2" ).arg( entry.width ).arg( entry.height ) );
+	dimItem->setData( qint64( entry.width ) * entry.height, BSAModel::SortRole );
+
+	auto mipItem = new QStandardItem( QString::number( entry.mipmaps ) );
+	mipItem->setData( entry.mipmaps, BSAModel::SortRole );
+
+	parent->setChild( row, BSAModel::FormatCol, formatItem );
+	parent->setChild( row, BSAModel::DimensionsCol, dimItem );
+	parent->setChild( row, BSAModel::MipmapsCol, mipItem );
+
+	if ( !entry.thumbnail.isEmpty() ) {
+		QImage img;
+		if ( img.loadFromData( entry.thumbnail, "PNG" ) ) {
+			fileItem->setIcon( QIcon( QPixmap::fromImage( img ) ) );
+			fileItem->setToolTip( QString( "<img src=\"data:image/png;base64,%1\"/><br/>%2, %3 x %4" )
+				.arg( QString::fromLatin1( entry.thumbnail.toBase64() ), format ).arg( entry.width ).arg( entry.height ) );
+		}
+	}
+}
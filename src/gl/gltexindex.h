@@ -0,0 +1,170 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+
+#ifndef GLTEXINDEX_H
+#define GLTEXINDEX_H
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QThread>
+
+
+//! @file gltexindex.h TexIndex, TexIndexThread, TexIndexer
+
+class BSA;
+class BSAModel;
+class QStandardItem;
+
+//! Metadata of a texture inside an archive
+struct TexIndexEntry
+{
+	//! DXGI_FORMAT, DXGI_FORMAT_UNKNOWN for legacy bitmask formats
+	quint32 format = 0;
+	quint32 width = 0;
+	quint32 height = 0;
+	quint32 mipmaps = 0;
+	//! Number of images, 6 per cube map
+	quint32 faces = 1;
+	bool cube = false;
+	//! False if the header could not be read
+	bool valid = false;
+	//! PNG encoded thumbnail, empty if the format could not be decoded
+	QByteArray thumbnail;
+};
+
+/*! A persistent index of the textures inside one archive
+ *
+ * Stored per archive in the cache directory, keyed by the archive path, size and
+ * modification time so a changed archive starts from an empty index.
+ */
+class TexIndex final
+{
+public:
+	TexIndex( const QString & archivePath );
+
+	//! Read the index from disk, false if there is none for this version of the archive
+	bool load();
+	//! Write the index to disk if it changed
+	bool save();
+
+	bool contains( const QString & path ) const;
+	TexIndexEntry value( const QString & path ) const;
+	void insert( const QString & path, const TexIndexEntry & entry );
+
+	//! Directory holding the index files of all archives
+	static QString cacheDir();
+
+private:
+	QString key;
+	QString filename;
+
+	mutable QMutex mutex;
+	QHash<QString, TexIndexEntry> entries;
+	bool modified = false;
+};
+
+/*! Worker thread that reads texture headers and smallest mipmaps
+ *
+ * Runs at the lowest priority, sleeps between textures and waits while paused, so it
+ * does not compete with files being opened in the foreground.
+ */
+class TexIndexThread final : public QThread
+{
+	Q_OBJECT
+
+public:
+	TexIndexThread( QObject * parent, BSA * archive, TexIndex * index, const QStringList & paths );
+	~TexIndexThread();
+
+	//! Stop reading from the archive until resumed
+	void setPaused( bool paused );
+	//! Stop as soon as possible
+	void abort();
+
+	//! Read the metadata and thumbnail of a single texture
+	static TexIndexEntry indexTexture( BSA * archive, const QString & path );
+
+signals:
+	void indexed( const QString & path );
+
+protected:
+	void run() override final;
+
+	BSA * archive;
+	TexIndex * index;
+	QStringList queue;
+
+	QAtomicInt paused;
+	QAtomicInt aborted;
+};
+
+/*! Fills the texture columns of a BSAModel from a TexIndex
+ *
+ * Cached entries are shown immediately, the rest are indexed in the background and
+ * shown as they arrive.
+ */
+class TexIndexer final : public QObject
+{
+	Q_OBJECT
+
+public:
+	TexIndexer( BSA * archive, BSAModel * model, QObject * parent = nullptr );
+	~TexIndexer();
+
+	//! Pause the background indexing, e.g. while a file is being loaded
+	void setPaused( bool paused );
+
+	//! Whether @p path is a texture the indexer handles
+	static bool isTexture( const QString & path );
+
+private slots:
+	void updateRow( const QString & path );
+
+private:
+	void collect( QStandardItem * parent );
+	void fillRow( QStandardItem * fileItem, const TexIndexEntry & entry );
+
+	TexIndex index;
+	BSAModel * model;
+	TexIndexThread * thread = nullptr;
+
+	//! Column 0 item of each texture row by path
+	QHash<QString, QStandardItem *> rows;
+};
+
+#endif
@@ -32,6 +32,8 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "gltexloaders.h"
 
+#include "gltexdecode.h"
+
 #include "message.h"
 #include "model/nifmodel.h"
 
@@ -623,10 +625,69 @@ GLuint texLoadBMP( QIODevice & f, QString & texformat, GLenum & target, GLuint &
 	return 0;
 }
 
+//! Decode a DDS on the CPU and upload it uncompressed, for formats the driver or GLI cannot handle
+static GLuint texLoadDecodedDDS( const QByteArray & data, GLenum & target, GLuint & id, GLuint & mipmaps )
+{
+	TexDecode::DDSInfo info;
+	if ( !TexDecode::parseDDS( data, info ) )
+		return 0;
+
+	// Only the first image of texture arrays
+	if ( info.cube && info.faces < 6 )
+		return 0;
+	int faces = info.cube ? 6 : 1;
+
+	TexDecode::Target decodeTarget = TexDecode::isHDR( info.format ) ? TexDecode::RGBA16F : TexDecode::RGBA8;
+	target = info.cube ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+
+	// The old name may be bound to another target, or hold the immutable storage of the failed
+	//	GLI upload, and neither can be respecified
+	if ( id )
+		glDeleteTextures( 1, &id );
+	glGenTextures( 1, &id );
+	glBindTexture( target, id );
+	glTexParameteri( target, GL_TEXTURE_SWIZZLE_R, GL_RED );
+	glTexParameteri( target, GL_TEXTURE_SWIZZLE_G, GL_GREEN );
+	glTexParameteri( target, GL_TEXTURE_SWIZZLE_B, GL_BLUE );
+	glTexParameteri( target, GL_TEXTURE_SWIZZLE_A, GL_ALPHA );
+
+	// Stop at the first missing mipmap of truncated files
+	int levels = 0;
+	for ( int face = 0; face < faces; face++ ) {
+		GLenum faceTarget = info.cube ? GLenum( GL_TEXTURE_CUBE_MAP_POSITIVE_X + face ) : target;
+		int level = 0;
+		for ( ; level < info.levels; level++ ) {
+			TexDecode::Image img;
+			if ( !TexDecode::decodeDDS( data, info, face, level, img, decodeTarget ) )
+				break;
+
+			if ( decodeTarget == TexDecode::RGBA16F )
+				glTexImage2D( faceTarget, level, GL_RGBA16F, img.width, img.height, 0, GL_RGBA, GL_HALF_FLOAT, img.pixels.constData() );
+			else
+				glTexImage2D( faceTarget, level, GL_RGBA8, img.width, img.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, img.pixels.constData() );
+		}
+
+		if ( level == 0 )
+			return 0;
+		levels = face ? std::min( levels, level ) : level;
+	}
+
+	glTexParameteri( target, GL_TEXTURE_BASE_LEVEL, 0 );
+	glTexParameteri( target, GL_TEXTURE_MAX_LEVEL, levels - 1 );
+
+	mipmaps = GLuint( levels );
+	return id;
+}
+
 GLuint texLoadDDS( const QString & filepath, QString & format, GLenum & target, GLuint & width, GLuint & height, GLuint & mipmaps, QByteArray & data, GLuint & id )
 {
 	GLuint result = 0;
 	gli::texture texture;
+
+	// Discard stale errors so a failed upload below can be detected,
+	//	a lost context keeps reporting GL_CONTEXT_LOST so the loop is bounded
+	for ( int i = 0; i < 16 && glGetError() != GL_NO_ERROR; i++ ) {}
+
 	if ( extStorageSupported ) {
 		texture = load_if_valid( data.constData(), data.size() );
 		if ( !texture.empty() )
@@ -637,9 +698,15 @@ GLuint texLoadDDS( const QString & filepath, QString & format, GLenum & target,
 			result = GLI_create_texture_fallback( texture, target, id );
 	}
 
+	// The driver rejected the format, e.g. BC6H/BC7 without ARB_texture_compression_bptc
+	if ( result && glGetError() != GL_NO_ERROR )
+		result = 0;
+
 	if ( result ) {
 		id = result;
 		mipmaps = (GLuint)texture.levels();
+	} else if ( (result = texLoadDecodedDDS( data, target, id, mipmaps )) != 0 ) {
+		id = result;
 	} else {
 		mipmaps = 0;
 		QString file = filepath;
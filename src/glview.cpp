@@ -1125,6 +1125,7 @@ void GLView::setNif( NifModel * nif )
 	if ( model ) {
 		connect( model, &NifModel::dataChanged, this, &GLView::dataChanged );
 		connect( model, &NifModel::linksChanged, this, &GLView::modelLinked );
+		connect( model, &NifModel::modelReset, this, &GLView::modelLoaded );
 		connect( model, &NifModel::modelReset, this, &GLView::modelChanged );
 		connect( model, &NifModel::destroyed, this, &GLView::modelDestroyed );
 	}
@@ -1196,6 +1197,12 @@ void GLView::modelChanged()
 	update();
 }
 
+void GLView::modelLoaded()
+{
+	// Resolve all texture paths before the first draw
+	TexCache::prefetch( model );
+}
+
 void GLView::modelLinked()
 {
 	if ( doCompile )
@@ -270,6 +270,7 @@ private slots:
 
 	void dataChanged( const QModelIndex &, const QModelIndex & );
 	void modelChanged();
+	void modelLoaded();
 	void modelLinked();
 	void modelDestroyed();
 };
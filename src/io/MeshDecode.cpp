@@ -0,0 +1,249 @@
+#include "io/MeshDecode.h"
+
+#include <half.h>
+
+#include <QtEndian>
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MESHDECODE_SSE2
+#include <emmintrin.h>
+#endif
+
+static_assert( sizeof(Vector2) == 2 * sizeof(float), "Vector2 must be tightly packed" );
+static_assert( sizeof(Vector3) == 3 * sizeof(float), "Vector3 must be tightly packed" );
+static_assert( sizeof(Color4) == 4 * sizeof(float), "Color4 must be tightly packed" );
+static_assert( sizeof(Triangle) == 3 * sizeof(quint16), "Triangle must be tightly packed" );
+
+
+namespace
+{
+	inline quint16 readU16( const char * p )
+	{
+		quint16 v;
+		memcpy( &v, p, sizeof(v) );
+		return qFromLittleEndian( v );
+	}
+
+	inline quint32 readU32( const char * p )
+	{
+		quint32 v;
+		memcpy( &v, p, sizeof(v) );
+		return qFromLittleEndian( v );
+	}
+
+	inline float halfToFloat( quint16 h )
+	{
+		union { float f; uint32_t i; } u;
+		u.i = half_to_float( h );
+		return u.f;
+	}
+
+	inline double snormToDouble( qint16 x )
+	{
+		return x < 0 ? x / double(32768) : x / double(32767);
+	}
+
+	//! UDEC3 component lookup, built with the same double math as unpackUDEC3
+	struct UDEC3Table
+	{
+		UDEC3Table()
+		{
+			for ( int i = 0; i < 1024; i++ )
+				v[i] = float( (i / 511.5) - 1.0 );
+		}
+
+		float v[1024];
+	};
+
+	const UDEC3Table & udec3Table()
+	{
+		static const UDEC3Table table;
+		return table;
+	}
+
+#ifdef MESHDECODE_SSE2
+	//! Half to float for the low 16 bits of each lane, exact for all inputs including denormals and Inf/NaN
+	inline __m128 halfToFloatSSE2( __m128i h )
+	{
+		const __m128i maskNoSign = _mm_set1_epi32( 0x7FFF );
+		const __m128 magic = _mm_castsi128_ps( _mm_set1_epi32( (254 - 15) << 23 ) );
+		const __m128i wasInfNaN = _mm_set1_epi32( 0x7BFF );
+		const __m128 expInfNaN = _mm_castsi128_ps( _mm_set1_epi32( 255 << 23 ) );
+
+		__m128i expmant = _mm_and_si128( maskNoSign, h );
+		__m128i sign = _mm_slli_epi32( _mm_xor_si128( h, expmant ), 16 );
+		__m128 scaled = _mm_mul_ps( _mm_castsi128_ps( _mm_slli_epi32( expmant, 13 ) ), magic );
+		__m128 infnan = _mm_and_ps( _mm_castsi128_ps( _mm_cmpgt_epi32( expmant, wasInfNaN ) ), expInfNaN );
+
+		return _mm_or_ps( scaled, _mm_or_ps( _mm_castsi128_ps( sign ), infnan ) );
+	}
+
+	//! SNORM16 to float for four sign-extended lanes, x / 32768 when negative and x / 32767 otherwise
+	inline __m128 snormToFloatSSE2( __m128i v )
+	{
+		const __m128 negDiv = _mm_set1_ps( 32768.0f );
+		const __m128 posDiv = _mm_set1_ps( 32767.0f );
+
+		// The exact quotient never lies close enough to a float rounding boundary for the
+		// double rounding of the scalar path to matter, so single precision division is bit-exact.
+		__m128 neg = _mm_castsi128_ps( _mm_cmplt_epi32( v, _mm_setzero_si128() ) );
+		__m128 div = _mm_or_ps( _mm_and_ps( neg, negDiv ), _mm_andnot_ps( neg, posDiv ) );
+		return _mm_div_ps( _mm_cvtepi32_ps( v ), div );
+	}
+#endif
+}
+
+
+const char * MeshDecode::simdPath()
+{
+#if defined(MESHDECODE_SSE2)
+	return "SSE2";
+#else
+	return "Scalar";
+#endif
+}
+
+Vector3 MeshDecode::unpackUDEC3( quint32 n )
+{
+	float x = ((n & 1023) / 511.5) - 1.0;
+	float y = (((n >> 10) & 1023) / 511.5) - 1.0;
+	float z = (((n >> 20) & 1023) / 511.5) - 1.0;
+
+	return Vector3( x, y, z );
+}
+
+void MeshDecode::positions( const char * src, int count, float scale, Vector3 * dst, bool simd )
+{
+	int i = 0;
+
+#ifdef MESHDECODE_SSE2
+	if ( simd ) {
+		float * out = reinterpret_cast<float *>(dst);
+		const __m128 s = _mm_set1_ps( scale );
+
+		// 4 positions per iteration: 12 shorts in, 12 floats out
+		for ( ; i + 4 <= count; i += 4 ) {
+			const char * p = src + i * 6;
+			__m128i lo = _mm_loadu_si128( reinterpret_cast<const __m128i *>(p) );
+			__m128i hi = _mm_loadl_epi64( reinterpret_cast<const __m128i *>(p + 16) );
+
+			__m128i a = _mm_srai_epi32( _mm_unpacklo_epi16( lo, lo ), 16 );
+			__m128i b = _mm_srai_epi32( _mm_unpackhi_epi16( lo, lo ), 16 );
+			__m128i c = _mm_srai_epi32( _mm_unpacklo_epi16( hi, hi ), 16 );
+
+			float * o = out + i * 3;
+			_mm_storeu_ps( o,     _mm_mul_ps( snormToFloatSSE2( a ), s ) );
+			_mm_storeu_ps( o + 4, _mm_mul_ps( snormToFloatSSE2( b ), s ) );
+			_mm_storeu_ps( o + 8, _mm_mul_ps( snormToFloatSSE2( c ), s ) );
+		}
+	}
+#else
+	Q_UNUSED( simd );
+#endif
+
+	for ( ; i < count; i++ ) {
+		const char * p = src + i * 6;
+		qint16 x = qint16( readU16( p ) );
+		qint16 y = qint16( readU16( p + 2 ) );
+		qint16 z = qint16( readU16( p + 4 ) );
+
+		// Dividing by 1024 is near exact previous game scale
+		// SNORM is / ~32768 though so scale is 32x smaller in .mesh
+		dst[i] = Vector3( snormToDouble( x ), snormToDouble( y ), snormToDouble( z ) ) * scale;
+	}
+}
+
+void MeshDecode::texcoords( const char * src, int count, Vector2 * dst, bool simd )
+{
+	int i = 0;
+
+#ifdef MESHDECODE_SSE2
+	if ( simd ) {
+		float * out = reinterpret_cast<float *>(dst);
+		const __m128i zero = _mm_setzero_si128();
+
+		// F16C is deliberately not used: _mm_cvtph_ps quiets signaling NaNs, which breaks bit-exactness.
+		// 4 coordinates per iteration: 8 halves in, 8 floats out
+		for ( ; i + 4 <= count; i += 4 ) {
+			__m128i h = _mm_loadu_si128( reinterpret_cast<const __m128i *>(src + i * 4) );
+			_mm_storeu_ps( out + i * 2,     halfToFloatSSE2( _mm_unpacklo_epi16( h, zero ) ) );
+			_mm_storeu_ps( out + i * 2 + 4, halfToFloatSSE2( _mm_unpackhi_epi16( h, zero ) ) );
+		}
+	}
+#else
+	Q_UNUSED( simd );
+#endif
+
+	for ( ; i < count; i++ ) {
+		const char * p = src + i * 4;
+		dst[i] = Vector2( halfToFloat( readU16( p ) ), halfToFloat( readU16( p + 2 ) ) );
+	}
+}
+
+void MeshDecode::udec3( const char * src, int count, Vector3 * dst, bool simd )
+{
+	if ( !simd ) {
+		for ( int i = 0; i < count; i++ )
+			dst[i] = unpackUDEC3( readU32( src + i * 4 ) );
+		return;
+	}
+
+	// There is no SSE2 gather and the scalar path works in double precision,
+	// so an exact per-component table is both faster and bit-identical.
+	const float * t = udec3Table().v;
+	for ( int i = 0; i < count; i++ ) {
+		quint32 n = readU32( src + i * 4 );
+		dst[i] = Vector3( t[n & 1023], t[(n >> 10) & 1023], t[(n >> 20) & 1023] );
+	}
+}
+
+void MeshDecode::colors( const char * src, int count, Color4 * dst, bool simd )
+{
+	int i = 0;
+
+#ifdef MESHDECODE_SSE2
+	if ( simd ) {
+		float * out = reinterpret_cast<float *>(dst);
+		const __m128 div = _mm_set1_ps( 255.0f );
+		const __m128i zero = _mm_setzero_si128();
+
+		// 4 colors per iteration, BGRA bytes in, RGBA floats out
+		for ( ; i + 4 <= count; i += 4 ) {
+			__m128i c = _mm_loadu_si128( reinterpret_cast<const __m128i *>(src + i * 4) );
+			__m128i lo = _mm_unpacklo_epi8( c, zero );
+			__m128i hi = _mm_unpackhi_epi8( c, zero );
+
+			__m128i px[4] = {
+				_mm_unpacklo_epi16( lo, zero ), _mm_unpackhi_epi16( lo, zero ),
+				_mm_unpacklo_epi16( hi, zero ), _mm_unpackhi_epi16( hi, zero )
+			};
+
+			for ( int j = 0; j < 4; j++ ) {
+				__m128 f = _mm_div_ps( _mm_cvtepi32_ps( px[j] ), div );
+				_mm_storeu_ps( out + (i + j) * 4, _mm_shuffle_ps( f, f, _MM_SHUFFLE( 3, 0, 1, 2 ) ) );
+			}
+		}
+	}
+#else
+	Q_UNUSED( simd );
+#endif
+
+	for ( ; i < count; i++ ) {
+		const quint8 * p = reinterpret_cast<const quint8 *>(src + i * 4);
+		dst[i] = Color4( p[2] / 255.0, p[1] / 255.0, p[0] / 255.0, p[3] / 255.0 );
+	}
+}
+
+void MeshDecode::triangles( const char * src, int count, Triangle * dst )
+{
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+	memcpy( dst, src, size_t( count ) * sizeof(Triangle) );
+#else
+	for ( int i = 0; i < count; i++ ) {
+		const char * p = src + i * 6;
+		dst[i] = Triangle( readU16( p ), readU16( p + 2 ), readU16( p + 4 ) );
+	}
+#endif
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "data/niftypes.h"
+
+#include <QtGlobal>
+
+
+//! @file MeshDecode.h Bulk decoders for packed Starfield .mesh vertex streams
+
+/*! Bulk decoders for the packed vertex formats used by Starfield .mesh files
+ *
+ * Every decoder reads @p count elements directly from the raw little-endian byte
+ * buffer @p src and writes them into preallocated storage at @p dst.
+ *
+ * The SIMD paths are bit-exact with the Scalar paths, which mirror the per-element
+ * QDataStream code MeshFile used previously. Passing @p simd = false forces the
+ * scalar fallback, e.g. to verify the SIMD output.
+ */
+namespace MeshDecode
+{
+	//! Name of the vector instruction set compiled in, or "Scalar"
+	const char * simdPath();
+
+	//! SNORM16 x3 positions, multiplied by @p scale (6 bytes per element)
+	void positions( const char * src, int count, float scale, Vector3 * dst, bool simd = true );
+	//! Half float x2 texture coordinates (4 bytes per element)
+	void texcoords( const char * src, int count, Vector2 * dst, bool simd = true );
+	//! UDEC3 normals or tangents, the 2-bit W component is ignored (4 bytes per element)
+	void udec3( const char * src, int count, Vector3 * dst, bool simd = true );
+	//! BGRA8 vertex colors (4 bytes per element)
+	void colors( const char * src, int count, Color4 * dst, bool simd = true );
+	//! 16-bit triangle indices (6 bytes per element)
+	void triangles( const char * src, int count, Triangle * dst );
+
+	//! Decode a UDEC3 value with the reference scalar math
+	Vector3 unpackUDEC3( quint32 n );
+}
@@ -1,27 +1,57 @@
 #include "io/MeshFile.h"
+#include "io/MeshDecode.h"
 #include "gamemanager.h"
 
 #include <fsengine/bsa.h>
-#include <half.h>
 
-#include <QBuffer>
 #include <QFile>
+#include <QtEndian>
 
-double snormToDouble(int16_t x) { return x < 0 ? x / double(32768) : x / double(32767); }
+#include <cstring>
 
-Vector3 UnpackUDEC3(quint32 n, bool& invertBitangent)
+namespace
 {
-	float x;
-	float y;
-	float z;
-	quint32 w;
+	//! Bounds-checked cursor over the raw .mesh bytes
+	class MeshReader
+	{
+	public:
+		MeshReader( const QByteArray & data ) : p( data.constData() ), end( data.constData() + data.size() ) {}
+
+		//! Reads a little-endian value, or 0 past the end of the data like QDataStream
+		template <typename T> T read()
+		{
+			T v = 0;
+			if ( end - p >= qint64(sizeof(T)) ) {
+				memcpy( &v, p, sizeof(T) );
+				p += sizeof(T);
+			} else {
+				p = end;
+			}
+			return qFromLittleEndian( v );
+		}
+
+		//! Claims @p count elements of @p stride bytes, clamping @p count to the bytes left
+		const char * take( quint32 & count, qint64 stride )
+		{
+			if ( stride <= 0 ) {
+				count = 0;
+				return p;
+			}
 
-	x = ((n & 1023) / 511.5) - 1.0;
-	y = (((n >> 10) & 1023) / 511.5) - 1.0;
-	z = (((n >> 20) & 1023) / 511.5) - 1.0;
-	w = (n >> 30) & 3;
+			qint64 avail = (end - p) / stride;
+			if ( qint64(count) > avail ) {
+				qWarning() << "MeshFile: stream truncated," << count << "elements expected," << avail << "available";
+				count = quint32( avail );
+			}
+			const char * data = p;
+			p += qint64(count) * stride;
+			return data;
+		}
 
-	return Vector3(x, y, z);
+	private:
+		const char * p;
+		const char * end;
+	};
 }
 
 MeshFile::MeshFile(const QString& filepath)
@@ -76,178 +106,112 @@ quint32 MeshFile::readMesh()
 	if ( data.isEmpty() )
 		return 0;
 
-	QBuffer f(&data);
-	if ( f.open(QIODevice::ReadOnly) ) {
-		in.setDevice(&f);
-		in.setByteOrder(QDataStream::LittleEndian);
-		in.setFloatingPointPrecision(QDataStream::SinglePrecision);
-
-		quint32 magic;
-		in >> magic;
-		if ( magic != 1 )
-			return 0;
-
-		quint32 indicesSize;
-		in >> indicesSize;
-		triangles.resize(indicesSize / 3);
-
-		for ( int i = 0; i < indicesSize / 3; i++ ) {
-			Triangle tri;
-			in >> tri;
-			triangles[i] = tri;
-
-		}
-
-		float scale;
-		in >> scale;
-		if ( scale <= 0.0 )
-			return 0; // From RE
-
-		quint32 numWeightsPerVertex;
-		in >> numWeightsPerVertex;
-		weightsPerVertex = numWeightsPerVertex;
-
-		quint32 numPositions;
-		in >> numPositions;
-		positions.resize(numPositions + positions.count());
-
-		for ( int i = 0; i < positions.count(); i++ ) {
-			int16_t x, y;
-			int16_t z;
-			union { float f; uint32_t i; } xu, yu, zu;
-
-			in >> x;
-			in >> y;
-			in >> z;
-
-			// Dividing by 1024 is near exact previous game scale
-			// SNORM is / ~32768 though so scale is 32x smaller in .mesh
-			positions[i] = Vector3(snormToDouble(x), snormToDouble(y), snormToDouble(z)) * scale;
-		}
-
-		quint32 numCoord1;
-		in >> numCoord1;
-		coords.append(TexCoords());
-		coords[0].resize(numCoord1);
-
-		for ( int i = 0; i < coords[0].count(); i++ ) {
-			uint16_t u, v;
-			union { float f; uint32_t i; } uu, vu;
-
-			in >> u;
-			in >> v;
-
-			uu.i = half_to_float(u);
-			vu.i = half_to_float(v);
+	MeshReader in( data );
 
-			Vector2 coord;
-			coord[0] = uu.f;
-			coord[1] = vu.f;
-
-			coords[0][i] = coord;
-		}
-
-		quint32 numCoord2;
-		in >> numCoord2;
-		coords.append(TexCoords());
-		coords[1].resize(numCoord2);
-
-		for ( int i = 0; i < coords[1].count(); i++ ) {
-			uint16_t u, v;
-			union { float f; uint32_t i; } uu, vu;
-
-			in >> u;
-			in >> v;
-			uu.i = half_to_float(u);
-			vu.i = half_to_float(v);
-
-			Vector2 coord;
-			coord[0] = uu.f;
-			coord[1] = vu.f;
-			coords[1][i] = coord;
-		}
+	quint32 magic = in.read<quint32>();
+	if ( magic != 1 )
+		return 0;
 
-		quint32 numColor;
-		in >> numColor;
-		if ( numColor > 0 ) {
-			colors.resize(numColor + colors.count());
-		}
-		for ( int i = 0; i < numColor; i++ ) {
-			uint8_t r, g, b, a;
-			in >> b;
-			in >> g;
-			in >> r;
-			in >> a;
-			colors[i] = Color4(r / 255.0, g / 255.0, b / 255.0, a / 255.0);
-		}
+	quint32 indicesSize = in.read<quint32>();
+	quint32 numTriangles = indicesSize / 3;
+	const char * triData = in.take( numTriangles, 6 );
+	triangles.resize( numTriangles );
+	MeshDecode::triangles( triData, numTriangles, triangles.data() );
+	// Skip any indices that do not form a whole triangle
+	quint32 numLooseIndices = indicesSize % 3;
+	in.take( numLooseIndices, 2 );
+
+	float scale = in.read<float>();
+	if ( scale <= 0.0 )
+		return 0; // From RE
+
+	// The count comes from the file, weightsPerVertex only holds 8 bits of it
+	quint32 numWeightsPerVertex = in.read<quint32>();
+	if ( numWeightsPerVertex > 0xFF ) {
+		qWarning() << "MeshFile:" << numWeightsPerVertex << "weights per vertex is not a valid mesh";
+		data = QByteArray();
+		return 0;
+	}
+	weightsPerVertex = numWeightsPerVertex;
+
+	quint32 numPositions = in.read<quint32>();
+	const char * posData = in.take( numPositions, 6 );
+	positions.resize( numPositions );
+	MeshDecode::positions( posData, numPositions, scale, positions.data() );
+
+	for ( int set = 0; set < 2; set++ ) {
+		quint32 numCoord = in.read<quint32>();
+		const char * coordData = in.take( numCoord, 4 );
+		coords.append( TexCoords( numCoord ) );
+		MeshDecode::texcoords( coordData, numCoord, coords[set].data() );
+	}
 
-		quint32 numNormal;
-		in >> numNormal;
-		if ( numNormal > 0 ) {
-			normals.resize(numNormal + normals.count());
-		}
-		for ( int i = 0; i < normals.count(); i++ ) {
-			quint32 n;
-			in >> n;
-			bool b = false;
-			normals[i] = UnpackUDEC3(n, b);
-		}
+	quint32 numColor = in.read<quint32>();
+	const char * colorData = in.take( numColor, 4 );
+	colors.resize( numColor );
+	MeshDecode::colors( colorData, numColor, colors.data() );
+
+	quint32 numNormal = in.read<quint32>();
+	const char * normalData = in.take( numNormal, 4 );
+	normals.resize( numNormal );
+	MeshDecode::udec3( normalData, numNormal, normals.data() );
+
+	quint32 numTangent = in.read<quint32>();
+	const char * tangentData = in.take( numTangent, 4 );
+	tangents.resize( numTangent );
+	tangentsBasis.resize( numTangent );
+	bitangents.resize( numTangent );
+	MeshDecode::udec3( tangentData, numTangent, tangents.data() );
+	for ( int i = 0; i < tangents.count(); i++ ) {
+		// The UDEC3 W bit is currently ignored, so the bitangent basis is always -1
+		const Vector3 & tan = tangents[i];
+		const Vector3 norm = (i < normals.count()) ? normals[i] : Vector3();
+		// For export
+		tangentsBasis[i] = Vector4( tan[0], tan[1], tan[2], -1.0 );
+		bitangents[i] = Vector3::crossproduct( tan, norm );
+	}
 
-		quint32 numTangent;
-		in >> numTangent;
-		if ( numTangent > 0 ) {
-			tangents.resize(numTangent + tangents.count());
-			tangentsBasis.resize(numTangent + tangentsBasis.count());
-			bitangents.resize(numTangent + bitangents.count());
-		}
-		for ( int i = 0; i < tangents.count(); i++ ) {
-			quint32 n;
-			in >> n;
-			bool b = false;
-			auto tan = UnpackUDEC3(n, b);
-			tangents[i] = tan;
-			// For export
-			tangentsBasis[i] = Vector4(tan[0], tan[1], tan[2], (b) ? 1.0 : -1.0);
-			bitangents[i] = (b) ? Vector3::crossproduct(normals[i], tangents[i]) : Vector3::crossproduct(tangents[i], normals[i]);
+	quint32 numWeights = in.read<quint32>();
+	if ( numWeights > 0 ) {
+		qint64 weightStride = qint64( numWeightsPerVertex ) * 4;
+		if ( weightStride <= 0 ) {
+			// The weights cannot be skipped without a stride, so nothing after them can be read
+			qWarning() << "MeshFile:" << numWeights << "weights without a weight count per vertex";
+			data = QByteArray();
+			return 0;
 		}
 
-		quint32 numWeights;
-		in >> numWeights;
-		if ( numWeights > 0 && numWeightsPerVertex > 0 ) {
-			weights.resize(numWeights / numWeightsPerVertex);
-		}
+		quint32 numWeighted = numWeights / numWeightsPerVertex;
+		const char * weightData = in.take( numWeighted, weightStride );
+		weights.resize( numWeighted );
 		for ( int i = 0; i < weights.count(); i++ ) {
+			const char * w = weightData + qint64(i) * weightStride;
 			QVector<QPair<quint16, quint16>> weightsUNORM;
-			for ( int j = 0; j < 8; j++ ) {
+			weightsUNORM.reserve( 8 );
+			for ( quint32 j = 0; j < 8; j++ ) {
 				if ( j < numWeightsPerVertex ) {
-					quint16 b, w;
-					in >> b;
-					in >> w;
-					weightsUNORM.append({ b, w });
+					quint16 b = qFromLittleEndian<quint16>( w + j * 4 );
+					quint16 v = qFromLittleEndian<quint16>( w + j * 4 + 2 );
+					weightsUNORM.append( { b, v } );
 				} else {
-					weightsUNORM.append({0, 0});
+					weightsUNORM.append( { 0, 0 } );
 				}
 			}
-			weights[i] = BoneWeightsUNorm(weightsUNORM, i);
-		}
-
-		quint32 numLODs;
-		in >> numLODs;
-		lods.resize(numLODs);
-		for ( int i = 0; i < numLODs; i++ ) {
-			quint32 indicesSize2;
-			in >> indicesSize2;
-			lods[i].resize(indicesSize2 / 3);
-
-			for ( int j = 0; j < indicesSize2 / 3; j++ ) {
-				Triangle tri;
-				in >> tri;
-				lods[i][j] = tri;
-			}
+			weights[i] = BoneWeightsUNorm( weightsUNORM, i );
 		}
+	}
 
-		return numPositions;
+	quint32 numLODs = in.read<quint32>();
+	lods.resize( numLODs );
+	for ( int i = 0; i < lods.count(); i++ ) {
+		quint32 indicesSize2 = in.read<quint32>();
+		quint32 numLODTriangles = indicesSize2 / 3;
+		const char * lodData = in.take( numLODTriangles, 6 );
+		lods[i].resize( numLODTriangles );
+		MeshDecode::triangles( lodData, numLODTriangles, lods[i].data() );
+		quint32 numLODLooseIndices = indicesSize2 % 3;
+		in.take( numLODLooseIndices, 2 );
 	}
 
-	return 0;
+	return numPositions;
 }
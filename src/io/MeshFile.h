@@ -4,7 +4,6 @@
 #include "gl/gltools.h"
 
 #include <QByteArray>
-#include <QDataStream>
 #include <QVector>
 
 #include <string>
@@ -46,6 +45,5 @@ public:
 
 private:
 	QByteArray data;
-	QDataStream in;
 	quint32 readMesh();
 };
@@ -167,7 +167,7 @@ bool NifIStream::read( NifValue & val )
 			yf = (double( y ) / 255.0) * 2.0 - 1.0;
 			zf = (double( z ) / 255.0) * 2.0 - 1.0;
 
-			Vector3 * v = static_cast<Vector3 *>(val.val.data);
+			Vector3 * v = val.payload<Vector3>();
 			v->xyz[0] = xf; v->xyz[1] = yf; v->xyz[2] = zf;
 
 			return (dataStream->status() == QDataStream::Ok);
@@ -185,7 +185,7 @@ bool NifIStream::read( NifValue & val )
 			yf = (float) y;
 			zf = (float) z;
 
-			Vector3 * v = static_cast<Vector3 *>(val.val.data);
+			Vector3 * v = val.payload<Vector3>();
 			v->xyz[0] = xf; v->xyz[1] = yf; v->xyz[2] = zf;
 
 			return (dataStream->status() == QDataStream::Ok);
@@ -203,7 +203,7 @@ bool NifIStream::read( NifValue & val )
 			yu.i = half_to_float( y );
 			zu.i = half_to_float( z );
 
-			Vector3 * v = static_cast<Vector3 *>(val.val.data);
+			Vector3 * v = val.payload<Vector3>();
 			v->xyz[0] = xu.f; v->xyz[1] = yu.f; v->xyz[2] = zu.f;
 
 			return (dataStream->status() == QDataStream::Ok);
@@ -219,52 +219,52 @@ bool NifIStream::read( NifValue & val )
 			xu.i = half_to_float( x );
 			yu.i = half_to_float( y );
 
-			Vector2 * v = static_cast<Vector2 *>(val.val.data);
+			Vector2 * v = val.payload<Vector2>();
 			v->xy[0] = xu.f; v->xy[1] = yu.f;
 
 			return (dataStream->status() == QDataStream::Ok);
 		}
 	case NifValue::tVector3:
 		{
-			Vector3 * v = static_cast<Vector3 *>(val.val.data);
+			Vector3 * v = val.payload<Vector3>();
 			*dataStream >> *v;
 			return (dataStream->status() == QDataStream::Ok);
 		}
 	case NifValue::tVector4:
 		{
-			Vector4 * v = static_cast<Vector4 *>(val.val.data);
+			Vector4 * v = val.payload<Vector4>();
 			*dataStream >> *v;
 			return (dataStream->status() == QDataStream::Ok);
 		}
 	case NifValue::tTriangle:
 		{
-			Triangle * t = static_cast<Triangle *>(val.val.data);
+			Triangle * t = val.payload<Triangle>();
 			*dataStream >> *t;
 			return (dataStream->status() == QDataStream::Ok);
 		}
 	case NifValue::tQuat:
 		{
-			Quat * q = static_cast<Quat *>(val.val.data);
+			Quat * q = val.payload<Quat>();
 			*dataStream >> *q;
 			return (dataStream->status() == QDataStream::Ok);
 		}
 	case NifValue::tQuatXYZW:
 		{
-			Quat * q = static_cast<Quat *>(val.val.data);
+			Quat * q = val.payload<Quat>();
 			return device->read( (char *)&q->wxyz[1], 12 ) == 12 && device->read( (char *)q->wxyz, 4 ) == 4;
 		}
 	case NifValue::tMatrix:
-		return device->read( (char *)static_cast<Matrix *>(val.val.data)->m, 36 ) == 36;
+		return device->read( (char *)val.payload<Matrix>()->m, 36 ) == 36;
 	case NifValue::tMatrix4:
-		return device->read( (char *)static_cast<Matrix4 *>(val.val.data)->m, 64 ) == 64;
+		return device->read( (char *)val.payload<Matrix4>()->m, 64 ) == 64;
 	case NifValue::tVector2:
 		{
-			Vector2 * v = static_cast<Vector2 *>(val.val.data);
+			Vector2 * v = val.payload<Vector2>();
 			*dataStream >> *v;
 			return (dataStream->status() == QDataStream::Ok);
 		}
 	case NifValue::tColor3:
-		return device->read( (char *)static_cast<Color3 *>(val.val.data)->rgb, 12 ) == 12;
+		return device->read( (char *)val.payload<Color3>()->rgb, 12 ) == 12;
 	case NifValue::tByteColor4:
 		{
 			quint8 r, g, b, a;
@@ -273,14 +273,14 @@ bool NifIStream::read( NifValue & val )
 			*dataStream >> b;
 			*dataStream >> a;
 
-			Color4 * c = static_cast<Color4 *>(val.val.data);
+			Color4 * c = val.payload<Color4>();
 			c->setRGBA( (float)r / 255.0, (float)g / 255.0, (float)b / 255.0, (float)a / 255.0 );
 
 			return (dataStream->status() == QDataStream::Ok);
 		}
 	case NifValue::tColor4:
 		{
-			Color4 * c = static_cast<Color4 *>(val.val.data);
+			Color4 * c = val.payload<Color4>();
 			*dataStream >> *c;
 			return (dataStream->status() == QDataStream::Ok);
 		}
@@ -291,7 +291,7 @@ bool NifIStream::read( NifValue & val )
 			*dataStream >> len;
 
 			if ( len > maxLength || len < 0 ) {
-				*static_cast<QString *>(val.val.data) = tr( "<string too long (0x%1)>" ).arg( len, 0, 16 ); return false;
+				*val.payload<QString>() = tr( "<string too long (0x%1)>" ).arg( len, 0, 16 ); return false;
 			}
 
 			QByteArray string = device->read( len );
@@ -301,7 +301,7 @@ bool NifIStream::read( NifValue & val )
 
 			//string.replace( "\r", "\\r" );
 			//string.replace( "\n", "\\n" );
-			*static_cast<QString *>(val.val.data) = QString( string );
+			*val.payload<QString>() = QString( string );
 		}
 		return true;
 	case NifValue::tShortString:
@@ -315,7 +315,7 @@ bool NifIStream::read( NifValue & val )
 
 			//string.replace( "\r", "\\r" );
 			//string.replace( "\n", "\\n" );
-			*static_cast<QString *>(val.val.data) = QString::fromLocal8Bit( string );
+			*val.payload<QString>() = QString::fromLocal8Bit( string );
 		}
 		return true;
 	case NifValue::tText:
@@ -324,7 +324,7 @@ bool NifIStream::read( NifValue & val )
 			device->read( (char *)&len, 4 );
 
 			if ( len > maxLength || len < 0 ) {
-				*static_cast<QString *>(val.val.data) = tr( "<string too long>" ); return false;
+				*val.payload<QString>() = tr( "<string too long>" ); return false;
 			}
 
 			QByteArray string = device->read( len );
@@ -332,7 +332,7 @@ bool NifIStream::read( NifValue & val )
 			if ( string.size() != len )
 				return false;
 
-			*static_cast<QString *>(val.val.data) = QString( string );
+			*val.payload<QString>() = QString( string );
 		}
 		return true;
 	case NifValue::tByteArray:
@@ -343,8 +343,8 @@ bool NifIStream::read( NifValue & val )
 			if ( len < 0 )
 				return false;
 
-			*static_cast<QByteArray *>(val.val.data) = device->read( len );
-			return static_cast<QByteArray *>(val.val.data)->count() == len;
+			*val.payload<QByteArray>() = device->read( len );
+			return val.payload<QByteArray>()->count() == len;
 		}
 	case NifValue::tStringPalette:
 		{
@@ -354,7 +354,7 @@ bool NifIStream::read( NifValue & val )
 			if ( len > 0xffff || len < 0 )
 				return false;
 
-			*static_cast<QByteArray *>(val.val.data) = device->read( len );
+			*val.payload<QByteArray>() = device->read( len );
 			device->read( (char *)&len, 4 );
 			return true;
 		}
@@ -370,7 +370,7 @@ bool NifIStream::read( NifValue & val )
 			int len = len1 * len2;
 			ByteMatrix tmp( len1, len2 );
 			qint64 rlen = device->read( tmp.data(), len );
-			tmp.swap( *static_cast<ByteMatrix *>(val.val.data) );
+			tmp.swap( *val.payload<ByteMatrix>() );
 			return (rlen == len);
 		}
 	case NifValue::tHeaderString:
@@ -398,7 +398,7 @@ bool NifIStream::read( NifValue & val )
 				version = 0;
 			//}
 
-			*static_cast<QString *>(val.val.data) = QString( string );
+			*val.payload<QString>() = QString( string );
 			bool x = model->setHeaderString( QString( string ), version );
 
 			init();
@@ -416,7 +416,7 @@ bool NifIStream::read( NifValue & val )
 			if ( c >= 255 )
 				return false;
 
-			*static_cast<QString *>(val.val.data) = QString( string );
+			*val.payload<QString>() = QString( string );
 			return true;
 		}
 	case NifValue::tChar8String:
@@ -431,7 +431,7 @@ bool NifIStream::read( NifValue & val )
 			if ( c > 9 )
 				return false;
 
-			*static_cast<QString *>(val.val.data) = QString( string );
+			*val.payload<QString>() = QString( string );
 			return true;
 		}
 	case NifValue::tFileVersion:
@@ -470,7 +470,7 @@ bool NifIStream::read( NifValue & val )
 				device->read( (char *)&len, 4 );
 
 				if ( len > maxLength || len < 0 ) {
-					*static_cast<QString *>(val.val.data) = tr( "<string too long>" ); return false;
+					*val.payload<QString>() = tr( "<string too long>" ); return false;
 				}
 
 				QByteArray string = device->read( len );
@@ -480,7 +480,7 @@ bool NifIStream::read( NifValue & val )
 
 				//string.replace( "\r", "\\r" );
 				//string.replace( "\n", "\\n" );
-				*static_cast<QString *>(val.val.data) = QString( string );
+				*val.payload<QString>() = QString( string );
 				return true;
 			}
 		}
@@ -496,7 +496,7 @@ bool NifIStream::read( NifValue & val )
 				device->read( (char *)&len, 4 );
 
 				if ( len > maxLength || len < 0 ) {
-					*static_cast<QString *>(val.val.data) = tr( "<string too long>" ); return false;
+					*val.payload<QString>() = tr( "<string too long>" ); return false;
 				}
 
 				QByteArray string = device->read( len );
@@ -504,19 +504,19 @@ bool NifIStream::read( NifValue & val )
 				if ( string.size() != len )
 					return false;
 
-				*static_cast<QString *>(val.val.data) = QString( string );
+				*val.payload<QString>() = QString( string );
 				return true;
 			}
 		}
 	case NifValue::tBSVertexDesc:
 		{
-			*dataStream >> *static_cast<BSVertexDesc *>(val.val.data);
+			*dataStream >> *val.payload<BSVertexDesc>();
 			return (dataStream->status() == QDataStream::Ok);
 		}
 	case NifValue::tBlob:
 		{
 			if ( val.val.data ) {
-				QByteArray * array = static_cast<QByteArray *>(val.val.data);
+				QByteArray * array = val.payload<QByteArray>();
 				return device->read( array->data(), array->size() ) == array->size();
 			}
 
@@ -615,7 +615,7 @@ bool NifOStream::write( const NifValue & val )
 		}
 	case NifValue::tByteVector3:
 		{
-			Vector3 * vec = static_cast<Vector3 *>(val.val.data);
+			Vector3 * vec = val.payload<Vector3>();
 			if ( !vec )
 				return false;
 
@@ -628,7 +628,7 @@ bool NifOStream::write( const NifValue & val )
 		}
 	case NifValue::tUshortVector3:
 		{
-			Vector3 * vec = static_cast<Vector3 *>(val.val.data);
+			Vector3 * vec = val.payload<Vector3>();
 			if ( !vec )
 				return false;
 
@@ -641,7 +641,7 @@ bool NifOStream::write( const NifValue & val )
 		}
 	case NifValue::tHalfVector3:
 		{
-			Vector3 * vec = static_cast<Vector3 *>(val.val.data);
+			Vector3 * vec = val.payload<Vector3>();
 			if ( !vec )
 				return false;
 
@@ -660,7 +660,7 @@ bool NifOStream::write( const NifValue & val )
 		}
 	case NifValue::tHalfVector2:
 		{
-			Vector2 * vec = static_cast<Vector2 *>(val.val.data);
+			Vector2 * vec = val.payload<Vector2>();
 			if ( !vec )
 				return false;
 
@@ -676,29 +676,29 @@ bool NifOStream::write( const NifValue & val )
 			return device->write( (char*)v, 4 ) == 4;
 		}
 	case NifValue::tVector3:
-		return device->write( (char *)static_cast<Vector3 *>(val.val.data)->xyz, 12 ) == 12;
+		return device->write( (char *)val.payload<Vector3>()->xyz, 12 ) == 12;
 	case NifValue::tVector4:
-		return device->write( (char *)static_cast<Vector4 *>(val.val.data)->xyzw, 16 ) == 16;
+		return device->write( (char *)val.payload<Vector4>()->xyzw, 16 ) == 16;
 	case NifValue::tTriangle:
-		return device->write( (char *)static_cast<Triangle *>(val.val.data)->v, 6 ) == 6;
+		return device->write( (char *)val.payload<Triangle>()->v, 6 ) == 6;
 	case NifValue::tQuat:
-		return device->write( (char *)static_cast<Quat *>(val.val.data)->wxyz, 16 ) == 16;
+		return device->write( (char *)val.payload<Quat>()->wxyz, 16 ) == 16;
 	case NifValue::tQuatXYZW:
 		{
-			Quat * q = static_cast<Quat *>(val.val.data);
+			Quat * q = val.payload<Quat>();
 			return device->write( (char *)&q->wxyz[1], 12 ) == 12 && device->write( (char *)q->wxyz, 4 ) == 4;
 		}
 	case NifValue::tMatrix:
-		return device->write( (char *)static_cast<Matrix *>(val.val.data)->m, 36 ) == 36;
+		return device->write( (char *)val.payload<Matrix>()->m, 36 ) == 36;
 	case NifValue::tMatrix4:
-		return device->write( (char *)static_cast<Matrix4 *>(val.val.data)->m, 64 ) == 64;
+		return device->write( (char *)val.payload<Matrix4>()->m, 64 ) == 64;
 	case NifValue::tVector2:
-		return device->write( (char *)static_cast<Vector2 *>(val.val.data)->xy, 8 ) == 8;
+		return device->write( (char *)val.payload<Vector2>()->xy, 8 ) == 8;
 	case NifValue::tColor3:
-		return device->write( (char *)static_cast<Color3 *>(val.val.data)->rgb, 12 ) == 12;
+		return device->write( (char *)val.payload<Color3>()->rgb, 12 ) == 12;
 	case NifValue::tByteColor4:
 		{
-			Color4 * color = static_cast<Color4 *>(val.val.data);
+			Color4 * color = val.payload<Color4>();
 			if ( !color )
 				return false;
 
@@ -712,10 +712,10 @@ bool NifOStream::write( const NifValue & val )
 			return device->write( (char*)c, 4 ) == 4;
 		}
 	case NifValue::tColor4:
-		return device->write( (char *)static_cast<Color4 *>(val.val.data)->rgba, 16 ) == 16;
+		return device->write( (char *)val.payload<Color4>()->rgba, 16 ) == 16;
 	case NifValue::tSizedString:
 		{
-			QByteArray string = static_cast<QString *>(val.val.data)->toLatin1();
+			QByteArray string = val.payload<QString>()->toLatin1();
 			//string.replace( "\\r", "\r" );
 			//string.replace( "\\n", "\n" );
 			int len = string.size();
@@ -727,7 +727,7 @@ bool NifOStream::write( const NifValue & val )
 		}
 	case NifValue::tShortString:
 		{
-			QByteArray string = static_cast<QString *>(val.val.data)->toLocal8Bit();
+			QByteArray string = val.payload<QString>()->toLocal8Bit();
 			string.replace( "\\r", "\r" );
 			string.replace( "\\n", "\n" );
 
@@ -743,7 +743,7 @@ bool NifOStream::write( const NifValue & val )
 		}
 	case NifValue::tText:
 		{
-			QByteArray string = static_cast<QString *>(val.val.data)->toLatin1();
+			QByteArray string = val.payload<QString>()->toLatin1();
 			int len = string.size();
 
 			if ( device->write( (char *)&len, 4 ) != 4 )
@@ -754,7 +754,7 @@ bool NifOStream::write( const NifValue & val )
 	case NifValue::tHeaderString:
 	case NifValue::tLineString:
 		{
-			QByteArray string = static_cast<QString *>(val.val.data)->toLatin1();
+			QByteArray string = val.payload<QString>()->toLatin1();
 
 			if ( device->write( string.constData(), string.length() ) != string.length() )
 				return false;
@@ -763,7 +763,7 @@ bool NifOStream::write( const NifValue & val )
 		}
 	case NifValue::tChar8String:
 		{
-			QByteArray string = static_cast<QString *>(val.val.data)->toLatin1();
+			QByteArray string = val.payload<QString>()->toLatin1();
 			quint32 n = std::min<quint32>( 8, string.length() );
 
 			if ( device->write( string.constData(), n ) != n )
@@ -779,7 +779,7 @@ bool NifOStream::write( const NifValue & val )
 		}
 	case NifValue::tByteArray:
 		{
-			QByteArray * array = static_cast<QByteArray *>(val.val.data);
+			QByteArray * array = val.payload<QByteArray>();
 			int len = array->count();
 
 			if ( device->write( (char *)&len, 4 ) != 4 )
@@ -789,7 +789,7 @@ bool NifOStream::write( const NifValue & val )
 		}
 	case NifValue::tStringPalette:
 		{
-			QByteArray * array = static_cast<QByteArray *>(val.val.data);
+			QByteArray * array = val.payload<QByteArray>();
 			int len = array->count();
 
 			if ( device->write( (char *)&len, 4 ) != 4 )
@@ -802,7 +802,7 @@ bool NifOStream::write( const NifValue & val )
 		}
 	case NifValue::tByteMatrix:
 		{
-			ByteMatrix * array = static_cast<ByteMatrix *>(val.val.data);
+			ByteMatrix * array = val.payload<ByteMatrix>();
 			int len = array->count( 0 );
 
 			if ( device->write( (char *)&len, 4 ) != 4 )
@@ -830,7 +830,7 @@ bool NifOStream::write( const NifValue & val )
 				QByteArray string;
 
 				if ( val.val.data != 0 ) {
-					string = static_cast<QString *>(val.val.data)->toLatin1();
+					string = val.payload<QString>()->toLatin1();
 				}
 
 				//string.replace( "\\r", "\r" );
@@ -845,7 +845,7 @@ bool NifOStream::write( const NifValue & val )
 		}
 	case NifValue::tBSVertexDesc:
 		{
-			auto d = static_cast<BSVertexDesc *>(val.val.data);
+			auto d = val.payload<BSVertexDesc>();
 			if ( !d )
 				return false;
 
@@ -854,7 +854,7 @@ bool NifOStream::write( const NifValue & val )
 	case NifValue::tBlob:
 
 		if ( val.val.data ) {
-			QByteArray * array = static_cast<QByteArray *>(val.val.data);
+			QByteArray * array = val.payload<QByteArray>();
 			return device->write( array->data(), array->size() ) == array->size();
 		}
 
@@ -940,14 +940,14 @@ int NifSStream::size( const NifValue & val )
 		return 16;
 	case NifValue::tSizedString:
 		{
-			QByteArray string = static_cast<QString *>(val.val.data)->toLatin1();
+			QByteArray string = val.payload<QString>()->toLatin1();
 			//string.replace( "\\r", "\r" );
 			//string.replace( "\\n", "\n" );
 			return 4 + string.size();
 		}
 	case NifValue::tShortString:
 		{
-			QByteArray string = static_cast<QString *>(val.val.data)->toLatin1();
+			QByteArray string = val.payload<QString>()->toLatin1();
 
 			//string.replace( "\\r", "\r" );
 			//string.replace( "\\n", "\n" );
@@ -958,13 +958,13 @@ int NifSStream::size( const NifValue & val )
 		}
 	case NifValue::tText:
 		{
-			QByteArray string = static_cast<QString *>(val.val.data)->toLatin1();
+			QByteArray string = val.payload<QString>()->toLatin1();
 			return 4 + string.size();
 		}
 	case NifValue::tHeaderString:
 	case NifValue::tLineString:
 		{
-			QByteArray string = static_cast<QString *>(val.val.data)->toLatin1();
+			QByteArray string = val.payload<QString>()->toLatin1();
 			return string.length() + 1;
 		}
 	case NifValue::tChar8String:
@@ -973,17 +973,17 @@ int NifSStream::size( const NifValue & val )
 		}
 	case NifValue::tByteArray:
 		{
-			QByteArray * array = static_cast<QByteArray *>(val.val.data);
+			QByteArray * array = val.payload<QByteArray>();
 			return 4 + array->count();
 		}
 	case NifValue::tStringPalette:
 		{
-			QByteArray * array = static_cast<QByteArray *>(val.val.data);
+			QByteArray * array = val.payload<QByteArray>();
 			return 4 + array->count() + 4;
 		}
 	case NifValue::tByteMatrix:
 		{
-			ByteMatrix * array = static_cast<ByteMatrix *>(val.val.data);
+			ByteMatrix * array = val.payload<ByteMatrix>();
 			return 4 + 4 + array->count();
 		}
 	case NifValue::tString:
@@ -992,7 +992,7 @@ int NifSStream::size( const NifValue & val )
 			if ( stringAdjust ) {
 				return 4;
 			}
-			QByteArray string = static_cast<QString *>(val.val.data)->toLatin1();
+			QByteArray string = val.payload<QString>()->toLatin1();
 			//string.replace( "\\r", "\r" );
 			//string.replace( "\\n", "\n" );
 			return 4 + string.size();
@@ -1001,7 +1001,7 @@ int NifSStream::size( const NifValue & val )
 	case NifValue::tBlob:
 
 		if ( val.val.data ) {
-			QByteArray * array = static_cast<QByteArray *>(val.val.data);
+			QByteArray * array = val.payload<QByteArray>();
 			return array->size();
 		}
 
@@ -0,0 +1,612 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#include "bonepacking.h"
+#include "vertexweld.h"
+
+#include <QMap>
+#include <QString>
+
+#include <bit>
+#include <functional>
+#include <iterator>
+#include <vector>
+
+
+//! \file bonepacking.cpp BonePacking
+
+namespace
+{
+	//! Bitsets of bones stored back to back
+	class Masks
+	{
+	public:
+		Masks( int numBones, int count ) : words( std::max( (numBones + 63) / 64, 1 ) ), bits( size_t( words ) * count, 0 ) {}
+
+		quint64 * operator[]( int i ) { return bits.data() + size_t( i ) * words; }
+		const quint64 * operator[]( int i ) const { return bits.data() + size_t( i ) * words; }
+
+		int count( int i ) const
+		{
+			const quint64 * a = (*this)[i];
+			int n = 0;
+			for ( int w = 0; w < words; w++ )
+				n += std::popcount( a[w] );
+			return n;
+		}
+
+		//! Number of bones in @p b that are not in @p a
+		int added( int a, int b ) const
+		{
+			const quint64 * x = (*this)[a];
+			const quint64 * y = (*this)[b];
+			int n = 0;
+			for ( int w = 0; w < words; w++ )
+				n += std::popcount( y[w] & ~x[w] );
+			return n;
+		}
+
+		void set( int i, int bone ) { (*this)[i][bone / 64] |= quint64( 1 ) << (bone % 64); }
+
+		void merge( int dst, int src )
+		{
+			quint64 * x = (*this)[dst];
+			const quint64 * y = (*this)[src];
+			for ( int w = 0; w < words; w++ )
+				x[w] |= y[w];
+		}
+
+		bool equal( int a, int b ) const { return std::equal( (*this)[a], (*this)[a] + words, (*this)[b] ); }
+		bool less( int a, int b ) const { return std::lexicographical_compare( (*this)[a], (*this)[a] + words, (*this)[b], (*this)[b] + words ); }
+
+		QVector<int> bones( int i ) const
+		{
+			QVector<int> out;
+			const quint64 * a = (*this)[i];
+			for ( int w = 0; w < words; w++ ) {
+				for ( quint64 m = a[w]; m; m &= m - 1 )
+					out.append( w * 64 + std::countr_zero( m ) );
+			}
+			return out;
+		}
+
+		//! Append an empty set, returns its index
+		int append()
+		{
+			bits.resize( bits.size() + words, 0 );
+			return int( bits.size() / words ) - 1;
+		}
+
+	private:
+		int words;
+		std::vector<quint64> bits;
+	};
+
+	//! Items keyed by the number of bones they add, then by their index
+	class Queue
+	{
+	public:
+		bool isEmpty() const { return heap.empty(); }
+
+		void push( int cost, int item )
+		{
+			heap.push_back( { cost, item } );
+			std::push_heap( heap.begin(), heap.end(), std::greater<>() );
+		}
+
+		std::pair<int, int> pop()
+		{
+			std::pop_heap( heap.begin(), heap.end(), std::greater<>() );
+			auto top = heap.back();
+			heap.pop_back();
+			return top;
+		}
+
+		//! Recompute all costs after the bones of the partition changed, dropping items that no longer fit
+		template <typename CostFn> void update( CostFn cost )
+		{
+			std::vector<std::pair<int, int>> items;
+			items.swap( heap );
+			for ( auto & i : items ) {
+				int c = cost( i.second );
+				if ( c >= 0 )
+					heap.push_back( { c, i.second } );
+			}
+			std::make_heap( heap.begin(), heap.end(), std::greater<>() );
+		}
+
+		void clear() { heap.clear(); }
+
+	private:
+		std::vector<std::pair<int, int>> heap;
+	};
+
+	//! Compressed lists of items for each key
+	struct Buckets
+	{
+		std::vector<int> offsets;
+		std::vector<int> items;
+
+		template <typename KeysFn> Buckets( int numKeys, int numItems, KeysFn keys )
+			: offsets( numKeys + 1, 0 )
+		{
+			for ( int i = 0; i < numItems; i++ )
+				keys( i, [this]( int k ) { offsets[k + 1]++; } );
+			for ( int k = 0; k < numKeys; k++ )
+				offsets[k + 1] += offsets[k];
+
+			items.resize( offsets[numKeys] );
+			std::vector<int> fill( offsets.begin(), offsets.end() - 1 );
+			for ( int i = 0; i < numItems; i++ )
+				keys( i, [this, &fill, i]( int k ) { items[fill[k]++] = i; } );
+		}
+
+		const int * begin( int key ) const { return items.data() + offsets[key]; }
+		const int * end( int key ) const { return items.data() + offsets[key + 1]; }
+	};
+
+	/*! Fill partitions greedily with the items that add the fewest bones
+	 *
+	 * Items are offered by @p neighbors once accepted into a partition, and by @p fitting when
+	 * nothing else fits; a new partition is started from the first unassigned item.
+	 * The masks of the items come first in @p masks, the partition masks are appended after them.
+	 */
+	template <typename NeighborsFn, typename FittingFn>
+	QVector<QVector<int>> fill( Masks & masks, int numItems, int maxBones, NeighborsFn neighbors, FittingFn fitting )
+	{
+		QVector<QVector<int>> parts;
+		std::vector<int> assigned( numItems, -1 );
+		std::vector<int> queued( numItems, -1 );
+		Queue queue;
+
+		for ( int seed = 0; seed < numItems; seed++ ) {
+			if ( assigned[seed] >= 0 )
+				continue;
+
+			int p = parts.count();
+			int mask = masks.append();
+			parts.append( {} );
+
+			auto cost = [&]( int item ) {
+				int n = masks.added( mask, item );
+				return masks.count( mask ) + n <= maxBones ? n : -1;
+			};
+
+			auto offer = [&]( int item ) {
+				if ( assigned[item] < 0 && queued[item] != p ) {
+					queued[item] = p;
+					int c = cost( item );
+					if ( c >= 0 )
+						queue.push( c, item );
+				}
+			};
+
+			queue.clear();
+			queue.push( 0, seed );
+			queued[seed] = p;
+
+			// Bones whose items were offered, items of the same bones are never offered twice
+			QVector<int> offeredBones;
+			bool refilled = false;
+
+			while ( true ) {
+				if ( queue.isEmpty() ) {
+					if ( refilled )
+						break;
+
+					QVector<int> bones = masks.bones( mask ), added;
+					std::set_difference( bones.begin(), bones.end(), offeredBones.begin(), offeredBones.end(), std::back_inserter( added ) );
+					offeredBones = bones;
+
+					fitting( added, offer );
+					refilled = true;
+					if ( queue.isEmpty() )
+						break;
+				}
+
+				int item = queue.pop().second;
+				if ( assigned[item] >= 0 )
+					continue;
+
+				// An oversized item only ever starts a partition
+				int c = masks.added( mask, item );
+				if ( masks.count( mask ) + c > maxBones && !parts[p].isEmpty() )
+					continue;
+
+				assigned[item] = p;
+				parts[p].append( item );
+
+				if ( c > 0 ) {
+					masks.merge( mask, item );
+					queue.update( cost );
+					// Items on the new bones have not been offered yet
+					refilled = false;
+				}
+
+				neighbors( item, offer );
+			}
+		}
+
+		return parts;
+	}
+
+	/*! Merge the pairs of partitions that share the most bones while they fit
+	 *
+	 * @param masks	Bone sets of the partitions from index @p first on, merged in place
+	 */
+	void merge( Masks & masks, int first, QVector<QVector<int>> & parts, int maxBones )
+	{
+		QVector<bool> alive( parts.count(), true );
+		while ( true ) {
+			int bestA = -1, bestB = -1, bestShared = -1, bestUnion = 0;
+			for ( int a = 0; a < parts.count(); a++ ) {
+				if ( !alive[a] )
+					continue;
+
+				int na = masks.count( first + a );
+				for ( int b = a + 1; b < parts.count(); b++ ) {
+					if ( !alive[b] )
+						continue;
+
+					int added = masks.added( first + a, first + b );
+					int merged = na + added;
+					if ( merged > maxBones )
+						continue;
+
+					int shared = masks.count( first + b ) - added;
+					if ( shared > bestShared || (shared == bestShared && merged < bestUnion) ) {
+						bestA = a;
+						bestB = b;
+						bestShared = shared;
+						bestUnion = merged;
+					}
+				}
+			}
+
+			if ( bestA < 0 )
+				break;
+
+			masks.merge( first + bestA, first + bestB );
+			parts[bestA] << parts[bestB];
+			parts[bestB].clear();
+			alive[bestB] = false;
+		}
+	}
+
+	//! Partitions from item lists, where each item is a list of triangles
+	QVector<BonePacking::Partition> collect( const Masks & masks, int first, const QVector<QVector<int>> & parts,
+		const QVector<QVector<int>> & items, const QVector<Triangle> & tris )
+	{
+		QVector<BonePacking::Partition> out;
+		for ( int p = 0; p < parts.count(); p++ ) {
+			if ( parts[p].isEmpty() )
+				continue;
+
+			BonePacking::Partition part;
+			part.bones = masks.bones( first + p );
+			for ( int item : parts[p] ) {
+				for ( int t : items[item] )
+					part.triangles.append( tris[t] );
+			}
+			out.append( part );
+		}
+		return out;
+	}
+
+	//! Grow partitions over the triangles sharing vertices
+	QVector<BonePacking::Partition> packAdjacent( Masks masks, const QVector<Triangle> & tris, int numVerts, int numBones, int maxBones )
+	{
+		Buckets vertexTris( numVerts, tris.count(), [&tris]( int t, auto add ) {
+			add( tris[t][0] );
+			if ( tris[t][1] != tris[t][0] )
+				add( tris[t][1] );
+			if ( tris[t][2] != tris[t][0] && tris[t][2] != tris[t][1] )
+				add( tris[t][2] );
+		} );
+
+		Buckets boneTris( std::max( numBones, 1 ), tris.count(), [&masks]( int t, auto add ) {
+			for ( int b : masks.bones( t ) )
+				add( b );
+		} );
+
+		QVector<QVector<int>> parts = fill( masks, tris.count(), maxBones,
+			[&]( int t, auto offer ) {
+				for ( int c = 0; c < 3; c++ ) {
+					for ( const int * n = vertexTris.begin( tris[t][c] ); n != vertexTris.end( tris[t][c] ); ++n )
+						offer( *n );
+				}
+			},
+			[&]( const QVector<int> & bones, auto offer ) {
+				for ( int b : bones ) {
+					for ( const int * n = boneTris.begin( b ); n != boneTris.end( b ); ++n )
+						offer( *n );
+				}
+			}
+		);
+
+		merge( masks, tris.count(), parts, maxBones );
+
+		QVector<QVector<int>> items;
+		items.reserve( tris.count() );
+		for ( int t = 0; t < tris.count(); t++ )
+			items.append( { t } );
+
+		return collect( masks, tris.count(), parts, items, tris );
+	}
+
+	//! Pack the distinct bone sets of the triangles, largest first
+	QVector<BonePacking::Partition> packGroups( const Masks & masks, const QVector<Triangle> & tris, int numBones, int maxBones )
+	{
+		// Sort the triangles by bone set to find the distinct sets
+		std::vector<int> order( tris.count() );
+		for ( int t = 0; t < tris.count(); t++ )
+			order[t] = t;
+		std::stable_sort( order.begin(), order.end(), [&masks]( int a, int b ) { return masks.less( a, b ); } );
+
+		QVector<QVector<int>> groups;
+		for ( size_t i = 0; i < order.size(); i++ ) {
+			if ( i == 0 || !masks.equal( order[i - 1], order[i] ) )
+				groups.append( {} );
+			groups.last().append( order[i] );
+		}
+
+		// Largest bone sets first, then the most triangles
+		std::stable_sort( groups.begin(), groups.end(), [&masks]( const QVector<int> & a, const QVector<int> & b ) {
+			int na = masks.count( a.first() ), nb = masks.count( b.first() );
+			return na > nb || (na == nb && a.count() > b.count());
+		} );
+
+		int numGroups = groups.count();
+		Masks groupMasks( numBones, numGroups );
+		for ( int g = 0; g < numGroups; g++ ) {
+			for ( int b : masks.bones( groups[g].first() ) )
+				groupMasks.set( g, b );
+		}
+
+		QVector<QVector<int>> parts = fill( groupMasks, numGroups, maxBones,
+			[]( int, auto ) {},
+			[numGroups]( const QVector<int> &, auto offer ) {
+				for ( int g = 0; g < numGroups; g++ )
+					offer( g );
+			}
+		);
+
+		merge( groupMasks, numGroups, parts, maxBones );
+
+		return collect( groupMasks, numGroups, parts, groups, tris );
+	}
+}
+
+
+QVector<BonePacking::Partition> BonePacking::pack( const QVector<QVector<int>> & vertexBones, const QVector<Triangle> & triangles,
+	int maxBones, Mode mode )
+{
+	int numVerts = vertexBones.count();
+
+	QVector<Triangle> tris;
+	tris.reserve( triangles.count() );
+	for ( const Triangle & t : triangles ) {
+		if ( t[0] < numVerts && t[1] < numVerts && t[2] < numVerts )
+			tris.append( t );
+	}
+
+	int numBones = 0;
+	for ( const QVector<int> & bones : vertexBones ) {
+		for ( int b : bones )
+			numBones = std::max( numBones, b + 1 );
+	}
+
+	Masks masks( numBones, tris.count() );
+	for ( int t = 0; t < tris.count(); t++ ) {
+		for ( int c = 0; c < 3; c++ ) {
+			for ( int b : vertexBones[tris[t][c]] ) {
+				if ( b >= 0 )
+					masks.set( t, b );
+			}
+		}
+	}
+
+	QVector<Partition> parts = packAdjacent( masks, tris, numVerts, numBones, maxBones );
+	if ( mode == MinimizeCount ) {
+		// Neither packing always wins, adjacency duplicates fewer vertices on a tie
+		QVector<Partition> grouped = packGroups( masks, tris, numBones, maxBones );
+		if ( grouped.count() < parts.count() )
+			parts = grouped;
+	}
+
+	return parts;
+}
+
+BonePacking::Stats BonePacking::analyze( const QVector<Partition> & partitions, int numVerts )
+{
+	Stats stats;
+	std::vector<int> seen( numVerts, -1 );
+	std::vector<bool> used( numVerts, false );
+
+	for ( int p = 0; p < partitions.count(); p++ ) {
+		const Partition & part = partitions[p];
+		int bones = part.bones.count();
+		stats.minBones = stats.partitions ? std::min( stats.minBones, bones ) : bones;
+		stats.maxBones = std::max( stats.maxBones, bones );
+		stats.totalBones += bones;
+		stats.partitions++;
+		stats.triangles += part.triangles.count();
+
+		for ( const Triangle & t : part.triangles ) {
+			for ( int c = 0; c < 3; c++ ) {
+				int v = t[c];
+				if ( v >= numVerts || seen[v] == p )
+					continue;
+
+				seen[v] = p;
+				stats.vertices++;
+				if ( !used[v] ) {
+					used[v] = true;
+					stats.meshVertices++;
+				}
+			}
+		}
+	}
+
+	return stats;
+}
+
+int BonePacking::limitTriangleBones( const QVector<Vector3> & verts, const QVector<Triangle> & triangles,
+	QVector<QList<BoneWeight>> & weights, int maxBones )
+{
+	const int numVerts = std::min( verts.count(), weights.count() );
+
+	// Vertices at exactly the same position, by the lowest of them. Only these can match.
+	QVector<int> position = weldVertices( verts, []( int, int ) { return true; } );
+	QVector<QVector<int>> shared( numVerts );
+	for ( int v = 0; v < numVerts; v++ )
+		shared[position[v]].append( v );
+
+	// The vertices each vertex matched so far, itself included. A match is found again whenever
+	// the weights of one of the vertices at a position changed, and kept when they differ later.
+	QVector<QVector<int>> match( numVerts );
+	QVector<int> dirty;
+	QVector<bool> isDirty( numVerts, false );
+	for ( int v = 0; v < numVerts; v++ ) {
+		if ( shared[v].count() > 1 ) {
+			dirty.append( v );
+			isDirty[v] = true;
+		}
+	}
+
+	auto addMatch = []( QVector<int> & list, int v ) {
+		auto it = std::lower_bound( list.begin(), list.end(), v );
+		if ( it == list.end() || *it != v )
+			list.insert( it, v );
+	};
+
+	auto detect = [&]() {
+		for ( int head : dirty ) {
+			const QVector<int> & members = shared[head];
+			for ( int i = 0; i < members.count(); i++ ) {
+				int a = members[i];
+				addMatch( match[a], a );
+				for ( int j = i + 1; j < members.count(); j++ ) {
+					int b = members[j];
+					if ( weights[a] == weights[b] ) {
+						addMatch( match[a], b );
+						addMatch( match[b], a );
+					}
+				}
+			}
+			isDirty[head] = false;
+		}
+		dirty.clear();
+	};
+
+	int removed = 0;
+	QList<int> tribones;
+
+	for ( const Triangle & tri : triangles ) {
+		do {
+			tribones.clear();
+
+			for ( int c = 0; c < 3; c++ ) {
+				for ( const auto & bw : weights[tri[c]] ) {
+					if ( !tribones.contains( bw.first ) )
+						tribones.append( bw.first );
+				}
+			}
+
+			if ( tribones.count() <= maxBones )
+				break;
+
+			// sum up the weights for each bone, bones with weight == 1 can't be removed
+			QMap<int, float> sum;
+			QList<int> nono;
+
+			for ( int t = 0; t < 3; t++ ) {
+				if ( weights[tri[t]].count() == 1 )
+					nono.append( weights[tri[t]].first().first );
+
+				for ( const auto & bw : weights[tri[t]] )
+					sum[bw.first] += bw.second;
+			}
+
+			float minWeight = 5.0;
+			int minBone = -1;
+
+			for ( auto it = sum.cbegin(); it != sum.cend(); ++it ) {
+				if ( !nono.contains( it.key() ) && it.value() < minWeight ) {
+					minWeight = it.value();
+					minBone = it.key();
+				}
+			}
+
+			if ( minBone < 0 )
+				throw QString( "internal error 0x01" );
+
+			detect();
+
+			// remove the bone from the corners and from the vertices matching them
+			for ( int t = 0; t < 3; t++ ) {
+				bool rem = false;
+				const QVector<int> & matching = ( tri[t] < numVerts && !match[tri[t]].isEmpty() ) ? match[tri[t]] : QVector<int>{ tri[t] };
+
+				for ( int v : matching ) {
+					QList<BoneWeight> & bws = weights[v];
+					for ( int b = bws.count() - 1; b >= 0; b-- ) {
+						if ( bws[b].first == minBone ) {
+							bws.removeAt( b );
+							rem = true;
+						}
+					}
+
+					float totalWeight = 0;
+					for ( const auto & bw : bws )
+						totalWeight += bw.second;
+
+					if ( totalWeight == 0 )
+						throw QString( "internal error 0x02" );
+
+					for ( auto & bw : bws )
+						bw.second /= totalWeight;
+
+					if ( v < numVerts && !isDirty[position[v]] && shared[position[v]].count() > 1 ) {
+						isDirty[position[v]] = true;
+						dirty.append( position[v] );
+					}
+				}
+
+				if ( rem )
+					removed++;
+			}
+		} while ( true );
+	}
+
+	return removed;
+}
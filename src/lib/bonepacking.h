@@ -0,0 +1,131 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#ifndef BONEPACKING_H
+#define BONEPACKING_H
+
+#include "data/niftypes.h"
+
+#include <QList>
+#include <QPair>
+#include <QVector>
+
+#include <algorithm>
+
+
+//! \file bonepacking.h Packing of skinned triangles into partitions with a bone limit
+
+/*! Grouping of skinned triangles into skin partitions
+ *
+ * Each triangle needs all bones influencing its vertices in the partition it is drawn with,
+ * and a partition may only reference a limited number of bones. Bone sets are stored as
+ * bitsets, and triangles are packed greedily with a priority queue ordered by the number of
+ * bones they would add to the partition being filled. Partitions are then merged by best fit.
+ *
+ * Triangles that need more bones than the limit by themselves each get their own partition.
+ * Triangles referring to vertices at or past the vertex count are ignored.
+ */
+namespace BonePacking
+{
+	enum Mode
+	{
+		//! Grow partitions over adjacent triangles, which duplicates fewer vertices across partitions
+		KeepAdjacent,
+		//! Also pack triangles by bone set regardless of adjacency, keeping whichever needs fewer partitions
+		MinimizeCount
+	};
+
+	struct Partition
+	{
+		//! Sorted bone indices
+		QVector<int> bones;
+		QVector<Triangle> triangles;
+	};
+
+	//! Summary of a set of partitions
+	struct Stats
+	{
+		int partitions = 0;
+		int triangles = 0;
+		//! Sum of the vertex counts of the partitions
+		int vertices = 0;
+		//! Number of distinct vertices used, less than vertices when partitions share vertices
+		int meshVertices = 0;
+		int minBones = 0;
+		int maxBones = 0;
+		int totalBones = 0;
+
+		double averageBones() const { return partitions ? double( totalBones ) / partitions : 0.0; }
+
+		Stats & operator+=( const Stats & other )
+		{
+			minBones = partitions ? (other.partitions ? std::min( minBones, other.minBones ) : minBones) : other.minBones;
+			maxBones = std::max( maxBones, other.maxBones );
+			partitions += other.partitions;
+			triangles += other.triangles;
+			vertices += other.vertices;
+			meshVertices += other.meshVertices;
+			totalBones += other.totalBones;
+			return *this;
+		}
+	};
+
+	/*! Split triangles into partitions of at most @p maxBones bones
+	 *
+	 * @param vertexBones	For each vertex, the bones that influence it
+	 */
+	QVector<Partition> pack( const QVector<QVector<int>> & vertexBones, const QVector<Triangle> & triangles, int maxBones,
+		Mode mode = KeepAdjacent );
+
+	//! Count partitions, bones and vertices
+	Stats analyze( const QVector<Partition> & partitions, int numVerts );
+
+	//! A bone and its weight on a vertex
+	using BoneWeight = QPair<int, float>;
+
+	/*! Remove bone influences until no triangle needs more than @p maxBones bones
+	 *
+	 * For each triangle in turn, the bone with the least summed weight over its corners is
+	 * removed from them and the weights renormalized, except bones that are the only
+	 * influence of a corner. Vertices at the same position that have, or at some point had,
+	 * the same weights as a corner lose the bone too, so that seams stay closed.
+	 *
+	 * Throws a QString if no bone can be removed or a vertex loses all its weight.
+	 *
+	 * @param weights	For each vertex, its bones and weights
+	 * @return			The number of triangle corners that lost an influence
+	 */
+	int limitTriangleBones( const QVector<Vector3> & verts, const QVector<Triangle> & triangles,
+		QVector<QList<BoneWeight>> & weights, int maxBones );
+}
+
+#endif
@@ -0,0 +1,756 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#include "convexdecomposition.h"
+
+#include <QHash>
+#include <QPair>
+#include <QSet>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <set>
+
+
+//! \file convexdecomposition.cpp ConvexDecomposition
+
+namespace
+{
+	//! Candidate split planes per axis and part
+	const int maxCandidates = 12;
+
+	enum Cell : quint8
+	{
+		Outside = 0,
+		Surface = 1,
+		Inside = 2
+	};
+
+	//! Voxel corner, in voxel units
+	struct Point
+	{
+		int v[3];
+
+		int operator[]( int i ) const { return v[i]; }
+	};
+
+	inline Point operator-( const Point & a, const Point & b )
+	{
+		return { { a[0] - b[0], a[1] - b[1], a[2] - b[2] } };
+	}
+
+	inline void cross( const Point & a, const Point & b, qint64 out[3] )
+	{
+		out[0] = qint64( a[1] ) * b[2] - qint64( a[2] ) * b[1];
+		out[1] = qint64( a[2] ) * b[0] - qint64( a[0] ) * b[2];
+		out[2] = qint64( a[0] ) * b[1] - qint64( a[1] ) * b[0];
+	}
+
+	inline qint64 dot( const qint64 n[3], const Point & p )
+	{
+		return n[0] * p[0] + n[1] * p[1] + n[2] * p[2];
+	}
+
+	inline quint32 packVoxel( int x, int y, int z )
+	{
+		return quint32( x ) | (quint32( y ) << 8) | (quint32( z ) << 16);
+	}
+
+	inline int voxelCoord( quint32 v, int axis )
+	{
+		return int( (v >> (8 * axis)) & 0xFF );
+	}
+
+	//! Incremental convex hull of integer points, exact since all predicates fit in 64 bits
+	class IntHull
+	{
+	public:
+		//! Build the hull of a point set, false if the points are coplanar
+		bool build( QVector<Point> points );
+		//! Add a point, false if it is inside the hull
+		bool add( const Point & p );
+
+		//! Six times the volume
+		qint64 volume6() const;
+		//! Largest distance of a point outside the face planes, not positive if inside
+		double distance( const Point & p ) const;
+
+		QVector<Point> vertices() const;
+		//! Distinct face planes as normals with integer components and their offsets, n . p = d
+		QVector<QPair<Point, qint64>> planes() const;
+
+	private:
+		struct Face
+		{
+			int v[3];
+			qint64 n[3];
+			qint64 d;
+			bool alive;
+		};
+
+		void addFace( int a, int b, int c );
+
+		QVector<Point> pts;
+		QVector<Face> faces;
+		int deadFaces = 0;
+	};
+
+	void IntHull::addFace( int a, int b, int c )
+	{
+		Face f;
+		f.v[0] = a;
+		f.v[1] = b;
+		f.v[2] = c;
+		cross( pts[b] - pts[a], pts[c] - pts[a], f.n );
+		f.d = dot( f.n, pts[a] );
+		f.alive = true;
+		faces.append( f );
+	}
+
+	bool IntHull::build( QVector<Point> points )
+	{
+		pts.clear();
+		faces.clear();
+		deadFaces = 0;
+
+		if ( points.count() < 4 )
+			return false;
+
+		auto dist2 = []( const Point & a, const Point & b ) {
+			Point d = a - b;
+			return qint64( d[0] ) * d[0] + qint64( d[1] ) * d[1] + qint64( d[2] ) * d[2];
+		};
+
+		// Initial tetrahedron from far apart points
+		int i0 = 0;
+		for ( int i = 1; i < points.count(); i++ ) {
+			if ( std::lexicographical_compare( points[i].v, points[i].v + 3, points[i0].v, points[i0].v + 3 ) )
+				i0 = i;
+		}
+
+		int i1 = -1;
+		qint64 best = 0;
+		for ( int i = 0; i < points.count(); i++ ) {
+			qint64 d = dist2( points[i], points[i0] );
+			if ( d > best ) {
+				best = d;
+				i1 = i;
+			}
+		}
+		if ( i1 < 0 )
+			return false;
+
+		int i2 = -1;
+		best = 0;
+		for ( int i = 0; i < points.count(); i++ ) {
+			qint64 n[3];
+			cross( points[i1] - points[i0], points[i] - points[i0], n );
+			qint64 d = n[0] * n[0] + n[1] * n[1] + n[2] * n[2];
+			if ( d > best ) {
+				best = d;
+				i2 = i;
+			}
+		}
+		if ( i2 < 0 )
+			return false;
+
+		qint64 n[3];
+		cross( points[i1] - points[i0], points[i2] - points[i0], n );
+		qint64 d0 = dot( n, points[i0] );
+
+		int i3 = -1;
+		best = 0;
+		for ( int i = 0; i < points.count(); i++ ) {
+			qint64 d = std::abs( dot( n, points[i] ) - d0 );
+			if ( d > best ) {
+				best = d;
+				i3 = i;
+			}
+		}
+		if ( i3 < 0 )
+			return false;
+
+		pts = { points[i0], points[i1], points[i2], points[i3] };
+		if ( dot( n, points[i3] ) > d0 ) {
+			addFace( 0, 2, 1 );
+			addFace( 0, 1, 3 );
+			addFace( 1, 2, 3 );
+			addFace( 2, 0, 3 );
+		} else {
+			addFace( 0, 1, 2 );
+			addFace( 0, 3, 1 );
+			addFace( 1, 3, 2 );
+			addFace( 2, 3, 0 );
+		}
+
+		// Random order keeps the intermediate hulls small
+		std::mt19937 rng( 1 );
+		std::shuffle( points.begin(), points.end(), rng );
+		for ( const Point & p : points )
+			add( p );
+
+		return true;
+	}
+
+	bool IntHull::add( const Point & p )
+	{
+		QVector<int> visible;
+		for ( int f = 0; f < faces.count(); f++ ) {
+			if ( faces[f].alive && dot( faces[f].n, p ) > faces[f].d )
+				visible.append( f );
+		}
+
+		if ( visible.isEmpty() )
+			return false;
+
+		int idx = pts.count();
+		pts.append( p );
+
+		auto edgeKey = []( int a, int b ) { return (quint64( quint32( a ) ) << 32) | quint32( b ); };
+
+		QSet<quint64> edges;
+		for ( int f : visible ) {
+			for ( int i = 0; i < 3; i++ )
+				edges.insert( edgeKey( faces[f].v[i], faces[f].v[(i + 1) % 3] ) );
+		}
+
+		// The horizon is made of the edges of the visible faces whose twin is not visible
+		for ( int f : visible ) {
+			faces[f].alive = false;
+			deadFaces++;
+
+			int v[3] = { faces[f].v[0], faces[f].v[1], faces[f].v[2] };
+			for ( int i = 0; i < 3; i++ ) {
+				int a = v[i], b = v[(i + 1) % 3];
+				if ( !edges.contains( edgeKey( b, a ) ) )
+					addFace( a, b, idx );
+			}
+		}
+
+		if ( deadFaces > faces.count() / 2 ) {
+			faces.erase( std::remove_if( faces.begin(), faces.end(), []( const Face & f ) { return !f.alive; } ), faces.end() );
+			deadFaces = 0;
+		}
+
+		return true;
+	}
+
+	qint64 IntHull::volume6() const
+	{
+		qint64 vol = 0;
+		for ( const Face & f : faces ) {
+			if ( !f.alive )
+				continue;
+
+			qint64 n[3];
+			cross( pts[f.v[1]], pts[f.v[2]], n );
+			vol += dot( n, pts[f.v[0]] );
+		}
+		return vol;
+	}
+
+	double IntHull::distance( const Point & p ) const
+	{
+		double best = -1e30;
+		for ( const Face & f : faces ) {
+			if ( !f.alive )
+				continue;
+
+			double len = std::sqrt( double( f.n[0] * f.n[0] + f.n[1] * f.n[1] + f.n[2] * f.n[2] ) );
+			if ( len > 0.0 )
+				best = std::max( best, (dot( f.n, p ) - f.d) / len );
+		}
+		return best;
+	}
+
+	QVector<Point> IntHull::vertices() const
+	{
+		QVector<bool> used( pts.count(), false );
+		for ( const Face & f : faces ) {
+			if ( f.alive ) {
+				for ( int i = 0; i < 3; i++ )
+					used[f.v[i]] = true;
+			}
+		}
+
+		QVector<Point> out;
+		for ( int i = 0; i < pts.count(); i++ ) {
+			if ( used[i] )
+				out.append( pts[i] );
+		}
+		return out;
+	}
+
+	QVector<QPair<Point, qint64>> IntHull::planes() const
+	{
+		QVector<QPair<Point, qint64>> out;
+		std::set<std::array<qint64, 4>> seen;
+		for ( const Face & f : faces ) {
+			if ( !f.alive )
+				continue;
+
+			// Coplanar triangles reduce to the same plane
+			qint64 g = std::gcd( std::gcd( std::abs( f.n[0] ), std::abs( f.n[1] ) ), std::abs( f.n[2] ) );
+			if ( g == 0 )
+				continue;
+
+			Point n = { { int( f.n[0] / g ), int( f.n[1] / g ), int( f.n[2] / g ) } };
+			qint64 d = f.d / g;
+			if ( seen.insert( { n[0], n[1], n[2], d } ).second )
+				out.append( { n, d } );
+		}
+		return out;
+	}
+
+	//! Separating axis test of a triangle against a box, Akenine-Möller
+	bool triangleBoxOverlap( const Vector3 & center, float half, const Vector3 tri[3] )
+	{
+		Vector3 v[3] = { tri[0] - center, tri[1] - center, tri[2] - center };
+		Vector3 e[3] = { v[1] - v[0], v[2] - v[1], v[0] - v[2] };
+
+		// The nine cross products of the triangle edges and the box axes
+		for ( int i = 0; i < 3; i++ ) {
+			for ( int a = 0; a < 3; a++ ) {
+				Vector3 axis;
+				axis[a] = 0.0f;
+				axis[(a + 1) % 3] = -e[i][(a + 2) % 3];
+				axis[(a + 2) % 3] = e[i][(a + 1) % 3];
+
+				float p0 = Vector3::dotproduct( axis, v[0] );
+				float p1 = Vector3::dotproduct( axis, v[1] );
+				float p2 = Vector3::dotproduct( axis, v[2] );
+				float r = half * (std::abs( axis[0] ) + std::abs( axis[1] ) + std::abs( axis[2] ));
+				if ( std::min( { p0, p1, p2 } ) > r || std::max( { p0, p1, p2 } ) < -r )
+					return false;
+			}
+		}
+
+		// The box axes
+		for ( int a = 0; a < 3; a++ ) {
+			if ( std::min( { v[0][a], v[1][a], v[2][a] } ) > half || std::max( { v[0][a], v[1][a], v[2][a] } ) < -half )
+				return false;
+		}
+
+		// The triangle plane
+		Vector3 n = Vector3::crossproduct( e[0], e[1] );
+		float d = Vector3::dotproduct( n, v[0] );
+		float r = half * (std::abs( n[0] ) + std::abs( n[1] ) + std::abs( n[2] ));
+		return std::abs( d ) <= r;
+	}
+
+	//! Voxelized mesh
+	struct Grid
+	{
+		int dim[3] = { 0, 0, 0 };
+		Vector3 origin;
+		float size = 0.0f;
+		QVector<quint8> cells;
+
+		int index( int x, int y, int z ) const { return (z * dim[1] + y) * dim[0] + x; }
+	};
+
+	Grid voxelize( const QVector<Vector3> & vertices, const QVector<Triangle> & triangles, int resolution )
+	{
+		Grid grid;
+
+		Vector3 lo = vertices[0], hi = vertices[0];
+		for ( const Vector3 & v : vertices ) {
+			lo.boundMin( v );
+			hi.boundMax( v );
+		}
+
+		Vector3 extent = hi - lo;
+		float largest = std::max( { extent[0], extent[1], extent[2] } );
+		if ( largest <= 0.0f )
+			return grid;
+
+		grid.size = largest / resolution;
+		for ( int a = 0; a < 3; a++ ) {
+			grid.dim[a] = int( std::ceil( extent[a] / grid.size ) ) + 1;
+			grid.origin[a] = lo[a] - (grid.dim[a] * grid.size - extent[a]) / 2;
+		}
+		grid.cells.fill( Outside, grid.dim[0] * grid.dim[1] * grid.dim[2] );
+
+		float half = grid.size / 2;
+		for ( const Triangle & t : triangles ) {
+			if ( t[0] >= vertices.count() || t[1] >= vertices.count() || t[2] >= vertices.count() )
+				continue;
+
+			const Vector3 tri[3] = { vertices[t[0]], vertices[t[1]], vertices[t[2]] };
+			int cmin[3], cmax[3];
+			for ( int a = 0; a < 3; a++ ) {
+				float tmin = std::min( { tri[0][a], tri[1][a], tri[2][a] } );
+				float tmax = std::max( { tri[0][a], tri[1][a], tri[2][a] } );
+				cmin[a] = std::clamp( int( std::floor( (tmin - grid.origin[a]) / grid.size ) ), 0, grid.dim[a] - 1 );
+				cmax[a] = std::clamp( int( std::floor( (tmax - grid.origin[a]) / grid.size ) ), 0, grid.dim[a] - 1 );
+			}
+
+			for ( int z = cmin[2]; z <= cmax[2]; z++ ) {
+				for ( int y = cmin[1]; y <= cmax[1]; y++ ) {
+					for ( int x = cmin[0]; x <= cmax[0]; x++ ) {
+						quint8 & cell = grid.cells[grid.index( x, y, z )];
+						if ( cell == Surface )
+							continue;
+
+						Vector3 center = grid.origin + Vector3( x + 0.5f, y + 0.5f, z + 0.5f ) * grid.size;
+						if ( triangleBoxOverlap( center, half, tri ) )
+							cell = Surface;
+					}
+				}
+			}
+		}
+
+		// Flood the outside from the border, whatever is not reached is enclosed by the surface
+		QVector<bool> reached( grid.cells.count(), false );
+		QVector<int> stack;
+		for ( int z = 0; z < grid.dim[2]; z++ ) {
+			for ( int y = 0; y < grid.dim[1]; y++ ) {
+				for ( int x = 0; x < grid.dim[0]; x++ ) {
+					bool border = x == 0 || y == 0 || z == 0 || x == grid.dim[0] - 1 || y == grid.dim[1] - 1 || z == grid.dim[2] - 1;
+					int i = grid.index( x, y, z );
+					if ( border && grid.cells[i] != Surface ) {
+						reached[i] = true;
+						stack.append( i );
+					}
+				}
+			}
+		}
+
+		const int step[3] = { 1, grid.dim[0], grid.dim[0] * grid.dim[1] };
+		while ( !stack.isEmpty() ) {
+			int i = stack.takeLast();
+			int c[3] = { i % grid.dim[0], (i / grid.dim[0]) % grid.dim[1], i / step[2] };
+			for ( int a = 0; a < 3; a++ ) {
+				for ( int dir : { -1, 1 } ) {
+					int n = c[a] + dir;
+					if ( n < 0 || n >= grid.dim[a] )
+						continue;
+
+					int j = i + dir * step[a];
+					if ( !reached[j] && grid.cells[j] != Surface ) {
+						reached[j] = true;
+						stack.append( j );
+					}
+				}
+			}
+		}
+
+		for ( int i = 0; i < grid.cells.count(); i++ ) {
+			if ( grid.cells[i] == Outside && !reached[i] )
+				grid.cells[i] = Inside;
+		}
+
+		return grid;
+	}
+
+	/*! Voxel corners whose hull is the hull of a set of voxels
+	 *
+	 * A hull vertex is the first or last point on the lines through it along each axis,
+	 * so only the corners that are extreme along all three axes are kept.
+	 */
+	QVector<Point> hullPoints( const QVector<quint32> & voxels )
+	{
+		int lo[3] = { 255, 255, 255 }, hi[3] = { 0, 0, 0 };
+		for ( quint32 v : voxels ) {
+			for ( int a = 0; a < 3; a++ ) {
+				lo[a] = std::min( lo[a], voxelCoord( v, a ) );
+				hi[a] = std::max( hi[a], voxelCoord( v, a ) );
+			}
+		}
+
+		// First and last corner of each corner line along X
+		int ny = hi[1] - lo[1] + 2, nz = hi[2] - lo[2] + 2;
+		QVector<int> xmin( ny * nz, INT_MAX ), xmax( ny * nz, INT_MIN );
+		for ( quint32 v : voxels ) {
+			int x = voxelCoord( v, 0 ), y = voxelCoord( v, 1 ) - lo[1], z = voxelCoord( v, 2 ) - lo[2];
+			for ( int dz = 0; dz < 2; dz++ ) {
+				for ( int dy = 0; dy < 2; dy++ ) {
+					int i = (z + dz) * ny + y + dy;
+					xmin[i] = std::min( xmin[i], x );
+					xmax[i] = std::max( xmax[i], x + 1 );
+				}
+			}
+		}
+
+		QVector<Point> points;
+		for ( int z = 0; z < nz; z++ ) {
+			for ( int y = 0; y < ny; y++ ) {
+				int i = z * ny + y;
+				if ( xmin[i] == INT_MAX )
+					continue;
+
+				points.append( { { xmin[i], y + lo[1], z + lo[2] } } );
+				points.append( { { xmax[i], y + lo[1], z + lo[2] } } );
+			}
+		}
+
+		// Keep those that are also first or last along Y and Z
+		auto extremes = [&points]( int axis, int u, int w ) {
+			QHash<quint32, QPair<int, int>> range;
+			for ( const Point & p : points ) {
+				quint32 key = (quint32( p[u] ) << 16) | quint32( p[w] );
+				if ( !range.contains( key ) ) {
+					range.insert( key, { p[axis], p[axis] } );
+				} else {
+					QPair<int, int> & r = range[key];
+					r.first = std::min( r.first, p[axis] );
+					r.second = std::max( r.second, p[axis] );
+				}
+			}
+			return range;
+		};
+
+		auto yRange = extremes( 1, 0, 2 );
+		auto zRange = extremes( 2, 0, 1 );
+
+		QVector<Point> out;
+		for ( const Point & p : points ) {
+			auto y = yRange.value( (quint32( p[0] ) << 16) | quint32( p[2] ) );
+			auto z = zRange.value( (quint32( p[0] ) << 16) | quint32( p[1] ) );
+			if ( (p[1] == y.first || p[1] == y.second) && (p[2] == z.first || p[2] == z.second) )
+				out.append( p );
+		}
+		return out;
+	}
+
+	//! Volume of the hull of a set of voxels beyond the voxels themselves, in voxels
+	double concavity( const QVector<quint32> & voxels )
+	{
+		IntHull hull;
+		if ( !hull.build( hullPoints( voxels ) ) )
+			return 0.0;
+
+		return std::max( hull.volume6() / 6.0 - voxels.count(), 0.0 );
+	}
+
+	struct Part
+	{
+		QVector<quint32> voxels;
+		double concavity = 0.0;
+	};
+
+	struct Candidate
+	{
+		int axis;
+		int position;
+		double cost = 0.0;
+		int imbalance = 0;
+	};
+
+	//! Split a part by the axis aligned plane that leaves the least concavity, false if it is one voxel
+	bool split( const Part & part, Part & left, Part & right )
+	{
+		int lo[3] = { 255, 255, 255 }, hi[3] = { 0, 0, 0 };
+		for ( quint32 v : part.voxels ) {
+			for ( int a = 0; a < 3; a++ ) {
+				lo[a] = std::min( lo[a], voxelCoord( v, a ) );
+				hi[a] = std::max( hi[a], voxelCoord( v, a ) );
+			}
+		}
+
+		// Voxels below the position go left, both sides are never empty
+		QVector<Candidate> candidates;
+		for ( int a = 0; a < 3; a++ ) {
+			int span = hi[a] - lo[a];
+			int count = std::min( span, maxCandidates );
+			for ( int i = 1; i <= count; i++ ) {
+				Candidate c;
+				c.axis = a;
+				c.position = lo[a] + (span * i + count / 2) / (count + 1) + 1;
+				c.position = std::clamp( c.position, lo[a] + 1, hi[a] );
+				candidates.append( c );
+			}
+		}
+
+		if ( candidates.isEmpty() )
+			return false;
+
+		QtConcurrent::blockingMap( candidates, [&part]( Candidate & c ) {
+			QVector<quint32> below, above;
+			for ( quint32 v : part.voxels )
+				(voxelCoord( v, c.axis ) < c.position ? below : above).append( v );
+
+			c.cost = concavity( below ) + concavity( above );
+			c.imbalance = std::abs( below.count() - above.count() );
+		} );
+
+		const Candidate & best = *std::min_element( candidates.begin(), candidates.end(), []( const Candidate & a, const Candidate & b ) {
+			return a.cost < b.cost || (a.cost == b.cost && a.imbalance < b.imbalance);
+		} );
+
+		left = Part();
+		right = Part();
+		for ( quint32 v : part.voxels )
+			(voxelCoord( v, best.axis ) < best.position ? left : right).voxels.append( v );
+
+		left.concavity = concavity( left.voxels );
+		right.concavity = concavity( right.voxels );
+		return true;
+	}
+
+	//! The hull of a part, reduced to the vertex budget by keeping the vertices furthest outside
+	ConvexDecomposition::Hull makeHull( const Part & part, const Grid & grid, int maxVertices )
+	{
+		ConvexDecomposition::Hull result;
+
+		IntHull hull;
+		if ( !hull.build( hullPoints( part.voxels ) ) )
+			return result;
+
+		QVector<Point> verts = hull.vertices();
+		if ( verts.count() > maxVertices ) {
+			// Start from the extremes along the axes and the diagonals
+			QVector<Point> kept;
+			const int dirs[13][3] = {
+				{ 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 },
+				{ 1, 1, 1 }, { 1, 1, -1 }, { 1, -1, 1 }, { -1, 1, 1 },
+				{ 1, 1, 0 }, { 1, -1, 0 }, { 1, 0, 1 }, { 1, 0, -1 }, { 0, 1, 1 }, { 0, 1, -1 }
+			};
+			for ( const auto & d : dirs ) {
+				for ( int sign : { 1, -1 } ) {
+					auto proj = [&d, sign]( const Point & p ) { return sign * (d[0] * p[0] + d[1] * p[1] + d[2] * p[2]); };
+					const Point & p = *std::max_element( verts.begin(), verts.end(), [&proj]( const Point & a, const Point & b ) {
+						return proj( a ) < proj( b );
+					} );
+
+					bool known = std::any_of( kept.begin(), kept.end(), [&p]( const Point & k ) {
+						return k[0] == p[0] && k[1] == p[1] && k[2] == p[2];
+					} );
+					if ( !known && kept.count() < std::max( maxVertices, 4 ) )
+						kept.append( p );
+				}
+			}
+
+			IntHull reduced;
+			if ( reduced.build( kept ) ) {
+				while ( reduced.vertices().count() < maxVertices ) {
+					int furthest = -1;
+					double best = 0.0;
+					for ( int i = 0; i < verts.count(); i++ ) {
+						double d = reduced.distance( verts[i] );
+						if ( d > best ) {
+							best = d;
+							furthest = i;
+						}
+					}
+
+					if ( furthest < 0 )
+						break;
+
+					reduced.add( verts[furthest] );
+				}
+				hull = reduced;
+			}
+		}
+
+		for ( const Point & p : hull.vertices() )
+			result.vertices.append( grid.origin + Vector3( p[0], p[1], p[2] ) * grid.size );
+
+		// n . (x - origin) / size = d in world units
+		for ( const auto & plane : hull.planes() ) {
+			const Point & n = plane.first;
+			Vector3 normal( n[0], n[1], n[2] );
+			float len = normal.length();
+			float offset = plane.second * grid.size + Vector3::dotproduct( normal, grid.origin );
+			result.planes.append( Vector4( normal / len, -offset / len ) );
+		}
+
+		result.volume = float( hull.volume6() / 6.0 ) * grid.size * grid.size * grid.size;
+		return result;
+	}
+}
+
+
+ConvexDecomposition::Result ConvexDecomposition::decompose( const QVector<Vector3> & vertices, const QVector<Triangle> & triangles,
+	const Options & opts )
+{
+	Result result;
+	if ( vertices.isEmpty() || triangles.isEmpty() )
+		return result;
+
+	Grid grid = voxelize( vertices, triangles, std::clamp( opts.resolution, 1, 250 ) );
+
+	Part root;
+	for ( int z = 0; z < grid.dim[2]; z++ ) {
+		for ( int y = 0; y < grid.dim[1]; y++ ) {
+			for ( int x = 0; x < grid.dim[0]; x++ ) {
+				if ( grid.cells[grid.index( x, y, z )] != Outside )
+					root.voxels.append( packVoxel( x, y, z ) );
+			}
+		}
+	}
+
+	if ( root.voxels.isEmpty() )
+		return result;
+
+	double total = root.voxels.count();
+	root.concavity = concavity( root.voxels );
+
+	QVector<Part> parts = { root };
+	while ( parts.count() < opts.maxHulls ) {
+		auto worst = std::max_element( parts.begin(), parts.end(), []( const Part & a, const Part & b ) {
+			return a.concavity < b.concavity;
+		} );
+
+		// Zero once every part is convex or too small to split
+		if ( worst->concavity <= 0.0 || worst->concavity / total < opts.maxConcavity )
+			break;
+
+		Part left, right;
+		if ( !split( *worst, left, right ) ) {
+			// A single voxel hull has no concavity left to remove
+			worst->concavity = 0.0;
+			continue;
+		}
+
+		*worst = left;
+		parts.append( right );
+	}
+
+	result.hulls.resize( parts.count() );
+	QVector<int> order( parts.count() );
+	std::iota( order.begin(), order.end(), 0 );
+	QtConcurrent::blockingMap( order, [&]( const int & i ) {
+		result.hulls[i] = makeHull( parts[i], grid, std::max( opts.maxVertices, 4 ) );
+	} );
+
+	result.meshVolume = float( total ) * grid.size * grid.size * grid.size;
+	for ( const Hull & h : result.hulls )
+		result.hullVolume += h.volume;
+
+	return result;
+}
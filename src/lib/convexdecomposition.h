@@ -0,0 +1,92 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#ifndef CONVEXDECOMPOSITION_H
+#define CONVEXDECOMPOSITION_H
+
+#include "data/niftypes.h"
+
+#include <QVector>
+
+
+//! \file convexdecomposition.h Approximate convex decomposition
+
+/*! Approximate convex decomposition of triangle meshes into a few convex hulls
+ *
+ * The mesh is voxelized and its inside filled when it is closed. The voxels are then split
+ * recursively by axis aligned planes, always splitting the part whose hull exceeds its voxels
+ * by the largest volume and choosing the plane that leaves the least such excess. Candidate
+ * planes are evaluated in parallel.
+ *
+ * Hulls are built from the voxel corners with exact integer arithmetic, so they enclose the
+ * mesh with up to one voxel of padding. Hulls with more vertices than the budget keep the
+ * vertices that lie furthest outside the hull of those already kept.
+ */
+namespace ConvexDecomposition
+{
+	struct Options
+	{
+		//! Largest number of hulls
+		int maxHulls = 8;
+		//! Largest number of vertices per hull
+		int maxVertices = 32;
+		//! Number of voxels along the largest dimension of the mesh, at most 250
+		int resolution = 64;
+		//! Parts whose hull exceeds their volume by less than this share of the mesh volume are not split
+		float maxConcavity = 0.01f;
+	};
+
+	struct Hull
+	{
+		QVector<Vector3> vertices;
+		//! Outward normal in XYZ, and minus the dot product of the normal and any point on the plane in W
+		QVector<Vector4> planes;
+		float volume = 0.0f;
+	};
+
+	struct Result
+	{
+		QVector<Hull> hulls;
+		//! Volume of the voxelized mesh
+		float meshVolume = 0.0f;
+		//! Sum of the hull volumes
+		float hullVolume = 0.0f;
+
+		//! Relative amount by which the hulls exceed the voxelized mesh
+		float volumeError() const { return meshVolume > 0.0f ? (hullVolume - meshVolume) / meshVolume : 0.0f; }
+	};
+
+	//! Decompose a mesh, triangles referring to missing vertices are ignored
+	Result decompose( const QVector<Vector3> & vertices, const QVector<Triangle> & triangles, const Options & opts = Options() );
+}
+
+#endif
@@ -33,6 +33,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "message.h"
 #include "gl/gltex.h"
 #include "gl/glscene.h"
+#include "model/meshstreams.h"
 #include "model/nifmodel.h"
 #include "spells/tangentspace.h"
 
@@ -137,18 +138,10 @@ static void writeData( const NifModel * nif, const QModelIndex & iData, QTextStr
 		if ( !iVertData.isValid() )
 			return;
 
-		QVector<Vector3> verts;
-		QVector<Vector2> coords;
-		QVector<Vector3> norms;
-
-		auto numVerts = nif->get<int>( iData, "Num Vertices" );
-		for ( int i = 0; i < numVerts; i++ ) {
-			auto idx = nif->index( i, 0, iVertData );
-
-			verts += nif->get<Vector3>( idx, "Vertex" );
-			coords += nif->get<HalfVector2>( idx, "UV" );
-			norms += nif->get<ByteVector3>( idx, "Normal" );
-		}
+		MeshStreams streams( nif, iVertData, nif->get<int>( iData, "Num Vertices" ) );
+		QVector<Vector3> verts = streams.positions();
+		QVector<Vector2> coords = streams.uvs();
+		QVector<Vector3> norms = streams.normals();
 
 		for ( Vector3 & v : verts ) {
 			v = t * v;
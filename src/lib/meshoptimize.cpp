@@ -0,0 +1,390 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#include "meshoptimize.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+
+//! \file meshoptimize.cpp MeshOptimize
+
+namespace
+{
+	//! Size of the LRU cache modeled by the vertex cache optimizer
+	const int forsythCacheSize = 32;
+	const float forsythDecayPower = 1.5f;
+	const float forsythLastTriScore = 0.75f;
+	const float forsythValenceScale = 2.0f;
+	const float forsythValencePower = 0.5f;
+
+	//! Cache size used to find the cluster boundaries for overdraw optimization
+	const int clusterCacheSize = 16;
+
+	//! Whether all vertices of @p tri are below @p numVerts
+	inline bool inRange( const Triangle & tri, int numVerts )
+	{
+		return tri[0] < numVerts && tri[1] < numVerts && tri[2] < numVerts;
+	}
+
+	//! Score of a vertex for the Forsyth optimizer
+	class VertexScorer
+	{
+	public:
+		VertexScorer()
+		{
+			for ( int i = 0; i < forsythCacheSize; i++ ) {
+				if ( i < 3 ) {
+					// The vertices of the last triangle get a fixed score, so the
+					// optimizer does not favor reusing them straight away
+					cacheScore[i] = forsythLastTriScore;
+				} else {
+					float s = 1.0f - float( i - 3 ) / ( forsythCacheSize - 3 );
+					cacheScore[i] = std::pow( s, forsythDecayPower );
+				}
+			}
+
+			for ( int v = 1; v < valenceTableSize; v++ )
+				valenceScore[v] = forsythValenceScale * std::pow( float( v ), -forsythValencePower );
+			valenceScore[0] = 0.0f;
+		}
+
+		float score( int cachePos, int remaining ) const
+		{
+			// Nothing left to draw with this vertex
+			if ( remaining <= 0 )
+				return -1.0f;
+
+			float s = ( cachePos >= 0 ) ? cacheScore[cachePos] : 0.0f;
+			if ( remaining < valenceTableSize )
+				return s + valenceScore[remaining];
+
+			return s + forsythValenceScale * std::pow( float( remaining ), -forsythValencePower );
+		}
+
+	private:
+		static const int valenceTableSize = 64;
+
+		float cacheScore[forsythCacheSize];
+		float valenceScore[valenceTableSize];
+	};
+}
+
+
+MeshOptimize::CacheStats MeshOptimize::analyzeVertexCache( const QVector<Triangle> & triangles, int numVerts, int cacheSize )
+{
+	CacheStats stats;
+	if ( numVerts <= 0 )
+		return stats;
+
+	// Time each vertex was last transformed, counted in transformed vertices
+	QVector<int> stamp( numVerts, -cacheSize - 1 );
+
+	for ( const Triangle & tri : triangles ) {
+		if ( !inRange( tri, numVerts ) )
+			continue;
+
+		stats.triangles++;
+		for ( int j = 0; j < 3; j++ ) {
+			int v = tri[j];
+			if ( stats.transformed - stamp[v] <= cacheSize )
+				continue;
+
+			if ( stamp[v] == -cacheSize - 1 )
+				stats.vertices++;
+
+			stamp[v] = stats.transformed++;
+		}
+	}
+
+	return stats;
+}
+
+QVector<Triangle> MeshOptimize::optimizeVertexCache( const QVector<Triangle> & triangles, int numVerts )
+{
+	QVector<Triangle> tris;
+	QVector<Triangle> tail;
+	tris.reserve( triangles.count() );
+	for ( const Triangle & tri : triangles ) {
+		if ( inRange( tri, numVerts ) )
+			tris << tri;
+		else
+			tail << tri;
+	}
+
+	const int numTris = tris.count();
+	if ( numTris < 2 )
+		return triangles;
+
+	// Triangles of each vertex, the first remaining[v] entries from first[v] are not drawn yet
+	QVector<int> remaining( numVerts, 0 );
+	for ( const Triangle & tri : tris ) {
+		for ( int j = 0; j < 3; j++ )
+			remaining[tri[j]]++;
+	}
+
+	QVector<int> first( numVerts + 1, 0 );
+	for ( int v = 0; v < numVerts; v++ )
+		first[v + 1] = first[v] + remaining[v];
+
+	QVector<int> adjacency( first[numVerts] );
+	{
+		QVector<int> fill( first.mid( 0, numVerts ) );
+		for ( int t = 0; t < numTris; t++ ) {
+			for ( int j = 0; j < 3; j++ )
+				adjacency[fill[tris[t][j]]++] = t;
+		}
+	}
+
+	static const VertexScorer scorer;
+
+	QVector<int> cachePos( numVerts, -1 );
+	QVector<float> vertexScore( numVerts );
+	for ( int v = 0; v < numVerts; v++ )
+		vertexScore[v] = scorer.score( -1, remaining[v] );
+
+	QVector<float> triScore( numTris );
+	QVector<bool> added( numTris, false );
+	int best = 0;
+	for ( int t = 0; t < numTris; t++ ) {
+		const Triangle & tri = tris[t];
+		triScore[t] = vertexScore[tri[0]] + vertexScore[tri[1]] + vertexScore[tri[2]];
+		if ( triScore[t] > triScore[best] )
+			best = t;
+	}
+
+	QVector<int> cache;
+	QVector<int> newCache;
+	cache.reserve( forsythCacheSize + 3 );
+	newCache.reserve( forsythCacheSize + 3 );
+
+	QVector<Triangle> result;
+	result.reserve( triangles.count() );
+	int cursor = 0;
+
+	while ( result.count() < numTris ) {
+		if ( best < 0 ) {
+			// Nothing in the cache has triangles left, start over with the next one in input order
+			while ( added[cursor] )
+				cursor++;
+			best = cursor;
+		}
+
+		const Triangle & tri = tris[best];
+		result << tri;
+		added[best] = true;
+
+		for ( int j = 0; j < 3; j++ ) {
+			int v = tri[j];
+			int * begin = adjacency.data() + first[v];
+			int * end = begin + remaining[v];
+			int * it = std::find( begin, end, best );
+			if ( it != end ) {
+				*it = *( end - 1 );
+				remaining[v]--;
+			}
+		}
+
+		// The vertices of the triangle move to the front of the cache, pushing the others back
+		newCache.clear();
+		for ( int j = 0; j < 3; j++ ) {
+			if ( !newCache.contains( tri[j] ) )
+				newCache << tri[j];
+		}
+		for ( int v : cache ) {
+			if ( !newCache.contains( v ) )
+				newCache << v;
+		}
+		std::swap( cache, newCache );
+
+		for ( int i = 0; i < cache.count(); i++ ) {
+			int v = cache[i];
+			cachePos[v] = ( i < forsythCacheSize ) ? i : -1;
+
+			float s = scorer.score( cachePos[v], remaining[v] );
+			float d = s - vertexScore[v];
+			if ( d != 0.0f ) {
+				for ( int a = first[v], e = first[v] + remaining[v]; a < e; a++ )
+					triScore[adjacency[a]] += d;
+				vertexScore[v] = s;
+			}
+		}
+
+		if ( cache.count() > forsythCacheSize )
+			cache.resize( forsythCacheSize );
+
+		best = -1;
+		float bestScore = -FLT_MAX;
+		for ( int v : cache ) {
+			for ( int a = first[v], e = first[v] + remaining[v]; a < e; a++ ) {
+				int t = adjacency[a];
+				if ( triScore[t] > bestScore ) {
+					bestScore = triScore[t];
+					best = t;
+				}
+			}
+		}
+	}
+
+	return result + tail;
+}
+
+QVector<Triangle> MeshOptimize::optimizeOverdraw( const QVector<Triangle> & triangles, const QVector<Vector3> & positions, float threshold )
+{
+	const int numVerts = positions.count();
+
+	QVector<Triangle> tris;
+	QVector<Triangle> tail;
+	tris.reserve( triangles.count() );
+	for ( const Triangle & tri : triangles ) {
+		if ( inRange( tri, numVerts ) )
+			tris << tri;
+		else
+			tail << tri;
+	}
+
+	const int numTris = tris.count();
+	if ( numTris < 2 )
+		return triangles;
+
+	// Cluster boundaries are where the cache restarts, i.e. a triangle misses on all of its vertices
+	QVector<int> clusterStart;
+	{
+		QVector<int> stamp( numVerts, -clusterCacheSize - 1 );
+		int transformed = 0;
+		for ( int t = 0; t < numTris; t++ ) {
+			int misses = 0;
+			for ( int j = 0; j < 3; j++ ) {
+				int v = tris[t][j];
+				if ( transformed - stamp[v] > clusterCacheSize ) {
+					stamp[v] = transformed++;
+					misses++;
+				}
+			}
+
+			if ( t == 0 || misses == 3 )
+				clusterStart << t;
+		}
+	}
+
+	const int numClusters = clusterStart.count();
+	if ( numClusters < 2 )
+		return triangles;
+	clusterStart << numTris;
+
+	// Area weighted centroid and normal of every cluster and of the whole mesh
+	QVector<Vector3> centroid( numClusters );
+	QVector<Vector3> normal( numClusters );
+	Vector3 meshCentroid;
+	double meshArea = 0.0;
+
+	for ( int c = 0; c < numClusters; c++ ) {
+		Vector3 sum;
+		double area = 0.0;
+		for ( int t = clusterStart[c]; t < clusterStart[c + 1]; t++ ) {
+			const Vector3 & a = positions[tris[t][0]];
+			const Vector3 & b = positions[tris[t][1]];
+			const Vector3 & d = positions[tris[t][2]];
+
+			Vector3 n = Vector3::crossproduct( b - a, d - a );
+			float w = n.length();
+			sum += ( a + b + d ) * ( w / 3.0f );
+			normal[c] += n;
+			area += w;
+		}
+
+		centroid[c] = ( area > 0.0 ) ? sum / area : Vector3();
+		meshCentroid += sum;
+		meshArea += area;
+	}
+
+	if ( !( meshArea > 0.0 ) || !std::isfinite( meshArea ) )
+		return triangles;
+	meshCentroid /= meshArea;
+
+	QVector<float> sortKey( numClusters );
+	QVector<int> order( numClusters );
+	for ( int c = 0; c < numClusters; c++ ) {
+		Vector3 n = normal[c];
+		n.normalize();
+		sortKey[c] = Vector3::dotproduct( centroid[c] - meshCentroid, n );
+		order[c] = c;
+	}
+
+	// Clusters on the outside and facing out occlude the most, draw them first
+	std::stable_sort( order.begin(), order.end(), [&sortKey]( int a, int b ) {
+		return sortKey[a] > sortKey[b];
+	} );
+
+	QVector<Triangle> result;
+	result.reserve( triangles.count() );
+	for ( int c : order ) {
+		for ( int t = clusterStart[c]; t < clusterStart[c + 1]; t++ )
+			result << tris[t];
+	}
+
+	double before = analyzeVertexCache( tris, numVerts ).acmr();
+	double after = analyzeVertexCache( result, numVerts ).acmr();
+	if ( after > before * threshold )
+		return triangles;
+
+	return result + tail;
+}
+
+QVector<int> MeshOptimize::optimizeVertexFetch( QVector<Triangle> & triangles, int numVerts )
+{
+	QVector<int> remap( numVerts, -1 );
+	QVector<int> order;
+	order.reserve( numVerts );
+
+	for ( Triangle & tri : triangles ) {
+		if ( !inRange( tri, numVerts ) )
+			continue;
+
+		for ( int j = 0; j < 3; j++ ) {
+			int v = tri[j];
+			if ( remap[v] < 0 ) {
+				remap[v] = order.count();
+				order << v;
+			}
+			tri[j] = quint16( remap[v] );
+		}
+	}
+
+	for ( int v = 0; v < numVerts; v++ ) {
+		if ( remap[v] < 0 )
+			order << v;
+	}
+
+	return order;
+}
@@ -0,0 +1,101 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#ifndef MESHOPTIMIZE_H
+#define MESHOPTIMIZE_H
+
+#include "data/niftypes.h"
+
+#include <QVector>
+
+
+//! \file meshoptimize.h Triangle and vertex ordering for the post-transform vertex cache
+
+/*! Reordering of indexed triangle lists for modern GPUs
+ *
+ * Triangles referring to vertices at or past the vertex count are never moved or
+ * remapped; they are kept after all other triangles.
+ */
+namespace MeshOptimize
+{
+	//! Post-transform vertex cache statistics of a triangle list, simulated with a FIFO cache
+	struct CacheStats
+	{
+		int triangles = 0;
+		//! Number of distinct vertices referenced by the triangles
+		int vertices = 0;
+		//! Number of vertices transformed, i.e. cache misses
+		int transformed = 0;
+
+		//! Average cache miss ratio, vertices transformed per triangle (0.5 to 3, lower is better)
+		double acmr() const { return triangles ? double( transformed ) / triangles : 0.0; }
+		//! Average transform to vertex ratio, vertices transformed per vertex (1 is ideal)
+		double atvr() const { return vertices ? double( transformed ) / vertices : 0.0; }
+
+		CacheStats & operator+=( const CacheStats & other )
+		{
+			triangles += other.triangles;
+			vertices += other.vertices;
+			transformed += other.transformed;
+			return *this;
+		}
+	};
+
+	//! Simulate a FIFO post-transform cache of @p cacheSize vertices
+	CacheStats analyzeVertexCache( const QVector<Triangle> & triangles, int numVerts, int cacheSize = 16 );
+
+	/*! Reorder triangles for vertex cache locality
+	 *
+	 * Uses Tom Forsyth's "Linear-Speed Vertex Cache Optimisation", which does not depend
+	 * on the exact cache size of the hardware.
+	 */
+	QVector<Triangle> optimizeVertexCache( const QVector<Triangle> & triangles, int numVerts );
+
+	/*! Reorder clusters of triangles to reduce overdraw
+	 *
+	 * @p triangles should already be optimized for the vertex cache. The list is split where
+	 * the cache restarts, and the clusters that face away from the mesh center are drawn first.
+	 * The result is discarded if it raises the ACMR by more than @p threshold times.
+	 */
+	QVector<Triangle> optimizeOverdraw( const QVector<Triangle> & triangles, const QVector<Vector3> & positions, float threshold = 1.05f );
+
+	/*! Reorder vertices in the order the triangles first use them
+	 *
+	 * Vertices no triangle uses keep their relative order after the used ones.
+	 * The triangles are remapped in place.
+	 *
+	 * @return	For each new vertex index, the old one
+	 */
+	QVector<int> optimizeVertexFetch( QVector<Triangle> & triangles, int numVerts );
+}
+
+#endif
@@ -0,0 +1,607 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#include "meshsimplify.h"
+
+#include <QHash>
+#include <QSet>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+
+
+//! \file meshsimplify.cpp MeshSimplify
+
+namespace
+{
+	//! Weight of the planes that hold open borders in place, relative to the face planes
+	const double borderWeight = 10.0;
+	//! Minimum cosine between the normals of a triangle before and after a collapse
+	const double flipThreshold = 0.2;
+
+	//! Sum of weighted squared distances to a set of planes
+	struct Quadric
+	{
+		double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+		double b0 = 0, b1 = 0, b2 = 0;
+		double c = 0;
+		//! Area of the faces, to turn the sum into a mean
+		double area = 0;
+
+		void addPlane( const Vector3 & n, double d, double w )
+		{
+			a00 += w * n[0] * n[0]; a01 += w * n[0] * n[1]; a02 += w * n[0] * n[2];
+			a11 += w * n[1] * n[1]; a12 += w * n[1] * n[2]; a22 += w * n[2] * n[2];
+			b0 += w * n[0] * d; b1 += w * n[1] * d; b2 += w * n[2] * d;
+			c += w * d * d;
+		}
+
+		double eval( const Vector3 & p ) const
+		{
+			double x = p[0], y = p[1], z = p[2];
+			double r = a00 * x * x + a11 * y * y + a22 * z * z
+				+ 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+				+ 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+
+			return std::max( r, 0.0 );
+		}
+
+		Quadric & operator+=( const Quadric & o )
+		{
+			a00 += o.a00; a01 += o.a01; a02 += o.a02;
+			a11 += o.a11; a12 += o.a12; a22 += o.a22;
+			b0 += o.b0; b1 += o.b1; b2 += o.b2;
+			c += o.c;
+			area += o.area;
+			return *this;
+		}
+	};
+
+	enum VertexKind : quint8
+	{
+		//! Interior vertex, collapses onto any neighbor
+		Manifold,
+		//! On a simple open border, collapses along the border only
+		Border,
+		//! On a seam, a border corner or a non-manifold edge, never moves
+		Locked
+	};
+
+	inline quint64 edgeKey( int a, int b )
+	{
+		return (quint64( quint32( a ) ) << 32) | quint32( b );
+	}
+
+	inline double sq( double x )
+	{
+		return x * x;
+	}
+
+	//! Edge collapse state of MeshSimplify::simplify
+	class Simplifier
+	{
+	public:
+		Simplifier( const QVector<Triangle> & triangles, const MeshSimplify::Mesh & mesh, const MeshSimplify::Options & opts );
+
+		/*! Collapse edges until at most @p targetCount triangles remain
+		 *
+		 * Collapses that would move the surface by more than the square root of @p maxError
+		 * are skipped. The attribute and skin costs only decide the order of the collapses.
+		 */
+		void run( int targetCount, double maxError );
+
+		//! The current triangles, followed by the out of range ones
+		QVector<Triangle> triangles() const { return tris + kept; }
+		//! Relative geometric error of the collapses so far
+		double error() const { return std::sqrt( resultError ); }
+
+	private:
+		bool canCollapse( int i, int j ) const;
+		//! Mean squared distance of the faces around @p i to @p j
+		double geometricError( int i, int j ) const;
+		//! Whether moving @p i onto @p j flips or degenerates a triangle that stays
+		bool flips( int i, int j, const int * fan, int fanSize ) const;
+		double attributeDistance( int i, int j ) const;
+		double skinDistance( int i, int j ) const;
+
+		const MeshSimplify::Mesh & mesh;
+		MeshSimplify::Options opts;
+		int numVerts;
+
+		//! Positions scaled to the unit cube
+		QVector<Vector3> pos;
+		//! The first vertex at the same position as each vertex
+		QVector<int> remap;
+		//! Per remapped vertex
+		QVector<VertexKind> kind;
+		//! Per remapped vertex
+		QVector<Quadric> quadrics;
+		//! Open border edges between remapped vertices, lower index first
+		QSet<quint64> borderEdges;
+
+		QVector<Triangle> tris;
+		QVector<Triangle> kept;
+
+		double resultError = 0;
+	};
+
+	Simplifier::Simplifier( const QVector<Triangle> & triangles, const MeshSimplify::Mesh & mesh, const MeshSimplify::Options & opts )
+		: mesh( mesh ), opts( opts ), numVerts( mesh.positions.count() )
+	{
+		for ( const Triangle & tri : triangles ) {
+			if ( tri[0] < numVerts && tri[1] < numVerts && tri[2] < numVerts )
+				tris << tri;
+			else
+				kept << tri;
+		}
+
+		// Scale to the unit cube, so the errors are relative to the size of the mesh
+		Vector3 lo( FLT_MAX, FLT_MAX, FLT_MAX ), hi( -FLT_MAX, -FLT_MAX, -FLT_MAX );
+		for ( const Vector3 & p : mesh.positions ) {
+			for ( int c = 0; c < 3; c++ ) {
+				lo[c] = std::min( lo[c], p[c] );
+				hi[c] = std::max( hi[c], p[c] );
+			}
+		}
+
+		float extent = 0.0f;
+		for ( int c = 0; c < 3 && numVerts > 0; c++ )
+			extent = std::max( extent, hi[c] - lo[c] );
+		float scale = (extent > 0.0f) ? 1.0f / extent : 1.0f;
+
+		pos.resize( numVerts );
+		for ( int i = 0; i < numVerts; i++ )
+			pos[i] = (mesh.positions.at( i ) - lo) * scale;
+
+		// Vertices sharing a position, split for their attributes
+		QVector<int> order( numVerts );
+		std::iota( order.begin(), order.end(), 0 );
+		auto posLess = [&mesh]( int a, int b ) {
+			const Vector3 & p = mesh.positions.at( a );
+			const Vector3 & q = mesh.positions.at( b );
+			return std::lexicographical_compare( &p[0], &p[0] + 3, &q[0], &q[0] + 3 );
+		};
+		std::stable_sort( order.begin(), order.end(), posLess );
+
+		remap.resize( numVerts );
+		QVector<int> wedges( numVerts, 0 );
+		for ( int k = 0; k < numVerts; k++ ) {
+			int v = order[k];
+			bool same = k > 0 && !posLess( order[k - 1], v ) && !posLess( v, order[k - 1] );
+			remap[v] = same ? remap[order[k - 1]] : v;
+			wedges[remap[v]]++;
+		}
+
+		kind.fill( Manifold, numVerts );
+		for ( int v = 0; v < numVerts; v++ ) {
+			if ( wedges[remap[v]] > 1 )
+				kind[remap[v]] = Locked;
+		}
+
+		// Edge topology between positions
+		QHash<quint64, int> directed;
+		for ( const Triangle & tri : tris ) {
+			for ( int k = 0; k < 3; k++ ) {
+				int a = remap[tri[k]], b = remap[tri[(k + 1) % 3]];
+				if ( a != b )
+					directed[edgeKey( a, b )]++;
+			}
+		}
+
+		QVector<int> borderCount( numVerts, 0 );
+		for ( auto it = directed.cbegin(); it != directed.cend(); ++it ) {
+			int a = int( it.key() >> 32 ), b = int( it.key() & 0xFFFFFFFF );
+			int back = directed.value( edgeKey( b, a ) );
+			if ( it.value() > 1 || it.value() + back > 2 ) {
+				kind[a] = kind[b] = Locked;
+			} else if ( back == 0 ) {
+				borderEdges.insert( edgeKey( std::min( a, b ), std::max( a, b ) ) );
+				borderCount[a]++;
+				borderCount[b]++;
+			}
+		}
+
+		for ( int v = 0; v < numVerts; v++ ) {
+			if ( borderCount[v] == 0 || kind[v] == Locked )
+				continue;
+			kind[v] = (opts.lockBorders || borderCount[v] != 2) ? Locked : Border;
+		}
+
+		// Face planes, weighted by area, and planes perpendicular to the open borders
+		quadrics.resize( numVerts );
+		for ( const Triangle & tri : tris ) {
+			int c[3] = { remap[tri[0]], remap[tri[1]], remap[tri[2]] };
+			const Vector3 & p0 = pos.at( c[0] );
+
+			Vector3 n = Vector3::crossproduct( pos.at( c[1] ) - p0, pos.at( c[2] ) - p0 );
+			float len = n.length();
+			if ( len <= 0.0f )
+				continue;
+
+			n /= len;
+			double d = -Vector3::dotproduct( n, p0 );
+			double area = 0.5 * len;
+			for ( int k = 0; k < 3; k++ ) {
+				quadrics[c[k]].addPlane( n, d, area );
+				quadrics[c[k]].area += area;
+			}
+
+			for ( int k = 0; k < 3; k++ ) {
+				int a = c[k], b = c[(k + 1) % 3];
+				if ( a == b || !borderEdges.contains( edgeKey( std::min( a, b ), std::max( a, b ) ) ) )
+					continue;
+
+				Vector3 e = pos.at( b ) - pos.at( a );
+				Vector3 bn = Vector3::crossproduct( e, n );
+				float blen = bn.length();
+				if ( blen <= 0.0f )
+					continue;
+
+				bn /= blen;
+				double bd = -Vector3::dotproduct( bn, pos.at( a ) );
+				double w = borderWeight * Vector3::dotproduct( e, e );
+				quadrics[a].addPlane( bn, bd, w );
+				quadrics[b].addPlane( bn, bd, w );
+			}
+		}
+	}
+
+	bool Simplifier::canCollapse( int i, int j ) const
+	{
+		int ci = remap[i], cj = remap[j];
+		if ( ci == cj )
+			return false;
+
+		switch ( kind[ci] ) {
+		case Manifold:
+			return true;
+		case Border:
+			return kind[cj] != Manifold && borderEdges.contains( edgeKey( std::min( ci, cj ), std::max( ci, cj ) ) );
+		default:
+			return false;
+		}
+	}
+
+	double Simplifier::attributeDistance( int i, int j ) const
+	{
+		double d = 0.0;
+
+		if ( mesh.uvs.count() == numVerts )
+			d += sq( mesh.uvs[i][0] - mesh.uvs[j][0] ) + sq( mesh.uvs[i][1] - mesh.uvs[j][1] );
+
+		// Normals and colors differ by up to 2 and 1 per component
+		if ( mesh.normals.count() == numVerts ) {
+			for ( int c = 0; c < 3; c++ )
+				d += 0.25 * sq( mesh.normals[i][c] - mesh.normals[j][c] );
+		}
+
+		if ( mesh.colors.count() == numVerts ) {
+			for ( int c = 0; c < 4; c++ )
+				d += sq( mesh.colors[i][c] - mesh.colors[j][c] );
+		}
+
+		return d;
+	}
+
+	double Simplifier::skinDistance( int i, int j ) const
+	{
+		int n = mesh.influences;
+		if ( n <= 0 || mesh.boneWeights.count() != numVerts * n || mesh.boneIndices.count() != numVerts * n )
+			return 0.0;
+
+		const int * bi = mesh.boneIndices.constData() + i * n;
+		const int * bj = mesh.boneIndices.constData() + j * n;
+		const float * wi = mesh.boneWeights.constData() + i * n;
+		const float * wj = mesh.boneWeights.constData() + j * n;
+
+		// Sum of the weight differences per bone, half of it as the vertices share no bones at all
+		double d = 0.0;
+		for ( int a = 0; a < n; a++ ) {
+			double w = 0.0;
+			for ( int b = 0; b < n; b++ ) {
+				if ( bj[b] == bi[a] )
+					w += wj[b];
+			}
+			d += std::abs( wi[a] - w );
+		}
+		for ( int b = 0; b < n; b++ ) {
+			if ( std::find( bi, bi + n, bj[b] ) == bi + n )
+				d += wj[b];
+		}
+
+		return 0.5 * d;
+	}
+
+	double Simplifier::geometricError( int i, int j ) const
+	{
+		const Quadric & q = quadrics.at( remap[i] );
+		double e = q.eval( pos.at( j ) );
+
+		return (q.area > 0.0) ? e / q.area : e;
+	}
+
+	bool Simplifier::flips( int i, int j, const int * fan, int fanSize ) const
+	{
+		for ( int f = 0; f < fanSize; f++ ) {
+			const Triangle & tri = tris.at( fan[f] );
+			if ( tri[0] == j || tri[1] == j || tri[2] == j )
+				continue;
+
+			int k = (tri[0] == i) ? 0 : (tri[1] == i) ? 1 : 2;
+			const Vector3 & b = pos.at( tri[(k + 1) % 3] );
+			const Vector3 & c = pos.at( tri[(k + 2) % 3] );
+
+			Vector3 n0 = Vector3::crossproduct( b - pos.at( i ), c - pos.at( i ) );
+			Vector3 n1 = Vector3::crossproduct( b - pos.at( j ), c - pos.at( j ) );
+			double l0 = n0.length();
+			if ( l0 <= 0.0 )
+				continue;
+
+			if ( Vector3::dotproduct( n0, n1 ) <= flipThreshold * l0 * n1.length() )
+				return true;
+		}
+
+		return false;
+	}
+
+	void Simplifier::run( int targetCount, double maxError )
+	{
+		QVector<int> first, fans, target, candidates, collapse;
+		QVector<double> cost, error;
+		QVector<bool> touched;
+
+		while ( tris.count() + kept.count() > targetCount && !tris.isEmpty() ) {
+			// Triangles around each vertex
+			first.fill( 0, numVerts + 1 );
+			for ( const Triangle & tri : tris ) {
+				for ( int k = 0; k < 3; k++ )
+					first[tri[k] + 1]++;
+			}
+			std::partial_sum( first.begin(), first.end(), first.begin() );
+
+			fans.resize( tris.count() * 3 );
+			QVector<int> fill = first;
+			for ( int t = 0; t < tris.count(); t++ ) {
+				for ( int k = 0; k < 3; k++ )
+					fans[fill[tris[t][k]]++] = t;
+			}
+
+			// Cheapest collapse of each vertex
+			target.fill( -1, numVerts );
+			cost.fill( DBL_MAX, numVerts );
+			error.fill( 0.0, numVerts );
+			auto consider = [&]( int i, int j ) {
+				if ( !canCollapse( i, j ) )
+					return;
+
+				double e = geometricError( i, j );
+				if ( e > maxError )
+					return;
+
+				double c = e + opts.attributeWeight * attributeDistance( i, j ) + opts.skinWeight * skinDistance( i, j );
+				if ( c < cost[i] ) {
+					cost[i] = c;
+					error[i] = e;
+					target[i] = j;
+				}
+			};
+
+			for ( const Triangle & tri : tris ) {
+				for ( int k = 0; k < 3; k++ ) {
+					int a = tri[k], b = tri[(k + 1) % 3];
+					consider( a, b );
+					consider( b, a );
+				}
+			}
+
+			candidates.clear();
+			for ( int v = 0; v < numVerts; v++ ) {
+				if ( target[v] >= 0 )
+					candidates << v;
+			}
+			std::sort( candidates.begin(), candidates.end(), [&cost]( int a, int b ) { return cost[a] < cost[b]; } );
+
+			// Collapse the cheapest edges whose triangles do not overlap
+			touched.fill( false, numVerts );
+			collapse.resize( numVerts );
+			std::iota( collapse.begin(), collapse.end(), 0 );
+
+			int goal = tris.count() + kept.count() - targetCount;
+			int removed = 0;
+			bool collapsed = false;
+			for ( int i : candidates ) {
+				int j = target[i];
+				const int * fan = fans.constData() + first[i];
+				int fanSize = first[i + 1] - first[i];
+
+				bool overlaps = false;
+				for ( int f = 0; f < fanSize && !overlaps; f++ ) {
+					const Triangle & tri = tris.at( fan[f] );
+					overlaps = touched[tri[0]] || touched[tri[1]] || touched[tri[2]];
+				}
+				if ( overlaps || flips( i, j, fan, fanSize ) )
+					continue;
+
+				for ( int f = 0; f < fanSize; f++ ) {
+					const Triangle & tri = tris.at( fan[f] );
+					for ( int k = 0; k < 3; k++ )
+						touched[tri[k]] = true;
+					if ( tri[0] == j || tri[1] == j || tri[2] == j )
+						removed++;
+				}
+
+				collapse[i] = j;
+				quadrics[remap[j]] += quadrics[remap[i]];
+				resultError = std::max( resultError, error[i] );
+				collapsed = true;
+
+				if ( removed >= goal )
+					break;
+			}
+
+			if ( !collapsed )
+				break;
+
+			int n = 0;
+			for ( int t = 0; t < tris.count(); t++ ) {
+				Triangle tri( collapse[tris[t][0]], collapse[tris[t][1]], collapse[tris[t][2]] );
+				int a = remap[tri[0]], b = remap[tri[1]], c = remap[tri[2]];
+				if ( a == b || b == c || c == a )
+					continue;
+
+				tris[n++] = tri;
+			}
+			tris.resize( n );
+		}
+	}
+}
+
+
+QVector<Triangle> MeshSimplify::simplify( const QVector<Triangle> & triangles, const Mesh & mesh, int targetCount,
+	float targetError, const Options & opts, float * resultError )
+{
+	Simplifier s( triangles, mesh, opts );
+	s.run( targetCount, sq( targetError ) );
+
+	if ( resultError )
+		*resultError = float( s.error() );
+
+	return s.triangles();
+}
+
+MeshSimplify::Parts MeshSimplify::connectedParts( const QVector<Triangle> & triangles, const Mesh & mesh )
+{
+	int numVerts = mesh.positions.count();
+	int numTris = triangles.count();
+
+	// Weld the vertices by position, so the seams do not split the parts
+	QVector<int> weld( numVerts );
+	QHash<QByteArray, int> byPosition;
+	for ( int v = 0; v < numVerts; v++ ) {
+		QByteArray key( reinterpret_cast<const char *>( mesh.positions.at( v ).data() ), sizeof( float ) * 3 );
+		weld[v] = byPosition.value( key, v );
+		if ( weld[v] == v )
+			byPosition.insert( key, v );
+	}
+
+	// Union the triangles sharing a welded vertex into connected parts
+	QVector<int> parent( numVerts );
+	std::iota( parent.begin(), parent.end(), 0 );
+	auto find = [&parent]( int v ) {
+		while ( parent[v] != v )
+			v = parent[v] = parent[parent[v]];
+		return v;
+	};
+
+	auto inRange = [numVerts]( const Triangle & tri ) {
+		return tri[0] < numVerts && tri[1] < numVerts && tri[2] < numVerts;
+	};
+
+	for ( const Triangle & tri : triangles ) {
+		if ( !inRange( tri ) )
+			continue;
+		int a = find( weld[tri[0]] );
+		for ( int c = 1; c < 3; c++ ) {
+			int b = find( weld[tri[c]] );
+			if ( a != b )
+				parent[b] = a;
+		}
+	}
+
+	Parts parts;
+	parts.partOf.fill( -1, numTris );
+	QHash<int, int> partIds;
+	for ( int t = 0; t < numTris; t++ ) {
+		const Triangle & tri = triangles.at( t );
+		if ( !inRange( tri ) )
+			continue;
+
+		int root = find( weld[tri[0]] );
+		auto it = partIds.find( root );
+		if ( it == partIds.end() ) {
+			it = partIds.insert( root, parts.counts.count() );
+			parts.counts.append( 0 );
+			parts.areas.append( 0.0 );
+		}
+
+		const Vector3 & p0 = mesh.positions.at( tri[0] );
+		parts.areas[it.value()] += Vector3::crossproduct( mesh.positions.at( tri[1] ) - p0, mesh.positions.at( tri[2] ) - p0 ).length();
+		parts.counts[it.value()]++;
+		parts.partOf[t] = it.value();
+	}
+
+	return parts;
+}
+
+QVector<Triangle> MeshSimplify::nestedLods( const QVector<Triangle> & triangles, const Mesh & mesh, const QVector<int> & targetCounts,
+	QVector<int> & sizes )
+{
+	int numTris = triangles.count();
+	Parts parts = connectedParts( triangles, mesh );
+
+	// The parts carrying most of the surface stay in the coarse LODs
+	QVector<int> order( parts.counts.count() );
+	std::iota( order.begin(), order.end(), 0 );
+	std::stable_sort( order.begin(), order.end(), [&parts]( int a, int b ) { return parts.areas.at( a ) > parts.areas.at( b ); } );
+
+	// Each target keeps the longest run of whole parts that fits in it, but at least one.
+	// The targets descend, so every run is a prefix of the one before and the LODs nest.
+	QVector<int> level( parts.counts.count(), 0 );
+	int levels = targetCounts.count();
+	for ( int l = 0; l < levels; l++ ) {
+		int count = 0;
+		for ( int i = 0; i < order.count(); i++ ) {
+			int partCount = parts.counts.at( order.at( i ) );
+			if ( i > 0 && count + partCount > targetCounts.at( l ) )
+				break;
+			count += partCount;
+			level[order.at( i )] = l + 1;
+		}
+	}
+
+	QVector<Triangle> result;
+	result.reserve( numTris );
+	sizes.fill( 0, levels + 1 );
+	for ( int l = levels; l >= 0; l-- ) {
+		for ( int t = 0; t < numTris; t++ ) {
+			int p = parts.partOf.at( t );
+			if ( (p < 0 ? 0 : level.at( p )) == l ) {
+				result << triangles.at( t );
+				sizes[levels - l]++;
+			}
+		}
+	}
+
+	return result;
+}
@@ -0,0 +1,125 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#ifndef MESHSIMPLIFY_H
+#define MESHSIMPLIFY_H
+
+#include "data/niftypes.h"
+
+#include <QVector>
+
+
+//! \file meshsimplify.h Quadric error mesh simplification
+
+/*! Simplification of indexed triangle lists with quadric error metrics
+ *
+ * Edges are collapsed onto one of their existing vertices, so the simplified triangles
+ * index the original vertex arrays and no vertex data has to be rewritten.
+ *
+ * Vertices on UV, normal or color seams (several vertices at one position) are never
+ * moved, which keeps the seams intact. Open borders only collapse along themselves.
+ * Differences in the attributes and skin weights of the two vertices of an edge add
+ * to the cost of collapsing it.
+ *
+ * Triangles referring to vertices at or past the vertex count are kept unchanged.
+ */
+namespace MeshSimplify
+{
+	//! The vertex attributes used for the collapse costs, all but the positions are optional
+	struct Mesh
+	{
+		QVector<Vector3> positions;
+		QVector<Vector3> normals;
+		QVector<Vector2> uvs;
+		QVector<Color4> colors;
+		//! Skin bone indices, @ref influences per vertex
+		QVector<int> boneIndices;
+		//! Skin weights, @ref influences per vertex
+		QVector<float> boneWeights;
+		int influences = 4;
+	};
+
+	struct Options
+	{
+		//! Cost scale of UV, normal and color differences
+		float attributeWeight = 1.0f;
+		//! Cost scale of skin weight differences
+		float skinWeight = 1.0f;
+		//! Never move vertices on open borders
+		bool lockBorders = false;
+	};
+
+	/*! Simplify a triangle list
+	 *
+	 * Stops at @p targetCount triangles, or before a collapse would move the surface further
+	 * than @p targetError, relative to the largest dimension of the mesh.
+	 *
+	 * @param resultError	If not null, receives the relative error of the result
+	 */
+	QVector<Triangle> simplify( const QVector<Triangle> & triangles, const Mesh & mesh, int targetCount,
+		float targetError = 1.0f, const Options & opts = Options(), float * resultError = nullptr );
+
+	//! The connected parts of a triangle list, see connectedParts()
+	struct Parts
+	{
+		//! For each triangle its part, -1 if it refers to vertices at or past the vertex count
+		QVector<int> partOf;
+		//! Number of triangles of each part
+		QVector<int> counts;
+		//! Surface area of each part, doubled
+		QVector<double> areas;
+	};
+
+	/*! Group the triangles into parts connected by a shared vertex position
+	 *
+	 * The parts are numbered in the order of their first triangle.
+	 */
+	Parts connectedParts( const QVector<Triangle> & triangles, const Mesh & mesh );
+
+	/*! Order the triangles for LOD levels that are drawn cumulatively
+	 *
+	 * Every LOD is a prefix of the list, so the coarse LODs can only leave original triangles
+	 * out and never collapse them. To keep them free of holes, only whole connected parts
+	 * (triangles sharing a vertex position) are left out: each of the descending @p targetCounts
+	 * keeps the largest parts by area that fit in it, and always the largest one.
+	 * A single connected surface therefore keeps all of its triangles in every LOD.
+	 *
+	 * Triangles referring to vertices at or past the vertex count only appear at full detail.
+	 *
+	 * @param sizes	Receives the number of triangles in each of the targetCounts.count() + 1 ranges,
+	 *				coarsest first
+	 */
+	QVector<Triangle> nestedLods( const QVector<Triangle> & triangles, const Mesh & mesh, const QVector<int> & targetCounts,
+		QVector<int> & sizes );
+}
+
+#endif
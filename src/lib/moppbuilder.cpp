@@ -0,0 +1,507 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#include "moppbuilder.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+//! \file moppbuilder.cpp MoppBuilder
+
+namespace
+{
+	//! Quantized coordinates span 254/256 of the 24-bit range, as in the Havok generated codes
+	const double quantRange = 256.0 * 256.0 * 254.0;
+	//! Padding around the bounding box, in Havok units
+	const float boundsMargin = 0.1f;
+	//! Share of the triangles that each side of a split keeps at least, to bound the depth
+	const int minSplitShare = 8;
+
+	enum Command : quint8
+	{
+		RETURN = 0x00,
+		JUMP8 = 0x05,
+		JUMP16 = 0x06,
+		JUMP24 = 0x07,
+		JUMP32 = 0x08,
+		REOFFSET8 = 0x09,
+		REOFFSET16 = 0x0A,
+		REOFFSET32 = 0x0B,
+		SPLIT_X = 0x10,
+		SPLIT_JUMP_X = 0x23,
+		DOUBLE_CUT_X = 0x26,
+		TERM4 = 0x30,
+		TERM8 = 0x50,
+		TERM16 = 0x51,
+		TERM24 = 0x52,
+		TERM32 = 0x53
+	};
+
+	inline quint32 quantize( float v, float origin, float scale )
+	{
+		double q = double( v - origin ) * scale;
+		return quint32( std::min( std::max( q, 0.0 ), double( 0xFFFFFF ) ) );
+	}
+
+	//! The top 8 bits of the quantized position, which the split commands compare against
+	inline void quantize( const Vector3 & p, const MoppBuilder::Code & code, quint8 out[3] )
+	{
+		for ( int a = 0; a < 3; a++ )
+			out[a] = quint8( quantize( p[a], code.origin[a], code.scale ) >> 16 );
+	}
+
+	void appendBigEndian( QByteArray & out, quint32 value, int bytes )
+	{
+		for ( int i = bytes - 1; i >= 0; i-- )
+			out.append( char( (value >> (8 * i)) & 0xFF ) );
+	}
+
+	//! Quantized bounds and key of a triangle
+	struct Prim
+	{
+		quint8 lo[3];
+		quint8 hi[3];
+		quint32 key;
+	};
+
+	//! Axis aligned box in quantized cells
+	struct Box
+	{
+		int lo[3] = { 255, 255, 255 };
+		int hi[3] = { -1, -1, -1 };
+
+		void add( const Prim & p )
+		{
+			for ( int a = 0; a < 3; a++ ) {
+				lo[a] = std::min( lo[a], int( p.lo[a] ) );
+				hi[a] = std::max( hi[a], int( p.hi[a] ) );
+			}
+		}
+
+		double area() const
+		{
+			double d[3];
+			for ( int a = 0; a < 3; a++ )
+				d[a] = std::max( hi[a] - lo[a] + 1, 0 );
+			return d[0] * d[1] + d[1] * d[2] + d[2] * d[0];
+		}
+	};
+
+	//! Top-down tree construction, emitting the code of each subtree after its children
+	class Builder
+	{
+	public:
+		Builder( const QVector<Prim> & prims, MoppBuilder::Stats & stats ) : prims( prims ), stats( stats ) {}
+
+		/*! Emit the code of a subtree
+		 *
+		 * @param range	Cells that a query reaching the subtree can be in, per axis
+		 */
+		QByteArray emit( QVector<int> & items, int depth, const int range[3][2] );
+
+	private:
+		QByteArray terminal( quint32 key );
+		QByteArray jump( int distance );
+
+		const QVector<Prim> & prims;
+		MoppBuilder::Stats & stats;
+	};
+
+	QByteArray Builder::terminal( quint32 key )
+	{
+		QByteArray out;
+		if ( key < 32 ) {
+			out.append( char( TERM4 + key ) );
+		} else if ( key < 0x100 ) {
+			out.append( char( TERM8 ) );
+			appendBigEndian( out, key, 1 );
+		} else if ( key < 0x10000 ) {
+			out.append( char( TERM16 ) );
+			appendBigEndian( out, key, 2 );
+		} else if ( key < 0x1000000 ) {
+			out.append( char( TERM24 ) );
+			appendBigEndian( out, key, 3 );
+		} else {
+			out.append( char( TERM32 ) );
+			appendBigEndian( out, key, 4 );
+		}
+		return out;
+	}
+
+	QByteArray Builder::jump( int distance )
+	{
+		QByteArray out;
+		if ( distance < 0x100 ) {
+			out.append( char( JUMP8 ) );
+			appendBigEndian( out, distance, 1 );
+		} else if ( distance < 0x10000 ) {
+			out.append( char( JUMP16 ) );
+			appendBigEndian( out, distance, 2 );
+		} else {
+			out.append( char( JUMP24 ) );
+			appendBigEndian( out, distance, 3 );
+		}
+		return out;
+	}
+
+	QByteArray Builder::emit( QVector<int> & items, int depth, const int range[3][2] )
+	{
+		int n = items.count();
+		if ( n == 1 ) {
+			stats.leaves++;
+			stats.depth = std::max( stats.depth, depth );
+
+			// Reject the queries outside the bounds of the triangle that the splits let through
+			const Prim & p = prims[items[0]];
+			QByteArray out;
+			for ( int a = 0; a < 3; a++ ) {
+				if ( p.lo[a] > range[a][0] || p.hi[a] < range[a][1] ) {
+					out.append( char( DOUBLE_CUT_X + a ) );
+					out.append( char( p.lo[a] ) );
+					out.append( char( p.hi[a] ) );
+				}
+			}
+			out.append( terminal( p.key ) );
+			return out;
+		}
+
+		// Choose the axis and position of the split by the surface area heuristic,
+		// over the triangles sorted by the centers of their bounds
+		int kMin = std::max( 1, n / minSplitShare );
+		int kMax = n - kMin;
+
+		int bestAxis = 0, bestK = n / 2;
+		double bestCost = -1.0;
+
+		auto byCenter = [this]( QVector<int> & list, int axis ) {
+			std::stable_sort( list.begin(), list.end(), [this, axis]( int a, int b ) {
+				return prims[a].lo[axis] + prims[a].hi[axis] < prims[b].lo[axis] + prims[b].hi[axis];
+			} );
+		};
+
+		QVector<double> prefixArea( n );
+		for ( int axis = 0; axis < 3; axis++ ) {
+			QVector<int> sorted = items;
+			byCenter( sorted, axis );
+
+			Box left;
+			for ( int k = 1; k < n; k++ ) {
+				left.add( prims[sorted[k - 1]] );
+				prefixArea[k] = left.area();
+			}
+
+			Box right;
+			for ( int k = n - 1; k >= kMin; k-- ) {
+				right.add( prims[sorted[k]] );
+				if ( k > kMax )
+					continue;
+
+				double cost = k * prefixArea[k] + (n - k) * right.area();
+				if ( bestCost < 0.0 || cost < bestCost ) {
+					bestCost = cost;
+					bestAxis = axis;
+					bestK = k;
+				}
+			}
+		}
+
+		byCenter( items, bestAxis );
+		QVector<int> leftItems = items.mid( 0, bestK );
+		QVector<int> rightItems = items.mid( bestK );
+		items.clear();
+
+		// Queries at or below the largest cell of the left side descend left,
+		// those at or above the smallest cell of the right side descend right
+		int b1 = 0, b2 = 255;
+		for ( int i : leftItems )
+			b1 = std::max( b1, int( prims[i].hi[bestAxis] ) );
+		for ( int i : rightItems )
+			b2 = std::min( b2, int( prims[i].lo[bestAxis] ) );
+
+		int leftRange[3][2], rightRange[3][2];
+		std::copy( &range[0][0], &range[0][0] + 6, &leftRange[0][0] );
+		std::copy( &range[0][0], &range[0][0] + 6, &rightRange[0][0] );
+		leftRange[bestAxis][1] = std::min( range[bestAxis][1], b1 );
+		rightRange[bestAxis][0] = std::max( range[bestAxis][0], b2 );
+
+		stats.nodes++;
+		QByteArray leftCode = emit( leftItems, depth + 1, leftRange );
+		QByteArray rightCode = emit( rightItems, depth + 1, rightRange );
+
+		QByteArray out;
+		out.append( char( SPLIT_X + bestAxis ) );
+		out.append( char( b1 ) );
+		out.append( char( b2 ) );
+
+		if ( leftCode.size() < 0x100 ) {
+			out.append( char( leftCode.size() ) );
+			out.append( leftCode );
+			out.append( rightCode );
+		} else {
+			// The split only jumps 255 bytes ahead for the right side,
+			// so the left side starts with a jump over the right side
+			QByteArray skip = jump( rightCode.size() );
+			out.append( char( skip.size() ) );
+			out.append( skip );
+			out.append( rightCode );
+			out.append( leftCode );
+		}
+
+		return out;
+	}
+
+	quint32 readBigEndian( const QByteArray & data, int pos, int bytes )
+	{
+		quint32 value = 0;
+		for ( int i = 0; i < bytes; i++ )
+			value = (value << 8) | quint8( data[pos + i] );
+		return value;
+	}
+
+	/*! Interpret a MOPP code
+	 *
+	 * @param point		Quantized query point, or null to visit every branch
+	 * @param result	Receives the keys of the terminals reached
+	 */
+	bool run( const QByteArray & data, const quint8 * point, QVector<quint32> & result, QString * error, MoppBuilder::Stats * stats )
+	{
+		struct Frame
+		{
+			int pc;
+			quint32 offset;
+			int depth;
+		};
+
+		auto fail = [error]( const QString & reason ) {
+			if ( error )
+				*error = reason;
+			return false;
+		};
+
+		// Every command moves forward, so the interpretation always ends
+		QVector<Frame> stack;
+		stack.append( { 0, 0, 0 } );
+
+		while ( !stack.isEmpty() ) {
+			Frame f = stack.takeLast();
+			bool next = true;
+
+			while ( next ) {
+				if ( f.pc >= data.size() )
+					return fail( QString( "the code runs past its end at byte %1" ).arg( f.pc ) );
+
+				quint8 op = quint8( data[f.pc] );
+				int args = 0;
+				if ( op >= SPLIT_JUMP_X && op <= SPLIT_JUMP_X + 2 )
+					args = 6;
+				else if ( op >= SPLIT_X && op <= SPLIT_X + 2 )
+					args = 3;
+				else if ( op >= DOUBLE_CUT_X && op <= DOUBLE_CUT_X + 2 )
+					args = 2;
+				else if ( op == JUMP8 || op == REOFFSET8 || op == TERM8 )
+					args = 1;
+				else if ( op == JUMP16 || op == REOFFSET16 || op == TERM16 )
+					args = 2;
+				else if ( op == JUMP24 || op == TERM24 )
+					args = 3;
+				else if ( op == JUMP32 || op == REOFFSET32 || op == TERM32 )
+					args = 4;
+
+				if ( f.pc + args >= data.size() )
+					return fail( QString( "command 0x%1 at byte %2 is cut off" ).arg( op, 2, 16, QChar( '0' ) ).arg( f.pc ) );
+
+				auto arg = [&]( int i, int bytes ) { return readBigEndian( data, f.pc + 1 + i, bytes ); };
+
+				auto leaf = [&]( quint32 key ) {
+					result.append( key );
+					if ( stats ) {
+						stats->leaves++;
+						stats->depth = std::max( stats->depth, f.depth );
+					}
+					next = false;
+				};
+
+				if ( op == RETURN ) {
+					next = false;
+				} else if ( op == JUMP8 || op == JUMP16 || op == JUMP24 || op == JUMP32 ) {
+					f.pc += 1 + args + int( arg( 0, args ) );
+				} else if ( op == REOFFSET8 || op == REOFFSET16 ) {
+					f.offset += arg( 0, args );
+					f.pc += 1 + args;
+				} else if ( op == REOFFSET32 ) {
+					f.offset = arg( 0, 4 );
+					f.pc += 5;
+				} else if ( op >= SPLIT_X && op <= SPLIT_X + 2 ) {
+					int v = point ? point[op - SPLIT_X] : -1;
+					int b1 = int( arg( 0, 1 ) ), b2 = int( arg( 1, 1 ) );
+					if ( stats )
+						stats->nodes++;
+
+					if ( !point || v >= b2 )
+						stack.append( { f.pc + 4 + int( arg( 2, 1 ) ), f.offset, f.depth + 1 } );
+
+					f.depth++;
+					f.pc += 4;
+					next = !point || v <= b1;
+				} else if ( op >= SPLIT_JUMP_X && op <= SPLIT_JUMP_X + 2 ) {
+					int v = point ? point[op - SPLIT_JUMP_X] : -1;
+					if ( stats )
+						stats->nodes++;
+
+					if ( !point || v <= int( arg( 0, 1 ) ) )
+						stack.append( { f.pc + 7 + int( arg( 2, 2 ) ), f.offset, f.depth + 1 } );
+					if ( !point || v >= int( arg( 1, 1 ) ) )
+						stack.append( { f.pc + 7 + int( arg( 4, 2 ) ), f.offset, f.depth + 1 } );
+					next = false;
+				} else if ( op >= DOUBLE_CUT_X && op <= DOUBLE_CUT_X + 2 ) {
+					int v = point ? point[op - DOUBLE_CUT_X] : -1;
+					next = !point || ( v >= int( arg( 0, 1 ) ) && v <= int( arg( 1, 1 ) ) );
+					f.pc += 3;
+				} else if ( op >= TERM4 && op < TERM8 ) {
+					leaf( f.offset + op - TERM4 );
+				} else if ( op >= TERM8 && op <= TERM32 ) {
+					leaf( f.offset + arg( 0, args ) );
+				} else {
+					return fail( QString( "unsupported command 0x%1 at byte %2" ).arg( op, 2, 16, QChar( '0' ) ).arg( f.pc ) );
+				}
+			}
+		}
+
+		if ( stats )
+			stats->codeSize = data.size();
+
+		return true;
+	}
+}
+
+
+MoppBuilder::Code MoppBuilder::build( const QVector<Vector3> & vertices, const QVector<Triangle> & triangles,
+	const QVector<quint32> & keys )
+{
+	Code code;
+	if ( vertices.isEmpty() || triangles.isEmpty() )
+		return code;
+
+	Vector3 lo = vertices[0], hi = vertices[0];
+	for ( const Vector3 & v : vertices ) {
+		lo.boundMin( v );
+		hi.boundMax( v );
+	}
+
+	float size = std::max( { hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2] } );
+	code.origin = lo - Vector3( boundsMargin, boundsMargin, boundsMargin );
+	code.scale = float( quantRange / (size + 2 * boundsMargin) );
+
+	QVector<Prim> prims;
+	prims.reserve( triangles.count() );
+	for ( int t = 0; t < triangles.count(); t++ ) {
+		const Triangle & tri = triangles[t];
+		if ( tri[0] >= vertices.count() || tri[1] >= vertices.count() || tri[2] >= vertices.count() )
+			continue;
+
+		Prim p;
+		quint8 q[3];
+		quantize( vertices[tri[0]], code, p.lo );
+		quantize( vertices[tri[0]], code, p.hi );
+		for ( int i = 1; i < 3; i++ ) {
+			quantize( vertices[tri[i]], code, q );
+			for ( int a = 0; a < 3; a++ ) {
+				p.lo[a] = std::min( p.lo[a], q[a] );
+				p.hi[a] = std::max( p.hi[a], q[a] );
+			}
+		}
+		p.key = t < keys.count() ? keys[t] : quint32( t );
+		prims.append( p );
+	}
+
+	if ( prims.isEmpty() )
+		return code;
+
+	QVector<int> items( prims.count() );
+	for ( int i = 0; i < items.count(); i++ )
+		items[i] = i;
+
+	const int range[3][2] = { { 0, 255 }, { 0, 255 }, { 0, 255 } };
+	Builder builder( prims, code.stats );
+	code.data = builder.emit( items, 0, range );
+	code.stats.codeSize = code.data.size();
+
+	return code;
+}
+
+bool MoppBuilder::query( const Code & code, const Vector3 & point, QVector<quint32> & result, QString * error )
+{
+	quint8 q[3];
+	quantize( point, code, q );
+	return run( code.data, q, result, error, nullptr );
+}
+
+bool MoppBuilder::validate( const Code & code, const QVector<Vector3> & vertices, const QVector<Triangle> & triangles,
+	const QVector<quint32> & keys, QString * error, Stats * stats )
+{
+	QVector<quint32> all;
+	Stats figures;
+	if ( !run( code.data, nullptr, all, error, &figures ) )
+		return false;
+
+	if ( stats )
+		*stats = figures;
+
+	QVector<quint32> result;
+	for ( int t = 0; t < triangles.count(); t++ ) {
+		const Triangle & tri = triangles[t];
+		if ( tri[0] >= vertices.count() || tri[1] >= vertices.count() || tri[2] >= vertices.count() )
+			continue;
+
+		quint32 key = t < keys.count() ? keys[t] : quint32( t );
+		const Vector3 points[4] = {
+			vertices[tri[0]], vertices[tri[1]], vertices[tri[2]],
+			(vertices[tri[0]] + vertices[tri[1]] + vertices[tri[2]]) / 3.0f
+		};
+
+		for ( const Vector3 & p : points ) {
+			result.clear();
+			if ( !query( code, p, result, error ) )
+				return false;
+
+			if ( !result.contains( key ) ) {
+				if ( error )
+					*error = QString( "triangle %1 (key %2) is not reached from (%3, %4, %5)" )
+						.arg( t ).arg( key ).arg( p[0] ).arg( p[1] ).arg( p[2] );
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
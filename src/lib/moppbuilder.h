@@ -0,0 +1,108 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#ifndef MOPPBUILDER_H
+#define MOPPBUILDER_H
+
+#include "data/niftypes.h"
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+
+//! \file moppbuilder.h Havok MOPP code generation
+
+/*! Generation and checking of Havok MOPP codes for triangle meshes
+ *
+ * A MOPP code is a bytecode bounding volume tree. Positions are quantized to 24 bits per axis
+ * from @ref Code::origin with @ref Code::scale, and the tree compares the top 8 bits of the
+ * quantized coordinates against the split planes. Each leaf returns the shape key of a triangle.
+ *
+ * The generator emits axis aligned splits, bounding cuts, jumps and terminals. The checker
+ * also understands the key offsets and the long split jumps found in game files; codes using
+ * the rescale or diagonal split commands are reported as unsupported.
+ */
+namespace MoppBuilder
+{
+	//! Tree quality figures
+	struct Stats
+	{
+		//! Largest number of splits on a path to a leaf
+		int depth = 0;
+		//! Number of split commands
+		int nodes = 0;
+		//! Number of terminals
+		int leaves = 0;
+		//! Size of the code in bytes
+		int codeSize = 0;
+	};
+
+	struct Code
+	{
+		//! Origin of the quantized space, the "Offset" XYZ of hkpMoppCode
+		Vector3 origin;
+		//! Quantization factor, the "Offset" W of hkpMoppCode
+		float scale = 0.0f;
+		QByteArray data;
+		Stats stats;
+	};
+
+	/*! Build the MOPP code of a triangle list
+	 *
+	 * The sub shapes of the mesh are not known here. When @p keys is empty every leaf returns
+	 * the triangle index, which is what the Havok SDK builds for a single sub shape. With several
+	 * sub shapes, NifMopp.dll can put the sub shape index into the keys instead, so the two
+	 * builders then agree on the tree bounds but not on the keys.
+	 *
+	 * @param keys	Shape key of each triangle, the triangle index if empty
+	 */
+	Code build( const QVector<Vector3> & vertices, const QVector<Triangle> & triangles,
+		const QVector<quint32> & keys = QVector<quint32>() );
+
+	/*! Run a point query on a MOPP code
+	 *
+	 * @param result	Receives the keys of the leaves whose bounds contain the point
+	 * @return			False if the code is malformed or uses unsupported commands, with the reason in @p error
+	 */
+	bool query( const Code & code, const Vector3 & point, QVector<quint32> & result, QString * error = nullptr );
+
+	/*! Check that a MOPP code reaches every triangle from its vertices and center
+	 *
+	 * @param stats		If not null, receives the figures of the code
+	 * @return			False on the first triangle that is missed, with the reason in @p error
+	 */
+	bool validate( const Code & code, const QVector<Vector3> & vertices, const QVector<Triangle> & triangles,
+		const QVector<quint32> & keys = QVector<quint32>(), QString * error = nullptr, Stats * stats = nullptr );
+}
+
+#endif
@@ -0,0 +1,158 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#include "nifmopp.h"
+
+#include <QCoreApplication>
+
+
+//! \file nifmopp.cpp NifMopp
+
+// Need to include headers before testing this
+#ifdef Q_OS_WIN32
+
+// This code is only intended to be run with Win32 platform.
+
+extern "C" void * __stdcall SetDllDirectoryA( const char * lpPathName );
+extern "C" void * __stdcall LoadLibraryA( const char * lpModuleName );
+extern "C" void * __stdcall GetProcAddress ( void * hModule, const char * lpProcName );
+extern "C" void __stdcall FreeLibrary( void * lpModule );
+
+namespace
+{
+	//! Interface to the external MOPP library
+	class HavokMoppCode
+	{
+	private:
+		typedef int (__stdcall * fnGenerateMoppCode)( int nVerts, Vector3 const * verts, int nTris, Triangle const * tris );
+		typedef int (__stdcall * fnGenerateMoppCodeWithSubshapes)( int nShapes, int const * shapes, int nVerts, Vector3 const * verts, int nTris, Triangle const * tris );
+		typedef int (__stdcall * fnRetrieveMoppCode)( int nBuffer, char * buffer );
+		typedef int (__stdcall * fnRetrieveMoppScale)( float * value );
+		typedef int (__stdcall * fnRetrieveMoppOrigin)( Vector3 * value );
+
+		void * hMoppLib;
+		fnGenerateMoppCode GenerateMoppCode;
+		fnRetrieveMoppCode RetrieveMoppCode;
+		fnRetrieveMoppScale RetrieveMoppScale;
+		fnRetrieveMoppOrigin RetrieveMoppOrigin;
+		fnGenerateMoppCodeWithSubshapes GenerateMoppCodeWithSubshapes;
+
+	public:
+		HavokMoppCode() : hMoppLib( 0 ), GenerateMoppCode( 0 ), RetrieveMoppCode( 0 ), RetrieveMoppScale( 0 ),
+			  RetrieveMoppOrigin( 0 ), GenerateMoppCodeWithSubshapes( 0 )
+		{
+		}
+
+		~HavokMoppCode()
+		{
+			if ( hMoppLib )
+				FreeLibrary( hMoppLib );
+		}
+
+		bool Initialize()
+		{
+			if ( !hMoppLib ) {
+				SetDllDirectoryA( QCoreApplication::applicationDirPath().toLocal8Bit().constData() );
+				hMoppLib = LoadLibraryA( "NifMopp.dll" );
+				GenerateMoppCode   = (fnGenerateMoppCode)GetProcAddress( hMoppLib, "GenerateMoppCode" );
+				RetrieveMoppCode   = (fnRetrieveMoppCode)GetProcAddress( hMoppLib, "RetrieveMoppCode" );
+				RetrieveMoppScale  = (fnRetrieveMoppScale)GetProcAddress( hMoppLib, "RetrieveMoppScale" );
+				RetrieveMoppOrigin = (fnRetrieveMoppOrigin)GetProcAddress( hMoppLib, "RetrieveMoppOrigin" );
+				GenerateMoppCodeWithSubshapes = (fnGenerateMoppCodeWithSubshapes)GetProcAddress( hMoppLib, "GenerateMoppCodeWithSubshapes" );
+			}
+
+			return (GenerateMoppCode && RetrieveMoppCode && RetrieveMoppScale && RetrieveMoppOrigin);
+		}
+
+		QByteArray CalculateMoppCode( QVector<int> const & subShapesVerts,
+		                              QVector<Vector3> const & verts,
+		                              QVector<Triangle> const & tris,
+		                              Vector3 * origin, float * scale )
+		{
+			QByteArray code;
+
+			if ( Initialize() ) {
+				int len;
+
+				if ( GenerateMoppCodeWithSubshapes && !subShapesVerts.isEmpty() )
+					len = GenerateMoppCodeWithSubshapes( subShapesVerts.size(), &subShapesVerts[0], verts.size(), &verts[0], tris.size(), &tris[0] );
+				else
+					len = GenerateMoppCode( verts.size(), &verts[0], tris.size(), &tris[0] );
+
+				if ( len > 0 ) {
+					code.resize( len );
+
+					if ( 0 != RetrieveMoppCode( len, code.data() ) ) {
+						if ( scale )
+							RetrieveMoppScale( scale );
+
+						if ( origin )
+							RetrieveMoppOrigin( origin );
+					} else {
+						code.clear();
+					}
+				}
+			}
+
+			return code;
+		}
+	}
+	TheHavokCode;
+}
+
+#endif // Q_OS_WIN32
+
+
+bool NifMopp::isAvailable()
+{
+#ifdef Q_OS_WIN32
+	return TheHavokCode.Initialize();
+#else
+	return false;
+#endif
+}
+
+MoppBuilder::Code NifMopp::build( const QVector<int> & subShapeVerts, const QVector<Vector3> & vertices,
+	const QVector<Triangle> & triangles )
+{
+	MoppBuilder::Code code;
+#ifdef Q_OS_WIN32
+	if ( !vertices.isEmpty() && !triangles.isEmpty() )
+		code.data = TheHavokCode.CalculateMoppCode( subShapeVerts, vertices, triangles, &code.origin, &code.scale );
+#else
+	Q_UNUSED( subShapeVerts );
+	Q_UNUSED( vertices );
+	Q_UNUSED( triangles );
+#endif
+	code.stats.codeSize = code.data.size();
+	return code;
+}
@@ -0,0 +1,62 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#ifndef NIFMOPP_H
+#define NIFMOPP_H
+
+#include "lib/moppbuilder.h"
+
+
+//! \file nifmopp.h MOPP codes from NifMopp.dll
+
+/*! The Havok SDK MOPP generator in NifMopp.dll
+ *
+ * The library is looked up next to the executable, and only on Windows. Its codes are the
+ * reference MoppBuilder is compared against.
+ */
+namespace NifMopp
+{
+	//! Whether NifMopp.dll was loaded
+	bool isAvailable();
+
+	/*! Generate the MOPP code of a triangle list
+	 *
+	 * Only the origin, scale and data of the code are set.
+	 *
+	 * @param subShapeVerts	Vertex count of each sub shape, passed on if NifMopp.dll takes sub shapes
+	 * @return				An empty code if NifMopp.dll is not available or failed
+	 */
+	MoppBuilder::Code build( const QVector<int> & subShapeVerts, const QVector<Vector3> & vertices,
+		const QVector<Triangle> & triangles );
+}
+
+#endif
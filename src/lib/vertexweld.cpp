@@ -0,0 +1,124 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#include "vertexweld.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+//! \file vertexweld.cpp VertexGrid
+
+//! Cells are slightly larger than the search radius so rounding never hides a neighbor two cells away
+static const double cellMargin = 1.01;
+//! Cell coordinates are clamped to this, merging cells only far outside any real mesh
+static const double cellLimit = 4.0e18;
+
+VertexGrid::VertexGrid( const QVector<Vector3> & positions, float maxSquaredDistance )
+	: positions( positions ), maxSquaredDistance( maxSquaredDistance )
+{
+	// Nothing can be closer than a non-positive distance
+	if ( !( maxSquaredDistance > 0.0f ) )
+		return;
+
+	double cellSize = std::sqrt( double( maxSquaredDistance ) ) * cellMargin;
+	invCellSize = std::isfinite( cellSize ) ? 1.0 / cellSize : 0.0;
+
+	const int numVerts = positions.count();
+
+	QVector<QPair<Cell, int>> sorted;
+	sorted.reserve( numVerts );
+	for ( int i = 0; i < numVerts; i++ ) {
+		Cell c;
+		if ( cellOf( positions[i], c ) )
+			sorted.append( { c, i } );
+	}
+
+	std::sort( sorted.begin(), sorted.end(), []( const QPair<Cell, int> & a, const QPair<Cell, int> & b ) {
+		if ( a.first.x != b.first.x )
+			return a.first.x < b.first.x;
+		if ( a.first.y != b.first.y )
+			return a.first.y < b.first.y;
+		if ( a.first.z != b.first.z )
+			return a.first.z < b.first.z;
+		return a.second < b.second;
+	} );
+
+	order.reserve( sorted.count() );
+	for ( int s = 0; s < sorted.count(); s++ ) {
+		if ( s == 0 || !( sorted[s].first == sorted[s - 1].first ) )
+			cells.insert( sorted[s].first, { s, 0 } );
+		cells[sorted[s].first].second++;
+		order.append( sorted[s].second );
+	}
+}
+
+bool VertexGrid::cellOf( const Vector3 & p, Cell & c ) const
+{
+	qint64 * out[3] = { &c.x, &c.y, &c.z };
+	for ( int i = 0; i < 3; i++ ) {
+		if ( !std::isfinite( p[i] ) )
+			return false;
+
+		double v = std::floor( double( p[i] ) * invCellSize );
+		*out[i] = qint64( std::max( -cellLimit, std::min( cellLimit, v ) ) );
+	}
+	return true;
+}
+
+void VertexGrid::neighbors( int i, QVector<int> & out ) const
+{
+	out.clear();
+
+	Cell c;
+	if ( cells.isEmpty() || !cellOf( positions[i], c ) )
+		return;
+
+	const Vector3 & p = positions[i];
+	for ( qint64 x = c.x - 1; x <= c.x + 1; x++ ) {
+		for ( qint64 y = c.y - 1; y <= c.y + 1; y++ ) {
+			for ( qint64 z = c.z - 1; z <= c.z + 1; z++ ) {
+				auto it = cells.constFind( { x, y, z } );
+				if ( it == cells.constEnd() )
+					continue;
+
+				for ( int s = it->first; s < it->first + it->second; s++ ) {
+					int j = order[s];
+					if ( j != i && ( p - positions[j] ).squaredLength() < maxSquaredDistance )
+						out.append( j );
+				}
+			}
+		}
+	}
+
+	std::sort( out.begin(), out.end() );
+}
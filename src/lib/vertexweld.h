@@ -0,0 +1,182 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#ifndef VERTEXWELD_H
+#define VERTEXWELD_H
+
+#include "data/niftypes.h"
+
+#include <QHash>
+#include <QVector>
+
+#include <cstring>
+
+
+//! \file vertexweld.h Spatial hashing of vertex positions
+
+/*! Uniform grid over a set of vertex positions
+ *
+ * Finds the vertices near a vertex by only visiting the 27 cells around it, which makes
+ * proximity searches over a whole mesh close to linear instead of quadratic.
+ *
+ * Two vertices are near when the squared length of their difference is less than the
+ * limit, computed exactly like a plain Vector3 comparison would, so the results match a
+ * brute force search. Vertices with non-finite positions are never near anything.
+ */
+class VertexGrid final
+{
+public:
+	/*! Build the grid
+	 *
+	 * @param positions				The vertex positions, must outlive the grid
+	 * @param maxSquaredDistance	Vertices are near when their squared distance is less than this
+	 */
+	VertexGrid( const QVector<Vector3> & positions, float maxSquaredDistance );
+
+	/*! Collect the vertices near vertex @p i, excluding @p i itself
+	 *
+	 * @param i		The vertex to search around
+	 * @param out	Cleared, then filled with the indices in ascending order
+	 */
+	void neighbors( int i, QVector<int> & out ) const;
+
+	//! A grid cell
+	struct Cell
+	{
+		qint64 x, y, z;
+
+		bool operator==( const Cell & other ) const { return x == other.x && y == other.y && z == other.z; }
+
+		friend uint qHash( const Cell & c, uint seed = 0 )
+		{
+			quint64 h = quint64( c.x ) * 73856093u ^ quint64( c.y ) * 19349663u ^ quint64( c.z ) * 83492791u;
+			return uint( h ^ ( h >> 32 ) ) ^ seed;
+		}
+	};
+
+private:
+	//! Get the cell of @p p, false if it is not finite
+	bool cellOf( const Vector3 & p, Cell & c ) const;
+
+	const QVector<Vector3> & positions;
+	float maxSquaredDistance;
+	double invCellSize = 0.0;
+	//! Vertex indices grouped by cell
+	QVector<int> order;
+	//! First index into order and number of vertices for each occupied cell
+	QHash<Cell, QPair<int, int>> cells;
+};
+
+//! Bitwise key of a vertex position
+struct VertexKey
+{
+	quint32 bits[3];
+
+	/*! Make the key of @p v
+	 *
+	 * Negative zero is folded into zero as Vector3::operator== treats them as equal.
+	 * @return False for positions containing NaN, which are never equal to anything.
+	 */
+	bool set( const Vector3 & v )
+	{
+		for ( int c = 0; c < 3; c++ ) {
+			float f = v[c];
+			if ( f != f )
+				return false;
+			if ( f == 0.0f )
+				f = 0.0f;
+			memcpy( &bits[c], &f, sizeof(f) );
+		}
+		return true;
+	}
+
+	bool operator==( const VertexKey & other ) const
+	{
+		return bits[0] == other.bits[0] && bits[1] == other.bits[1] && bits[2] == other.bits[2];
+	}
+
+	friend uint qHash( const VertexKey & k, uint seed = 0 )
+	{
+		return ( k.bits[0] * 73856093u ^ k.bits[1] * 19349663u ^ k.bits[2] * 83492791u ) ^ seed;
+	}
+};
+
+/*! Group vertices with identical positions and attributes
+ *
+ * Each vertex is compared only against the first vertex of every group at exactly the
+ * same position, so the cost is linear in the number of vertices.
+ *
+ * @param positions	The vertex positions, compared exactly
+ * @param same		Called as same( a, b ) with a < b for vertices at the same position;
+ *					must be an equivalence on the vertices it returns true for
+ * @return			For each vertex, the lowest index of the vertices it was grouped with
+ */
+template <typename Pred> QVector<int> weldVertices( const QVector<Vector3> & positions, Pred same )
+{
+	const int numVerts = positions.count();
+
+	QVector<int> group( numVerts );
+	// Groups at the same position, chained through nextGroup from the head stored per position
+	QVector<int> nextGroup( numVerts, -1 );
+	QHash<VertexKey, int> heads;
+	heads.reserve( numVerts );
+
+	for ( int i = 0; i < numVerts; i++ ) {
+		group[i] = i;
+
+		VertexKey key;
+		if ( !key.set( positions[i] ) )
+			continue;
+
+		auto it = heads.find( key );
+		if ( it == heads.end() ) {
+			heads.insert( key, i );
+			continue;
+		}
+
+		int g = it.value(), last = g;
+		for ( ; g >= 0; g = nextGroup[g] ) {
+			if ( same( g, i ) ) {
+				group[i] = g;
+				break;
+			}
+			last = g;
+		}
+
+		if ( group[i] == i )
+			nextGroup[last] = i;
+	}
+
+	return group;
+}
+
+#endif
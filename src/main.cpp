@@ -48,6 +48,9 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QUrl>
 
 
+// NifTest (NifTest.pro) links this file for IPCsocket and has its own main
+#ifndef NIFSKOPE_TEST
+
 QCoreApplication * createApplication( int &argc, char *argv[] )
 {
 	QApplication::setAttribute(Qt::AA_UseDesktopOpenGL);
@@ -159,6 +162,8 @@ int main( int argc, char * argv[] )
 	return 0;
 }
 
+#endif // NIFSKOPE_TEST
+
 
 
 /*
@@ -250,6 +250,16 @@ bool BaseModel::setItemValue( NifItem * item, const NifValue & val )
 	return true;
 }
 
+bool BaseModel::setItemValue( NifItem * item, NifValue && val )
+{
+	if ( !item )
+		return false;
+
+	item->value() = std::move( val );
+	onItemValueChange( item );
+	return true;
+}
+
 
 /*
  *  QAbstractModel interface
@@ -584,12 +594,43 @@ void BaseModel::refreshFileInfo( const QString & f )
  *  searching
  */
 
-const NifItem * BaseModel::getItemInternal( const NifItem * parent, const QString & name, bool reportErrors ) const
+//! Find a child by name, through the field table of the parent's type when its layout matches
+template <typename S> static const NifItem * findChild( const BaseModel * model, const NifItem * parent, const S & name )
 {
+	const NifFieldTable * fields = parent->fieldTable().get();
+	if ( fields && fields->rowCount() == parent->childCount() ) {
+		const NifFieldTable::Field * field = fields->find( name );
+		if ( !field )
+			return nullptr;
+
+		bool matched = true;
+		for ( int row : field->rows ) {
+			const NifItem * item = parent->child( row );
+			if ( !item->hasName( name ) ) {
+				matched = false;
+				break;
+			}
+			if ( model->evalCondition( item ) )
+				return item;
+		}
+
+		if ( matched )
+			return nullptr;
+	}
+
 	for ( auto item : parent->childIter() )
-		if ( item->hasName(name) && evalCondition(item) )
+		if ( item->hasName(name) && model->evalCondition(item) )
 			return item;
 
+	return nullptr;
+}
+
+const NifItem * BaseModel::getItemInternal( const NifItem * parent, const QString & name, bool reportErrors ) const
+{
+	const NifItem * item = findChild( this, parent, name );
+	if ( item )
+		return item;
+
 	if ( reportErrors )
 		reportError( parent, tr( "Could not find \"%1\" subitem." ).arg( name ) );
 	return nullptr;
@@ -597,9 +638,9 @@ const NifItem * BaseModel::getItemInternal( const NifItem * parent, const QStrin
 
 const NifItem * BaseModel::getItemInternal( const NifItem * parent, const QLatin1String & name, bool reportErrors ) const
 {
-	for ( auto item : parent->childIter() )
-		if ( item->hasName(name) && evalCondition(item) )
-			return item;
+	const NifItem * item = findChild( this, parent, name );
+	if ( item )
+		return item;
 
 	if ( reportErrors )
 		reportError( parent, tr( "Could not find \"%1\" subitem." ).arg( QString(name) ) );
@@ -877,6 +918,79 @@ void BaseModel::onArrayValuesChange( NifItem * arrayRootItem )
 	}
 }
 
+void BaseModel::onColumnValuesChange( NifItem * arrayRootItem, int fieldRow )
+{
+	Q_UNUSED( fieldRow );
+
+	if ( state != Processing )
+		onArrayValuesChange( arrayRootItem );
+	else
+		changedWhileProcessing = true;
+}
+
+int BaseModel::getColumnRow( const NifItem * arrayRootItem, const QString & fieldName ) const
+{
+	if ( !arrayRootItem || !arrayRootItem->isArray() )
+		return -1;
+
+	const NifItem * first = arrayRootItem->child( 0 );
+	if ( !first )
+		return -1;
+
+	const NifItem * field = getItem( first, fieldName, false );
+	if ( !field || field->parent() != first )
+		return -1;
+
+	return field->row();
+}
+
+//! Collect the items without children under @p item, depth first
+static void collectLeaves( NifItem * item, QVector<NifItem *> & leaves )
+{
+	if ( item->childCount() == 0 ) {
+		leaves << item;
+		return;
+	}
+
+	for ( auto c : item->childIter() )
+		collectLeaves( c, leaves );
+}
+
+bool BaseModel::reorderArray( NifItem * arrayRootItem, const QVector<int> & order )
+{
+	if ( !arrayRootItem || !arrayRootItem->isArray() )
+		return false;
+
+	const int n = arrayRootItem->childCount();
+	if ( order.count() != n )
+		return false;
+
+	QVector<bool> used( n, false );
+	for ( int i : order ) {
+		if ( i < 0 || i >= n || used[i] )
+			return false;
+		used[i] = true;
+	}
+
+	QVector<QVector<NifItem *>> leaves( n );
+	for ( int i = 0; i < n; i++ ) {
+		collectLeaves( arrayRootItem->child( i ), leaves[i] );
+		if ( leaves[i].count() != leaves[0].count() )
+			return false;
+	}
+
+	QVector<NifValue> moved( n );
+	for ( int k = 0; k < leaves.value( 0 ).count(); k++ ) {
+		for ( int i = 0; i < n; i++ )
+			moved[i] = leaves[order[i]][k]->value();
+		for ( int i = 0; i < n; i++ )
+			leaves[i][k]->value() = std::move( moved[i] );
+	}
+
+	onArrayValuesChange( arrayRootItem );
+	return true;
+}
+
 const NifItem * BaseModel::getTopItem( const NifItem * item ) const
 {
 	while( item ) {
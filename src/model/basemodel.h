@@ -44,6 +44,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QVariant>
 #include <QVector>
 
+#include <algorithm>
 #include <climits>
 
 #define NifSkopeDisplayRole (Qt::UserRole + 42)
@@ -537,6 +538,50 @@ public:
 	//! Fill a child array with a value.
 	template <typename T> void fillArray( const QModelIndex & arrayParent, const char * arrayName, const T & val );
 
+	// Array columns
+public:
+	/*! Get the child row of a field in the structs of an array of structs, or -1.
+	 *
+	 * The field is resolved on the first array element only, so all elements must share
+	 * the same layout (e.g. BSVertexData, whose fields depend only on the vertex desc).
+	 */
+	int getColumnRow( const NifItem * arrayRootItem, const QString & fieldName ) const;
+	/*! Get a field of every struct in an array of structs as a QVector.
+	 *
+	 * The field values are read as @p Stored and converted to @p T.
+	 * The result has @p count elements, or one per array element if @p count is negative.
+	 * Missing elements, or all of them if the field does not exist, are set to @p missing.
+	 */
+	template <typename T, typename Stored = T> QVector<T> getColumn( const NifItem * arrayRootItem, const QString & fieldName, int count = -1, const T & missing = T() ) const;
+	//! Get a field of every struct in a model index array of structs as a QVector.
+	template <typename T, typename Stored = T> QVector<T> getColumn( const QModelIndex & iArray, const QString & fieldName, int count = -1, const T & missing = T() ) const;
+	/*! Get an array field of every struct in an array of structs as a flat QVector of @p width values per struct.
+	 *
+	 * Short or missing field arrays are padded with @p missing.
+	 */
+	template <typename T> QVector<T> getColumnArrays( const NifItem * arrayRootItem, const QString & fieldName, int width, int count = -1, const T & missing = T() ) const;
+	//! Get an array field of every struct in a model index array of structs as a flat QVector of @p width values per struct.
+	template <typename T> QVector<T> getColumnArrays( const QModelIndex & iArray, const QString & fieldName, int width, int count = -1, const T & missing = T() ) const;
+	/*! Write a QVector to a field of every struct in an array of structs.
+	 *
+	 * The values are converted to @p Stored before they are set. Extra values, or extra structs,
+	 * are left alone. Block links are not updated, so the field must not be a link.
+	 * Returns false if the field does not exist.
+	 */
+	template <typename Stored, typename T> bool setColumn( NifItem * arrayRootItem, const QString & fieldName, const QVector<T> & column );
+	//! Write a QVector to a field of every struct in a model index array of structs.
+	template <typename Stored, typename T> bool setColumn( const QModelIndex & iArray, const QString & fieldName, const QVector<T> & column );
+	/*! Reorder the elements of an array, element i takes the values of old element @p order[i].
+	 *
+	 * All elements must have the same layout, and conditions inside an element must not
+	 * depend on the values being moved (e.g. BSVertexData, or arrays of plain values).
+	 * Returns false, without changing anything, if @p order is not a permutation of the
+	 * elements or the layouts differ.
+	 */
+	bool reorderArray( NifItem * arrayRootItem, const QVector<int> & order );
+	//! Reorder the elements of a model index array.
+	bool reorderArray( const QModelIndex & iArray, const QVector<int> & order ) { return reorderArray( getItem(iArray), order ); }
+
 signals:
 	//! Messaging signal
 	void sigMessage( const TestMessage & msg ) const;
@@ -546,6 +591,8 @@ signals:
 protected:
 	//! Set an item value
 	bool setItemValue( NifItem * item, const NifValue & v );
+	//! Set an item value, taking over the data of @p v
+	bool setItemValue( NifItem * item, NifValue && v );
 
 	//! Convert a version number to a string
 	virtual QString ver2str( quint32 ) const = 0;
@@ -563,6 +610,8 @@ protected:
 
 	virtual void onItemValueChange( NifItem * item );
 	void onArrayValuesChange( NifItem * arrayRootItem );
+	//! Called after BaseModel::setColumn has written the field at child row @p fieldRow of every struct in an array
+	virtual void onColumnValuesChange( NifItem * arrayRootItem, int fieldRow );
 
 	//! NifSkope window the model belongs to
 	QWidget * parentWindow;
@@ -1038,4 +1087,80 @@ template <typename T> inline void BaseModel::fillArray( const QModelIndex & arra
 	fillArray( getItem(arrayParent, QLatin1String(arrayName), true), val );
 }
 
+// Array columns
+
+template <typename T, typename Stored> inline QVector<T> BaseModel::getColumn( const NifItem * arrayRootItem, const QString & fieldName, int count, const T & missing ) const
+{
+	int nRows = arrayRootItem ? arrayRootItem->childCount() : 0;
+	if ( count < 0 )
+		count = nRows;
+
+	QVector<T> column( count, missing );
+	int row = getColumnRow( arrayRootItem, fieldName );
+	if ( row >= 0 ) {
+		int n = std::min( count, nRows );
+		for ( int i = 0; i < n; i++ ) {
+			const NifItem * field = arrayRootItem->child( i )->child( row );
+			if ( field )
+				column[i] = T( field->get<Stored>() );
+		}
+	}
+
+	return column;
+}
+template <typename T, typename Stored> inline QVector<T> BaseModel::getColumn( const QModelIndex & iArray, const QString & fieldName, int count, const T & missing ) const
+{
+	return getColumn<T, Stored>( getItem(iArray), fieldName, count, missing );
+}
+
+template <typename T> inline QVector<T> BaseModel::getColumnArrays( const NifItem * arrayRootItem, const QString & fieldName, int width, int count, const T & missing ) const
+{
+	int nRows = arrayRootItem ? arrayRootItem->childCount() : 0;
+	if ( count < 0 )
+		count = nRows;
+
+	QVector<T> column( count * width, missing );
+	int row = getColumnRow( arrayRootItem, fieldName );
+	if ( row >= 0 ) {
+		int n = std::min( count, nRows );
+		T * out = column.data();
+		for ( int i = 0; i < n; i++, out += width ) {
+			const NifItem * field = arrayRootItem->child( i )->child( row );
+			if ( !field )
+				continue;
+			int m = std::min( width, field->childCount() );
+			for ( int j = 0; j < m; j++ )
+				out[j] = field->child( j )->get<T>();
+		}
+	}
+
+	return column;
+}
+template <typename T> inline QVector<T> BaseModel::getColumnArrays( const QModelIndex & iArray, const QString & fieldName, int width, int count, const T & missing ) const
+{
+	return getColumnArrays<T>( getItem(iArray), fieldName, width, count, missing );
+}
+
+template <typename Stored, typename T> inline bool BaseModel::setColumn( NifItem * arrayRootItem, const QString & fieldName, const QVector<T> & column )
+{
+	int row = getColumnRow( arrayRootItem, fieldName );
+	if ( row < 0 )
+		return false;
+
+	int n = std::min( column.count(), arrayRootItem->childCount() );
+	for ( int i = 0; i < n; i++ ) {
+		NifItem * field = arrayRootItem->child( i )->child( row );
+		if ( field )
+			field->set<Stored>( Stored( column.at(i) ) );
+	}
+
+	if ( n > 0 )
+		onColumnValuesChange( arrayRootItem, row );
+	return true;
+}
+template <typename Stored, typename T> inline bool BaseModel::setColumn( const QModelIndex & iArray, const QString & fieldName, const QVector<T> & column )
+{
+	return setColumn<Stored>( getItem(iArray), fieldName, column );
+}
+
 #endif
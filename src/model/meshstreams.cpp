@@ -0,0 +1,170 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#include "meshstreams.h"
+
+#include "model/nifmodel.h"
+
+
+//! @file meshstreams.cpp MeshStreams
+
+MeshStreams::MeshStreams( const NifModel * nif, const QModelIndex & iVertexData, int numVerts )
+	: model( nif ), iData( iVertexData ), numVerts( numVerts )
+{
+	if ( this->numVerts < 0 )
+		this->numVerts = ( nif && iData.isValid() ) ? nif->rowCount( iData ) : 0;
+}
+
+MeshStreams::MeshStreams( NifModel * nif, const QModelIndex & iVertexData, int numVerts )
+	: MeshStreams( static_cast<const NifModel *>( nif ), iVertexData, numVerts )
+{
+	writable = nif;
+}
+
+bool MeshStreams::has( const QString & field ) const
+{
+	return isValid() && model->getColumnRow( model->getItem( iData ), field ) >= 0;
+}
+
+QVector<Vector3> MeshStreams::positions() const
+{
+	return model->getColumn<Vector3>( iData, "Vertex", numVerts );
+}
+
+QVector<Vector2> MeshStreams::uvs() const
+{
+	return model->getColumn<Vector2, HalfVector2>( iData, "UV", numVerts );
+}
+
+QVector<Vector3> MeshStreams::normals() const
+{
+	return model->getColumn<Vector3, ByteVector3>( iData, "Normal", numVerts );
+}
+
+QVector<Vector3> MeshStreams::tangents() const
+{
+	return model->getColumn<Vector3, ByteVector3>( iData, "Tangent", numVerts );
+}
+
+QVector<Vector3> MeshStreams::bitangents() const
+{
+	QVector<float> x = model->getColumn<float>( iData, "Bitangent X", numVerts, 0.0f );
+	QVector<float> y = model->getColumn<float>( iData, "Bitangent Y", numVerts, 0.0f );
+	QVector<float> z = model->getColumn<float>( iData, "Bitangent Z", numVerts, 0.0f );
+
+	QVector<Vector3> bitangents( numVerts );
+	for ( int i = 0; i < numVerts; i++ )
+		bitangents[i] = Vector3( x.at(i), y.at(i), z.at(i) );
+
+	return bitangents;
+}
+
+QVector<Color4> MeshStreams::colors( const Color4 & missing ) const
+{
+	return model->getColumn<Color4, ByteColor4>( iData, "Vertex Colors", numVerts, missing );
+}
+
+QVector<float> MeshStreams::boneWeights() const
+{
+	return model->getColumnArrays<float>( iData, "Bone Weights", 4, numVerts, 0.0f );
+}
+
+QVector<quint8> MeshStreams::boneIndices() const
+{
+	return model->getColumnArrays<quint8>( iData, "Bone Indices", 4, numVerts, 0 );
+}
+
+bool MeshStreams::setPositions( const QVector<Vector3> & positions )
+{
+	if ( !writable )
+		return false;
+
+	// Half precision positions when the vertex desc has no Full Precision flag
+	auto root = writable->getItem( iData );
+	int row = writable->getColumnRow( root, "Vertex" );
+	if ( row >= 0 && root->child( 0 )->child( row )->hasValueType( NifValue::tHalfVector3 ) )
+		return writable->setColumn<HalfVector3>( root, "Vertex", positions );
+
+	return writable->setColumn<Vector3>( root, "Vertex", positions );
+}
+
+bool MeshStreams::setUVs( const QVector<Vector2> & uvs )
+{
+	return writable && writable->setColumn<HalfVector2>( iData, "UV", uvs );
+}
+
+bool MeshStreams::setNormals( const QVector<Vector3> & normals )
+{
+	return writable && writable->setColumn<ByteVector3>( iData, "Normal", normals );
+}
+
+bool MeshStreams::setTangents( const QVector<Vector3> & tangents )
+{
+	return writable && writable->setColumn<ByteVector3>( iData, "Tangent", tangents );
+}
+
+bool MeshStreams::setBitangents( const QVector<Vector3> & bitangents )
+{
+	if ( !writable )
+		return false;
+
+	QVector<float> x, y, z;
+	x.reserve( bitangents.count() );
+	y.reserve( bitangents.count() );
+	z.reserve( bitangents.count() );
+	for ( const Vector3 & b : bitangents ) {
+		x << b[0];
+		y << b[1];
+		z << b[2];
+	}
+
+	bool ok = writable->setColumn<float>( iData, "Bitangent X", x );
+	ok = writable->setColumn<float>( iData, "Bitangent Y", y ) && ok;
+	ok = writable->setColumn<float>( iData, "Bitangent Z", z ) && ok;
+	return ok;
+}
+
+bool MeshStreams::setColors( const QVector<Color4> & colors )
+{
+	if ( !writable )
+		return false;
+
+	QVector<ByteColor4> bytes;
+	bytes.reserve( colors.count() );
+	for ( const Color4 & c : colors ) {
+		ByteColor4 b;
+		b.setRGBA( c[0], c[1], c[2], c[3] );
+		bytes << b;
+	}
+
+	return writable->setColumn<ByteColor4>( iData, "Vertex Colors", bytes );
+}
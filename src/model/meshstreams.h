@@ -0,0 +1,103 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#ifndef MESHSTREAMS_H
+#define MESHSTREAMS_H
+
+#include "data/niftypes.h"
+
+#include <QModelIndex>
+#include <QVector>
+
+
+//! @file meshstreams.h MeshStreams
+
+class NifModel;
+
+/*! Whole-column access to the attributes of a BSVertexData array
+ *
+ * BSTriShape, BSDynamicTriShape and the BS version 100 NiSkinPartition store their
+ * vertices as an array of BSVertexData structs whose fields are selected by the vertex desc.
+ * Every vertex therefore has the same layout, so each attribute is resolved once and then read
+ * or written for all vertices in one pass, instead of looking up fields by name per vertex.
+ *
+ * Attributes that the vertex desc does not enable read back as their default values
+ * and are not written.
+ */
+class MeshStreams final
+{
+public:
+	/*! Read-only streams of a "Vertex Data" array
+	 *
+	 * @param numVerts	Number of vertices to return from the getters, or -1 for the array size.
+	 *					The columns are padded with defaults if the array is shorter.
+	 */
+	MeshStreams( const NifModel * nif, const QModelIndex & iVertexData, int numVerts = -1 );
+	//! Read-write streams of a "Vertex Data" array
+	MeshStreams( NifModel * nif, const QModelIndex & iVertexData, int numVerts = -1 );
+
+	bool isValid() const { return model && iData.isValid(); }
+	//! Number of vertices returned by the getters
+	int count() const { return numVerts; }
+	//! Whether the vertex desc enables a BSVertexData field, e.g. "Vertex Colors"
+	bool has( const QString & field ) const;
+
+	QVector<Vector3> positions() const;
+	QVector<Vector2> uvs() const;
+	QVector<Vector3> normals() const;
+	QVector<Vector3> tangents() const;
+	//! Bitangents, assembled from the "Bitangent X", "Bitangent Y" and "Bitangent Z" fields
+	QVector<Vector3> bitangents() const;
+	//! Vertex colors, @p missing for every vertex if the vertex desc has no colors
+	QVector<Color4> colors( const Color4 & missing = Color4( 0, 0, 0, 1 ) ) const;
+	//! Skin weights, 4 per vertex
+	QVector<float> boneWeights() const;
+	//! Skin bone indices, 4 per vertex
+	QVector<quint8> boneIndices() const;
+
+	bool setPositions( const QVector<Vector3> & positions );
+	bool setUVs( const QVector<Vector2> & uvs );
+	bool setNormals( const QVector<Vector3> & normals );
+	bool setTangents( const QVector<Vector3> & tangents );
+	//! Set the "Bitangent X", "Bitangent Y" and "Bitangent Z" fields
+	bool setBitangents( const QVector<Vector3> & bitangents );
+	bool setColors( const QVector<Color4> & colors );
+
+private:
+	const NifModel * model = nullptr;
+	//! The model, if the streams were created for writing
+	NifModel * writable = nullptr;
+	QModelIndex iData;
+	int numVerts = 0;
+};
+
+#endif
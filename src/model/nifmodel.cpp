@@ -38,12 +38,18 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "data/niftypes.h"
 #include "io/nifstream.h"
 
+#include <QBuffer>
 #include <QByteArray>
 #include <QColor>
 #include <QDebug>
 #include <QFile>
+#include <QSet>
 #include <QSettings>
+#include <QSignalBlocker>
 #include <QStringBuilder>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <algorithm>
 
 //! @file nifmodel.cpp The NIF data model.
 
@@ -266,6 +272,37 @@ NifModel::NifModel( QObject * parent ) : BaseModel( parent )
 	setupArrayPseudonyms();
 	updateSettings();
 
+	// Keep the row cache of snapshotRows() in step with every edit the views are told about
+	connect( this, &NifModel::dataChanged, this, [this]( const QModelIndex & topLeft, const QModelIndex & bottomRight ) {
+		if ( !topLeft.isValid() ) {
+			return;
+		} else if ( topLeft.parent().isValid() ) {
+			invalidateRowCache( getItem( topLeft, false ) );
+		} else {
+			for ( int r = topLeft.row(); r <= bottomRight.row(); r++ )
+				invalidateRowCache( root->child( r ) );
+		}
+	} );
+	connect( this, &NifModel::rowsInserted, this, [this]( const QModelIndex & parent, int first, int last ) {
+		if ( parent.isValid() )
+			invalidateRowCache( getItem( parent, false ) );
+		else if ( first <= rowCache.count() )
+			rowCache.insert( first, last - first + 1, RowData() );
+		else
+			rowCache.clear();
+	} );
+	connect( this, &NifModel::rowsRemoved, this, [this]( const QModelIndex & parent, int first, int last ) {
+		if ( parent.isValid() )
+			invalidateRowCache( getItem( parent, false ) );
+		else if ( last < rowCache.count() )
+			rowCache.remove( first, last - first + 1 );
+		else
+			rowCache.clear();
+	} );
+	connect( this, &NifModel::modelReset, this, [this]() {
+		rowCache.clear();
+	} );
+
 	clear();
 }
 
@@ -369,6 +406,8 @@ void NifModel::clear()
 	folder = QString();
 	bsVersion = 0;
 	root->killChildren();
+	lazyBlocks.clear();
+	linksPending = false;
 
 	NifData headerData = NifData( "NiHeader", "Header" );
 	NifData footerData = NifData( "NiFooter", "Footer" );
@@ -442,6 +481,11 @@ QString NifModel::createRTTIName( const NifItem * block ) const
 	if ( !block )
 		return {};
 
+	if ( block->hasName("NiDataStream") && isBlockPending( block ) ) {
+		const NiMesh::DataStreamMetadata & metadata = lazyBlocks.value( block ).metadata;
+		return QString( "NiDataStream\x01%1\x01%2" ).arg( metadata.usage ).arg( metadata.access );
+	}
+
 	if ( block->hasName("NiDataStream") ) {
 		return QString( "NiDataStream\x01%1\x01%2" )
 			.arg( NifItem::get<quint32>( getItem( block, "Usage", true ) ) )
@@ -457,6 +501,11 @@ const NifItem * NifModel::getHeaderItem() const
 }
 
 void NifModel::updateHeader()
+{
+	updateHeaderImpl( true );
+}
+
+void NifModel::updateHeaderImpl( bool computeBlockSizes )
 {
 	emit beginUpdateHeader();
 
@@ -497,7 +546,8 @@ void NifModel::updateHeader()
 
 			if ( itemBlockSizes ) {
 				updateChildArraySizes( itemBlock );
-				blockSizes.append( blockSize( itemBlock ) );
+				if ( computeBlockSizes )
+					blockSizes.append( blockSize( itemBlock ) );
 			}
 		}
 
@@ -512,7 +562,8 @@ void NifModel::updateHeader()
 		}
 		if ( itemBlockSizes ) {
 			updateArraySize(itemBlockSizes);
-			itemBlockSizes->setArray<int>( blockSizes );
+			if ( computeBlockSizes )
+				itemBlockSizes->setArray<int>( blockSizes );
 		}
 		// 20.3.1.2 Custom Version
 		if ( itemBlockTypeHashes ) {
@@ -562,6 +613,9 @@ void NifModel::updateFooter()
 		return;
 	}
 
+	// Pending blocks are missing from the link graph, and would all become roots
+	completeLinks();
+
 	NifItem * footer = getFooterItem();
 	NifItem * itemRoots = getItem( footer, "Roots" );
 	if ( itemRoots ) {
@@ -619,6 +673,11 @@ bool NifModel::updateArraySizeImpl( NifItem * array )
 		data.setIsConditionless( true );
 		data.setIsCompound( array->isCompound() );
 		data.setIsArray( array->isMultiArray() );
+		if ( array->isCompound() && !array->isMultiArray() ) {
+			// Set once here so the elements share it instead of each getting its own copy in insertType
+			if ( NifBlockPtr compound = compounds.value( array->strType() ) )
+				data.setFieldTable( compound->fields );
+		}
 
 		beginInsertRows( itemToIndex(array), nOldSize, nNewSize - 1 );
 		array->prepareInsert( nNewSize - nOldSize );
@@ -638,7 +697,7 @@ bool NifModel::updateArraySizeImpl( NifItem * array )
 		&& ( bOldHasChildLinks || array->hasChildLinks() ) // had or has any links inside
 		&& !array->isDescendantOf( getFooterItem() )
 	) {
-		updateLinks();
+		updateBlockLinks( array );
 		updateFooter();
 		emit linksChanged();
 	}
@@ -743,28 +802,7 @@ QModelIndex NifModel::insertNiBlock( const QString & identifier, int at )
 		else
 			at = getBlockCount() + 1;
 
-		beginInsertRows( QModelIndex(), at, at );
-
-		NifData d = NifData( identifier, "NiBlock", block->text );
-		d.setIsConditionless( true );
-		NifItem * branch = insertBranch( root, d, at );
-		endInsertRows();
-
-		if ( !block->ancestor.isEmpty() )
-			insertAncestor( branch, block->ancestor );
-
-		branch->prepareInsert( block->types.count() );
-
-		if ( getBSVersion() >= 151 && identifier.startsWith( "BSLighting" ) ) {
-			// TODO: This appears to be incomplete
-			for ( const NifData& data : block->types ) {
-				insertType( branch, data );
-			}
-		} else {
-			for ( const NifData& data : block->types ) {
-				insertType( branch, data );
-			}
-		}
+		NifItem * branch = insertBlockRow( identifier, at );
 
 		if ( state != Loading ) {
 			updateHeader();
@@ -781,16 +819,258 @@ QModelIndex NifModel::insertNiBlock( const QString & identifier, int at )
 	return QModelIndex();
 }
 
+NifItem * NifModel::insertBlockRow( const QString & identifier, int row, bool withFields )
+{
+	NifBlockPtr block = blocks.value( identifier );
+	if ( !block )
+		return nullptr;
+
+	beginInsertRows( QModelIndex(), row, row );
+
+	NifData d = NifData( identifier, "NiBlock", block->text );
+	d.setIsConditionless( true );
+	d.setFieldTable( block->fields );
+	NifItem * branch = insertBranch( root, d, row );
+	endInsertRows();
+
+	if ( withFields )
+		insertBlockFields( branch );
+
+	return branch;
+}
+
+void NifModel::insertBlockFields( NifItem * branch )
+{
+	NifBlockPtr block = blocks.value( branch->name() );
+	if ( !block )
+		return;
+
+	const QString & identifier = branch->name();
+
+	if ( !block->ancestor.isEmpty() )
+		insertAncestor( branch, block->ancestor );
+
+	branch->prepareInsert( block->types.count() );
+
+	if ( getBSVersion() >= 151 && identifier.startsWith( "BSLighting" ) ) {
+		// TODO: This appears to be incomplete
+		for ( const NifData& data : block->types ) {
+			insertType( branch, data );
+		}
+	} else {
+		for ( const NifData& data : block->types ) {
+			insertType( branch, data );
+		}
+	}
+}
+
+/*
+ *  lazy loading
+ */
+
+const NifItem * NifModel::decodeBlock( const NifItem * block ) const
+{
+	if ( lazyBlocks.isEmpty() || !block )
+		return block;
+
+	auto it = lazyBlocks.find( block );
+	if ( it == lazyBlocks.end() || it->decoded )
+		return block;
+
+	it->decoded = true;
+	const_cast<NifModel *>( this )->decodeBlockImpl( const_cast<NifItem *>( block ) );
+	return block;
+}
+
+std::unique_ptr<NifItem> NifModel::readBlockFields( NifItem * block, const LazyBlock & pending )
+{
+	// Built on a copy of the empty block outside the tree, so that the views only see
+	// the fields once they are complete instead of every array resize along the way
+	std::unique_ptr<NifItem> fields( block->clone( this, root ) );
+	QSignalBlocker blocker( this );
+
+	insertBlockFields( fields.get() );
+
+	QBuffer buffer;
+	buffer.setData( pending.data );
+	buffer.open( QIODevice::ReadOnly );
+
+	NifIStream stream( this, &buffer );
+	if ( !loadItem( fields.get(), stream ) )
+		logWarning( tr( "failed to load block number %1 (%2)" ).arg( getBlockNumber( block ) ).arg( block->name() ) );
+
+	if ( block->hasName( "NiDataStream" ) ) {
+		set<quint32>( fields.get(), "Usage", pending.metadata.usage );
+		set<quint32>( fields.get(), "Access", pending.metadata.access );
+	}
+
+	return fields;
+}
+
+void NifModel::decodeBlockImpl( NifItem * block )
+{
+	std::unique_ptr<NifItem> fields = readBlockFields( block, lazyBlocks.value( block ) );
+
+	const int count = fields->childCount();
+	if ( count > 0 ) {
+		beginInsertRows( itemToIndex( block ), 0, count - 1 );
+		block->prepareInsert( count );
+		while ( fields->childCount() > 0 )
+			block->insertChild( fields->takeChild( 0 ) );
+		endInsertRows();
+	}
+
+	int blockNum = getBlockNumber( block );
+	if ( blockNum >= 0 ) {
+		updateLinks( blockNum );
+		// Decoding can happen inside a view's query of the model, notify once it returns.
+		// Lazy readers have no views, and may run without an event loop to deliver it.
+		if ( receivers( SIGNAL( linksChanged() ) ) > 0 )
+			QMetaObject::invokeMethod( this, "linksChanged", Qt::QueuedConnection );
+	}
+}
+
+const NifModel::LazyBlock * NifModel::pendingLinks( int block ) const
+{
+	NifItem * item = getBlockRowItem( block );
+	auto it = lazyBlocks.find( item );
+	if ( it == lazyBlocks.end() || it->decoded )
+		return nullptr;
+
+	if ( !it->linksRead ) {
+		std::unique_ptr<NifItem> fields = const_cast<NifModel *>( this )->readBlockFields( item, *it );
+		collectLinks( fields.get(), it->childLinks, it->parentLinks );
+		it->linksRead = true;
+	}
+
+	return &*it;
+}
+
+void NifModel::readPendingLinks()
+{
+	linksPending = false;
+
+	for ( int b = 0; b < getBlockCount(); b++ )
+		pendingLinks( b );
+
+	rebuildLinks();
+
+	if ( receivers( SIGNAL( linksChanged() ) ) > 0 )
+		QMetaObject::invokeMethod( this, "linksChanged", Qt::QueuedConnection );
+}
+
+void NifModel::decodeAllBlocks()
+{
+	// Cleared first, decoding a block queries the link graph
+	linksPending = false;
+
+	if ( lazyBlocks.isEmpty() )
+		return;
+
+	for ( int r = firstBlockRow(); r <= lastBlockRow(); r++ )
+		decodeBlock( root->child( r ) );
+}
+
+int NifModel::releaseBlocks()
+{
+	int released = 0;
+
+	for ( int r = firstBlockRow(); r <= lastBlockRow() && !lazyBlocks.isEmpty(); r++ ) {
+		NifItem * block = root->child( r );
+		auto it = lazyBlocks.find( block );
+		if ( it == lazyBlocks.end() || !it->decoded || block->hasChildLinks() )
+			continue;
+
+		// Only drop a block whose items hold nothing but what was read
+		QByteArray data;
+		QBuffer buffer( &data );
+		buffer.open( QIODevice::WriteOnly );
+		NifOStream stream( this, &buffer );
+		if ( !saveItem( block, stream ) || data != it->data )
+			continue;
+
+		if ( block->childCount() > 0 ) {
+			beginRemoveRows( itemToIndex( block ), 0, block->childCount() - 1 );
+			block->removeChildren( 0, block->childCount() );
+			endRemoveRows();
+		}
+
+		// The bytes are unchanged, so are the links the graph already has for them
+		int b = r - firstBlockRow();
+		it->childLinks = childLinks.value( b );
+		it->parentLinks = parentLinks.value( b );
+		it->linksRead = true;
+		it->decoded = false;
+		released++;
+	}
+
+	return released;
+}
+
+bool NifModel::hasChildren( const QModelIndex & parent ) const
+{
+	if ( isBlockPending( getItem( parent ) ) )
+		return true;
+
+	return BaseModel::hasChildren( parent );
+}
+
+bool NifModel::canFetchMore( const QModelIndex & parent ) const
+{
+	return isBlockPending( getItem( parent ) );
+}
+
+void NifModel::fetchMore( const QModelIndex & parent )
+{
+	decodeBlock( getItem( parent ) );
+}
+
 void NifModel::removeNiBlock( int blocknum )
 {
 	if ( !isValidBlockNumber( blocknum ) )
 		return;
 
-	adjustLinks( root, blocknum, 0 );
-	adjustLinks( root, blocknum, -1 );
-	beginRemoveRows( QModelIndex(), blocknum + 1, blocknum + 1 );
-	root->removeChild( blocknum + 1 );
-	endRemoveRows();
+	removeNiBlocks( { blocknum } );
+}
+
+void NifModel::removeNiBlocks( QVector<qint32> blocknums )
+{
+	std::sort( blocknums.begin(), blocknums.end() );
+	blocknums.erase( std::unique( blocknums.begin(), blocknums.end() ), blocknums.end() );
+	blocknums.erase( std::remove_if( blocknums.begin(), blocknums.end(), [this]( qint32 b ) {
+		return !isValidBlockNumber( b );
+	} ), blocknums.end() );
+
+	if ( blocknums.isEmpty() )
+		return;
+
+	// One pass over the links for all the removed blocks:
+	// links to a removed block are cleared, the others move down by the number of removed blocks before them
+	remapLinks( root, [&blocknums]( qint32 l ) -> qint32 {
+		auto it = std::lower_bound( blocknums.cbegin(), blocknums.cend(), l );
+		if ( it != blocknums.cend() && *it == l )
+			return -1;
+		return l - qint32( it - blocknums.cbegin() );
+	} );
+
+	// Remove contiguous runs of rows, last first so the remaining row numbers stay valid
+	int end = blocknums.count() - 1;
+	while ( end >= 0 ) {
+		int start = end;
+		while ( start > 0 && blocknums.at( start - 1 ) == blocknums.at( start ) - 1 )
+			start--;
+
+		int first = blocknums.at( start ) + 1;
+		int count = end - start + 1;
+		beginRemoveRows( QModelIndex(), first, first + count - 1 );
+		for ( int c = first; c < first + count; c++ )
+			lazyBlocks.remove( root->child( c ) );
+		root->removeChildren( first, count );
+		endRemoveRows();
+
+		end = start - 1;
+	}
+
 	updateLinks();
 	updateFooter();
 	emit linksChanged();
@@ -854,6 +1134,10 @@ QMap<qint32, qint32> NifModel::moveAllNiBlocks( NifModel * targetnif, bool updat
 
 	bool doStringUpdate = ( this->getVersionNumber() >= 0x14010003 || targetnif->getVersionNumber() >= 0x14010003 );
 
+	// The items move to the other model, the links and strings in them have to be decoded
+	decodeAllBlocks();
+	lazyBlocks.clear();
+
 	QMap<qint32, qint32> map;
 
 	beginRemoveRows( QModelIndex(), 1, bcnt );
@@ -889,6 +1173,57 @@ QMap<qint32, qint32> NifModel::moveAllNiBlocks( NifModel * targetnif, bool updat
 	return map;
 }
 
+std::shared_ptr<const NifModel::BlockCopy> NifModel::copyBlocks( const QList<qint32> & blocknums ) const
+{
+	auto copy = std::make_shared<BlockCopy>();
+	copy->version = version;
+	copy->userVersion = getUserVersion();
+	copy->bsVersion = bsVersion;
+
+	copy->items.reserve( blocknums.count() );
+	for ( qint32 b : blocknums ) {
+		const NifItem * block = getBlockItem( b );
+		if ( block )
+			copy->items.append( block->clone( nullptr, nullptr ) );
+	}
+
+	return copy;
+}
+
+bool NifModel::canPasteBlocks( const BlockCopy & copy ) const
+{
+	return copy.version == version && copy.userVersion == getUserVersion() && copy.bsVersion == bsVersion;
+}
+
+QModelIndex NifModel::pasteBlocks( const BlockCopy & copy, const QMap<qint32, qint32> & map )
+{
+	if ( copy.items.isEmpty() || !canPasteBlocks( copy ) )
+		return QModelIndex();
+
+	const int first = getBlockCount() + firstBlockRow();
+	const int count = copy.items.count();
+
+	beginInsertRows( QModelIndex(), first, first + count - 1 );
+	root->prepareInsert( count );
+	for ( int i = 0; i < count; i++ )
+		root->insertChild( copy.items.at( i )->clone( this, nullptr ), first + i );
+	endInsertRows();
+
+	if ( !map.isEmpty() ) {
+		for ( int i = 0; i < count; i++ )
+			mapLinks( root->child( first + i ), map );
+	}
+
+	if ( state != Loading ) {
+		updateHeader();
+		updateLinks();
+		updateFooter();
+		emit linksChanged();
+	}
+
+	return createIndex( first, 0, root->child( first ) );
+}
+
 void NifModel::reorderBlocks( const QVector<qint32> & order )
 {
 	if ( getBlockCount() <= 1 )
@@ -968,7 +1303,7 @@ int NifModel::getBlockNumber( const NifItem * item ) const
 const NifItem * NifModel::_getBlockItem( const NifItem * block, const QString & ancestor ) const
 {
 	if ( block && inherits( block->name(), ancestor ) )
-		return block;
+		return decodeBlock( block );
 
 	return nullptr;
 }
@@ -976,7 +1311,7 @@ const NifItem * NifModel::_getBlockItem( const NifItem * block, const QString &
 const NifItem * NifModel::_getBlockItem( const NifItem * block, const QLatin1String & ancestor ) const
 {
 	if ( block && inherits( block->name(), ancestor ) )
-		return block;
+		return decodeBlock( block );
 
 	return nullptr;
 }
@@ -984,7 +1319,7 @@ const NifItem * NifModel::_getBlockItem( const NifItem * block, const QLatin1Str
 const NifItem * NifModel::_getBlockItem( const NifItem * block, const std::initializer_list<const char *> & ancestors ) const
 {
 	if ( block && inherits( block->name(), ancestors ) )
-		return block;
+		return decodeBlock( block );
 
 	return nullptr;
 }
@@ -992,17 +1327,20 @@ const NifItem * NifModel::_getBlockItem( const NifItem * block, const std::initi
 const NifItem * NifModel::_getBlockItem( const NifItem * block, const QStringList & ancestors ) const
 {
 	if ( block && inherits( block->name(), ancestors ) )
-		return block;
+		return decodeBlock( block );
 
 	return nullptr;
 }
 
 const NifItem * NifModel::getBlockItem( qint32 link ) const
 {
-	if ( isValidBlockNumber( link ) )
-		return root->child( link + firstBlockRow() );
+	return decodeBlock( getBlockRowItem( link ) );
+}
 
-	return nullptr;
+QString NifModel::getBlockType( qint32 link ) const
+{
+	const NifItem * block = getBlockRowItem( link );
+	return block ? block->name() : QString();
 }
 
 const NifItem * NifModel::getBlockItem( const NifItem * item ) const
@@ -1139,7 +1477,14 @@ void NifModel::insertType( NifItem * parent, const NifData & data, int at )
 		NifBlockPtr compound = compounds.value( data.type() );
 		if ( !compound )
 			return;
-		NifItem * branch = insertBranch( parent, data, at );
+		NifItem * branch;
+		if ( data.fieldTable() == compound->fields ) {
+			branch = insertBranch( parent, data, at );
+		} else {
+			NifData d( data );
+			d.setFieldTable( compound->fields );
+			branch = insertBranch( parent, d, at );
+		}
 		branch->prepareInsert( compound->types.count() );
 		for ( const NifData & d : compound->types ) {
 			insertType( branch, d );
@@ -1674,7 +2019,7 @@ bool NifModel::removeRows( int iStart, int count, const QModelIndex & parent )
 		endRemoveRows();
 
 		if ( hasLinks ) {
-			updateLinks();
+			updateBlockLinks( item );
 			updateFooter();
 			emit linksChanged();
 		}
@@ -1788,6 +2133,7 @@ bool NifModel::load( QIODevice & device )
 {
 	QSettings settings;
 	bool ignoreSize = settings.value( "Ignore Block Size", true ).toBool();
+	bool lazy = lazyLoading;
 
 	clear();
 
@@ -1813,6 +2159,17 @@ bool NifModel::load( QIODevice & device )
 	emit sigProgress( 0, numblocks );
 	//QTime t = QTime::currentTime();
 
+	// The raw bytes of lazy blocks, shared with lazyBlocks, so that the first snapshotRows() does
+	// not have to write them. Decoded blocks are not copied, the first snapshot, i.e. the first
+	// undoable spell, writes them instead, so files no spell is cast on keep no second copy.
+	QVector<RowData> loadedRows;
+	auto keepRow = [&loadedRows]( const NifItem * item, const QByteArray & data ) {
+		int row = item->row();
+		if ( row >= loadedRows.count() )
+			loadedRows.resize( row + 1 );
+		loadedRows[row] = { item->name(), data };
+	};
+
 	qint64 curpos = 0;
 	try
 	{
@@ -1864,7 +2221,7 @@ bool NifModel::load( QIODevice & device )
 						}
 
 						// for version 20.2.0.? and above the block size is stored in the header
-						if ( !ignoreSize && version >= 0x14020000 )
+						if ( ( lazy || !ignoreSize ) && version >= 0x14020000 )
 							size = get<quint32>( index( c, 0, getIndex( createIndex( header->row(), 0, header ), "Block Size" ) ) );
 					} else {
 						int len;
@@ -1882,7 +2239,22 @@ bool NifModel::load( QIODevice & device )
 					if ( blktyp.startsWith( "NiDataStream\x01" ) )
 						blktyp = extractRTTIArgs( blktyp, metadata );
 
-					if ( isNiBlock( blktyp ) ) {
+					if ( isNiBlock( blktyp ) && lazy && size != UINT_MAX ) {
+						// Only keep the bytes, the block is decoded on first access
+						NifItem * branch = insertBlockRow( blktyp, getBlockCount() + firstBlockRow(), false );
+
+						LazyBlock & pending = lazyBlocks[branch];
+						pending.data = device.read( size );
+						pending.metadata = metadata;
+						linksPending = true;
+
+						if ( pending.data.size() != int( size ) )
+							throw tr( "unexpected EOF during load" );
+
+						// NiDataStream fields come from the RTTI arguments, not from the bytes
+						if ( blktyp != "NiDataStream" )
+							keepRow( branch, pending.data );
+					} else if ( isNiBlock( blktyp ) ) {
 						//qDebug() << "loading block" << c << ":" << blktyp );
 						QModelIndex newBlock = insertNiBlock( blktyp, -1 );
 
@@ -2014,9 +2386,59 @@ bool NifModel::load( QIODevice & device )
 
 	//qDebug() << t.msecsTo( QTime::currentTime() );
 	reset(); // notify model views that a significant change to the data structure has occurded
+
+	if ( loadedRows.count() <= root->childCount() ) {
+		loadedRows.resize( root->childCount() );
+		rowCache = loadedRows;
+	}
 	return true;
 }
 
+//! Evaluate and cache the conditions of an item and all its children
+static void cacheConditions( const NifModel * nif, const NifItem * item )
+{
+	for ( auto child : item->childIter() ) {
+		if ( nif->evalCondition( child ) )
+			cacheConditions( nif, child );
+	}
+}
+
+void NifModel::saveRows( const QVector<int> & rows, QVector<QByteArray> & buffers, QVector<char> & written, QVector<QStringList> & warnings ) const
+{
+	const int numRows = root->childCount();
+
+	// The header and the block items are shared by all condition evaluations, cache their
+	// conditions up front so each worker only writes to the condition cache of its own block.
+	cacheConditions( this, getHeaderItem() );
+	for ( int c = 0; c < numRows; c++ )
+		evalCondition( root->child( c ) );
+
+	buffers = QVector<QByteArray>( numRows );
+	warnings = QVector<QStringList>( numRows );
+	written = QVector<char>( numRows, 0 );
+
+	// Detached up front, the workers only touch their own elements
+	QByteArray * bufferData = buffers.data();
+	QStringList * warningData = warnings.data();
+	char * writtenData = written.data();
+
+	QtConcurrent::blockingMap( rows, [&]( const int & c ) {
+		QBuffer buffer( &bufferData[c] );
+		buffer.open( QIODevice::WriteOnly );
+
+		// A block never decoded is written back as it was read
+		const NifItem * item = root->child( c );
+		if ( isBlockPending( item ) ) {
+			bufferData[c] = lazyBlocks.value( item ).data;
+			writtenData[c] = 1;
+			return;
+		}
+
+		NifOStream blockStream( this, &buffer );
+		writtenData[c] = saveItem( item, blockStream, &warningData[c] );
+	} );
+}
+
 bool NifModel::save( QIODevice & device ) const
 {
 	NifOStream stream( this, &device );
@@ -2024,15 +2446,45 @@ bool NifModel::save( QIODevice & device ) const
 	setState( Saving );
 
 	// Force update header and footer prior to save
-	if ( NifModel * mdl = const_cast<NifModel *>(this) ) {
-		mdl->updateHeader();
-		mdl->updateFooter();
+	// In parallel, Block Size is filled in from the serialized blocks below instead of a separate size pass
+	NifModel * mdl = const_cast<NifModel *>(this);
+	if ( !parallelSaving )
+		mdl->decodeAllBlocks();
+	mdl->updateHeaderImpl( !parallelSaving );
+	mdl->updateFooter();
+
+	const int numRows = rowCount( QModelIndex() );
+	emit sigProgress( 0, numRows );
+
+	// Everything after the header is serialized into one buffer per row on the thread pool
+	QVector<int> rows;
+	for ( int c = 1; c < numRows && parallelSaving; c++ )
+		rows.append( c );
+
+	QVector<QByteArray> buffers;
+	QVector<QStringList> warnings;
+	QVector<char> written;
+	saveRows( rows, buffers, written, warnings );
+
+	for ( const QStringList & list : warnings ) {
+		for ( const QString & w : list )
+			logWarning( w );
+	}
+
+	if ( version >= 0x14020000 && !lockUpdates && parallelSaving ) {
+		if ( NifItem * itemBlockSizes = mdl->getItem( mdl->getHeaderItem(), "Block Size" ) ) {
+			QVector<int> blockSizes;
+			for ( int r = firstBlockRow(); r <= lastBlockRow(); r++ )
+				blockSizes.append( buffers.at( r ).size() );
+
+			setState( Processing );
+			itemBlockSizes->setArray<int>( blockSizes );
+			restoreState();
+		}
 	}
 
-	emit sigProgress( 0, rowCount( QModelIndex() ) );
-
-	for ( int c = 0; c < rowCount( QModelIndex() ); c++ ) {
-		emit sigProgress( c + 1, rowCount( QModelIndex() ) );
+	for ( int c = 0; c < numRows; c++ ) {
+		emit sigProgress( c + 1, numRows );
 
 		//qDebug() << "saving block " << c << ": " << itemName( index( c, 0 ) );
 
@@ -2063,7 +2515,9 @@ bool NifModel::save( QIODevice & device ) const
 			}
 		}
 
-		if ( !saveItem( root->child( c ), stream ) ) {
+		bool ok = (c == 0 || !parallelSaving) ? saveItem( root->child( c ), stream )
+		                   : written.at( c ) && device.write( buffers.at( c ) ) == buffers.at( c ).size();
+		if ( !ok ) {
 			Message::critical( nullptr, tr( "Failed to write block %1 (%2)." ).arg( itemName( index( c, 0 ) ) ).arg( c - 1 ) );
 			resetState();
 			return false;
@@ -2085,9 +2539,12 @@ bool NifModel::loadIndex( QIODevice & device, const QModelIndex & index )
 {
 	NifItem * item = getItem( index );
 	if ( item ) {
+		decodeBlock( item );
+
 		NifIStream stream( this, &device );
 		bool ok = loadItem( item, stream );
-		updateLinks();
+		invalidateRowCache( item );
+		updateBlockLinks( item );
 		updateFooter();
 		emit linksChanged();
 		return ok;
@@ -2101,8 +2558,11 @@ bool NifModel::loadAndMapLinks( QIODevice & device, const QModelIndex & index, c
 {
 	NifItem * item = getItem( index );
 	if ( item ) {
+		decodeBlock( item );
+
 		NifIStream stream( this, &device );
 		bool ok = loadItem( item, stream );
+		invalidateRowCache( item );
 		mapLinks( item, map );
 		updateLinks();
 		updateFooter();
@@ -2174,7 +2634,7 @@ bool NifModel::earlyRejection( const QString & filepath, const QString & blockId
 
 bool NifModel::saveIndex( QIODevice & device, const QModelIndex & index ) const
 {
-	const NifItem * item = getItem( index );
+	const NifItem * item = decodeBlock( getItem( index ) );
 	if ( item ) {
 		NifOStream stream( this, &device );
 		return saveItem( item, stream );
@@ -2182,6 +2642,143 @@ bool NifModel::saveIndex( QIODevice & device, const QModelIndex & index ) const
 	return false;
 }
 
+QVector<NifModel::RowData> NifModel::snapshotRows() const
+{
+	const int numRows = root->childCount();
+	if ( rowCache.count() != numRows )
+		rowCache = QVector<RowData>( numRows );
+
+	// The header and the footer follow every edit of the blocks, they are always written
+	QVector<int> rows;
+	for ( int c = 0; c < numRows; c++ ) {
+		if ( !isBlockRow( c ) || rowCache.at( c ).type.isEmpty() )
+			rows.append( c );
+	}
+
+	QVector<QByteArray> buffers;
+	QVector<QStringList> warnings;
+	QVector<char> written;
+	saveRows( rows, buffers, written, warnings );
+
+	for ( int c : rows ) {
+		if ( !written.at( c ) )
+			return {};
+
+		rowCache[c].type = root->child( c )->name();
+		rowCache[c].data = buffers.at( c );
+	}
+
+	return rowCache;
+}
+
+void NifModel::invalidateRowCache( const NifItem * item )
+{
+	if ( rowCache.isEmpty() )
+		return;
+
+	if ( !item || item == root ) {
+		rowCache.clear();
+		return;
+	}
+
+	while ( item->parent() && item->parent() != root )
+		item = item->parent();
+
+	int row = item->row();
+	if ( item->parent() == root && row >= 0 && row < rowCache.count() )
+		rowCache[row] = RowData();
+}
+
+bool NifModel::restoreRows( int first, const QVector<RowData> & current, const QVector<RowData> & target )
+{
+	if ( first < 0 || first + current.count() > root->childCount() )
+		return false;
+
+	bool ok = true;
+	bool renumbered = ( current.count() != target.count() );
+	QVector<int> loaded;
+
+	auto load = [this, &ok, &loaded]( int row, const QByteArray & data ) {
+		QBuffer buffer;
+		buffer.setData( data );
+		buffer.open( QIODevice::ReadOnly );
+
+		NifItem * item = root->child( row );
+		decodeBlock( item );
+		lazyBlocks.remove( item );
+
+		NifIStream stream( this, &buffer );
+		if ( !loadItem( item, stream ) )
+			ok = false;
+		loaded.append( row );
+	};
+
+	// Rows present in both states are loaded in place, or replaced when their type differs
+	const int common = std::min( current.count(), target.count() );
+	for ( int i = 0; i < common; i++ ) {
+		int row = first + i;
+		const RowData & t = target.at( i );
+		if ( current.at( i ) == t )
+			continue;
+
+		if ( current.at( i ).type != t.type ) {
+			beginRemoveRows( QModelIndex(), row, row );
+			lazyBlocks.remove( root->child( row ) );
+			root->removeChild( row );
+			endRemoveRows();
+
+			if ( !insertBlockRow( t.type, row ) )
+				return false;
+		}
+
+		load( row, t.data );
+	}
+
+	if ( current.count() > common ) {
+		int row = first + common;
+		int count = current.count() - common;
+		beginRemoveRows( QModelIndex(), row, row + count - 1 );
+		for ( int c = row; c < row + count; c++ )
+			lazyBlocks.remove( root->child( c ) );
+		root->removeChildren( row, count );
+		endRemoveRows();
+	}
+
+	for ( int i = common; i < target.count(); i++ ) {
+		int row = first + i;
+		if ( !insertBlockRow( target.at( i ).type, row ) )
+			return false;
+
+		load( row, target.at( i ).data );
+	}
+
+	// The links were restored verbatim, only the link graph needs updating
+	if ( renumbered ) {
+		updateLinks();
+	} else {
+		for ( int row : loaded ) {
+			if ( isBlockRow( row ) )
+				updateLinks( row - firstBlockRow() );
+		}
+	}
+
+	for ( int row : loaded ) {
+		if ( row < root->childCount() )
+			emit dataChanged( index( row, 0 ), index( row, ValueCol ) );
+	}
+	emit linksChanged();
+
+	// The restored blocks hold exactly the target rows, the next snapshot need not write them
+	if ( ok && rowCache.count() == root->childCount() ) {
+		for ( int row : loaded ) {
+			if ( isBlockRow( row ) )
+				rowCache[row] = target.at( row - first );
+		}
+	}
+
+	return ok;
+}
+
 int NifModel::fileOffset( const QModelIndex & index ) const
 {
 	const NifItem * target = getItem( index );
@@ -2219,6 +2816,9 @@ int NifModel::fileOffset( const QModelIndex & index ) const
 
 int NifModel::blockSize( const NifItem * item ) const
 {
+	if ( isBlockPending( item ) )
+		return lazyBlocks.value( item ).data.size();
+
 	NifSStream stream( this );
 	return blockSize( item, stream );
 }
@@ -2361,7 +2961,7 @@ bool NifModel::loadHeader( NifItem * header, NifIStream & stream )
 	return result;
 }
 
-bool NifModel::saveItem( const NifItem * parent, NifOStream & stream ) const
+bool NifModel::saveItem( const NifItem * parent, NifOStream & stream, QStringList * warnings ) const
 {
 	if ( !parent )
 		return false;
@@ -2381,14 +2981,16 @@ bool NifModel::saveItem( const NifItem * parent, NifOStream & stream ) const
 					int nRealSize = child->childCount();
 					int nCalcSize = evalArraySize( child );
 					if ( nRealSize != nCalcSize ) {
-						logWarning( 
-							tr( "The size of %3 array (%1) does not match its calculated size (%2)." ).arg( nRealSize ).arg( nCalcSize ).arg( itemRepr(child) )
-						);
+						QString warning = tr( "The size of %3 array (%1) does not match its calculated size (%2)." ).arg( nRealSize ).arg( nCalcSize ).arg( itemRepr(child) );
+						if ( warnings )
+							warnings->append( warning );
+						else
+							logWarning( warning );
 					}
 
 				}
 
-				if ( !saveItem( child, stream ) )
+				if ( !saveItem( child, stream, warnings ) )
 					return false;
 			} else {
 				if ( !stream.write( child->value() ) )
@@ -2497,6 +3099,16 @@ void NifModel::invalidateDependentConditions( NifItem * item )
 	if ( !p || p == root || p->isArray() )
 		return;
 
+	// The field table of the parent knows which siblings refer to the item
+	const NifFieldTable * fields = p->fieldTable().get();
+	if ( fields && fields->rowCount() == p->childCount() ) {
+		for ( ushort r : fields->dependents( item->row() ) ) {
+			if ( auto c = p->child( r ) )
+				c->invalidateCondition();
+		}
+		return;
+	}
+
 	const QString & name = item->name();
 	for ( int i = item->row() + 1; i < p->childCount(); i++ ) {
 		auto c = p->child( i );
@@ -2519,6 +3131,67 @@ void NifModel::invalidateHeaderConditions()
 	invalidateItemConditions( getHeaderItem() );
 }
 
+void NifModel::revalidateConditions()
+{
+	const int numRows = root->childCount();
+	if ( numRows == 0 )
+		return;
+
+	// The header is shared by all blocks, so it is evaluated before the workers start.
+	// Each worker then only writes to the condition cache of its own block.
+	NifItem * header = getHeaderItem();
+	header->resetConditions();
+	evalCondition( header );
+	cacheConditions( this, header );
+
+	QVector<int> rows;
+	rows.reserve( numRows - 1 );
+	for ( int c = 1; c < numRows; c++ )
+		rows.append( c );
+
+	QtConcurrent::blockingMap( rows, [this]( const int & c ) {
+		NifItem * item = root->child( c );
+		item->resetConditions();
+		if ( evalCondition( item ) )
+			cacheConditions( this, item );
+	} );
+
+	emit dataChanged( index( 0, 0 ), index( numRows - 1, NumColumns - 1 ) );
+}
+
+//! Count the items under and including @p item, and the bytes allocated for their values
+static void countItemMemory( const NifItem * item, qint64 & items, qint64 & bytes )
+{
+	items++;
+	bytes += sizeof(NifItem) + item->value().payloadSize() + item->childCount() * sizeof(NifItem *);
+	for ( int c = 0; c < item->childCount(); c++ )
+		countItemMemory( item->child( c ), items, bytes );
+}
+
+QString NifModel::memoryStats() const
+{
+	qint64 items = 0, bytes = 0;
+	for ( int c = 0; c < root->childCount(); c++ )
+		countItemMemory( root->child( c ), items, bytes );
+
+	qint64 pending = 0, raw = 0;
+	for ( const LazyBlock & b : lazyBlocks ) {
+		if ( !b.decoded )
+			pending++;
+		raw += b.data.size();
+	}
+
+	QString stats = QString( "model: %1 items, %2 MB" )
+		.arg( items )
+		.arg( double( bytes ) / (1024 * 1024), 0, 'f', 1 );
+	if ( !lazyBlocks.isEmpty() )
+		stats += QString( ", %1 blocks pending, %2 MB raw" )
+			.arg( pending )
+			.arg( double( raw ) / (1024 * 1024), 0, 'f', 1 );
+
+	return stats + "\n" + NifPool::summary();
+}
+
 void NifModel::invalidateItemConditions( NifItem * item )
 {
 	if ( item ) {
@@ -2538,132 +3211,278 @@ void NifModel::updateLinks( int block )
 		return;
 	}
 
+	int n = getBlockCount();
+
 	if ( block >= 0 ) {
+		QList<int> oldChildren = childLinks.value( block );
+
 		childLinks[ block ].clear();
 		parentLinks[ block ].clear();
-		updateLinks( block, getBlockItem( block ) );
-	} else {
-		rootLinks.clear();
-		childLinks.clear();
-		parentLinks.clear();
+		updateLinks( block, getBlockRowItem( block ) );
 
-		// Run updateLinks() for each block
-		for ( int c = 0; c < getBlockCount(); c++ )
-			updateLinks( c );
+		// Only new edges can close a cycle
+		const QList<int> children = childLinks.value( block );
+		for ( const auto child : children ) {
+			if ( !oldChildren.contains( child ) && reachesBlock( child, block ) ) {
+				logWarning(tr("Infinite recursive link detected (%1 -> %2 -> %1)").arg(block).arg(child));
 
-		// Run checkLinks() for each block
-		for ( int c = 0; c < getBlockCount(); c++ ) {
-			QStack<int> stack;
-			checkLinks( c, stack );
+				childLinks[block].removeAll( child );
+			}
 		}
 
+		// Links to missing blocks stay in childLinks but never become childRefs, as in the full rebuild
+		const QList<int> & newChildren = childLinks[block];
+		for ( const auto child : oldChildren ) {
+			if ( child >= 0 && child < n && !newChildren.contains( child ) ) {
+				childRefs[child].removeOne( block );
+				updateRootLink( child );
+			}
+		}
 
-		int n = getBlockCount();
-		QByteArray hasrefs( n, 0 );
-
-		for ( int c = 0; c < n; c++ ) {
-			for ( const auto d : childLinks.value( c ) ) {
-				if ( d >= 0 && d < n )
-					hasrefs[d] = 1;
+		for ( const auto child : newChildren ) {
+			if ( child >= 0 && child < n && !oldChildren.contains( child ) ) {
+				QList<int> & refs = childRefs[child];
+				refs.insert( std::lower_bound( refs.begin(), refs.end(), block ), block );
+				updateRootLink( child );
 			}
 		}
+	} else {
+		rebuildLinks();
+	}
+}
+
+void NifModel::rebuildLinks()
+{
+	int n = getBlockCount();
 
-		for ( int c = 0; c < n; c++ ) {
-			if ( !hasrefs[c] )
-				rootLinks.append( c );
+	rootLinks.clear();
+	childLinks.clear();
+	parentLinks.clear();
+	childRefs.clear();
+
+	// Run updateLinks() for each block, blocks pending a lazy load have no links until they are read
+	for ( int c = 0; c < n; c++ ) {
+		childLinks[c].clear();
+		parentLinks[c].clear();
+
+		NifItem * item = getBlockRowItem( c );
+		auto pending = lazyBlocks.isEmpty() ? lazyBlocks.end() : lazyBlocks.find( item );
+		if ( pending == lazyBlocks.end() || pending->decoded ) {
+			updateLinks( c, item );
+		} else if ( pending->linksRead ) {
+			childLinks[c] = pending->childLinks;
+			parentLinks[c] = pending->parentLinks;
 		}
 	}
+
+	// Run checkLinks() for each block, each block is visited once
+	QVector<char> state( n, 0 );
+	for ( int c = 0; c < n; c++ ) {
+		if ( state[c] == 0 )
+			checkLinks( c, state );
+	}
+
+	for ( int c = 0; c < n; c++ ) {
+		for ( const auto d : childLinks.value( c ) ) {
+			if ( d >= 0 && d < n )
+				childRefs[d].append( c );
+		}
+	}
+
+	for ( int c = 0; c < n; c++ ) {
+		if ( childRefs.value( c ).isEmpty() )
+			rootLinks.append( c );
+	}
 }
 
-void NifModel::updateLinks( int block, NifItem * parent )
+void NifModel::updateBlockLinks( const NifItem * item )
 {
-	if ( !parent )
+	int block = getBlockNumber( item );
+	if ( block >= 0 )
+		updateLinks( block );
+	else
+		updateLinks();
+}
+
+void NifModel::updateRootLink( int block )
+{
+	if ( block < 0 || block >= getBlockCount() )
 		return;
 
+	auto it = std::lower_bound( rootLinks.begin(), rootLinks.end(), block );
+	bool isRoot = ( it != rootLinks.end() && *it == block );
+
+	if ( childRefs.value( block ).isEmpty() ) {
+		if ( !isRoot )
+			rootLinks.insert( it, block );
+	} else if ( isRoot ) {
+		rootLinks.erase( it );
+	}
+}
+
+bool NifModel::reachesBlock( int block, int target ) const
+{
+	QVector<int> stack{ block };
+	QSet<int> visited;
+
+	while ( !stack.isEmpty() ) {
+		int b = stack.takeLast();
+		if ( b == target )
+			return true;
+
+		if ( visited.contains( b ) )
+			continue;
+		visited.insert( b );
+
+		for ( const auto child : childLinks.value( b ) )
+			stack.append( child );
+	}
+
+	return false;
+}
+
+void NifModel::updateLinks( int block, NifItem * parent )
+{
+	if ( parent )
+		collectLinks( parent, childLinks[block], parentLinks[block] );
+}
+
+void NifModel::collectLinks( const NifItem * parent, QList<int> & children, QList<int> & parents ) const
+{
 	auto links = parent->getLinkRows();
 	for ( int l : links ) {
-		NifItem * c = parent->child( l );
+		const NifItem * c = parent->child( l );
 		if ( !c )
 			continue;
 	
 		if ( c->childCount() > 0 ) {
-			updateLinks( block, c );
+			collectLinks( c, children, parents );
 			continue;
 		}
 	
 		int i = c->getLinkValue();
 		if ( i >= 0 ) {
 			if ( c->valueType() == NifValue::tUpLink ) {
-				if ( !parentLinks[block].contains( i ) )
-					parentLinks[block].append( i );
+				if ( !parents.contains( i ) )
+					parents.append( i );
 			} else {
-				if ( !childLinks[block].contains( i ) )
-					childLinks[block].append( i );
+				if ( !children.contains( i ) )
+					children.append( i );
 			}
 		}
 	}
 	
 	auto linkparents = parent->getLinkAncestorRows();
 	for ( int p : linkparents ) {
-		NifItem * c = parent->child( p );
+		const NifItem * c = parent->child( p );
 		if ( c && c->childCount() > 0 )
-			updateLinks( block, c );
+			collectLinks( c, children, parents );
 	}
 }
 
-void NifModel::checkLinks( int block, QStack<int> & parents )
+void NifModel::checkLinks( int block, QVector<char> & state )
 {
-	parents.push( block );
-	foreach ( const auto child, childLinks.value( block ) ) {
-		if ( parents.contains( child ) ) {
+	// 1: on the current path, 2: done
+	state[block] = 1;
+	for ( const auto child : childLinks.value( block ) ) {
+		if ( child < 0 || child >= state.count() )
+			continue;
+
+		if ( state[child] == 1 ) {
 			logWarning(tr("Infinite recursive link detected (%1 -> %2 -> %1)").arg(block).arg(child));
 
 			childLinks[block].removeAll( child );
-		} else {
-			checkLinks( child, parents );
+		} else if ( state[child] == 0 ) {
+			checkLinks( child, state );
 		}
 	}
-	parents.pop();
+	state[block] = 2;
 }
 
-void NifModel::adjustLinks( NifItem * parent, int block, int delta )
+/*! Call @p fn for every link item below @p parent
+ *
+ * Only the branches recorded in the link caches of NifItem are visited, so the cost
+ * is proportional to the number of links rather than the number of items.
+ */
+template <typename F> static void forEachLink( NifItem * parent, F & fn )
 {
-	if ( !parent )
-		return;
+	for ( int l : parent->getLinkRows() ) {
+		NifItem * c = parent->child( l );
+		if ( !c )
+			continue;
 
-	if ( parent->childCount() > 0 ) {
-		for ( auto child : parent->children() )
-			adjustLinks( child, block, delta );
-	} else if ( parent->isLink() ) {
-		int l = parent->getLinkValue();
+		if ( c->childCount() > 0 )
+			forEachLink( c, fn );
+		else
+			fn( c );
+	}
 
-		if ( l >= 0 && ( ( delta != 0 && l >= block ) || l == block ) ) {
-			if ( delta == 0 )
-				parent->setLinkValue( -1 );
-			else
-				parent->setLinkValue( l + delta );
-		}
+	// Link arrays are in both lists, they have been visited above
+	for ( int p : parent->getLinkAncestorRows() ) {
+		NifItem * c = parent->child( p );
+		if ( c && c->childCount() > 0 && !c->isLink() )
+			forEachLink( c, fn );
 	}
 }
 
-void NifModel::mapLinks( NifItem * parent, const QMap<qint32, qint32> & map )
+void NifModel::remapLinks( NifItem * parent, const std::function<qint32( qint32 )> & map )
 {
 	if ( !parent )
 		return;
 
-	if ( parent->childCount() > 0 ) {
-		for ( auto child : parent->children() )
-			mapLinks( child, map );
-	} else if ( parent->isLink() ) {
-		int l = parent->getLinkValue();
-
+	// The items are changed without notifying the views, the blocks are marked in the row cache
+	bool changed = false;
+	auto apply = [&map, &changed]( NifItem * item ) {
+		qint32 l = item->getLinkValue();
 		if ( l >= 0 ) {
-			if ( map.contains( l ) )
-				parent->setLinkValue( map[ l ] );
+			qint32 m = map( l );
+			if ( m != l ) {
+				item->setLinkValue( m );
+				changed = true;
+			}
+		}
+	};
+
+	if ( parent == root ) {
+		// Links are renumbered in the items, the raw bytes of pending blocks cannot be
+		decodeAllBlocks();
+
+		// The row caches are 16-bit, go through the blocks directly
+		for ( auto block : root->children() ) {
+			if ( block->hasChildLinks() ) {
+				changed = false;
+				forEachLink( block, apply );
+				if ( changed )
+					invalidateRowCache( block );
+			}
 		}
+	} else {
+		if ( parent->childCount() > 0 )
+			forEachLink( parent, apply );
+		else if ( parent->isLink() )
+			apply( parent );
+
+		if ( changed )
+			invalidateRowCache( parent );
 	}
 }
 
+void NifModel::adjustLinks( NifItem * parent, int block, int delta )
+{
+	remapLinks( parent, [block, delta]( qint32 l ) -> qint32 {
+		if ( delta == 0 )
+			return ( l == block ) ? -1 : l;
+		return ( l >= block ) ? l + delta : l;
+	} );
+}
+
+void NifModel::mapLinks( NifItem * parent, const QMap<qint32, qint32> & map )
+{
+	remapLinks( parent, [&map]( qint32 l ) -> qint32 {
+		return map.value( l, l );
+	} );
+}
+
 bool NifModel::setLink( NifItem * item, qint32 link )
 {
 	if ( item && item->setLinkValue(link) ) {
@@ -2722,7 +3541,7 @@ bool NifModel::setLinkArray( NifItem * arrayRootItem, const QVector<qint32> & li
 	onArrayValuesChange( arrayRootItem );
 
 	if ( !arrayRootItem->isDescendantOf( getFooterItem() ) ) {
-		updateLinks();
+		updateBlockLinks( arrayRootItem );
 		updateFooter();
 		emit linksChanged();
 	}
@@ -2732,16 +3551,8 @@ bool NifModel::setLinkArray( NifItem * arrayRootItem, const QVector<qint32> & li
 
 int NifModel::getParent( int block ) const
 {
-	int parent = -1;
-
-	for ( int b = 0; b < getBlockCount(); b++ ) {
-		if ( childLinks.value( b ).contains( block ) ) {
-			parent = b;
-			break;
-		}
-	}
-
-	return parent;
+	completeLinks();
+	return childRefs.value( block ).value( 0, -1 );
 }
 
 int NifModel::getParent( const QModelIndex & index ) const
@@ -2879,7 +3690,7 @@ bool NifModel::assignString( NifItem * item, const QString & string, bool replac
 	} else if ( item->valueType() == NifValue::tStringIndex ) {
 		NifValue v( NifValue::tString );
 		v.set<QString>( string, this, item );
-		return setItemValue( item, v );
+		return setItemValue( item, std::move( v ) );
 	}
 
 	return BaseModel::set<QString>( item, string );
@@ -2893,6 +3704,8 @@ void NifModel::convertNiBlock( const QString & identifier, const QModelIndex & i
 	if ( !branch )
 		return;
 
+	decodeBlock( branch );
+
 	const QString & btype = branch->name();
 	if ( btype == identifier )
 		return;
@@ -2907,6 +3720,7 @@ void NifModel::convertNiBlock( const QString & identifier, const QModelIndex & i
 
 	if ( srcBlock && dstBlock ) {
 		branch->setName( identifier );
+		branch->setFieldTable( dstBlock->fields );
 
 		if ( inherits( btype, identifier ) ) {
 			// Remove any level between the two types
@@ -3028,15 +3842,26 @@ QString NifModel::topItemRepr( const NifItem * item ) const
 void NifModel::onItemValueChange( NifItem * item )
 {
 	invalidateDependentConditions( item );
+	// No dataChanged while processing, so the row cache is told directly
+	invalidateRowCache( item );
 	BaseModel::onItemValueChange( item );
 
 	if ( item->isLink() && !item->isDescendantOf( getFooterItem() ) ) {
-		updateLinks();
+		updateBlockLinks( item );
 		updateFooter();
 		emit linksChanged();
 	}
 }
 
+void NifModel::onColumnValuesChange( NifItem * arrayRootItem, int fieldRow )
+{
+	for ( auto c : arrayRootItem->childIter() )
+		invalidateDependentConditions( c->child( fieldRow ) );
+
+	invalidateRowCache( arrayRootItem );
+	BaseModel::onColumnValuesChange( arrayRootItem, fieldRow );
+}
+
 
 /*
  *  NifModelEval
@@ -37,9 +37,10 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <QHash>
 #include <QReadWriteLock>
-#include <QStack>
 #include <QStringList>
+#include <QVector>
 
+#include <functional>
 #include <memory>
 
 class SpellBook;
@@ -66,7 +67,6 @@ class NifModel final : public BaseModel
 	friend class NifXmlHandler;
 	friend class NifModelEval;
 	friend class NifOStream;
-	friend class ArrayUpdateCommand;
 
 public:
 	NifModel( QObject * parent = 0 );
@@ -88,6 +88,10 @@ public:
 
 	QModelIndex buddy( const QModelIndex & index ) const override;
 
+	bool hasChildren( const QModelIndex & parent = QModelIndex() ) const override final;
+	bool canFetchMore( const QModelIndex & parent ) const override final;
+	void fetchMore( const QModelIndex & parent ) override final;
+
 	// end QAbstractItemModel
 
 	// BaseModel
@@ -101,10 +105,76 @@ public:
 
 	// end BaseModel
 
+	/*! Enable or disable lazy loading for the following loads
+	 *
+	 * For 20.2 and later files, which store the size of every block in the header, a
+	 * lazy load only reads the block types and raw bytes. A block is decoded the first time
+	 * it is accessed through getBlockItem() or getBlockIndex(), or expanded in a view.
+	 * Blocks never decoded are saved by writing back their original bytes.
+	 *
+	 * Meant for readers that look at a few blocks of many files, such as the XML checker. Views
+	 * are not supported, their indexes reach the items without decoding the block. The link
+	 * graph and the footer roots need the links of every block: the first getRootLinks(),
+	 * getChildRefs(), getParent() or footer update reads them from the bytes of the pending
+	 * blocks, getChildLinks() and getParentLinks() only from the block asked for. The items
+	 * built to read them are dropped again, the blocks stay pending.
+	 */
+	void setLazyLoading( bool enable ) { lazyLoading = enable; }
+	/*! Serialize the blocks on the global thread pool when saving, the default
+	 *
+	 * When disabled, save() computes Block Size with blockSize() and writes every row through
+	 * one stream, as before the parallel writer. The output is the same either way.
+	 */
+	void setParallelSaving( bool enable ) { parallelSaving = enable; }
+	//! Whether a block has been read by a lazy load and not decoded yet
+	bool isBlockPending( const NifItem * block ) const;
+	//! Decode a block read by a lazy load if it has not been yet, returns @p block
+	const NifItem * decodeBlock( const NifItem * block ) const;
+	//! Decode every block read by a lazy load
+	void decodeAllBlocks();
+	/*! Drop the items of decoded blocks which are unchanged and have no links
+	 *
+	 * A block is only dropped if it still serializes to the bytes it was read from. It is
+	 * decoded again on the next access. NifItem pointers into the dropped blocks become invalid.
+	 * Lazy readers call it from time to time to bound the memory used by huge files.
+	 *
+	 * @return The number of blocks dropped
+	 */
+	int releaseBlocks();
+
 	//! Load from QIODevice and index
 	bool loadIndex( QIODevice & device, const QModelIndex & );
 	//! Save to QIODevice and index
 	bool saveIndex( QIODevice & device, const QModelIndex & ) const;
+
+	//! A serialized root row, i.e. the header, a block or the footer
+	struct RowData
+	{
+		//! Type of the row, e.g. "NiHeader" or the block type
+		QString type;
+		//! The row as written by saveIndex
+		QByteArray data;
+
+		//! Rows taken from the same cache entry share their data and compare without a memcmp
+		bool operator==( const RowData & other ) const
+		{
+			return type == other.type && ( data.isSharedWith( other.data ) || data == other.data );
+		}
+		bool operator!=( const RowData & other ) const { return !( *this == other ); }
+	};
+
+	/*! Serialize every root row, returns an empty list if a row could not be written
+	 *
+	 * Only the header, the footer and the blocks changed since the previous snapshot, or since
+	 * the load, are written. The other blocks are taken from the row cache.
+	 */
+	QVector<RowData> snapshotRows() const;
+	/*! Replace the root rows starting at @p first, which currently hold @p current, with @p target
+	 *
+	 * Rows equal in both lists are left alone. Links are restored as serialized instead of being
+	 * renumbered, so @p target must come from the state the rest of the model belongs to.
+	 */
+	bool restoreRows( int first, const QVector<RowData> & current, const QVector<RowData> & target );
 	//! Resets the model to its original state in any attached views.
 	void reset();
 
@@ -112,6 +182,14 @@ public:
 	void invalidateDependentConditions( NifItem * item );
 	//! Reset all cached conditions of the header
 	void invalidateHeaderConditions();
+	/*! Discard every cached condition and evaluate them all again
+	 *
+	 * The header is evaluated first, then the blocks in parallel on the global thread pool.
+	 */
+	void revalidateConditions();
+
+	//! Summary of the memory held by the items and the pending lazy blocks, for the Memory Statistics spell
+	QString memoryStats() const;
 
 	//! Loads a model and maps links
 	bool loadAndMapLinks( QIODevice & device, const QModelIndex &, const QMap<qint32, qint32> & map );
@@ -168,6 +246,8 @@ public:
 	QList<int> getRootLinks() const;
 	QList<int> getChildLinks( int block ) const;
 	QList<int> getParentLinks( int block ) const;
+	//! Blocks with a child link to the block, in ascending order
+	QList<int> getChildRefs( int block ) const;
 
 	/*! Get parent
 	 * @return	Parent block number or -1 if there are zero or multiple parents.
@@ -237,6 +317,8 @@ public:
 	QModelIndex insertNiBlock( const QString & identifier, int row = -1 );
 	//! Remove a block from the list
 	void removeNiBlock( int blocknum );
+	//! Remove several blocks from the list, renumbering the links once
+	void removeNiBlocks( QVector<qint32> blocknums );
 	//! Move a block in the list
 	void moveNiBlock( int src, int dst );
 
@@ -249,8 +331,54 @@ public:
 	//! Convert a block from one type to another
 	void convertNiBlock( const QString & identifier, const QModelIndex & index );
 
+	/*! Blocks copied out of a model by copyBlocks(), detached from any model
+	 *
+	 * The copied items share their NifData and the implicitly shared parts of their values
+	 * with the source, so copying and pasting involves no serialization. A copy can only be
+	 * pasted into a model with the same version, user version and Bethesda version, since
+	 * the item layout depends on them.
+	 */
+	class BlockCopy final
+	{
+		friend class NifModel;
+
+	public:
+		BlockCopy() = default;
+		BlockCopy( const BlockCopy & ) = delete;
+		BlockCopy & operator=( const BlockCopy & ) = delete;
+		~BlockCopy() { qDeleteAll( items ); }
+
+		//! The number of copied blocks
+		int count() const { return items.count(); }
+
+	private:
+		quint32 version = 0;
+		quint32 userVersion = 0;
+		quint32 bsVersion = 0;
+		QVector<NifItem *> items;
+	};
+
+	//! Copy blocks, in the given order, for pasteBlocks()
+	std::shared_ptr<const BlockCopy> copyBlocks( const QList<qint32> & blocknums ) const;
+	//! Whether blocks copied with copyBlocks() have the item layout of this model
+	bool canPasteBlocks( const BlockCopy & copy ) const;
+	/*! Append copied blocks
+	 *
+	 * Links of the pasted blocks are renumbered through @p map, links missing from it are kept.
+	 * String indices are kept as well, the caller has to restore strings pasted from another file.
+	 *
+	 * @return The index of the first pasted block
+	 */
+	QModelIndex pasteBlocks( const BlockCopy & copy, const QMap<qint32, qint32> & map );
+
+	//! Get the type of a block by its number, without decoding a block read by a lazy load
+	QString getBlockType( qint32 link ) const;
+
 	// Block item getters
 private:
+	//! Get a block NifItem by its number without decoding it
+	NifItem * getBlockRowItem( qint32 link ) const;
+
 	const NifItem * _getBlockItem( const NifItem * block, const QString & ancestor ) const;
 	const NifItem * _getBlockItem( const NifItem * block, const QLatin1String & ancestor ) const;
 	const NifItem * _getBlockItem( const NifItem * block, const std::initializer_list<const char *> & ancestors ) const;
@@ -667,17 +795,47 @@ protected:
 
 	bool loadItem( NifItem * parent, NifIStream & stream );
 	bool loadHeader( NifItem * parent, NifIStream & stream );
-	bool saveItem( const NifItem * parent, NifOStream & stream ) const;
+	//! Writes an item, appending array size warnings to @p warnings if given instead of logging them
+	bool saveItem( const NifItem * parent, NifOStream & stream, QStringList * warnings = nullptr ) const;
+	//! Serialize root rows @p rows into @p buffers on the thread pool, indexed by row
+	void saveRows( const QVector<int> & rows, QVector<QByteArray> & buffers, QVector<char> & written, QVector<QStringList> & warnings ) const;
 	bool fileOffset( const NifItem * parent, const NifItem * target, NifSStream & stream, int & ofs ) const;
 
 protected:
+	//! Updates the header infos, Block Size is left as is unless @p computeBlockSizes
+	void updateHeaderImpl( bool computeBlockSizes );
+
 	void insertAncestor( NifItem * parent, const QString & identifier, int row = -1 );
 	void insertType( NifItem * parent, const NifData & data, int row = -1 );
 	NifItem * insertBranch( NifItem * parent, const NifData & data, int row = -1 );
-
+	//! Insert an empty block of type @p identifier at root row @p row without renumbering links
+	NifItem * insertBlockRow( const QString & identifier, int row, bool withFields = true );
+	//! Insert the fields of the block type of @p branch
+	void insertBlockFields( NifItem * branch );
+	//! Decode a pending block, see setLazyLoading()
+	void decodeBlockImpl( NifItem * block );
+
+	/*! Update the link graph
+	 *
+	 * With a block number only the edges of that block are rescanned, otherwise
+	 * the whole graph is rebuilt.
+	 */
 	void updateLinks( int block = -1 );
 	void updateLinks( int block, NifItem * parent );
-	void checkLinks( int block, QStack<int> & parents );
+	//! Rebuild the whole link graph, regardless of lockUpdates
+	void rebuildLinks();
+	//! Append the links below @p parent to @p children and @p parents, each link once
+	void collectLinks( const NifItem * parent, QList<int> & children, QList<int> & parents ) const;
+	//! Update the link graph after the links below @p item changed
+	void updateBlockLinks( const NifItem * item );
+	//! Remove child links closing a cycle, depth first from @p block
+	void checkLinks( int block, QVector<char> & state );
+	//! Whether @p target can be reached from @p block through child links
+	bool reachesBlock( int block, int target ) const;
+	//! Add or remove @p block from rootLinks depending on whether anything links to it
+	void updateRootLink( int block );
+	//! Replace every link @p l >= 0 below @p parent with @p map( l ), visiting only link items
+	void remapLinks( NifItem * parent, const std::function<qint32( qint32 )> & map );
 	void adjustLinks( NifItem * parent, int block, int delta );
 	void mapLinks( NifItem * parent, const QMap<qint32, qint32> & map );
 
@@ -688,10 +846,49 @@ protected:
 
 	QHash<int, QList<int> > childLinks;
 	QHash<int, QList<int> > parentLinks;
+	//! Reverse of childLinks, the blocks linking to each block as a child in ascending order
+	QHash<int, QList<int> > childRefs;
+	//! Blocks without child references in ascending order
 	QList<int> rootLinks;
 
 	bool lockUpdates;
 
+	//! Whether the next load is lazy, see setLazyLoading()
+	bool lazyLoading = false;
+	//! See setParallelSaving()
+	bool parallelSaving = true;
+
+	//! Raw bytes of a block read by a lazy load
+	struct LazyBlock
+	{
+		QByteArray data;
+		//! NiDataStream RTTI arguments
+		NiMesh::DataStreamMetadata metadata = {};
+		//! Whether the items of the block have been created
+		bool decoded = false;
+		//! Whether childLinks and parentLinks hold the links of the block while it is pending
+		bool linksRead = false;
+		QList<int> childLinks;
+		QList<int> parentLinks;
+	};
+	//! Blocks read by a lazy load, decoded or not
+	mutable QHash<const NifItem *, LazyBlock> lazyBlocks;
+	//! Whether pending blocks may hold links missing from the link graph
+	bool linksPending = false;
+	//! Read the links of the pending blocks into the link graph if it is missing them
+	void completeLinks() const;
+	//! Read the links of every pending block and rebuild the link graph, see completeLinks()
+	void readPendingLinks();
+	//! Build the items of a pending block outside the tree from its bytes
+	std::unique_ptr<NifItem> readBlockFields( NifItem * block, const LazyBlock & pending );
+	//! The pending block @p block with its links read, nullptr if the block is not pending
+	const LazyBlock * pendingLinks( int block ) const;
+
+	//! The root rows as of the last snapshotRows(), a row with an empty type has changed since
+	mutable QVector<RowData> rowCache;
+	//! Mark the block holding @p item as changed in the row cache, or every row if @p item is null
+	void invalidateRowCache( const NifItem * item = nullptr );
+
 	enum UpdateType
 	{
 		utNone   = 0,
@@ -709,11 +906,14 @@ protected:
 
 	QString topItemRepr( const NifItem * item ) const override final;
 	void onItemValueChange( NifItem * item ) override final;
+	void onColumnValuesChange( NifItem * arrayRootItem, int fieldRow ) override final;
 
 	void invalidateItemConditions( NifItem * item );
 
 	//! Parse the XML file using a NifXmlHandler
 	static QString parseXmlDescription( const QString & filename );
+	//! Build the field tables of all niobjects and structs after parsing
+	static void buildFieldTables();
 
 	// XML structures
 	static QList<quint32> supportedVersions;
@@ -819,21 +1019,43 @@ inline bool NifModel::isVersionSupported( quint32 v )
 	return supportedVersions.contains( v );
 }
 
+inline void NifModel::completeLinks() const
+{
+	if ( linksPending )
+		const_cast<NifModel *>( this )->readPendingLinks();
+}
+
 inline QList<int> NifModel::getRootLinks() const
 {
+	completeLinks();
 	return rootLinks;
 }
 
 inline QList<int> NifModel::getChildLinks( int block ) const
 {
+	// The links of the block itself, no need to read the other pending blocks
+	if ( linksPending ) {
+		if ( const LazyBlock * pending = pendingLinks( block ) )
+			return pending->childLinks;
+	}
 	return childLinks.value( block );
 }
 
 inline QList<int> NifModel::getParentLinks( int block ) const
 {
+	if ( linksPending ) {
+		if ( const LazyBlock * pending = pendingLinks( block ) )
+			return pending->parentLinks;
+	}
 	return parentLinks.value( block );
 }
 
+inline QList<int> NifModel::getChildRefs( int block ) const
+{
+	completeLinks();
+	return childRefs.value( block );
+}
+
 inline bool NifModel::isLink( const NifItem * item ) const
 {
 	return item && item->isLink();
@@ -879,28 +1101,42 @@ inline bool NifModel::isValidBlockNumber( qint32 blockNum ) const
 	return blockNum >= 0 && blockNum < getBlockCount();
 }
 
+inline NifItem * NifModel::getBlockRowItem( qint32 link ) const
+{
+	return isValidBlockNumber( link ) ? root->child( link + firstBlockRow() ) : nullptr;
+}
+
+inline bool NifModel::isBlockPending( const NifItem * block ) const
+{
+	if ( lazyBlocks.isEmpty() )
+		return false;
+
+	auto it = lazyBlocks.constFind( block );
+	return it != lazyBlocks.cend() && !it->decoded;
+}
+
 
 // Block item getters
 
 inline const NifItem * NifModel::getBlockItem( qint32 link, const QString & ancestor ) const
 {
-	return _getBlockItem( getBlockItem(link), ancestor );
+	return _getBlockItem( getBlockRowItem(link), ancestor );
 }
 inline const NifItem * NifModel::getBlockItem( qint32 link, const QLatin1String & ancestor ) const
 {
-	return _getBlockItem( getBlockItem(link), ancestor );
+	return _getBlockItem( getBlockRowItem(link), ancestor );
 }
 inline const NifItem * NifModel::getBlockItem( qint32 link, const char * ancestor ) const
 {
-	return _getBlockItem( getBlockItem(link), QLatin1Literal(ancestor) );
+	return _getBlockItem( getBlockRowItem(link), QLatin1Literal(ancestor) );
 }
 inline const NifItem * NifModel::getBlockItem( qint32 link, const std::initializer_list<const char *> & ancestors ) const
 {
-	return _getBlockItem( getBlockItem(link), ancestors );
+	return _getBlockItem( getBlockRowItem(link), ancestors );
 }
 inline const NifItem * NifModel::getBlockItem( qint32 link, const QStringList & ancestors ) const
 {
-	return _getBlockItem( getBlockItem(link), ancestors );
+	return _getBlockItem( getBlockRowItem(link), ancestors );
 }
 
 inline const NifItem * NifModel::getBlockItem( const NifItem * item, const QString & ancestor ) const
@@ -34,14 +34,47 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "data/nifvalue.h"
 #include "model/nifmodel.h"
+#include "message.h"
 
 #include <QCoreApplication>
+#include <QSettings>
+#include <QUndoStack>
 
+#include <algorithm>
 
-//! @file undocommands.cpp ChangeValueCommand, ToggleCheckBoxListCommand
+
+//! @file undocommands.cpp ItemPath, ChangeValueCommand, ToggleCheckBoxListCommand, SpellCommand
 
 size_t ChangeValueCommand::lastID = 0;
 
+/*
+ *  ItemPath
+ */
+
+ItemPath::ItemPath( const QModelIndex & index )
+{
+	if ( !index.isValid() )
+		return;
+
+	column = index.column();
+	for ( QModelIndex i = index; i.isValid(); i = i.parent() )
+		rows.prepend( i.row() );
+}
+
+QModelIndex ItemPath::index( const NifModel * model ) const
+{
+	QModelIndex idx;
+	for ( int i = 0; i < rows.count(); i++ ) {
+		int row = rows.at( i );
+		if ( row < 0 || row >= model->rowCount( idx ) )
+			return QModelIndex();
+
+		idx = model->index( row, ( i == rows.count() - 1 ) ? column : 0, idx );
+	}
+	return idx;
+}
+
+
 /*
  *  ChangeValueCommand
  */
@@ -92,15 +125,15 @@ void ChangeValueCommand::redo()
 	if ( idxs.size() > 1 )
 		nif->setState( BaseModel::Processing );
 
-	int i = 0;
-	for ( auto idx : idxs ) {
+	for ( int i = 0; i < idxs.count(); i++ ) {
+		QModelIndex idx = idxs.at( i ).index( nif );
 		if ( idx.isValid() )
-			nif->setData( idx, newValues.at( i++ ), Qt::EditRole );
+			nif->setData( idx, newValues.at( i ), Qt::EditRole );
 	}
 
 	if ( idxs.size() > 1 ) {
 		nif->restoreState();
-		nif->dataChanged( idxs.first(), idxs.last() );
+		nif->dataChanged( idxs.first().index( nif ), idxs.last().index( nif ) );
 	}
 
 	//qDebug() << nif->data( idx ).toString();
@@ -113,15 +146,15 @@ void ChangeValueCommand::undo()
 	if ( idxs.size() > 1 )
 		nif->setState( BaseModel::Processing );
 
-	int i = 0;
-	for ( auto idx : idxs ) {
+	for ( int i = 0; i < idxs.count(); i++ ) {
+		QModelIndex idx = idxs.at( i ).index( nif );
 		if ( idx.isValid() )
-			nif->setData( idx, oldValues.at( i++ ), Qt::EditRole );
+			nif->setData( idx, oldValues.at( i ), Qt::EditRole );
 	}
 
 	if ( idxs.size() > 1 ) {
 		nif->restoreState();
-		nif->dataChanged( idxs.first(), idxs.last() );
+		nif->dataChanged( idxs.first().index( nif ), idxs.last().index( nif ) );
 	}
 
 	//qDebug() << nif->data( idx ).toString();
@@ -171,8 +204,9 @@ ToggleCheckBoxListCommand::ToggleCheckBoxListCommand( const QModelIndex & index,
 void ToggleCheckBoxListCommand::redo()
 {
 	//qDebug() << "Redoing";
-	if ( idx.isValid() )
-		nif->setData( idx, newValue, Qt::EditRole );
+	QModelIndex index = idx.index( nif );
+	if ( index.isValid() )
+		nif->setData( index, newValue, Qt::EditRole );
 
 	//qDebug() << nif->data( idx ).toString();
 }
@@ -180,31 +214,208 @@ void ToggleCheckBoxListCommand::redo()
 void ToggleCheckBoxListCommand::undo()
 {
 	//qDebug() << "Undoing";
-	if ( idx.isValid() )
-		nif->setData( idx, oldValue, Qt::EditRole );
+	QModelIndex index = idx.index( nif );
+	if ( index.isValid() )
+		nif->setData( index, oldValue, Qt::EditRole );
 
 	//qDebug() << nif->data( idx ).toString();
 }
 
-ArrayUpdateCommand::ArrayUpdateCommand( const QModelIndex & index, NifModel * model )
-	: QUndoCommand(), nif( model ), idx( index )
+
+/*
+ *  SpellCommand
+ */
+
+//! Number of most recent spell commands per model that stay uncompressed
+static const int SPELL_UNCOMPRESSED = 2;
+
+//! Live spell commands, oldest first
+static QList<SpellCommand *> & spellHistory()
 {
-	setText( QCoreApplication::translate( "ArrayUpdateCommand", "Update Array" ) );
+	static QList<SpellCommand *> history;
+	return history;
 }
 
-void ArrayUpdateCommand::redo()
+SpellCommand::SpellCommand( const QString & text, NifModel * model )
+	: QUndoCommand(), nif( model )
 {
-	if ( idx.isValid() ) {
-		oldSize = nif->rowCount( idx );
-		nif->updateArraySize( idx );
-		newSize = nif->rowCount( idx );
+	setText( text );
+	snapshot = nif->snapshotRows();
+}
+
+SpellCommand::~SpellCommand()
+{
+	spellHistory().removeAll( this );
+}
+
+bool SpellCommand::isEnabled()
+{
+	return depth() != 0;
+}
+
+int SpellCommand::depth()
+{
+	QSettings settings;
+	return std::max( settings.value( "Settings/Undo/Depth", 50 ).toInt(), 0 );
+}
+
+qint64 SpellCommand::memoryLimit()
+{
+	QSettings settings;
+	return std::max<qint64>( settings.value( "Settings/Undo/Memory Limit", 256 ).toLongLong(), 1 ) * 1024 * 1024;
+}
+
+bool SpellCommand::finish()
+{
+	QVector<NifModel::RowData> current = nif->snapshotRows();
+	QVector<NifModel::RowData> before;
+	before.swap( snapshot );
+
+	// Without both snapshots, older commands can no longer be trusted to apply
+	if ( before.count() < 2 || current.count() < 2 ) {
+		if ( nif->undoStack )
+			nif->undoStack->clear();
+		return false;
 	}
+
+	if ( before.first() != current.first() )
+		regions.append( { 0, { before.first() }, { current.first() } } );
+
+	// Blocks, skipping the unchanged ones at either end
+	const int n = before.count() - 2;
+	const int m = current.count() - 2;
+
+	int prefix = 0;
+	while ( prefix < n && prefix < m && before.at( 1 + prefix ) == current.at( 1 + prefix ) )
+		prefix++;
+
+	int suffix = 0;
+	while ( suffix < n - prefix && suffix < m - prefix && before.at( n - suffix ) == current.at( m - suffix ) )
+		suffix++;
+
+	if ( prefix < n - suffix || prefix < m - suffix ) {
+		Region r;
+		r.first = 1 + prefix;
+		r.before = before.mid( 1 + prefix, n - prefix - suffix );
+		r.after = current.mid( 1 + prefix, m - prefix - suffix );
+
+		// Share the rows that are identical in both states
+		for ( int i = 0; i < std::min( r.before.count(), r.after.count() ); i++ ) {
+			if ( r.before.at( i ) == r.after.at( i ) )
+				r.after[i] = r.before.at( i );
+		}
+
+		regions.append( r );
+	}
+
+	if ( before.last() != current.last() )
+		regions.append( { -1, { before.last() }, { current.last() } } );
+
+	if ( regions.isEmpty() )
+		return false;
+
+	QList<SpellCommand *> & history = spellHistory();
+	qint64 total = size();
+	for ( SpellCommand * cmd : history ) {
+		if ( cmd->nif == nif )
+			total += cmd->size();
+	}
+
+	if ( total > memoryLimit() && nif->undoStack ) {
+		nif->undoStack->clear();
+		total = size();
+	}
+
+	if ( total > memoryLimit() ) {
+		Message::append( QCoreApplication::translate( "SpellCommand", "Undo history" ),
+			QCoreApplication::translate( "SpellCommand", "'%1' changed too much data to be undone." ).arg( text() ) );
+		return false;
+	}
+
+	// Compress everything but the most recent commands of this model
+	history.append( this );
+	int recent = 0;
+	for ( int i = history.count() - 1; i >= 0; i-- ) {
+		if ( history.at( i )->nif == nif && ++recent > SPELL_UNCOMPRESSED )
+			history.at( i )->compress();
+	}
+
+	return true;
+}
+
+qint64 SpellCommand::size() const
+{
+	qint64 bytes = 0;
+	for ( const Region & r : regions ) {
+		for ( const NifModel::RowData & row : r.before )
+			bytes += row.data.size();
+		for ( int i = 0; i < r.after.count(); i++ ) {
+			// Shared rows only count once
+			if ( i >= r.before.count() || !r.after.at( i ).data.isSharedWith( r.before.at( i ).data ) )
+				bytes += r.after.at( i ).data.size();
+		}
+	}
+	return bytes;
+}
+
+void SpellCommand::compress()
+{
+	if ( compressed )
+		return;
+
+	for ( Region & r : regions ) {
+		for ( int i = 0; i < r.before.count(); i++ ) {
+			bool shared = i < r.after.count() && r.after.at( i ).data.isSharedWith( r.before.at( i ).data );
+			r.before[i].data = qCompress( r.before.at( i ).data );
+			if ( shared )
+				r.after[i].data = r.before.at( i ).data;
+		}
+		for ( int i = 0; i < r.after.count(); i++ ) {
+			if ( i >= r.before.count() || !r.after.at( i ).data.isSharedWith( r.before.at( i ).data ) )
+				r.after[i].data = qCompress( r.after.at( i ).data );
+		}
+	}
+
+	compressed = true;
+}
+
+void SpellCommand::apply( bool forward )
+{
+	auto rows = [this]( const QVector<NifModel::RowData> & list ) {
+		if ( !compressed )
+			return list;
+
+		QVector<NifModel::RowData> out = list;
+		for ( NifModel::RowData & row : out )
+			row.data = qUncompress( row.data );
+		return out;
+	};
+
+	for ( const Region & r : regions ) {
+		int first = ( r.first < 0 ) ? nif->rowCount( QModelIndex() ) - 1 : r.first;
+
+		const QVector<NifModel::RowData> & from = forward ? r.before : r.after;
+		const QVector<NifModel::RowData> & to = forward ? r.after : r.before;
+
+		if ( !nif->restoreRows( first, rows( from ), rows( to ) ) )
+			Message::append( QCoreApplication::translate( "SpellCommand", "Undo history" ),
+				QCoreApplication::translate( "SpellCommand", "Could not restore the blocks changed by '%1'." ).arg( text() ) );
+	}
+
+	nif->invalidateHeaderConditions();
 }
 
-void ArrayUpdateCommand::undo()
+void SpellCommand::redo()
 {
-	if ( idx.isValid() ) {
-		// TODO: Actually attempt to set the array size back
-		nif->updateArraySize( idx );
+	if ( skipRedo ) {
+		skipRedo = false;
+		return;
 	}
+
+	apply( true );
+}
+
+void SpellCommand::undo()
+{
+	apply( false );
 }
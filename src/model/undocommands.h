@@ -33,16 +33,36 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef UNDOCOMMANDS_H
 #define UNDOCOMMANDS_H
 
+#include "model/nifmodel.h"
+
 #include <QUndoCommand>
 #include <QModelIndex>
 #include <QVariant>
 
 
-//! @file undocommands.h ChangeValueCommand, ToggleCheckBoxListCommand
+//! @file undocommands.h ItemPath, ChangeValueCommand, ToggleCheckBoxListCommand, SpellCommand
 
-class NifModel;
 class NifValue;
 
+/*! The rows leading from the root to a model index
+ *
+ * Unlike a QPersistentModelIndex it still resolves after SpellCommand removed and restored the
+ * rows of a block, as the commands are undone in order and find the rows as they left them.
+ */
+class ItemPath
+{
+public:
+	ItemPath() {}
+	ItemPath( const QModelIndex & index );
+
+	//! The index in @p model, invalid if the rows no longer exist
+	QModelIndex index( const NifModel * model ) const;
+
+private:
+	QVector<int> rows;
+	int column = 0;
+};
+
 class ChangeValueCommand : public QUndoCommand
 {
 public:
@@ -65,7 +85,7 @@ public:
 private:
 	NifModel * nif;
 	QVector<QVariant> newValues, oldValues;
-	QVector<QPersistentModelIndex> idxs;
+	QVector<ItemPath> idxs;
 
 	//! The command ID for this undo command
 	size_t localID;
@@ -84,20 +104,59 @@ public:
 private:
 	NifModel * nif;
 	QVariant newValue, oldValue;
-	QPersistentModelIndex idx;
+	ItemPath idx;
 };
 
-
-class ArrayUpdateCommand : public QUndoCommand
+/*! Undo for spells and other edits that may touch any number of blocks
+ *
+ * The rows of the model are snapshot before and after the edit. NifModel::snapshotRows() only
+ * writes the blocks changed since its previous call, so the cost follows the blocks the edit
+ * touched rather than the file. Only the header, the footer and the range of blocks that
+ * differ are kept, so undo and redo reload just the blocks that changed. All but the most
+ * recent commands of a model are kept compressed.
+ */
+class SpellCommand : public QUndoCommand
 {
 public:
-	ArrayUpdateCommand( const QModelIndex & index, NifModel * model );
+	//! Snapshot @p model before an edit named @p text
+	SpellCommand( const QString & text, NifModel * model );
+	~SpellCommand();
+
+	/*! Record the changes made since the snapshot
+	 *
+	 * Returns false if nothing changed or the changes exceed the memory limit. In the latter
+	 * case the undo stack is cleared, as the older commands no longer apply to the model.
+	 */
+	bool finish();
+
 	void redo() override;
 	void undo() override;
+
+	//! Whether spells should be recorded, i.e. "Settings/Undo/Depth" is not 0
+	static bool isEnabled();
+	//! Maximum number of undo commands, "Settings/Undo/Depth"
+	static int depth();
+	//! Memory limit in bytes for the spell history of a model, "Settings/Undo/Memory Limit" in MB
+	static qint64 memoryLimit();
+
 private:
+	//! Consecutive rows that changed, @p first is -1 for the footer
+	struct Region
+	{
+		int first = 0;
+		QVector<NifModel::RowData> before, after;
+	};
+
+	void apply( bool forward );
+	void compress();
+	qint64 size() const;
+
 	NifModel * nif;
-	uint newSize, oldSize;
-	QPersistentModelIndex idx;
+	QVector<NifModel::RowData> snapshot;
+	QVector<Region> regions;
+	//! The first redo() happens when the command is pushed, after the edit was made
+	bool skipRedo = true;
+	bool compressed = false;
 };
 
 #endif // UNDOCOMMANDS_H
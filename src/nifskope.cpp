@@ -38,9 +38,11 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "spellbook.h"
 #include "version.h"
 #include "gl/glscene.h"
+#include "gl/gltexindex.h"
 #include "model/kfmmodel.h"
 #include "model/nifmodel.h"
 #include "model/nifproxymodel.h"
+#include "model/undocommands.h"
 #include "ui/widgets/fileselect.h"
 #include "ui/widgets/nifview.h"
 #include "ui/widgets/refrbrowser.h"
@@ -168,6 +170,7 @@ NifSkope::NifSkope()
 
 	// Setup QUndoStack
 	nif->undoStack = new QUndoStack( this );
+	nif->undoStack->setUndoLimit( SpellCommand::depth() );
 
 	indexStack = new QUndoStack( this );
 
@@ -235,6 +238,13 @@ NifSkope::NifSkope()
 	bsaModel = new BSAModel( this );
 	bsaProxyModel = new BSAProxyModel( this );
 
+	texIndexerResume = new QTimer( this );
+	texIndexerResume->setSingleShot( true );
+	connect( texIndexerResume, &QTimer::timeout, [this]() {
+		if ( texIndexer )
+			texIndexer->setPaused( false );
+	} );
+
 	// Empty Model for swapping out before model fill
 	emptyModel = new QStandardItemModel( this );
 
@@ -342,6 +352,8 @@ void NifSkope::exitRequested()
 
 NifSkope::~NifSkope()
 {
+	// The indexer thread reads from the archive owned by archiveHandler
+	delete texIndexer;
 	delete ui;
 }
 
@@ -785,6 +797,10 @@ void NifSkope::checkFile( QFileInfo fInfo, QByteArray hash )
 
 void NifSkope::openArchive( const QString & archive )
 {
+	// Stop indexing before the model items and the archive go away
+	delete texIndexer;
+	texIndexer = nullptr;
+
 	// Clear memory from previously opened archives
 	bsaModel->clear();
 	bsaProxyModel->clear();
@@ -811,8 +827,19 @@ void NifSkope::openArchive( const QString & archive )
 		// Populate model from BSA
 		bsa->fillModel( bsaModel, "meshes" );
 
+		// Textures are listed under their own folder
+		bool hasTextures = false;
+		if ( bsa->hasFolder( "textures" ) ) {
+			auto texturesItem = new QStandardItem( "textures" );
+			bsaModel->invisibleRootItem()->appendRow( { texturesItem, new QStandardItem( "" ), new QStandardItem( "" ) } );
+
+			hasTextures = bsa->scan( bsa->getFolder( "textures" ), texturesItem, "textures" );
+			if ( !hasTextures )
+				bsaModel->removeRow( texturesItem->row() );
+		}
+
 		if ( bsaModel->rowCount() == 0 ) {
-			qCWarning( nsIo ) << "The BSA does not contain any meshes.";
+			qCWarning( nsIo ) << "The BSA does not contain any meshes or textures.";
 			clearCurrentArchive();
 			return;
 		}
@@ -826,9 +853,12 @@ void NifSkope::openArchive( const QString & archive )
 		bsaView->setColumnWidth( 0, 300 );
 		bsaView->setColumnWidth( 2, 50 );
 
+		for ( int c = BSAModel::FormatCol; c < BSAModel::NumColumns; c++ )
+			bsaView->setColumnHidden( c, !hasTextures );
+
 		// Sort proxy after model/view is populated
 		bsaProxyModel->sort( 0, Qt::AscendingOrder );
-		bsaProxyModel->setFiletypes( { ".nif", ".bto", ".btr" } );
+		bsaProxyModel->setFiletypes( { ".nif", ".bto", ".btr", ".dds" } );
 		bsaProxyModel->resetFilter();
 
 		// Set filename label
@@ -862,6 +892,9 @@ void NifSkope::openArchive( const QString & archive )
 
 		// Update filter when switching open archives
 		filterTimer->start( 0 );
+
+		if ( hasTextures )
+			texIndexer = new TexIndexer( bsa, bsaModel, this );
 	}
 }
 
@@ -869,7 +902,8 @@ void NifSkope::openArchiveFile( const QModelIndex & index )
 {
 	QString filepath = index.sibling( index.row(), 1 ).data( Qt::EditRole ).toString();
 
-	if ( !filepath.isEmpty() )
+	// Textures are listed for browsing only
+	if ( !filepath.isEmpty() && !TexIndexer::isTexture( filepath ) )
 		openArchiveFileString( currentArchive, filepath );
 }
 
@@ -72,6 +72,7 @@ class FSArchiveHandler;
 class BSA;
 class BSAModel;
 class BSAProxyModel;
+class TexIndexer;
 class QStandardItemModel;
 class QAction;
 class QActionGroup;
@@ -435,6 +436,11 @@ private:
 	BSAProxyModel * bsaProxyModel;
 	QStandardItemModel * emptyModel;
 
+	//! Background texture index of the open archive, if it has textures
+	TexIndexer * texIndexer = nullptr;
+	//! Resumes texIndexer a little after a file has finished loading
+	QTimer * texIndexerResume;
+
 	QMenu * mRecentArchiveFiles;
 };
 
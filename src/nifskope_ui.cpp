@@ -38,6 +38,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "spellbook.h"
 #include "version.h"
 #include "gl/glscene.h"
+#include "gl/gltexindex.h"
 #include "model/kfmmodel.h"
 #include "model/nifmodel.h"
 #include "model/nifproxymodel.h"
@@ -774,6 +775,11 @@ void NifSkope::openDlg()
 
 void NifSkope::onLoadBegin()
 {
+	// Keep the archive indexer off the disk while loading
+	texIndexerResume->stop();
+	if ( texIndexer )
+		texIndexer->setPaused( true );
+
 	// Disconnect the models from the views
 	swapModels();
 
@@ -856,6 +862,9 @@ void NifSkope::onLoadComplete( bool success, QString & fname )
 
 	// Hide Progress Bar
 	QTimer::singleShot( timeout, progress, SLOT( hide() ) );
+
+	// Give textures of the new file a head start before indexing again
+	texIndexerResume->start( 2000 );
 }
 
 
@@ -32,11 +32,15 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "spellbook.h"
 
+#include "model/undocommands.h"
 #include "ui/checkablemessagebox.h"
 
 #include <QCache>
 #include <QDir>
 #include <QSettings>
+#include <QUndoStack>
+
+#include <memory>
 
 
 
@@ -123,7 +127,9 @@ void SpellBook::cast( NifModel * nif, const QModelIndex & index, SpellPtr spell
 		return;
 	}
 
-	if ( !suppressConfirm && spell->page() != "Array" ) {
+	bool undoable = nif->undoStack && SpellCommand::isEnabled();
+
+	if ( !undoable && !suppressConfirm && spell->page() != "Array" ) {
 		response = CheckableMessageBox::question( this, "Confirmation", "This action cannot currently be undone. Do you want to continue?", "Do not ask me again", &accepted );
 
 		if ( accepted )
@@ -131,6 +137,11 @@ void SpellBook::cast( NifModel * nif, const QModelIndex & index, SpellPtr spell
 	}
 	
 	if ( (response == QDialogButtonBox::Yes) && spell && spell->isApplicable( nif, index ) ) {
+		// Snapshot the blocks so the changes made by the spell can be undone
+		std::unique_ptr<SpellCommand> undo;
+		if ( undoable )
+			undo.reset( new SpellCommand( spell->name(), nif ) );
+
 		bool noSignals = spell->batch();
 		if ( noSignals )
 			nif->setState( BaseModel::Processing );
@@ -143,6 +154,9 @@ void SpellBook::cast( NifModel * nif, const QModelIndex & index, SpellPtr spell
 		nif->invalidateHeaderConditions();
 		nif->updateHeader();
 
+		if ( undo && undo->finish() )
+			nif->undoStack->push( undo.release() );
+
 		if ( noSignals && nif->getProcessingResult() ) {
 			emit nif->dataChanged( idx, idx );
 		}
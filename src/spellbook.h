@@ -45,6 +45,8 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QMap>
 #include <QPersistentModelIndex>
 #include <QString>
+#include <QVector>
+#include <QtConcurrent/QtConcurrentMap>
 
 #include <memory>
 
@@ -99,6 +101,22 @@ public:
 			cast( nif, index );
 	}
 
+	/*! Cast a per block spell on many blocks, with the expensive part spread over the global thread pool
+	 *
+	 * The work on each block is split into three phases:
+	 * - @p snapshot copies what the block needs out of the model into a Job, on the model thread.
+	 *   It returns false to skip the block.
+	 * - @p compute works on its Job alone, on the thread pool. It must not touch the model.
+	 * - @p commit writes the Job back to the model, on the model thread, in block order.
+	 *
+	 * The commit phase runs with link updates held and the model in Processing state,
+	 * so the views are refreshed once at the end instead of once per value.
+	 *
+	 * @param blocks	Persistent indices, since a commit may insert or remove blocks
+	 */
+	template <typename Job, typename Snapshot, typename Compute, typename Commit>
+	static void castParallel( NifModel * nif, const QList<QPersistentModelIndex> & blocks, Snapshot snapshot, Compute compute, Commit commit );
+
 	//! i18n wrapper for various strings
 	/*!
 	 * Note that we don't use QObject::tr() because that doesn't provide
@@ -110,6 +128,40 @@ public:
 	static inline QString tr( const char * key, const char * comment = 0 ) { return QCoreApplication::translate( "Spell", key, comment ); }
 };
 
+template <typename Job, typename Snapshot, typename Compute, typename Commit>
+void Spell::castParallel( NifModel * nif, const QList<QPersistentModelIndex> & blocks, Snapshot snapshot, Compute compute, Commit commit )
+{
+	QVector<Job> jobs;
+	jobs.reserve( blocks.count() );
+	for ( const QPersistentModelIndex & idx : blocks ) {
+		Job job;
+		if ( idx.isValid() && snapshot( nif, idx, job ) )
+			jobs.append( std::move( job ) );
+	}
+
+	if ( jobs.isEmpty() )
+		return;
+
+	QtConcurrent::blockingMap( jobs, [&compute]( Job & job ) { compute( job ); } );
+
+	bool wasProcessing = ( nif->getState() == BaseModel::Processing );
+	bool oldHoldUpdates = nif->holdUpdates( true );
+	nif->setState( BaseModel::Processing );
+
+	for ( const Job & job : jobs )
+		commit( nif, job );
+
+	nif->restoreState();
+	nif->holdUpdates( oldHoldUpdates );
+
+	// Leave the refresh to the caller if it was already processing
+	if ( !wasProcessing && nif->getProcessingResult() ) {
+		int last = nif->rowCount() - 1;
+		if ( last >= 0 )
+			emit nif->dataChanged( nif->index( 0, 0 ), nif->index( last, NifModel::NumColumns - 1 ) );
+	}
+}
+
 using SpellPtr = std::shared_ptr<Spell>;
 
 //! Spell menu
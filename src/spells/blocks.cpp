@@ -1268,6 +1268,23 @@ public:
 
 REGISTER_SPELL( spPasteOverBlock )
 
+/*! The branch last copied to the clipboard by this process
+ *
+ * While the clipboard still holds its data, Paste Branch appends the copied items directly
+ * instead of parsing the data, if the target has the same item layout as the source.
+ */
+static struct
+{
+	//! The clipboard data of the branch
+	QByteArray data;
+	//! The copied blocks
+	std::shared_ptr<const NifModel::BlockCopy> blocks;
+	//! The RTTI name of each block
+	QStringList types;
+	//! The strings of each block, see serializeStrings()
+	QList<QStringList> strings;
+} localBranch;
+
 //! Copy a branch (a block and its descendents) to the clipboard
 
 bool spCopyBranch::isApplicable( const NifModel * nif, const QModelIndex & index )
@@ -1326,14 +1343,20 @@ QModelIndex spCopyBranch::cast( NifModel * nif, const QModelIndex & index )
 		ds << blockMap;
 		ds << parentMap;
 
+		QStringList types;
+		QList<QStringList> strings;
+
 		for ( const auto block : blocks ) {
 			auto iBlock = nif->getBlockIndex( block );
 			auto bType = nif->createRTTIName( iBlock );
 
 			ds << bType;
+			types << bType;
 
-			if ( nif->checkVersion( 0x14010001, 0 ) )
-				ds << serializeStrings( nif, iBlock, bType );
+			if ( nif->checkVersion( 0x14010001, 0 ) ) {
+				strings << serializeStrings( nif, iBlock, bType );
+				ds << strings.last();
+			}
 
 			if ( !nif->saveIndex( buffer, iBlock ) ) {
 				Message::append( tr( B_ERR ).arg( name() ),
@@ -1344,6 +1367,11 @@ QModelIndex spCopyBranch::cast( NifModel * nif, const QModelIndex & index )
 			}
 		}
 
+		localBranch.data = data;
+		localBranch.blocks = nif->copyBlocks( blocks );
+		localBranch.types = types;
+		localBranch.strings = strings;
+
 		QMimeData * mime = new QMimeData;
 		mime->setData( QString( STR_BR ).arg( nif->getVersion() ), data );
 		QApplication::clipboard()->setMimeData( mime );
@@ -1447,6 +1475,29 @@ QModelIndex spPasteBranch::cast( NifModel * nif, const QModelIndex & index )
 
 					QModelIndex iRoot;
 
+					// Copied by this process, paste the copied items without parsing the data
+					if ( localBranch.blocks && localBranch.blocks->count() == count && localBranch.data == data
+						 && nif->canPasteBlocks( *localBranch.blocks ) )
+					{
+						nif->holdUpdates( true );
+						iRoot = nif->pasteBlocks( *localBranch.blocks, blockMap );
+
+						if ( nif->checkVersion( 0x14010001, 0 ) ) {
+							int first = nif->getBlockNumber( iRoot );
+							for ( int c = 0; c < count; c++ ) {
+								NiMesh::DataStreamMetadata metadata = {};
+								QString bType = nif->extractRTTIArgs( localBranch.types.value( c ), metadata );
+								QStringList strings = localBranch.strings.value( c );
+								deserializeStrings( nif, nif->getBlockIndex( first + c ), bType, strings );
+							}
+						}
+						nif->holdUpdates( false );
+
+						blockLink( nif, index, iRoot );
+
+						return iRoot;
+					}
+
 					nif->holdUpdates( true );
 					for ( int c = 0; c < count; c++ ) {
 						QString bType;
@@ -1684,17 +1735,14 @@ public:
 
 		QRegularExpression exp( match );
 
-		int n = 0;
-
-		while ( n < nif->getBlockCount() ) {
-			QModelIndex iBlock = nif->getBlockIndex( n );
-
-			if ( nif->itemName( iBlock ).indexOf( exp ) >= 0 )
-				nif->removeNiBlock( n );
-			else
-				n++;
+		QVector<qint32> remove;
+		for ( int n = 0; n < nif->getBlockCount(); n++ ) {
+			if ( nif->itemName( nif->getBlockIndex( n ) ).indexOf( exp ) >= 0 )
+				remove << n;
 		}
 
+		nif->removeNiBlocks( remove );
+
 		return QModelIndex();
 	}
 };
@@ -1737,18 +1785,14 @@ public:
 		QList<quint32> branch = getBranch( nif, nif->getBlockNumber( index ) );
 		//qDebug() << branch;
 		// remove non-branch blocks
-		int n = 0; // tracks the current block number in the new system (after some blocks have been removed already)
-		int m = 0; // tracks the block number in the old system i.e.  as they are numbered in the branch list
-
-		while ( n < nif->getBlockCount() ) {
-			if ( !branch.contains( m ) )
-				nif->removeNiBlock( n );
-			else
-				n++;
-
-			m++;
+		QVector<qint32> remove;
+		for ( int n = 0; n < nif->getBlockCount(); n++ ) {
+			if ( !branch.contains( n ) )
+				remove << n;
 		}
 
+		nif->removeNiBlocks( remove );
+
 		// done
 		return QModelIndex();
 	}
@@ -1834,22 +1878,12 @@ public:
 
 	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
 	{
-		// from spCopyBlock
-		QByteArray data;
-		QBuffer buffer( &data );
+		// Same file, the copied items need neither link nor string mapping
+		QModelIndex block = nif->pasteBlocks( *nif->copyBlocks( { nif->getBlockNumber( index ) } ), {} );
+		if ( block.isValid() )
+			blockLink( nif, nif->getBlockIndex( nif->getParent( nif->getBlockNumber( index ) ) ), block );
 
-		// Opening in ReadWrite doesn't work - race condition?
-		if ( buffer.open( QIODevice::WriteOnly ) && nif->saveIndex( buffer, index ) ) {
-			// from spPasteBlock
-			if ( buffer.open( QIODevice::ReadOnly ) ) {
-				QModelIndex block = nif->insertNiBlock( nif->itemName( index ), nif->getBlockCount() );
-				nif->loadIndex( buffer, block );
-				blockLink( nif, nif->getBlockIndex( nif->getParent( nif->getBlockNumber( index ) ) ), block );
-				return block;
-			}
-		}
-
-		return QModelIndex();
+		return block;
 	}
 };
 
@@ -1864,126 +1898,22 @@ bool spDuplicateBranch::isApplicable( const NifModel * nif, const QModelIndex &
 
 QModelIndex spDuplicateBranch::cast( NifModel * nif, const QModelIndex & index )
 {
-	// from spCopyBranch
 	QList<qint32> blocks;
 	populateBlocks( blocks, nif, nif->getBlockNumber( index ) );
 
+	// Links within the branch move to the copies, links to other blocks of the file are kept
 	QMap<qint32, qint32> blockMap;
-
 	for ( int b = 0; b < blocks.count(); b++ )
-		blockMap.insert( blocks[b], b );
-
-	QMap<qint32, QString> parentMap;
-	for ( const auto block : blocks )
-	{
-		for ( const auto link : nif->getParentLinks( block ) ) {
-			if ( !blocks.contains( link ) && !parentMap.contains( link ) ) {
-				QString failMessage = Spell::tr( "parent link invalid" );
-				QModelIndex iParent = nif->getBlockIndex( link );
-
-				if ( iParent.isValid() ) {
-					failMessage = Spell::tr( "parent unnamed" );
-					QString name = nif->get<QString>( iParent, "Name" );
-
-					if ( !name.isEmpty() ) {
-						parentMap.insert( link, nif->itemName( iParent ) + NAME_SEP + name );
-						continue;
-					}
-				}
-
-				Message::append( tr( B_ERR ).arg( name() ),
-								 tr( "failed to map parent link %1 %2 for block %3 %4; %5." )
-									.arg( link )
-									.arg( nif->itemName( nif->getBlockIndex( link ) ) )
-									.arg( block )
-									.arg( nif->itemName( nif->getBlockIndex( block ) ) )
-									.arg( failMessage ),
-								 QMessageBox::Critical
-				);
-				return index;
-			}
-		}
-	}
+		blockMap.insert( blocks[b], nif->getBlockCount() + b );
 
-	QByteArray data;
-	QBuffer buffer( &data );
+	nif->holdUpdates( true );
+	QModelIndex iRoot = nif->pasteBlocks( *nif->copyBlocks( blocks ), blockMap );
+	nif->holdUpdates( false );
 
-	if ( buffer.open( QIODevice::WriteOnly ) ) {
-		QDataStream ds( &buffer );
-		ds << blocks.count();
-		ds << blockMap;
-		ds << parentMap;
-		for ( const auto block : blocks ) {
-			ds << nif->itemName( nif->getBlockIndex( block ) );
-
-			if ( !nif->saveIndex( buffer, nif->getBlockIndex( block ) ) ) {
-				Message::append( tr( B_ERR ).arg( name() ),
-								 tr( "failed to save block %1 %2." ).arg( block )
-									.arg( nif->itemName( nif->getBlockIndex( block ) ) ),
-								 QMessageBox::Critical
-				);
-				return index;
-			}
-		}
-	}
-
-	// from spPasteBranch
-	if ( buffer.open( QIODevice::ReadOnly ) ) {
-		QDataStream ds( &buffer );
-
-		int count;
-		ds >> count;
-
-		QMap<qint32, qint32> blockMap;
-		ds >> blockMap;
-		QMutableMapIterator<qint32, qint32> ibm( blockMap );
-
-		while ( ibm.hasNext() ) {
-			ibm.next();
-			ibm.value() += nif->getBlockCount();
-		}
-
-		QMap<qint32, QString> parentMap;
-		ds >> parentMap;
-
-		QMapIterator<qint32, QString> ipm( parentMap );
-
-		while ( ipm.hasNext() ) {
-			ipm.next();
-			qint32 block = getBlockByName( nif, ipm.value() );
-
-			if ( block >= 0 ) {
-				blockMap.insert( ipm.key(), block );
-			} else {
-				Message::append( tr( B_ERR ).arg( name() ),
-								 tr( "failed to map parent link %1" ).arg( ipm.value() ),
-								 QMessageBox::Critical
-				);
-				return index;
-			}
-		}
-
-		QModelIndex iRoot;
-		nif->holdUpdates( true );
-		for ( int c = 0; c < count; c++ ) {
-			QString type;
-			ds >> type;
-
-			QModelIndex block = nif->insertNiBlock( type, -1 );
-
-			if ( !nif->loadAndMapLinks( buffer, block, blockMap ) )
-				return index;
-
-			if ( c == 0 )
-				iRoot = block;
-		}
-		nif->holdUpdates( false );
+	if ( iRoot.isValid() )
 		blockLink( nif, nif->getBlockIndex( nif->getParent( nif->getBlockNumber( index ) ) ), iRoot );
 
-		return iRoot;
-	}
-
-	return QModelIndex();
+	return iRoot;
 }
 
 REGISTER_SPELL( spDuplicateBranch )
@@ -2122,7 +2052,7 @@ public:
 	{
 		int blockNum = nif->getBlockNumber( index );
 
-		QVector<int> parents;
+		QVector<int> parents = nif->getChildRefs( blockNum ).toVector();
 		QVector<int> children;
 		for ( int i = 0; i < nif->getBlockCount(); i++ ) {
 			if ( i == blockNum )
@@ -2131,10 +2061,6 @@ public:
 			auto parentLinks = nif->getParentLinks( i );
 			if ( parentLinks.contains( blockNum ) )
 				children << i;
-
-			auto childLinks = nif->getChildLinks( i );
-			if ( childLinks.contains( blockNum ) )
-				parents << i;
 		}
 
 		int refCount = parents.count() + children.count();
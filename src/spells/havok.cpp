@@ -3,16 +3,21 @@
 #include "gl/gltools.h"
 #include "spells/blocks.h"
 
+#include "lib/convexdecomposition.h"
 #include "lib/nvtristripwrapper.h"
 #include "lib/qhull.h"
 
+#include <QCheckBox>
 #include <QDialog>
 #include <QDoubleSpinBox>
+#include <QElapsedTimer>
+#include <QGridLayout>
 #include <QLabel>
 #include <QLayout>
 #include <QMap>
 #include <QMessageBox>
 #include <QPushButton>
+#include <QSpinBox>
 
 #include <algorithm> // std::sort
 
@@ -27,6 +32,218 @@
 //! For Havok coordinate transforms
 static const float havokConst = 7.0;
 
+//! Havok units per NIF unit for the version of a file
+static float shapeHavokScale( const NifModel * nif )
+{
+	float havokScale = (nif->checkVersion( 0x14020007, 0x14020007 ) && nif->getUserVersion() >= 12) ? 10.0f : 1.0f;
+
+	return havokScale * havokConst;
+}
+
+//! Vertices of a shape, transformed into the space of its parent
+static QVector<Vector3> shapeVertices( const NifModel * nif, const QModelIndex & index, const QModelIndex & iData )
+{
+	QVector<Vector3> verts;
+
+	if ( nif->getBSVersion() < 100 ) {
+		verts = nif->getArray<Vector3>( iData, "Vertices" );
+	} else {
+		int numVerts = nif->get<int>( index, "Num Vertices" );
+		verts.reserve( numVerts );
+		for ( int i = 0; i < numVerts; i++ )
+			verts += nif->get<Vector3>( nif->index( i, 0, iData ), "Vertex" );
+	}
+
+	// Offset by translation of NiTriShape
+	Transform transform;
+	transform.translation = nif->get<Vector3>( index, "Translation" );
+	transform.rotation = nif->get<Matrix>( index, "Rotation" );
+	transform.scale = nif->get<float>( index, "Scale" );
+
+	QVector<Vector3> vertsTrans;
+	vertsTrans.reserve( verts.count() );
+	for ( auto v : verts ) {
+		vertsTrans.append( transform * v );
+	}
+
+	return vertsTrans;
+}
+
+//! Triangles of a shape, with strips triangulated
+static QVector<Triangle> shapeTriangles( const NifModel * nif, const QModelIndex & index, const QModelIndex & iData )
+{
+	if ( nif->getBSVersion() >= 100 )
+		return nif->getArray<Triangle>( index, "Triangles" );
+
+	if ( !nif->isNiBlock( iData, "NiTriStripsData" ) )
+		return nif->getArray<Triangle>( iData, "Triangles" );
+
+	QVector<Triangle> tris;
+	QModelIndex iPoints = nif->getIndex( iData, "Points" );
+	for ( int x = 0; x < nif->rowCount( iPoints ); x++ ) {
+		tris += triangulate( nif->getArray<quint16>( iPoints.child( x, 0 ) ) );
+	}
+
+	return tris;
+}
+
+//! Creates a bhkConvexVerticesShape from hull vertices and planes in NIF units
+static QModelIndex createConvexShape( NifModel * nif, const QVector<Vector4> & hullVerts, const QVector<Vector4> & hullNorms,
+	float havokScale, float radius )
+{
+	/* those will be filled with the CVS data */
+	QVector<Vector4> convex_verts, convex_norms;
+
+	// sort and remove duplicate vertices
+	QList<Vector4> sortedVerts;
+	for ( Vector4 vert : hullVerts ) {
+		vert /= havokScale;
+
+		if ( !sortedVerts.contains( vert ) ) {
+			sortedVerts.append( vert );
+		}
+	}
+	std::sort( sortedVerts.begin(), sortedVerts.end(), Vector4::lexLessThan );
+	QListIterator<Vector4> vertIter( sortedVerts );
+
+	while ( vertIter.hasNext() ) {
+		Vector4 sorted = vertIter.next();
+		convex_verts.append( sorted );
+	}
+
+	// sort and remove duplicate normals
+	QList<Vector4> sortedNorms;
+	for ( Vector4 norm : hullNorms ) {
+		norm = Vector4( Vector3( norm ), norm[3] / havokScale );
+
+		if ( !sortedNorms.contains( norm ) ) {
+			sortedNorms.append( norm );
+		}
+	}
+	std::sort( sortedNorms.begin(), sortedNorms.end(), Vector4::lexLessThan );
+	QListIterator<Vector4> normIter( sortedNorms );
+
+	while ( normIter.hasNext() ) {
+		Vector4 sorted = normIter.next();
+		convex_norms.append( sorted );
+	}
+
+	/* create the CVS block */
+	QModelIndex iCVS = nif->insertNiBlock( "bhkConvexVerticesShape" );
+
+	/* set CVS verts */
+	nif->set<uint>( iCVS, "Num Vertices", convex_verts.count() );
+	nif->updateArraySize( iCVS, "Vertices" );
+	nif->setArray<Vector4>( iCVS, "Vertices", convex_verts );
+
+	/* set CVS norms */
+	nif->set<uint>( iCVS, "Num Normals", convex_norms.count() );
+	nif->updateArraySize( iCVS, "Normals" );
+	nif->setArray<Vector4>( iCVS, "Normals", convex_norms );
+
+	// radius is always 0.1?
+	// TODO: Figure out if radius is not arbitrarily set in vanilla NIFs
+	nif->set<float>( iCVS, "Radius", radius );
+
+	return iCVS;
+}
+
+//! Sets the sub shapes of a bhkListShape or bhkConvexListShape
+static void setSubShapes( NifModel * nif, const QModelIndex & iListShape, const QVector<qint32> & shapeLinks )
+{
+	nif->set<uint>( iListShape, "Num Sub Shapes", shapeLinks.size() );
+	nif->updateArraySize( iListShape, "Sub Shapes" );
+	nif->setLinkArray( iListShape, "Sub Shapes", shapeLinks );
+	if ( nif->isNiBlock( iListShape, "bhkListShape" ) ) {
+		nif->set<uint>( iListShape, "Num Unknown Ints", shapeLinks.size() );
+		nif->updateArraySize( iListShape, "Unknown Ints" );
+	}
+}
+
+/*! Links new shapes to the collision of the parent of a shape
+ *
+ * The collision object and rigid body are created when missing. When the rigid body already
+ * has a shape, the user chooses between adding the new shapes to it as a list and replacing it.
+ * Several new shapes are always combined into a list of type @p listType.
+ *
+ * @return The rigid body
+ */
+static QModelIndex attachShapes( NifModel * nif, const QModelIndex & index, const QVector<qint32> & newShapes,
+	const QString & listType = "bhkListShape" )
+{
+	QModelIndex iParent = nif->getBlockIndex( nif->getParent( nif->getBlockNumber( index ) ) );
+	QModelIndex collisionLink = nif->getIndex( iParent, "Collision Object" );
+	QModelIndex collisionObject = nif->getBlockIndex( nif->getLink( collisionLink ) );
+
+	// create bhkCollisionObject
+	if ( !collisionObject.isValid() ) {
+		collisionObject = nif->insertNiBlock( "bhkCollisionObject" );
+
+		nif->setLink( collisionLink, nif->getBlockNumber( collisionObject ) );
+		nif->setLink( collisionObject, "Target", nif->getBlockNumber( iParent ) );
+	}
+
+	QModelIndex rigidBodyLink = nif->getIndex( collisionObject, "Body" );
+	QPersistentModelIndex rigidBody = nif->getBlockIndex( nif->getLink( rigidBodyLink ) );
+
+	// create bhkRigidBody
+	if ( !rigidBody.isValid() ) {
+		rigidBody = nif->insertNiBlock( "bhkRigidBody" );
+
+		nif->setLink( rigidBodyLink, nif->getBlockNumber( rigidBody ) );
+	}
+
+	QPersistentModelIndex shapeLink = nif->getIndex( rigidBody, "Shape" );
+	QPersistentModelIndex shape = nif->getBlockIndex( nif->getLink( shapeLink ) );
+
+	QVector<qint32> shapeLinks;
+	bool replace = true;
+	if ( shape.isValid() ) {
+		shapeLinks = { nif->getBlockNumber( shape ) };
+
+		QString questionTitle = Spell::tr( "Create List Shape" );
+		QString questionBody = Spell::tr( "This collision object already has a shape. Combine into a list shape? 'No' will replace the shape." );
+
+		bool isListShape = false;
+		if ( nif->isNiBlock( shape, { "bhkListShape", "bhkConvexListShape" } ) ) {
+			isListShape = true;
+			questionTitle = Spell::tr( "Add to List Shape" );
+			questionBody = Spell::tr( "This collision object already has a list shape. Add to list shape? 'No' will replace the list shape." );
+			shapeLinks = nif->getLinkArray( shape, "Sub Shapes" );
+		}
+
+		int response = QMessageBox::question( nullptr, questionTitle, questionBody,	QMessageBox::Yes, QMessageBox::No );
+		if ( response == QMessageBox::Yes ) {
+			QModelIndex iListShape = shape;
+			if ( !isListShape ) {
+				iListShape = nif->insertNiBlock( listType );
+				nif->setLink( shapeLink, nif->getBlockNumber( iListShape ) );
+			}
+
+			shapeLinks << newShapes;
+			setSubShapes( nif, iListShape, shapeLinks );
+			replace = false;
+		}
+	}
+
+	if ( replace ) {
+		qint32 newShape = newShapes.value( 0, -1 );
+		if ( newShapes.count() > 1 ) {
+			QModelIndex iListShape = nif->insertNiBlock( listType );
+			setSubShapes( nif, iListShape, newShapes );
+			newShape = nif->getBlockNumber( iListShape );
+		}
+
+		// Replace link
+		nif->setLink( shapeLink, newShape );
+		// Remove all old shapes
+		spRemoveBranch rm;
+		rm.castIfApplicable( nif, shape );
+	}
+
+	return rigidBody;
+}
+
 //! Creates a convex hull using Qhull
 class spCreateCVS final : public Spell
 {
@@ -56,38 +273,10 @@ public:
 		if ( !iData.isValid() )
 			return index;
 
-		float havokScale = (nif->checkVersion( 0x14020007, 0x14020007 ) && nif->getUserVersion() >= 12) ? 10.0f : 1.0f;
-
-		havokScale *= havokConst;
-
-		/* those will be filled with the CVS data */
-		QVector<Vector4> convex_verts, convex_norms;
+		float havokScale = shapeHavokScale( nif );
 
 		/* get the verts of our mesh */
-		QVector<Vector3> verts = nif->getArray<Vector3>( iData, "Vertices" );
-		QVector<Vector3> vertsTrans;
-
-		if ( nif->getBSVersion() < 100 ) {
-			verts = nif->getArray<Vector3>( iData, "Vertices" );
-		} else {
-			int numVerts = nif->get<int>( index, "Num Vertices" );
-			verts.reserve( numVerts );
-			for ( int i = 0; i < numVerts; i++ )
-				verts += nif->get<Vector3>( nif->index( i, 0, iData ), "Vertex" );
-		}
-
-		// Offset by translation of NiTriShape
-		Vector3 trans = nif->get<Vector3>( index, "Translation" );
-		Matrix rot = nif->get<Matrix>( index, "Rotation" );
-		float scale = nif->get<float>( index, "Scale" );
-		Transform transform;
-		transform.translation = trans;
-		transform.rotation = rot;
-		transform.scale = scale;
-
-		for ( auto v : verts ) {
-			vertsTrans.append( transform * v );
-		}
+		QVector<Vector3> vertsTrans = shapeVertices( nif, index, iData );
 
 		// to store results
 		QVector<Vector4> hullVerts, hullNorms;
@@ -137,135 +326,169 @@ public:
 		/* make a convex hull from it */
 		compute_convex_hull( vertsTrans, hullVerts, hullNorms, (float)precSpin->value() );
 
-		// sort and remove duplicate vertices
-		QList<Vector4> sortedVerts;
-		for ( Vector4 vert : hullVerts ) {
-			vert /= havokScale;
+		QPersistentModelIndex iCVS = createConvexShape( nif, hullVerts, hullNorms, havokScale, spnRadius->value() );
+		QModelIndex rigidBody = attachShapes( nif, index, { nif->getBlockNumber( iCVS ) } );
 
-			if ( !sortedVerts.contains( vert ) ) {
-				sortedVerts.append( vert );
-			}
-		}
-		std::sort( sortedVerts.begin(), sortedVerts.end(), Vector4::lexLessThan );
-		QListIterator<Vector4> vertIter( sortedVerts );
+		Message::info( nullptr,
+					   Spell::tr( "Created hull with %1 vertices, %2 normals" )
+						.arg( nif->get<int>( iCVS, "Num Vertices" ) )
+						.arg( nif->get<int>( iCVS, "Num Normals" ) ) 
+		);
 
-		while ( vertIter.hasNext() ) {
-			Vector4 sorted = vertIter.next();
-			convex_verts.append( sorted );
-		}
+		return (iCVS.isValid()) ? iCVS : rigidBody;
+	}
+};
 
-		// sort and remove duplicate normals
-		QList<Vector4> sortedNorms;
-		for ( Vector4 norm : hullNorms ) {
-			norm = Vector4( Vector3( norm ), norm[3] / havokScale );
+REGISTER_SPELL( spCreateCVS )
 
-			if ( !sortedNorms.contains( norm ) ) {
-				sortedNorms.append( norm );
-			}
-		}
-		std::sort( sortedNorms.begin(), sortedNorms.end(), Vector4::lexLessThan );
-		QListIterator<Vector4> normIter( sortedNorms );
+//! Creates a set of convex hulls approximating a concave mesh
+class spCreateConvexDecomposition final : public Spell
+{
+public:
+	QString name() const override final { return Spell::tr( "Create Convex Decomposition" ); }
+	QString page() const override final { return Spell::tr( "Havok" ); }
+
+	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final
+	{
+		if ( !(nif->blockInherits( index, "NiTriBasedGeom" ) || nif->blockInherits( index, "BSTriShape" ))
+			 || !nif->getBSVersion() )
+			return false;
+
+		QModelIndex iData = nif->getBlockIndex( nif->getLink( index, "Data" ) );
+		if ( !iData.isValid() && nif->getIndex( index, "Vertex Data" ).isValid() )
+			iData = index;
+
+		return iData.isValid() && nif->get<int>( iData, "Num Vertices" ) > 0;
+	}
+
+	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
+	{
+		QModelIndex iData = nif->getBlockIndex( nif->getLink( index, "Data" ) );
+		if ( !iData.isValid() )
+			iData = nif->getIndex( index, "Vertex Data" );
 
-		while ( normIter.hasNext() ) {
-			Vector4 sorted = normIter.next();
-			convex_norms.append( sorted );
+		if ( !iData.isValid() )
+			return index;
+
+		QVector<Vector3> verts = shapeVertices( nif, index, iData );
+		QVector<Triangle> tris = shapeTriangles( nif, index, iData );
+		if ( tris.isEmpty() ) {
+			Message::warning( nullptr, Spell::tr( "The shape has no triangles." ) );
+			return index;
 		}
 
-		/* create the CVS block */
-		QModelIndex iCVS = nif->insertNiBlock( "bhkConvexVerticesShape" );
+		// bhkConvexListShape only exists in Fallout 3
+		bool canConvexList = nif->getBSVersion() == 34;
 
-		/* set CVS verts */
-		nif->set<uint>( iCVS, "Num Vertices", convex_verts.count() );
-		nif->updateArraySize( iCVS, "Vertices" );
-		nif->setArray<Vector4>( iCVS, "Vertices", convex_verts );
+		QDialog dlg;
+		dlg.setWindowTitle( Spell::tr( "Create Convex Decomposition" ) );
 
-		/* set CVS norms */
-		nif->set<uint>( iCVS, "Num Normals", convex_norms.count() );
-		nif->updateArraySize( iCVS, "Normals" );
-		nif->setArray<Vector4>( iCVS, "Normals", convex_norms );
+		QGridLayout * grid = new QGridLayout;
+		dlg.setLayout( grid );
+		int row = 0;
 
-		// radius is always 0.1?
-		// TODO: Figure out if radius is not arbitrarily set in vanilla NIFs
-		nif->set<float>( iCVS, "Radius", spnRadius->value() );
+		ConvexDecomposition::Options opts;
 
-		QModelIndex iParent = nif->getBlockIndex( nif->getParent( nif->getBlockNumber( index ) ) );
-		QModelIndex collisionLink = nif->getIndex( iParent, "Collision Object" );
-		QModelIndex collisionObject = nif->getBlockIndex( nif->getLink( collisionLink ) );
+		auto addSpin = [&]( const QString & label, int min, int max, int value ) {
+			QSpinBox * spn = new QSpinBox;
+			spn->setRange( min, max );
+			spn->setValue( value );
+			grid->addWidget( new QLabel( label ), row, 0 );
+			grid->addWidget( spn, row++, 1 );
+			return spn;
+		};
 
-		// create bhkCollisionObject
-		if ( !collisionObject.isValid() ) {
-			collisionObject = nif->insertNiBlock( "bhkCollisionObject" );
+		// Also the limit of bhkConvexListShape sub shapes
+		QSpinBox * spnHulls = addSpin( Spell::tr( "Maximum hulls" ), 1, 64, opts.maxHulls );
+		QSpinBox * spnVerts = addSpin( Spell::tr( "Maximum vertices per hull" ), 4, 255, opts.maxVertices );
+		QSpinBox * spnResolution = addSpin( Spell::tr( "Voxel resolution" ), 16, 250, opts.resolution );
 
-			nif->setLink( collisionLink, nif->getBlockNumber( collisionObject ) );
-			nif->setLink( collisionObject, "Target", nif->getBlockNumber( iParent ) );
-		}
+		QDoubleSpinBox * spnConcavity = new QDoubleSpinBox;
+		spnConcavity->setRange( 0.0, 100.0 );
+		spnConcavity->setDecimals( 2 );
+		spnConcavity->setSingleStep( 0.5 );
+		spnConcavity->setValue( opts.maxConcavity * 100.0 );
+		spnConcavity->setSuffix( "%" );
+		grid->addWidget( new QLabel( Spell::tr( "Maximum concavity" ) ), row, 0 );
+		grid->addWidget( spnConcavity, row++, 1 );
 
-		QModelIndex rigidBodyLink = nif->getIndex( collisionObject, "Body" );
-		QModelIndex rigidBody = nif->getBlockIndex( nif->getLink( rigidBodyLink ) );
+		QDoubleSpinBox * spnRadius = new QDoubleSpinBox;
+		spnRadius->setRange( 0, 0.5 );
+		spnRadius->setDecimals( 4 );
+		spnRadius->setSingleStep( 0.001 );
+		spnRadius->setValue( 0.05 );
+		grid->addWidget( new QLabel( Spell::tr( "Collision Radius" ) ), row, 0 );
+		grid->addWidget( spnRadius, row++, 1 );
 
-		// create bhkRigidBody
-		if ( !rigidBody.isValid() ) {
-			rigidBody = nif->insertNiBlock( "bhkRigidBody" );
+		QCheckBox * chkConvexList = new QCheckBox( Spell::tr( "Use bhkConvexListShape (movable objects)" ) );
+		chkConvexList->setEnabled( canConvexList );
+		grid->addWidget( chkConvexList, row++, 0, 1, 2 );
 
-			nif->setLink( rigidBodyLink, nif->getBlockNumber( rigidBody ) );
-		}
+		QPushButton * btOk = new QPushButton( Spell::tr( "Ok" ) );
+		QObject::connect( btOk, &QPushButton::clicked, &dlg, &QDialog::accept );
 
-		QPersistentModelIndex shapeLink = nif->getIndex( rigidBody, "Shape" );
-		QPersistentModelIndex shape = nif->getBlockIndex( nif->getLink( shapeLink ) );
+		QPushButton * btCancel = new QPushButton( Spell::tr( "Cancel" ) );
+		QObject::connect( btCancel, &QPushButton::clicked, &dlg, &QDialog::reject );
 
-		QVector<qint32> shapeLinks;
-		bool replace = true;
-		if ( shape.isValid() ) {
-			shapeLinks = { nif->getBlockNumber( shape ) };
+		grid->addWidget( btOk, row, 0 );
+		grid->addWidget( btCancel, row, 1 );
 
-			QString questionTitle = tr( "Create List Shape" );
-			QString questionBody = tr( "This collision object already has a shape. Combine into a list shape? 'No' will replace the shape." );
+		if ( dlg.exec() != QDialog::Accepted )
+			return index;
 
-			bool isListShape = false;
-			if ( nif->blockInherits( shape, "bhkListShape" ) ) {
-				isListShape = true;
-				questionTitle = tr( "Add to List Shape" );
-				questionBody = tr( "This collision object already has a list shape. Add to list shape? 'No' will replace the list shape." );
-				shapeLinks = nif->getLinkArray( shape, "Sub Shapes" );
-			}
+		bool convexList = canConvexList && chkConvexList->isChecked();
 
-			int response = QMessageBox::question( nullptr, questionTitle, questionBody,	QMessageBox::Yes, QMessageBox::No );
-			if ( response == QMessageBox::Yes ) {
-				QModelIndex iListShape = shape;
-				if ( !isListShape ) {
-					iListShape = nif->insertNiBlock( "bhkListShape" );
-					nif->setLink( shapeLink, nif->getBlockNumber( iListShape ) );
-				}
+		opts.maxHulls = spnHulls->value();
+		opts.maxVertices = spnVerts->value();
+		opts.resolution = spnResolution->value();
+		opts.maxConcavity = spnConcavity->value() / 100.0;
 
-				shapeLinks << nif->getBlockNumber( iCVS );
-				nif->set<uint>( iListShape, "Num Sub Shapes", shapeLinks.size() );
-				nif->updateArraySize( iListShape, "Sub Shapes" );
-				nif->setLinkArray( iListShape, "Sub Shapes", shapeLinks );
-				nif->set<uint>( iListShape, "Num Unknown Ints", shapeLinks.size() );
-				nif->updateArraySize( iListShape, "Unknown Ints" );
-				replace = false;
-			}
-		} 
-		
-		if ( replace ) {
-			// Replace link
-			nif->setLink( shapeLink, nif->getBlockNumber( iCVS ) );
-			// Remove all old shapes
-			spRemoveBranch rm;
-			rm.castIfApplicable( nif, shape );
+		QElapsedTimer timer;
+		timer.start();
+
+		ConvexDecomposition::Result result = ConvexDecomposition::decompose( verts, tris, opts );
+		if ( result.hulls.isEmpty() ) {
+			Message::warning( nullptr, Spell::tr( "Could not decompose the mesh, it has no volume." ) );
+			return index;
+		}
+
+		float havokScale = shapeHavokScale( nif );
+		float radius = spnRadius->value();
+
+		QVector<qint32> shapes;
+		int numVerts = 0;
+		for ( const ConvexDecomposition::Hull & hull : result.hulls ) {
+			QVector<Vector4> hullVerts;
+			for ( const Vector3 & v : hull.vertices )
+				hullVerts.append( Vector4( v ) );
+
+			QModelIndex iCVS = createConvexShape( nif, hullVerts, hull.planes, havokScale, radius );
+			shapes << nif->getBlockNumber( iCVS );
+			numVerts += hullVerts.count();
 		}
 
+		QString listType = convexList ? "bhkConvexListShape" : "bhkListShape";
+		QModelIndex rigidBody = attachShapes( nif, index, shapes, listType );
+
+		// All sub shapes of a bhkConvexListShape share its radius
+		QModelIndex iShape = nif->getBlockIndex( nif->getLink( rigidBody, "Shape" ) );
+		if ( nif->isNiBlock( iShape, "bhkConvexListShape" ) )
+			nif->set<float>( iShape, "Radius", radius );
+
 		Message::info( nullptr,
-					   Spell::tr( "Created hull with %1 vertices, %2 normals" )
-						.arg( convex_verts.count() )
-						.arg( convex_norms.count() ) 
+					   Spell::tr( "Created %1 hulls with %2 vertices in %3 ms" )
+						.arg( result.hulls.count() )
+						.arg( numVerts )
+						.arg( timer.elapsed() ),
+					   Spell::tr( "The hulls exceed the voxelized mesh by %1% of its volume." )
+						.arg( result.volumeError() * 100.0, 0, 'f', 1 )
 		);
 
-		return (iCVS.isValid()) ? iCVS : rigidBody;
+		return rigidBody;
 	}
 };
 
-REGISTER_SPELL( spCreateCVS )
+REGISTER_SPELL( spCreateConvexDecomposition )
 
 //! Transforms Havok constraints
 class spConstraintHelper final : public Spell
@@ -1,5 +1,7 @@
 #include "mesh.h"
 #include "gl/gltools.h"
+#include "lib/vertexweld.h"
+#include "model/meshstreams.h"
 
 #include <QDialog>
 #include <QGridLayout>
@@ -504,33 +506,34 @@ public:
 
 			// detect the dublicates
 
-			QMap<quint16, quint16> map;
-
-			for ( int a = 0; a < numVerts; a++ ) {
-				Vector3 v = verts[a];
+			auto sameAttributes = [&]( int a, int b ) {
+				if ( norms.count() && !( norms[a] == norms[b] ) )
+					return false;
 
-				for ( int b = 0; b < a; b++ ) {
-					if ( !( v == verts[b] ) )
-						continue;
+				if ( colors.count() && !( colors[a] == colors[b] ) )
+					return false;
 
-					if ( norms.count() && !( norms[a] == norms[b] ) )
-						continue;
+				for ( int t = 0; t < texco.count(); t++ ) {
+					if ( !( texco[t][a] == texco[t][b] ) )
+						return false;
+				}
 
-					if ( colors.count() && !( colors[a] == colors[b] ) )
-						continue;
+				return true;
+			};
 
-					int t = 0;
+			QVector<int> group = weldVertices( verts, sameAttributes );
 
-					for ( t = 0; t < texco.count(); t++ ) {
-						if ( !( texco[t][a] == texco[t][b] ) )
-							break;
-					}
+			// every duplicate is replaced by the last vertex of its group
+			QVector<int> last( numVerts );
+			for ( int a = 0; a < numVerts; a++ )
+				last[group[a]] = a;
 
-					if ( t < texco.count() )
-						continue;
+			QMap<quint16, quint16> map;
 
+			for ( int b = 0; b < numVerts; b++ ) {
+				int a = last[group[b]];
+				if ( a != b )
 					map.insert( b, a );
-				}
 			}
 
 			//qDebug() << QString( Spell::tr("detected % duplicates") ).arg( map.count() );
@@ -691,22 +694,40 @@ public:
 
 	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
 	{
-		auto vertData = nif->getIndex( index, "Vertex Data" );
+		Job job;
+		if ( snapshot( nif, index, job ) ) {
+			compute( job );
+			commit( nif, job );
+		}
+
+		return index;
+	}
 
-		// Retrieve the verts
+	//! The vertices of a shape and the bounding sphere computed from them
+	struct Job
+	{
+		QPersistentModelIndex iShape;
 		QVector<Vector3> verts;
-		for ( int i = 0; i < nif->rowCount( vertData ); i++ ) {
-			verts << nif->get<Vector3>( vertData.child( i, 0 ), "Vertex" );
-		}
+		BoundSphere bounds;
+	};
 
-		if ( verts.isEmpty() )
-			return index;
+	static bool snapshot( const NifModel * nif, const QModelIndex & index, Job & job )
+	{
+		job.verts = MeshStreams( nif, nif->getIndex( index, "Vertex Data" ) ).positions();
+		job.iShape = index;
+		return !job.verts.isEmpty();
+	}
 
+	static void compute( Job & job )
+	{
 		// Creating a bounding sphere from the verts
-		BoundSphere bounds = BoundSphere( verts );
-		bounds.update( nif, index );
+		job.bounds = BoundSphere( job.verts );
+	}
 
-		return index;
+	static void commit( NifModel * nif, const Job & job )
+	{
+		BoundSphere bounds = job.bounds;
+		bounds.update( nif, job.iShape );
 	}
 };
 
@@ -740,9 +761,7 @@ public:
 				indices << idx;
 		}
 
-		for ( const QModelIndex& idx : indices ) {
-			updBounds.castIfApplicable( nif, idx );
-		}
+		castParallel<spUpdateBounds::Job>( nif, indices, spUpdateBounds::snapshot, spUpdateBounds::compute, spUpdateBounds::commit );
 
 		return QModelIndex();
 	}
@@ -1,5 +1,6 @@
 #include "misc.h"
-#include "model/undocommands.h"
+
+#include "gl/gltexdiskcache.h"
 
 #include <QFileDialog>
 
@@ -51,7 +52,8 @@ public:
 
 	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
 	{
-		nif->undoStack->push( new ArrayUpdateCommand( index, nif ) );
+		// SpellBook::cast records the undo step
+		nif->updateArraySize( index );
 		return index;
 	}
 };
@@ -154,6 +156,33 @@ public:
 
 REGISTER_SPELL( spFileOffset )
 
+//! Shows the memory held by the model and the item pool, and the texture disk cache figures
+class spMemoryStats final : public Spell
+{
+public:
+	QString name() const override final { return Spell::tr( "Memory Statistics" ); }
+	bool constant() const override final { return true; }
+
+	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final
+	{
+		return nif != nullptr;
+	}
+
+	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
+	{
+		QString stats = nif->memoryStats();
+
+		QString cacheStats = TexDiskCache::get()->stats();
+		if ( !cacheStats.isEmpty() )
+			stats += "\n" + cacheStats;
+
+		Message::info( nif->getWindow(), Spell::tr( "Memory statistics" ), stats );
+		return index;
+	}
+};
+
+REGISTER_SPELL( spMemoryStats )
+
 //! Exports the binary data of a binary row to a file
 class spExportBinary final : public Spell
 {
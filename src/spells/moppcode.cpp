@@ -1,176 +1,94 @@
 #include "spellbook.h"
 
+#include "lib/moppbuilder.h"
+#include "lib/nifmopp.h"
+
+#include <QElapsedTimer>
+#include <QMessageBox>
+
+#include <algorithm>
+
 
 // Brief description is deliberately not autolinked to class Spell
 /*! \file moppcode.cpp
  * \brief Havok MOPP spells
  *
- * Note that this code only works on the Windows platform due an external
- * dependency on the Havok SDK, with which NifMopp.dll is compiled.
+ * The codes are generated by MoppBuilder. On Windows, NifMopp.dll is used instead
+ * if it is found next to the executable, as it is compiled with the Havok SDK.
  *
  * Most classes here inherit from the Spell class.
  */
 
-// Need to include headers before testing this
-#ifdef Q_OS_WIN32
-
-// This code is only intended to be run with Win32 platform.
-
-extern "C" void * __stdcall SetDllDirectoryA( const char * lpPathName );
-extern "C" void * __stdcall LoadLibraryA( const char * lpModuleName );
-extern "C" void * __stdcall GetProcAddress ( void * hModule, const char * lpProcName );
-extern "C" void __stdcall FreeLibrary( void * lpModule );
-
-//! Interface to the external MOPP library
-class HavokMoppCode
+//! Shared by the MOPP spells
+namespace Mopp
 {
-private:
-	typedef int (__stdcall * fnGenerateMoppCode)( int nVerts, Vector3 const * verts, int nTris, Triangle const * tris );
-	typedef int (__stdcall * fnGenerateMoppCodeWithSubshapes)( int nShapes, int const * shapes, int nVerts, Vector3 const * verts, int nTris, Triangle const * tris );
-	typedef int (__stdcall * fnRetrieveMoppCode)( int nBuffer, char * buffer );
-	typedef int (__stdcall * fnRetrieveMoppScale)( float * value );
-	typedef int (__stdcall * fnRetrieveMoppOrigin)( Vector3 * value );
-
-	void * hMoppLib;
-	fnGenerateMoppCode GenerateMoppCode;
-	fnRetrieveMoppCode RetrieveMoppCode;
-	fnRetrieveMoppScale RetrieveMoppScale;
-	fnRetrieveMoppOrigin RetrieveMoppOrigin;
-	fnGenerateMoppCodeWithSubshapes GenerateMoppCodeWithSubshapes;
-
-public:
-	HavokMoppCode() : hMoppLib( 0 ), GenerateMoppCode( 0 ), RetrieveMoppCode( 0 ), RetrieveMoppScale( 0 ),
-		  RetrieveMoppOrigin( 0 ), GenerateMoppCodeWithSubshapes( 0 )
-	{
-	}
-
-	~HavokMoppCode()
+	//! Whether a block is a bhkMoppBvTreeShape of a version the MOPP code can be generated for
+	static bool isSupported( const NifModel * nif, const QModelIndex & index )
 	{
-		if ( hMoppLib )
-			FreeLibrary( hMoppLib );
-	}
+		if ( nif->getUserVersion() != 10 && nif->getUserVersion() != 11 )
+			return false;
 
-	bool Initialize()
-	{
-		if ( !hMoppLib ) {
-			SetDllDirectoryA( QCoreApplication::applicationDirPath().toLocal8Bit().constData() );
-			hMoppLib = LoadLibraryA( "NifMopp.dll" );
-			GenerateMoppCode   = (fnGenerateMoppCode)GetProcAddress( hMoppLib, "GenerateMoppCode" );
-			RetrieveMoppCode   = (fnRetrieveMoppCode)GetProcAddress( hMoppLib, "RetrieveMoppCode" );
-			RetrieveMoppScale  = (fnRetrieveMoppScale)GetProcAddress( hMoppLib, "RetrieveMoppScale" );
-			RetrieveMoppOrigin = (fnRetrieveMoppOrigin)GetProcAddress( hMoppLib, "RetrieveMoppOrigin" );
-			GenerateMoppCodeWithSubshapes = (fnGenerateMoppCodeWithSubshapes)GetProcAddress( hMoppLib, "GenerateMoppCodeWithSubshapes" );
+		if ( nif->isNiBlock( index, "bhkMoppBvTreeShape" ) ) {
+			return ( nif->checkVersion( 0x14000004, 0x14000005 )
+			         || nif->checkVersion( 0x14020007, 0x14020007 ) );
 		}
 
-		return (GenerateMoppCode && RetrieveMoppCode && RetrieveMoppScale && RetrieveMoppOrigin);
+		return false;
 	}
 
-	QByteArray CalculateMoppCode( QVector<Vector3> const & verts, QVector<Triangle> const & tris, Vector3 * origin, float * scale )
+	//! Number of sub shapes of the bhkPackedNiTriStripsShape below a bhkMoppBvTreeShape
+	static int subShapeCount( const NifModel * nif, const QModelIndex & ibhkMoppBvTreeShape )
 	{
-		QByteArray code;
-
-		if ( Initialize() ) {
-			int len = GenerateMoppCode( verts.size(), &verts[0], tris.size(), &tris[0] );
-
-			if ( len > 0 ) {
-				code.resize( len );
+		QModelIndex ibhkPackedNiTriStripsShape = nif->getBlockIndex( nif->getLink( ibhkMoppBvTreeShape, "Shape" ) );
+		if ( !nif->isNiBlock( ibhkPackedNiTriStripsShape, "bhkPackedNiTriStripsShape" ) )
+			return 0;
 
-				if ( 0 != RetrieveMoppCode( len, code.data() ) ) {
-					if ( scale )
-						RetrieveMoppScale( scale );
+		if ( nif->checkVersion( 0x14020007, 0x14020007 ) )
+			return nif->get<int>( nif->getBlockIndex( nif->getLink( ibhkPackedNiTriStripsShape, "Data" ) ), "Num Sub Shapes" );
 
-					if ( origin )
-						RetrieveMoppOrigin( origin );
-				} else {
-					code.clear();
-				}
-			}
-		}
-
-		return code;
+		return nif->get<int>( ibhkPackedNiTriStripsShape, "Num Sub Shapes" );
 	}
 
-	QByteArray CalculateMoppCode( QVector<int> const & subShapesVerts,
-	                              QVector<Vector3> const & verts,
-	                              QVector<Triangle> const & tris,
-	                              Vector3 * origin, float * scale )
+	/*! Ask whether to build codes for shapes with several sub shapes without NifMopp.dll
+	 *
+	 * MoppBuilder keys the triangles by index. For several sub shapes, that layout has not been
+	 * checked against the codes of the game or NifMopp.dll, which may key them by sub shape.
+	 *
+	 * @param shapes	Number of such shapes
+	 */
+	static bool confirmSubShapes( int shapes )
 	{
-		QByteArray code;
-
-		if ( Initialize() ) {
-			int len;
-
-			if ( GenerateMoppCodeWithSubshapes )
-				len = GenerateMoppCodeWithSubshapes( subShapesVerts.size(), &subShapesVerts[0], verts.size(), &verts[0], tris.size(), &tris[0] );
-			else
-				len = GenerateMoppCode( verts.size(), &verts[0], tris.size(), &tris[0] );
-
-			if ( len > 0 ) {
-				code.resize( len );
-
-				if ( 0 != RetrieveMoppCode( len, code.data() ) ) {
-					if ( scale )
-						RetrieveMoppScale( scale );
-
-					if ( origin )
-						RetrieveMoppOrigin( origin );
-				} else {
-					code.clear();
-				}
-			}
-		}
-
-		return code;
+		QString which = ( shapes == 1 ) ? Spell::tr( "The shape has several sub shapes." )
+			: Spell::tr( "%1 shapes have several sub shapes." ).arg( shapes );
+
+		return QMessageBox::question( nullptr, Spell::tr( "Update MOPP Code" ),
+			which + " " + Spell::tr( "Without NifMopp.dll, the MOPP code keys the triangles by their index, which is "
+				"only known to match the game for a single sub shape, so collisions with the other sub shapes may fail. "
+				"Generate the MOPP code anyway?" ),
+			QMessageBox::Yes | QMessageBox::No, QMessageBox::No ) == QMessageBox::Yes;
 	}
-}
-TheHavokCode;
 
-//! Update Havok MOPP for a given shape
-class spMoppCode final : public Spell
-{
-public:
-	QString name() const override final { return Spell::tr( "Update MOPP Code" ); }
-	QString page() const override final { return Spell::tr( "Havok" ); }
-
-	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final
-	{
-		if ( nif->getUserVersion() != 10 && nif->getUserVersion() != 11 )
-			return false;
-
-		if ( TheHavokCode.Initialize() ) {
-			//QModelIndex iData = nif->getBlockIndex( nif->getLink( index, "Data" ) );
-
-			if ( nif->isNiBlock( index, "bhkMoppBvTreeShape" ) ) {
-				return ( nif->checkVersion( 0x14000004, 0x14000005 )
-				         || nif->checkVersion( 0x14020007, 0x14020007 ) );
-			}
-		}
-
-		return false;
-	}
-
-	QModelIndex cast( NifModel * nif, const QModelIndex & iBlock ) override final
+	/*! Read the triangles of the bhkPackedNiTriStripsShape below a bhkMoppBvTreeShape
+	 *
+	 * The shape keys of the triangles are their indices. @p subshapeVerts receives the vertex
+	 * count of each sub shape, which only NifMopp.dll uses.
+	 *
+	 * @return	False, after telling the user why, if the shape has no usable geometry
+	 */
+	static bool getGeometry( const NifModel * nif, const QModelIndex & ibhkMoppBvTreeShape,
+		QVector<int> & subshapeVerts, QVector<Vector3> & verts, QVector<Triangle> & triangles )
 	{
-		if ( !TheHavokCode.Initialize() ) {
-			Message::critical( nullptr, Spell::tr( "Unable to locate NifMopp.dll" ) );
-			return iBlock;
-		}
-
-		QPersistentModelIndex ibhkMoppBvTreeShape = iBlock;
-
 		QModelIndex ibhkPackedNiTriStripsShape = nif->getBlockIndex( nif->getLink( ibhkMoppBvTreeShape, "Shape" ) );
 
 		if ( !nif->isNiBlock( ibhkPackedNiTriStripsShape, "bhkPackedNiTriStripsShape" ) ) {
 			Message::warning( nullptr, Spell::tr( "Only bhkPackedNiTriStripsShape is supported at this time." ) );
-			return iBlock;
+			return false;
 		}
 
 		QModelIndex ihkPackedNiTriStripsData = nif->getBlockIndex( nif->getLink( ibhkPackedNiTriStripsShape, "Data" ) );
 
 		if ( !nif->isNiBlock( ihkPackedNiTriStripsData, "hkPackedNiTriStripsData" ) )
-			return iBlock;
-
-		QVector<int> subshapeVerts;
+			return false;
 
 		if ( nif->checkVersion( 0x14000004, 0x14000005 ) ) {
 			int nSubShapes = nif->get<int>( ibhkPackedNiTriStripsShape, "Num Sub Shapes" );
@@ -190,8 +108,7 @@ public:
 			}
 		}
 
-		QVector<Vector3> verts = nif->getArray<Vector3>( ihkPackedNiTriStripsData, "Vertices" );
-		QVector<Triangle> triangles;
+		verts = nif->getArray<Vector3>( ihkPackedNiTriStripsData, "Vertices" );
 
 		int nTriangles = nif->get<int>( ihkPackedNiTriStripsData, "Num Triangles" );
 		QModelIndex iTriangles = nif->getIndex( ihkPackedNiTriStripsData, "Triangles" );
@@ -205,30 +122,119 @@ public:
 			Message::critical( nullptr, Spell::tr( "Insufficient data to calculate MOPP code" ),
 				Spell::tr("Vertices: %1, Triangles: %2").arg( !verts.isEmpty() ).arg( !triangles.isEmpty() )
 			);
-			return iBlock;
+			return false;
 		}
 
-		Vector3 origin;
-		float scale;
-		QByteArray moppcode = TheHavokCode.CalculateMoppCode( subshapeVerts, verts, triangles, &origin, &scale );
+		return true;
+	}
 
-		if ( moppcode.size() == 0 ) {
-			Message::critical( nullptr, Spell::tr( "Failed to generate MOPP code" ) );
-		} else {
-			auto iMoppCode = nif->getIndex( ibhkMoppBvTreeShape, "MOPP Code" );
+	//! Read the MOPP code stored in a bhkMoppBvTreeShape
+	static MoppBuilder::Code getCode( const NifModel * nif, const QModelIndex & ibhkMoppBvTreeShape )
+	{
+		auto iMoppCode = nif->getIndex( ibhkMoppBvTreeShape, "MOPP Code" );
+		Vector4 offset = nif->get<Vector4>( iMoppCode, "Offset" );
 
-			nif->set<Vector4>( nif->getIndex( iMoppCode, "Offset" ), Vector4(origin, scale) );
+		MoppBuilder::Code code;
+		code.origin = Vector3( offset );
+		code.scale = offset[3];
+		code.data = nif->get<QByteArray>( nif->getIndex( iMoppCode, "Data" ).child( 0, 0 ) );
+		return code;
+	}
+
+	static void setCode( NifModel * nif, const QModelIndex & ibhkMoppBvTreeShape, const MoppBuilder::Code & code )
+	{
+		auto iMoppCode = nif->getIndex( ibhkMoppBvTreeShape, "MOPP Code" );
+
+		nif->set<Vector4>( nif->getIndex( iMoppCode, "Offset" ), Vector4( code.origin, code.scale ) );
+
+		QModelIndex iCodeSize = nif->getIndex( iMoppCode, "Data Size" );
+		QModelIndex iCode = nif->getIndex( iMoppCode, "Data" ).child( 0, 0 );
+
+		if ( iCodeSize.isValid() && iCode.isValid() ) {
+			nif->set<int>( iCodeSize, code.data.size() );
+			nif->updateArraySize( iCode );
+			nif->set<QByteArray>( iCode, code.data );
+		}
+	}
+
+	static QString describe( const MoppBuilder::Stats & stats )
+	{
+		return Spell::tr( "%1 bytes, depth %2, %3 splits, %4 leaves" )
+			.arg( stats.codeSize ).arg( stats.depth ).arg( stats.nodes ).arg( stats.leaves );
+	}
 
-			QModelIndex iCodeSize = nif->getIndex( iMoppCode, "Data Size" );
-			QModelIndex iCode = nif->getIndex( iMoppCode, "Data" ).child( 0, 0 );
+	/*! Generate the MOPP code of a bhkMoppBvTreeShape
+	 *
+	 * @param allowSubShapes	Whether MoppBuilder may build the code of a shape with several sub shapes,
+	 *							see confirmSubShapes()
+	 * @param report			Receives the triangle count, the tree figures and the build time,
+	 *							or why the shape was skipped
+	 */
+	static bool update( NifModel * nif, const QModelIndex & ibhkMoppBvTreeShape, bool allowSubShapes, QString & report )
+	{
+		QVector<int> subshapeVerts;
+		QVector<Vector3> verts;
+		QVector<Triangle> triangles;
+		if ( !getGeometry( nif, ibhkMoppBvTreeShape, subshapeVerts, verts, triangles ) )
+			return false;
+
+		QElapsedTimer timer;
+		timer.start();
 
-			if ( iCodeSize.isValid() && iCode.isValid() ) {
-				nif->set<int>( iCodeSize, moppcode.size() );
-				nif->updateArraySize( iCode );
-				nif->set<QByteArray>( iCode, moppcode );
+		MoppBuilder::Code code;
+		QString source;
+		if ( NifMopp::isAvailable() ) {
+			code = NifMopp::build( subshapeVerts, verts, triangles );
+			source = Spell::tr( " by NifMopp.dll" );
+		} else {
+			if ( subshapeVerts.count() > 1 && !allowSubShapes ) {
+				report = Spell::tr( "[%1] skipped, %2 sub shapes" )
+					.arg( nif->getBlockNumber( ibhkMoppBvTreeShape ) ).arg( subshapeVerts.count() );
+				return false;
 			}
+
+			code = MoppBuilder::build( verts, triangles );
+			if ( subshapeVerts.count() > 1 )
+				source = Spell::tr( ", keyed by triangle index across %1 sub shapes" ).arg( subshapeVerts.count() );
 		}
 
+		qint64 elapsed = timer.elapsed();
+
+		if ( code.data.isEmpty() ) {
+			Message::critical( nullptr, Spell::tr( "Failed to generate MOPP code" ) );
+			return false;
+		}
+
+		setCode( nif, ibhkMoppBvTreeShape, code );
+
+		report = Spell::tr( "[%1] %2 triangles: %3, built in %4 ms%5" )
+			.arg( nif->getBlockNumber( ibhkMoppBvTreeShape ) ).arg( triangles.count() )
+			.arg( describe( code.stats ) ).arg( elapsed ).arg( source );
+		return true;
+	}
+}
+
+//! Update Havok MOPP for a given shape
+class spMoppCode final : public Spell
+{
+public:
+	QString name() const override final { return Spell::tr( "Update MOPP Code" ); }
+	QString page() const override final { return Spell::tr( "Havok" ); }
+
+	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final
+	{
+		return Mopp::isSupported( nif, index );
+	}
+
+	QModelIndex cast( NifModel * nif, const QModelIndex & iBlock ) override final
+	{
+		if ( !NifMopp::isAvailable() && Mopp::subShapeCount( nif, iBlock ) > 1 && !Mopp::confirmSubShapes( 1 ) )
+			return iBlock;
+
+		QString report;
+		if ( Mopp::update( nif, iBlock, true, report ) )
+			Message::info( nullptr, Spell::tr( "Updated MOPP code" ), report );
+
 		return iBlock;
 	}
 };
@@ -236,6 +242,9 @@ public:
 REGISTER_SPELL( spMoppCode )
 
 //! Update MOPP code on all shapes in this model
+/*!
+ * The report lists the triangle count, tree figures and build time of each shape.
+ */
 class spAllMoppCodes final : public Spell
 {
 public:
@@ -247,11 +256,9 @@ public:
 		if ( nif && nif->getUserVersion() != 10 && nif->getUserVersion() != 11 )
 			return false;
 
-		if ( TheHavokCode.Initialize() ) {
-			if ( nif && !idx.isValid() ) {
-				return ( nif->checkVersion( 0x14000004, 0x14000005 )
-				         || nif->checkVersion( 0x14020007, 0x14020007 ) );
-			}
+		if ( nif && !idx.isValid() ) {
+			return ( nif->checkVersion( 0x14000004, 0x14000005 )
+			         || nif->checkVersion( 0x14020007, 0x14020007 ) );
 		}
 
 		return false;
@@ -261,24 +268,76 @@ public:
 	{
 		QList<QPersistentModelIndex> indices;
 
-		spMoppCode TSpacer;
-
 		for ( int n = 0; n < nif->getBlockCount(); n++ ) {
 			QModelIndex idx = nif->getBlockIndex( n );
 
-			if ( TSpacer.isApplicable( nif, idx ) )
+			if ( Mopp::isSupported( nif, idx ) )
 				indices << idx;
 		}
 
+		// Ask once for all the shapes with several sub shapes
+		bool allowSubShapes = NifMopp::isAvailable();
+		if ( !allowSubShapes ) {
+			int shapes = int( std::count_if( indices.begin(), indices.end(), [nif]( const QPersistentModelIndex & idx ) {
+				return Mopp::subShapeCount( nif, idx ) > 1;
+			} ) );
+			allowSubShapes = shapes == 0 || Mopp::confirmSubShapes( shapes );
+		}
+
+		QStringList reports;
+		int updated = 0;
 		for ( const QModelIndex& idx : indices ) {
-			TSpacer.castIfApplicable( nif, idx );
+			QString report;
+			if ( Mopp::update( nif, idx, allowSubShapes, report ) )
+				updated++;
+			if ( !report.isEmpty() )
+				reports << report;
 		}
 
+		if ( !reports.isEmpty() )
+			Message::info( nullptr, Spell::tr( "Updated %1 MOPP codes" ).arg( updated ), reports.join( "\n" ) );
+
 		return QModelIndex();
 	}
 };
 
 REGISTER_SPELL( spAllMoppCodes )
 
-#endif // Q_OS_WIN32
+//! Check that the MOPP code of a shape reaches all of its triangles
+/*!
+ * Every vertex and center of a triangle is run as a point query through the code, which
+ * must return the triangle. Stale codes left behind by mesh edits fail the check.
+ */
+class spCheckMoppCode final : public Spell
+{
+public:
+	QString name() const override final { return Spell::tr( "Check MOPP Code" ); }
+	QString page() const override final { return Spell::tr( "Havok" ); }
+
+	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final
+	{
+		return Mopp::isSupported( nif, index );
+	}
+
+	QModelIndex cast( NifModel * nif, const QModelIndex & iBlock ) override final
+	{
+		QVector<int> subshapeVerts;
+		QVector<Vector3> verts;
+		QVector<Triangle> triangles;
+		if ( !Mopp::getGeometry( nif, iBlock, subshapeVerts, verts, triangles ) )
+			return iBlock;
+
+		QString error;
+		MoppBuilder::Stats stats;
+		if ( MoppBuilder::validate( Mopp::getCode( nif, iBlock ), verts, triangles, QVector<quint32>(), &error, &stats ) ) {
+			Message::info( nullptr, Spell::tr( "The MOPP code reaches all %1 triangles." ).arg( triangles.count() ),
+				Mopp::describe( stats ) );
+		} else {
+			Message::warning( nullptr, Spell::tr( "The MOPP code could not be verified: %1" ).arg( error ) );
+		}
+
+		return iBlock;
+	}
+};
 
+REGISTER_SPELL( spCheckMoppCode )
@@ -1,12 +1,15 @@
 #include "spellbook.h"
 
 #include "lib/nvtristripwrapper.h"
+#include "lib/vertexweld.h"
+#include "model/meshstreams.h"
 
 #include <QDialog>
 #include <QDoubleSpinBox>
 #include <QLabel>
 #include <QLayout>
 #include <QPushButton>
+#include <QSet>
 
 
 // Brief description is deliberately not autolinked to class Spell
@@ -57,28 +60,40 @@ public:
 
 	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
 	{
-		QModelIndex iData = getShapeData( nif, index );
+		Job job;
+		if ( snapshot( nif, index, job ) ) {
+			compute( job );
+			commit( nif, job );
+		}
 
-		auto faceNormals = []( const QVector<Vector3> & verts, const QVector<Triangle> & triangles, QVector<Vector3> & norms ) {
-			for ( const Triangle & tri : triangles ) {
-				Vector3 a = verts[tri[0]];
-				Vector3 b = verts[tri[1]];
-				Vector3 c = verts[tri[2]];
+		return index;
+	}
 
-				Vector3 fn = Vector3::crossproduct( b - a, c - a );
-				norms[tri[0]] += fn;
-				norms[tri[1]] += fn;
-				norms[tri[2]] += fn;
-			}
+	//! The geometry of a shape and the normals computed from it
+	struct Job
+	{
+		QPersistentModelIndex iData;
+		//! Whether the normals are a "Normals" array instead of part of the vertex data
+		bool hasArray = false;
 
-			for ( int n = 0; n < norms.count(); n++ ) {
-				norms[n].normalize();
-			}
-		};
+		QVector<Vector3> verts;
+		QVector<Triangle> triangles;
+
+		QVector<Vector3> norms;
+	};
+
+	//! Copy the vertices and triangles of a shape, false if it has no shape data
+	static bool snapshot( const NifModel * nif, const QModelIndex & index, Job & job )
+	{
+		QModelIndex iData = getShapeData( nif, index );
+		if ( !iData.isValid() )
+			return false;
+
+		job.iData = iData;
 
 		if ( nif->getBSVersion() < 100 ) {
-			QVector<Vector3> verts = nif->getArray<Vector3>( iData, "Vertices" );
-			QVector<Triangle> triangles;
+			job.hasArray = true;
+			job.verts = nif->getArray<Vector3>( iData, "Vertices" );
 			QModelIndex iPoints = nif->getIndex( iData, "Points" );
 
 			if ( iPoints.isValid() ) {
@@ -87,26 +102,16 @@ public:
 				for ( int r = 0; r < nif->rowCount( iPoints ); r++ )
 					strips.append( nif->getArray<quint16>( iPoints.child( r, 0 ) ) );
 
-				triangles = triangulate( strips );
+				job.triangles = triangulate( strips );
 			} else {
-				triangles = nif->getArray<Triangle>( iData, "Triangles" );
+				job.triangles = nif->getArray<Triangle>( iData, "Triangles" );
 			}
-
-
-			QVector<Vector3> norms( verts.count() );
-			
-			faceNormals( verts, triangles, norms );
-
-			nif->set<int>( iData, "Has Normals", 1 );
-			nif->updateArraySize( iData, "Normals" );
-			nif->setArray<Vector3>( iData, "Normals", norms );
 		} else {
-			QVector<Triangle> triangles;
 			int numVerts;
 			auto vf = nif->get<BSVertexDesc>( index, "Vertex Desc" );
 			if ( !((vf & VertexFlags::VF_SKINNED) && nif->getBSVersion() == 100) ) {
 				numVerts = nif->get<int>( index, "Num Vertices" );
-				triangles = nif->getArray<Triangle>( index, "Triangles" );
+				job.triangles = nif->getArray<Triangle>( index, "Triangles" );
 			} else {
 				// Skinned SSE
 				auto iPart = iData.parent();
@@ -116,43 +121,100 @@ public:
 				auto numParts = nif->get<int>( iPart, "Num Partitions" );
 				auto iParts = nif->getIndex( iPart, "Partitions" );
 				for ( int i = 0; i < numParts; i++ )
-					triangles << nif->getArray<Triangle>( iParts.child( i, 0 ), "Triangles" );
+					job.triangles << nif->getArray<Triangle>( iParts.child( i, 0 ), "Triangles" );
 			}
 
-			QVector<Vector3> verts;
-			verts.reserve( numVerts );
-			QVector<Vector3> norms( numVerts );
-
-			if ( nif->isNiBlock(index, "BSDynamicTriShape") ) {
-				auto dynVerts = nif->getArray<Vector4>(index, "Vertices");
-				verts.clear();
-				verts.reserve(numVerts);
+			if ( nif->isNiBlock( index, "BSDynamicTriShape" ) ) {
+				auto dynVerts = nif->getArray<Vector4>( index, "Vertices" );
+				job.verts.reserve( dynVerts.count() );
 				for ( const auto & v : dynVerts )
-					verts << Vector3(v);
+					job.verts << Vector3( v );
+				job.verts.resize( numVerts );
 			} else {
-				for ( int i = 0; i < numVerts; i++ ) {
-					auto idx = nif->index(i, 0, iData);
-
-					verts += nif->get<Vector3>(idx, "Vertex");
-				}
+				job.verts = MeshStreams( nif, iData, numVerts ).positions();
 			}
+		}
 
-			faceNormals( verts, triangles, norms );
+		return true;
+	}
 
-			// Pause updates between model/view
-			nif->setState( BaseModel::Processing );
-			for ( int i = 0; i < numVerts; i++ ) {
-				nif->set<ByteVector3>( nif->index( i, 0, iData ), "Normal", norms[i] );
-			}
-			nif->resetState();
+	//! Sum the face normals around each vertex; does not access the model
+	static void compute( Job & job )
+	{
+		const QVector<Vector3> & verts = job.verts;
+		QVector<Vector3> & norms = job.norms;
+		norms.fill( Vector3(), verts.count() );
+
+		for ( const Triangle & tri : job.triangles ) {
+			if ( tri[0] >= verts.count() || tri[1] >= verts.count() || tri[2] >= verts.count() )
+				continue;
+
+			Vector3 a = verts[tri[0]];
+			Vector3 b = verts[tri[1]];
+			Vector3 c = verts[tri[2]];
+
+			Vector3 fn = Vector3::crossproduct( b - a, c - a );
+			norms[tri[0]] += fn;
+			norms[tri[1]] += fn;
+			norms[tri[2]] += fn;
 		}
 
-		return index;
+		for ( int n = 0; n < norms.count(); n++ ) {
+			norms[n].normalize();
+		}
+	}
+
+	//! Write the normals to the model
+	static void commit( NifModel * nif, const Job & job )
+	{
+		if ( job.hasArray ) {
+			nif->set<int>( job.iData, "Has Normals", 1 );
+			nif->updateArraySize( job.iData, "Normals" );
+			nif->setArray<Vector3>( job.iData, "Normals", job.norms );
+		} else {
+			MeshStreams( nif, job.iData ).setNormals( job.norms );
+		}
 	}
 };
 
 REGISTER_SPELL( spFaceNormals )
 
+//! Recalculates and faces the normals of all meshes
+class spAllFaceNormals final : public Spell
+{
+public:
+	QString name() const override final { return Spell::tr( "Face All Normals" ); }
+	QString page() const override final { return Spell::tr( "Batch" ); }
+
+	bool isApplicable( const NifModel * nif, const QModelIndex & idx ) override final
+	{
+		return nif && !idx.isValid();
+	}
+
+	QModelIndex cast( NifModel * nif, const QModelIndex & ) override final
+	{
+		QList<QPersistentModelIndex> indices;
+		// A shape and its data block share the data, face it once
+		QSet<QModelIndex> shapeData;
+
+		for ( int n = 0; n < nif->getBlockCount(); n++ ) {
+			QModelIndex idx = nif->getBlockIndex( n );
+			QModelIndex iData = spFaceNormals::getShapeData( nif, idx );
+
+			if ( iData.isValid() && !shapeData.contains( iData ) ) {
+				shapeData.insert( iData );
+				indices << idx;
+			}
+		}
+
+		castParallel<spFaceNormals::Job>( nif, indices, spFaceNormals::snapshot, spFaceNormals::compute, spFaceNormals::commit );
+
+		return QModelIndex();
+	}
+};
+
+REGISTER_SPELL( spAllFaceNormals )
+
 //! Flip normals of a mesh, without recalculating them.
 class spFlipNormals final : public Spell
 {
@@ -218,15 +280,9 @@ public:
 				numVerts = nif->get<uint>( iPart, "Data Size" ) / nif->get<uint>( iPart, "Vertex Size" );
 			}
 
-			verts.reserve( numVerts );
-			norms.reserve( numVerts );
-
-			for ( int i = 0; i < numVerts; i++ ) {
-				auto idx = nif->index( i, 0, iData );
-
-				verts += nif->get<Vector3>( idx, "Vertex" );
-				norms += nif->get<ByteVector3>( idx, "Normal" );
-			}
+			MeshStreams streams( nif, iData, numVerts );
+			verts = streams.positions();
+			norms = streams.normals();
 		}
 
 		if ( nif->isNiBlock(index, "BSDynamicTriShape") ) {
@@ -283,21 +339,19 @@ public:
 
 		QVector<Vector3> snorms( norms );
 
-		for ( int i = 0; i < verts.count(); i++ ) {
-			const Vector3 & a = verts[i];
-			Vector3 an = norms[i];
+		// Neighbors are summed in ascending order, the same order as a pairwise loop over all vertices
+		VertexGrid grid( verts, maxd );
+		QVector<int> nearby;
 
-			for ( int j = i + 1; j < verts.count(); j++ ) {
-				const Vector3 & b = verts[j];
+		for ( int i = 0; i < verts.count(); i++ ) {
+			const Vector3 & an = norms[i];
 
-				if ( ( a - b ).squaredLength() < maxd ) {
-					Vector3 bn = norms[j];
+			grid.neighbors( i, nearby );
+			for ( int j : nearby ) {
+				const Vector3 & bn = norms[j];
 
-					if ( Vector3::angle( an, bn ) < maxa ) {
-						snorms[i] += bn;
-						snorms[j] += an;
-					}
-				}
+				if ( Vector3::angle( an, bn ) < maxa )
+					snorms[i] += bn;
 			}
 		}
 
@@ -307,11 +361,7 @@ public:
 		if ( nif->getBSVersion() < 100 ) {
 			nif->setArray<Vector3>( iData, "Normals", snorms );
 		} else {
-			// Pause updates between model/view
-			nif->setState( BaseModel::Processing );
-			for ( int i = 0; i < numVerts; i++ )
-				nif->set<ByteVector3>( nif->index( i, 0, iData ), "Normal", snorms[i] );
-			nif->resetState();
+			MeshStreams( nif, iData ).setNormals( snorms );
 		}
 		
 
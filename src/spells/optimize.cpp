@@ -5,11 +5,20 @@
 #include "spells/tangentspace.h"
 #include "spells/transform.h"
 
+#include "gl/gltools.h"
+#include "lib/meshoptimize.h"
+#include "model/meshstreams.h"
+
 #include <QBuffer>
+#include <QCheckBox>
+#include <QCryptographicHash>
+#include <QDialog>
+#include <QGridLayout>
 #include <QMessageBox>
+#include <QPushButton>
+#include <QSet>
 
 #include <algorithm> // std::sort
-#include <functional> //std::greater
 
 
 // Brief description is deliberately not autolinked to class Spell
@@ -100,11 +109,7 @@ public:
 			if ( !map.isEmpty() ) {
 				numRemoved += map.count();
 				nif->mapLinks( map );
-				QList<qint32> l = map.keys();
-				std::sort( l.begin(), l.end(), std::greater<qint32>() );
-				for ( const auto b : l ) {
-					nif->removeNiBlock( b );
-				}
+				nif->removeNiBlocks( map.keys().toVector() );
 			}
 		} while ( !map.isEmpty() );
 
@@ -495,6 +500,359 @@ public:
 
 REGISTER_SPELL( spCombiTris )
 
+//! Merges shapes with the same render state into as few draw calls as possible
+/*!
+ * Unlike spCombiTris, the shapes may be anywhere below the node and may be BSTriShapes.
+ * Transforms are baked into the vertices, unless a node on the way is animated, collides,
+ * carries extra data or switches between its children; such nodes are batched on their own.
+ *
+ * Shapes are grouped by a hash of their render state: flags, vertex format and the contents
+ * of their properties. Blocks linked from the properties, such as texture sets, must be shared.
+ */
+class spBatchShapes final : public Spell
+{
+public:
+	QString name() const override final { return Spell::tr( "Merge Shapes by Material" ); }
+	QString page() const override final { return Spell::tr( "Optimize" ); }
+
+	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final
+	{
+		return nif && ( !index.isValid() || nif->blockInherits( index, "NiNode" ) );
+	}
+
+	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
+	{
+		QPersistentModelIndex iIndex = index;
+		int before = countShapes( nif );
+
+		QList<QPersistentModelIndex> roots;
+		if ( index.isValid() ) {
+			roots << index;
+		} else {
+			for ( const auto l : nif->getRootLinks() ) {
+				QModelIndex iRoot = nif->getBlockIndex( l );
+				if ( nif->blockInherits( iRoot, "NiNode" ) )
+					roots << iRoot;
+			}
+		}
+
+		for ( const QPersistentModelIndex & iRoot : roots )
+			batch( nif, iRoot );
+
+		Message::info( nullptr, Spell::tr( "Shapes in the file: %1 before, %2 after." ).arg( before ).arg( countShapes( nif ) ) );
+
+		return iIndex;
+	}
+
+private:
+	//! Shape and its transform relative to the node being batched
+	struct Candidate
+	{
+		QPersistentModelIndex iShape;
+		Transform transform;
+		int numVerts;
+		int numTris;
+	};
+
+	static int countShapes( const NifModel * nif )
+	{
+		int count = 0;
+		for ( int b = 0; b < nif->getBlockCount(); b++ ) {
+			if ( nif->blockInherits( nif->getBlockIndex( b ), { "NiTriBasedGeom", "BSTriShape" } ) )
+				count++;
+		}
+		return count;
+	}
+
+	//! Whether the shapes below a node may be moved to its parent
+	static bool canBake( const NifModel * nif, const QModelIndex & iNode )
+	{
+		return nif->isNiBlock( iNode, { "NiNode", "BSFadeNode" } )
+			&& nif->getLink( iNode, "Controller" ) == -1
+			&& nif->getLink( iNode, "Collision Object" ) == -1
+			&& nif->getLinkArray( iNode, "Extra Data List" ).isEmpty();
+	}
+
+	//! Hash of a property, by value; the blocks it links to are compared by number
+	static QByteArray propertyKey( const NifModel * nif, qint32 link )
+	{
+		QModelIndex iBlock = nif->getBlockIndex( link );
+		if ( !iBlock.isValid() )
+			return QByteArray();
+
+		// An animated property cannot be shared with another shape's copy of it
+		if ( nif->getLink( iBlock, "Controller" ) != -1 )
+			return QByteArray( "#" ) + QByteArray::number( link );
+
+		QBuffer data;
+		data.open( QBuffer::WriteOnly );
+		data.write( nif->itemName( iBlock ).toLatin1() );
+		nif->saveIndex( data, iBlock );
+
+		return QCryptographicHash::hash( data.buffer(), QCryptographicHash::Sha1 );
+	}
+
+	//! Hash of the render state of a shape, empty if the shape cannot be merged
+	static QByteArray materialKey( const NifModel * nif, const QModelIndex & iShape, int & numVerts, int & numTris )
+	{
+		if ( nif->getLink( iShape, "Controller" ) != -1 || nif->getLink( iShape, "Collision Object" ) != -1 )
+			return QByteArray();
+
+		QCryptographicHash hash( QCryptographicHash::Sha1 );
+		hash.addData( nif->itemName( iShape ).toLatin1() );
+		hash.addData( QByteArray::number( nif->get<quint32>( iShape, "Flags" ) ) );
+
+		if ( nif->isNiBlock( iShape, "NiTriShape" ) ) {
+			qint32 lData = nif->getLink( iShape, "Data" );
+			QModelIndex iData = nif->getBlockIndex( lData, "NiTriShapeData" );
+			if ( !iData.isValid() || nif->getChildRefs( lData ).count() > 1
+				 || nif->getLink( iShape, "Skin Instance" ) != -1
+				 || nif->getLink( iData, "Additional Data" ) != -1
+				 || nif->rowCount( nif->getIndex( iData, "Match Groups" ) ) > 0 )
+				return QByteArray();
+
+			QVector<qint32> lProps = nif->getLinkArray( iShape, "Properties" );
+			lProps << nif->getLink( iShape, "Shader Property" ) << nif->getLink( iShape, "Alpha Property" );
+			lProps.removeAll( -1 );
+
+			// Anything else attached, such as extra data, prevents merging
+			for ( const auto l : nif->getChildLinks( nif->getBlockNumber( iShape ) ) ) {
+				QModelIndex iBlock = nif->getBlockIndex( l );
+				if ( l == lData || lProps.contains( l ) )
+					continue;
+				if ( nif->isNiBlock( iBlock, "NiBinaryExtraData" ) && nif->get<QString>( iBlock, "Name" ) == "Tangent space (binormal & tangent vectors)" )
+					continue;
+				return QByteArray();
+			}
+
+			QList<QByteArray> propKeys;
+			for ( const auto l : lProps )
+				propKeys << propertyKey( nif, l );
+			std::sort( propKeys.begin(), propKeys.end() );
+			for ( const QByteArray & k : propKeys )
+				hash.addData( k );
+
+			for ( const char * name : { "Normals", "Tangents", "Bitangents", "Vertex Colors" } )
+				hash.addData( nif->rowCount( nif->getIndex( iData, name ) ) > 0 ? "1" : "0" );
+			hash.addData( QByteArray::number( nif->rowCount( nif->getIndex( iData, "UV Sets" ) ) ) );
+			for ( const char * name : { "Data Flags", "BS Data Flags", "Consistency Flags" } )
+				hash.addData( QByteArray::number( nif->get<int>( iData, name ) ) );
+
+			numVerts = nif->get<int>( iData, "Num Vertices" );
+			numTris = nif->rowCount( nif->getIndex( iData, "Triangles" ) );
+		} else if ( nif->isNiBlock( iShape, "BSTriShape" ) ) {
+			if ( nif->getLink( iShape, "Skin" ) != -1
+				 || !nif->getLinkArray( iShape, "Extra Data List" ).isEmpty()
+				 || !nif->getIndex( iShape, "Vertex Data" ).isValid()
+				 || nif->get<uint>( iShape, "Particle Data Size" ) != 0 )
+				return QByteArray();
+
+			hash.addData( QByteArray::number( nif->get<BSVertexDesc>( iShape, "Vertex Desc" ).Value() ) );
+			hash.addData( propertyKey( nif, nif->getLink( iShape, "Shader Property" ) ) );
+			hash.addData( propertyKey( nif, nif->getLink( iShape, "Alpha Property" ) ) );
+
+			numVerts = nif->get<int>( iShape, "Num Vertices" );
+			numTris = nif->rowCount( nif->getIndex( iShape, "Triangles" ) );
+		} else {
+			return QByteArray();
+		}
+
+		if ( numVerts <= 0 || numTris <= 0 )
+			return QByteArray();
+
+		return hash.result();
+	}
+
+	//! Gather the shapes below a node by material key, and the nodes to batch on their own
+	static void collect( const NifModel * nif, const QModelIndex & iNode, const Transform & parent,
+		QHash<QByteArray, QVector<Candidate>> & groups, QList<QByteArray> & keys, QList<QPersistentModelIndex> & subRoots )
+	{
+		qint32 lNode = nif->getBlockNumber( iNode );
+		bool isSwitch = nif->blockInherits( iNode, { "NiSwitchNode", "NiLODNode" } );
+
+		for ( const auto l : nif->getLinkArray( iNode, "Children" ) ) {
+			QModelIndex iChild = nif->getBlockIndex( l );
+			if ( !iChild.isValid() || nif->getParent( l ) != lNode )
+				continue;
+
+			// Hidden
+			if ( nif->get<quint32>( iChild, "Flags" ) & 1 )
+				continue;
+
+			if ( nif->blockInherits( iChild, "NiNode" ) ) {
+				if ( !isSwitch && canBake( nif, iChild ) )
+					collect( nif, iChild, parent * Transform( nif, iChild ), groups, keys, subRoots );
+				else
+					subRoots << iChild;
+				continue;
+			}
+
+			// The children of switch nodes are alternatives
+			if ( isSwitch )
+				continue;
+
+			Candidate c{ iChild, parent * Transform( nif, iChild ), 0, 0 };
+			QByteArray key = materialKey( nif, iChild, c.numVerts, c.numTris );
+			if ( key.isEmpty() )
+				continue;
+
+			if ( !groups.contains( key ) )
+				keys << key;
+			groups[key] << c;
+		}
+	}
+
+	//! Bake the transform of a shape relative to @p iRoot into its vertices
+	static void bake( NifModel * nif, const Candidate & c )
+	{
+		c.transform.writeBack( nif, c.iShape );
+		spApplyTransformation().cast( nif, c.iShape );
+	}
+
+	//! Append the vertices and triangles of BSTriShape @p iB to @p iA, which has the same vertex desc
+	static void combineBSTriShapes( NifModel * nif, const QModelIndex & iA, const QModelIndex & iB )
+	{
+		int numA = nif->get<int>( iA, "Num Vertices" );
+		int numB = nif->get<int>( iB, "Num Vertices" );
+
+		QVector<Triangle> tris = nif->getArray<Triangle>( iA, "Triangles" );
+		for ( Triangle t : nif->getArray<Triangle>( iB, "Triangles" ) ) {
+			t[0] += numA;
+			t[1] += numA;
+			t[2] += numA;
+			tris << t;
+		}
+
+		// Both vertex arrays serialize to the same layout, so load them into the enlarged array in one go
+		QBuffer data;
+		data.open( QBuffer::WriteOnly );
+		nif->saveIndex( data, nif->getIndex( iA, "Vertex Data" ) );
+		nif->saveIndex( data, nif->getIndex( iB, "Vertex Data" ) );
+		data.close();
+
+		auto desc = nif->get<BSVertexDesc>( iA, "Vertex Desc" );
+		nif->set<int>( iA, "Num Vertices", numA + numB );
+		nif->set<uint>( iA, "Num Triangles", tris.count() );
+		nif->set<uint>( iA, "Data Size", desc.GetVertexSize() * (numA + numB) + 6 * tris.count() );
+		nif->updateArraySize( iA, "Vertex Data" );
+		nif->updateArraySize( iA, "Triangles" );
+
+		data.open( QBuffer::ReadOnly );
+		nif->loadIndex( data, nif->getIndex( iA, "Vertex Data" ) );
+		nif->setArray<Triangle>( iA, "Triangles", tris );
+	}
+
+	/*! The blocks below @p shapes that nothing else links to, together with @p shapes
+	 *
+	 * A block is owned once every block linking to it is owned. Unlike spRemoveBranch, which follows
+	 * getParent(), this keeps blocks such as a BSShaderTextureSet that a kept shader shares
+	 * with the shader of a removed shape, whichever of the two has the lower block number.
+	 */
+	static QVector<qint32> ownedBlocks( const NifModel * nif, const QList<QPersistentModelIndex> & shapes )
+	{
+		QSet<qint32> owned;
+		QVector<qint32> todo;
+		for ( const QPersistentModelIndex & iShape : shapes ) {
+			qint32 l = nif->getBlockNumber( iShape );
+			if ( l >= 0 && !owned.contains( l ) ) {
+				owned.insert( l );
+				todo << l;
+			}
+		}
+
+		// A child shared by two owned blocks is checked again when the second one is visited
+		while ( !todo.isEmpty() ) {
+			qint32 block = todo.takeLast();
+			for ( const auto child : nif->getChildLinks( block ) ) {
+				if ( owned.contains( child ) )
+					continue;
+
+				const QList<int> refs = nif->getChildRefs( child );
+				bool all = std::all_of( refs.begin(), refs.end(), [&owned]( int r ) { return owned.contains( r ); } );
+				if ( all ) {
+					owned.insert( child );
+					todo << child;
+				}
+			}
+		}
+
+		return owned.values().toVector();
+	}
+
+	static void batch( NifModel * nif, const QPersistentModelIndex & iRoot )
+	{
+		QHash<QByteArray, QVector<Candidate>> groups;
+		QList<QByteArray> keys;
+		QList<QPersistentModelIndex> subRoots;
+		collect( nif, iRoot, Transform(), groups, keys, subRoots );
+
+		QList<QPersistentModelIndex> remove;
+		for ( const QByteArray & key : keys ) {
+			const QVector<Candidate> & group = groups[key];
+
+			// Split into batches that 16-bit indices and counts can address
+			QVector<QVector<Candidate>> batches( 1 );
+			int numVerts = 0, numTris = 0;
+			for ( const Candidate & c : group ) {
+				if ( numVerts + c.numVerts > 0xFFFF || numTris + c.numTris > 0xFFFF ) {
+					batches.append( QVector<Candidate>() );
+					numVerts = numTris = 0;
+				}
+				batches.last() << c;
+				numVerts += c.numVerts;
+				numTris += c.numTris;
+			}
+
+			for ( const QVector<Candidate> & shapes : batches ) {
+				if ( shapes.count() < 2 )
+					continue;
+
+				const Candidate & a = shapes.first();
+				bool isTriShape = nif->isNiBlock( a.iShape, "NiTriShape" );
+
+				// The merged shape lives directly below the root
+				qint32 lA = nif->getBlockNumber( a.iShape );
+				QModelIndex iParent = nif->getBlockIndex( nif->getParent( lA ) );
+				if ( iParent != iRoot ) {
+					delLink( nif, iParent, "Children", lA );
+					addLink( nif, iRoot, "Children", lA );
+				}
+				bake( nif, a );
+
+				for ( int s = 1; s < shapes.count(); s++ ) {
+					const Candidate & b = shapes.at( s );
+					bake( nif, b );
+
+					if ( isTriShape )
+						spCombiTris().combine( nif, a.iShape, b.iShape );
+					else
+						combineBSTriShapes( nif, a.iShape, b.iShape );
+
+					qint32 lB = nif->getBlockNumber( b.iShape );
+					delLink( nif, nif->getBlockIndex( nif->getParent( lB ) ), "Children", lB );
+					remove << b.iShape;
+				}
+
+				if ( isTriShape ) {
+					spTangentSpace().castIfApplicable( nif, a.iShape );
+				} else {
+					BoundSphere bounds( MeshStreams( nif, nif->getIndex( a.iShape, "Vertex Data" ) ).positions() );
+					bounds.update( nif, a.iShape );
+				}
+			}
+		}
+
+		nif->removeNiBlocks( ownedBlocks( nif, remove ) );
+
+		for ( const QPersistentModelIndex & iNode : subRoots ) {
+			if ( iNode.isValid() )
+				batch( nif, iNode );
+		}
+	}
+};
+
+REGISTER_SPELL( spBatchShapes )
+
 
 void scan( const QModelIndex & idx, NifModel * nif, QMap<QString, qint32> & usedStrings, bool hasCED )
 {
@@ -582,3 +940,299 @@ public:
 };
 
 REGISTER_SPELL( spRemoveUnusedStrings )
+
+
+//! Reorders triangles for the post-transform vertex cache, and vertices for fetch locality
+/*!
+ * Shapes whose segments or LOD levels are ranges of triangles (BSSubIndexTriShape,
+ * BSMeshLODTriShape, BSLODTriShape) are not supported. Vertices of skinned shapes
+ * and of shapes with controllers are not reordered, as the skin data or the morphs
+ * refer to them by number.
+ *
+ * \sa spOptimizeAllVertexCaches
+ */
+class spOptimizeVertexCache final : public Spell
+{
+public:
+	QString name() const override final { return Spell::tr( "Optimize Vertex Cache" ); }
+	QString page() const override final { return Spell::tr( "Mesh" ); }
+
+	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final
+	{
+		return canOptimize( nif, index );
+	}
+
+	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
+	{
+		Options opts;
+		if ( !getOptions( opts ) )
+			return index;
+
+		MeshOptimize::CacheStats before, after;
+		optimize( nif, index, opts, before, after );
+		report( before, after );
+
+		return index;
+	}
+
+	struct Options
+	{
+		bool overdraw = true;
+		bool vertices = true;
+	};
+
+	//! Ask the user for the options, false if cancelled
+	static bool getOptions( Options & opts );
+
+	static bool canOptimize( const NifModel * nif, const QModelIndex & index )
+	{
+		if ( nif->isNiBlock( index, "NiTriShape" ) )
+			return nif->getBlockIndex( nif->getLink( index, "Data" ), "NiTriShapeData" ).isValid();
+
+		return nif->isNiBlock( index, { "BSTriShape", "BSDynamicTriShape" } );
+	}
+
+	//! Optimize a shape, adding the cache statistics of its triangles to @p before and @p after
+	static void optimize( NifModel * nif, const QModelIndex & index, const Options & opts, MeshOptimize::CacheStats & before, MeshOptimize::CacheStats & after );
+
+	static void report( const MeshOptimize::CacheStats & before, const MeshOptimize::CacheStats & after )
+	{
+		Message::info( nullptr, Spell::tr( "Vertex cache optimized for %1 triangles. ACMR: %2 to %3, ATVR: %4 to %5." )
+			.arg( after.triangles )
+			.arg( before.acmr(), 0, 'f', 3 ).arg( after.acmr(), 0, 'f', 3 )
+			.arg( before.atvr(), 0, 'f', 3 ).arg( after.atvr(), 0, 'f', 3 )
+		);
+	}
+
+private:
+	static void optimizeTriangles( QVector<Triangle> & tris, int numVerts, const QVector<Vector3> & positions, const Options & opts, MeshOptimize::CacheStats & before, MeshOptimize::CacheStats & after )
+	{
+		before += MeshOptimize::analyzeVertexCache( tris, numVerts );
+
+		tris = MeshOptimize::optimizeVertexCache( tris, numVerts );
+		if ( opts.overdraw && positions.count() == numVerts )
+			tris = MeshOptimize::optimizeOverdraw( tris, positions );
+
+		after += MeshOptimize::analyzeVertexCache( tris, numVerts );
+	}
+
+	static void optimizePartitions( NifModel * nif, const QModelIndex & iSkinPart, const QVector<Vector3> & positions, bool globalIndices, const Options & opts, MeshOptimize::CacheStats & before, MeshOptimize::CacheStats & after );
+};
+
+bool spOptimizeVertexCache::getOptions( Options & opts )
+{
+	QDialog dlg;
+	dlg.setWindowTitle( Spell::tr( "Optimize Vertex Cache" ) );
+
+	QGridLayout * grid = new QGridLayout;
+	dlg.setLayout( grid );
+
+	QCheckBox * overdraw = new QCheckBox( Spell::tr( "Reduce overdraw" ) );
+	overdraw->setChecked( opts.overdraw );
+	grid->addWidget( overdraw, 0, 0, 1, 2 );
+
+	QCheckBox * vertices = new QCheckBox( Spell::tr( "Reorder vertices (breaks external morphs such as .tri files)" ) );
+	vertices->setChecked( opts.vertices );
+	grid->addWidget( vertices, 1, 0, 1, 2 );
+
+	QPushButton * btOk = new QPushButton( Spell::tr( "Optimize" ) );
+	QObject::connect( btOk, &QPushButton::clicked, &dlg, &QDialog::accept );
+
+	QPushButton * btCancel = new QPushButton( Spell::tr( "Cancel" ) );
+	QObject::connect( btCancel, &QPushButton::clicked, &dlg, &QDialog::reject );
+
+	grid->addWidget( btOk, 2, 0 );
+	grid->addWidget( btCancel, 2, 1 );
+
+	if ( dlg.exec() != QDialog::Accepted )
+		return false;
+
+	opts.overdraw = overdraw->isChecked();
+	opts.vertices = vertices->isChecked();
+	return true;
+}
+
+void spOptimizeVertexCache::optimizePartitions( NifModel * nif, const QModelIndex & iSkinPart, const QVector<Vector3> & positions, bool globalIndices, const Options & opts, MeshOptimize::CacheStats & before, MeshOptimize::CacheStats & after )
+{
+	QModelIndex iParts = nif->getIndex( iSkinPart, "Partitions" );
+	for ( int p = 0; p < nif->rowCount( iParts ); p++ ) {
+		QModelIndex iPart = iParts.child( p, 0 );
+		QModelIndex iTris = nif->getIndex( iPart, "Triangles" );
+		if ( !iTris.isValid() || nif->get<int>( iPart, "Num Strips" ) != 0 )
+			continue;
+
+		QVector<Triangle> tris = nif->getArray<Triangle>( iTris );
+		QVector<Vector3> partPositions;
+		int numVerts;
+		if ( globalIndices ) {
+			partPositions = positions;
+			numVerts = positions.count();
+		} else {
+			// Partition triangles index the vertex map
+			numVerts = nif->get<int>( iPart, "Num Vertices" );
+			for ( int v : nif->getArray<int>( iPart, "Vertex Map" ) ) {
+				if ( v < 0 || v >= positions.count() )
+					break;
+				partPositions << positions.at( v );
+			}
+		}
+
+		// Keep the copy of the triangles in step, if it is one
+		QModelIndex iCopy = nif->getIndex( iPart, "Triangles Copy" );
+		bool hasCopy = iCopy.isValid() && nif->rowCount( iCopy ) > 0;
+		if ( hasCopy && nif->getArray<Triangle>( iCopy ) != tris )
+			continue;
+
+		optimizeTriangles( tris, numVerts, partPositions, opts, before, after );
+
+		nif->setArray<Triangle>( iTris, tris );
+		if ( hasCopy )
+			nif->setArray<Triangle>( iCopy, tris );
+	}
+}
+
+void spOptimizeVertexCache::optimize( NifModel * nif, const QModelIndex & index, const Options & opts, MeshOptimize::CacheStats & before, MeshOptimize::CacheStats & after )
+{
+	QPersistentModelIndex iShape = index;
+	bool hasController = nif->getLink( iShape, "Controller" ) != -1;
+
+	if ( nif->isNiBlock( iShape, "NiTriShape" ) ) {
+		QModelIndex iData = nif->getBlockIndex( nif->getLink( iShape, "Data" ), "NiTriShapeData" );
+		if ( !iData.isValid() )
+			return;
+
+		int numVerts = nif->get<int>( iData, "Num Vertices" );
+		QVector<Vector3> verts = nif->getArray<Vector3>( iData, "Vertices" );
+		QVector<Triangle> tris = nif->getArray<Triangle>( iData, "Triangles" );
+
+		bool skinned = false;
+		QModelIndex iSkin = nif->getBlockIndex( nif->getLink( iShape, "Skin Instance" ) );
+		if ( iSkin.isValid() ) {
+			skinned = true;
+			QModelIndex iSkinPart = nif->getBlockIndex( nif->getLink( iSkin, "Skin Partition" ), "NiSkinPartition" );
+			if ( iSkinPart.isValid() )
+				optimizePartitions( nif, iSkinPart, verts, false, opts, before, after );
+		}
+
+		if ( tris.isEmpty() )
+			return;
+
+		optimizeTriangles( tris, numVerts, verts, opts, before, after );
+
+		bool reorder = opts.vertices && !skinned && !hasController && verts.count() == numVerts
+			&& nif->getLink( iData, "Additional Data" ) == -1;
+		if ( reorder ) {
+			QVector<int> order = MeshOptimize::optimizeVertexFetch( tris, numVerts );
+
+			for ( const char * name : { "Vertices", "Normals", "Tangents", "Bitangents", "Vertex Colors", "DIV2 Floats" } ) {
+				QModelIndex iArray = nif->getIndex( iData, name );
+				if ( iArray.isValid() && nif->rowCount( iArray ) == numVerts )
+					nif->reorderArray( iArray, order );
+			}
+
+			QModelIndex iUVSets = nif->getIndex( iData, "UV Sets" );
+			for ( int r = 0; r < nif->rowCount( iUVSets ); r++ )
+				nif->reorderArray( iUVSets.child( r, 0 ), order );
+
+			// Match groups list vertices by number
+			QVector<int> remap( numVerts );
+			for ( int i = 0; i < numVerts; i++ )
+				remap[order[i]] = i;
+
+			QModelIndex iGroups = nif->getIndex( iData, "Match Groups" );
+			for ( int g = 0; g < nif->rowCount( iGroups ); g++ ) {
+				QModelIndex iIndices = nif->getIndex( iGroups.child( g, 0 ), "Vertex Indices" );
+				QVector<quint16> indices = nif->getArray<quint16>( iIndices );
+				for ( quint16 & i : indices ) {
+					if ( i < numVerts )
+						i = quint16( remap[i] );
+				}
+				nif->setArray<quint16>( iIndices, indices );
+			}
+		}
+
+		nif->setArray<Triangle>( iData, "Triangles", tris );
+		return;
+	}
+
+	auto vf = nif->get<BSVertexDesc>( iShape, "Vertex Desc" );
+	if ( (vf & VertexFlags::VF_SKINNED) && nif->getBSVersion() == 100 ) {
+		// Skinned SSE, the partitions hold the vertex data and the triangles
+		auto iSkin = nif->getBlockIndex( nif->getLink( iShape, "Skin" ), "NiSkinInstance" );
+		auto iSkinPart = nif->getBlockIndex( nif->getLink( iSkin, "Skin Partition" ), "NiSkinPartition" );
+		if ( iSkinPart.isValid() ) {
+			QVector<Vector3> verts = MeshStreams( nif, nif->getIndex( iSkinPart, "Vertex Data" ) ).positions();
+			optimizePartitions( nif, iSkinPart, verts, true, opts, before, after );
+		}
+		return;
+	}
+
+	QModelIndex iVertData = nif->getIndex( iShape, "Vertex Data" );
+	int numVerts = nif->rowCount( iVertData );
+	QVector<Triangle> tris = nif->getArray<Triangle>( iShape, "Triangles" );
+	if ( tris.isEmpty() )
+		return;
+
+	bool isDynamic = nif->isNiBlock( iShape, "BSDynamicTriShape" );
+	QVector<Vector3> verts;
+	if ( isDynamic ) {
+		for ( const Vector4 & v : nif->getArray<Vector4>( iShape, "Vertices" ) )
+			verts << Vector3( v );
+	} else {
+		verts = MeshStreams( nif, iVertData ).positions();
+	}
+
+	optimizeTriangles( tris, numVerts, verts, opts, before, after );
+
+	// Dynamic shapes are facegen heads, and skinned bodies carry external .tri morphs,
+	//	both address their vertices by number
+	if ( opts.vertices && !isDynamic && !(vf & VertexFlags::VF_SKINNED) && !hasController ) {
+		QVector<int> order = MeshOptimize::optimizeVertexFetch( tris, numVerts );
+		nif->reorderArray( iVertData, order );
+	}
+
+	nif->setArray<Triangle>( iShape, "Triangles", tris );
+}
+
+REGISTER_SPELL( spOptimizeVertexCache )
+
+
+//! Optimizes the vertex cache of all shapes
+class spOptimizeAllVertexCaches final : public Spell
+{
+public:
+	QString name() const override final { return Spell::tr( "Optimize Vertex Cache on All Shapes" ); }
+	QString page() const override final { return Spell::tr( "Optimize" ); }
+
+	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final
+	{
+		return nif && !index.isValid();
+	}
+
+	QModelIndex cast( NifModel * nif, const QModelIndex & ) override final
+	{
+		QList<QPersistentModelIndex> shapes;
+		for ( int n = 0; n < nif->getBlockCount(); n++ ) {
+			QModelIndex idx = nif->getBlockIndex( n );
+			if ( spOptimizeVertexCache::canOptimize( nif, idx ) )
+				shapes << idx;
+		}
+
+		if ( shapes.isEmpty() )
+			return QModelIndex();
+
+		spOptimizeVertexCache::Options opts;
+		if ( !spOptimizeVertexCache::getOptions( opts ) )
+			return QModelIndex();
+
+		MeshOptimize::CacheStats before, after;
+		for ( const QPersistentModelIndex & idx : shapes )
+			spOptimizeVertexCache::optimize( nif, idx, opts, before, after );
+
+		spOptimizeVertexCache::report( before, after );
+
+		return QModelIndex();
+	}
+};
+
+REGISTER_SPELL( spOptimizeAllVertexCaches )
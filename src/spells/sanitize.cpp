@@ -351,6 +351,33 @@ public:
 
 REGISTER_SPELL( spSanityCheckLinks )
 
+/*! Evaluates every cond and vercond of the file again
+ *
+ * Editing the Arg, Condition or version columns of an item in the tree does not discard
+ * the results cached in the item and the items below it; this brings them up to date.
+ */
+class spRevalidateConditions final : public Spell
+{
+public:
+	QString name() const override final { return Spell::tr( "Revalidate Conditions" ); }
+	QString page() const override final { return Spell::tr( "Sanitize" ); }
+	bool constant() const override final { return true; }
+
+	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final
+	{
+		Q_UNUSED( nif );
+		return !index.isValid();
+	}
+
+	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
+	{
+		nif->revalidateConditions();
+		return index;
+	}
+};
+
+REGISTER_SPELL( spRevalidateConditions )
+
 //! Fixes invalid block names
 class spFixInvalidNames final : public Spell
 {
@@ -0,0 +1,324 @@
+#include "spellbook.h"
+
+#include "lib/meshsimplify.h"
+#include "model/meshstreams.h"
+
+#include <QCheckBox>
+#include <QDialog>
+#include <QDoubleSpinBox>
+#include <QGridLayout>
+#include <QLabel>
+#include <QPushButton>
+#include <QSpinBox>
+
+#include <algorithm>
+
+
+// Brief description is deliberately not autolinked to class Spell
+/*! \file simplify.cpp
+ * \brief Mesh simplification spells
+ *
+ * All classes here inherit from the Spell class.
+ */
+
+//! Shared by the simplification spells
+namespace Simplify
+{
+	//! Whether the triangles of a shape live in the shape or its NiTriShapeData alone
+	static bool canSimplify( const NifModel * nif, const QModelIndex & iShape )
+	{
+		if ( nif->blockInherits( iShape, "NiTriBasedGeom" ) ) {
+			if ( !nif->getBlockIndex( nif->getLink( iShape, "Data" ), "NiTriShapeData" ).isValid() )
+				return false;
+
+			// Partitions hold their own copy of the triangles
+			QModelIndex iSkin = nif->getBlockIndex( nif->getLink( iShape, "Skin Instance" ), "NiSkinInstance" );
+			return nif->getLink( iSkin, "Skin Partition" ) == -1;
+		}
+
+		if ( !nif->isNiBlock( iShape, { "BSTriShape", "BSMeshLODTriShape" } ) )
+			return false;
+
+		// Skinned SSE shapes keep the triangles in the partitions
+		auto vf = nif->get<BSVertexDesc>( iShape, "Vertex Desc" );
+		if ( (vf & VertexFlags::VF_SKINNED) && nif->getBSVersion() == 100 )
+			return false;
+
+		return nif->get<uint>( iShape, "Particle Data Size" ) == 0;
+	}
+
+	//! Read the triangles of a shape and the vertex attributes used for the collapse costs
+	static QVector<Triangle> getMesh( const NifModel * nif, const QModelIndex & iShape, MeshSimplify::Mesh & mesh )
+	{
+		if ( nif->blockInherits( iShape, "NiTriBasedGeom" ) ) {
+			QModelIndex iData = nif->getBlockIndex( nif->getLink( iShape, "Data" ), "NiTriShapeData" );
+
+			mesh.positions = nif->getArray<Vector3>( iData, "Vertices" );
+			mesh.normals = nif->getArray<Vector3>( iData, "Normals" );
+			mesh.colors = nif->getArray<Color4>( iData, "Vertex Colors" );
+
+			QModelIndex iUVSets = nif->getIndex( iData, "UV Sets" );
+			if ( nif->rowCount( iUVSets ) > 0 )
+				mesh.uvs = nif->getArray<Vector2>( iUVSets.child( 0, 0 ) );
+
+			// Keep the 4 largest weights of each vertex
+			QModelIndex iSkin = nif->getBlockIndex( nif->getLink( iShape, "Skin Instance" ), "NiSkinInstance" );
+			QModelIndex iSkinData = nif->getBlockIndex( nif->getLink( iSkin, "Data" ), "NiSkinData" );
+			QModelIndex iBones = nif->getIndex( iSkinData, "Bone List" );
+			int numVerts = mesh.positions.count();
+			if ( nif->rowCount( iBones ) > 0 ) {
+				mesh.boneIndices.fill( 0, numVerts * 4 );
+				mesh.boneWeights.fill( 0.0f, numVerts * 4 );
+
+				for ( int b = 0; b < nif->rowCount( iBones ); b++ ) {
+					QModelIndex iWeights = nif->getIndex( iBones.child( b, 0 ), "Vertex Weights" );
+					for ( int w = 0; w < nif->rowCount( iWeights ); w++ ) {
+						int v = nif->get<int>( iWeights.child( w, 0 ), "Index" );
+						float weight = nif->get<float>( iWeights.child( w, 0 ), "Weight" );
+						if ( v < 0 || v >= numVerts )
+							continue;
+
+						float * slots = mesh.boneWeights.data() + v * 4;
+						int s = int( std::min_element( slots, slots + 4 ) - slots );
+						if ( weight > slots[s] ) {
+							slots[s] = weight;
+							mesh.boneIndices[v * 4 + s] = b;
+						}
+					}
+				}
+			}
+
+			return nif->getArray<Triangle>( iData, "Triangles" );
+		}
+
+		MeshStreams streams( nif, nif->getIndex( iShape, "Vertex Data" ) );
+		mesh.positions = streams.positions();
+		if ( streams.has( "UV" ) )
+			mesh.uvs = streams.uvs();
+		if ( streams.has( "Normal" ) )
+			mesh.normals = streams.normals();
+		if ( streams.has( "Vertex Colors" ) )
+			mesh.colors = streams.colors();
+		if ( streams.has( "Bone Weights" ) ) {
+			mesh.boneWeights = streams.boneWeights();
+			for ( quint8 b : streams.boneIndices() )
+				mesh.boneIndices << b;
+		}
+
+		return nif->getArray<Triangle>( iShape, "Triangles" );
+	}
+
+	//! Replace the triangles of a shape, resizing the arrays if the count changed
+	static void setTriangles( NifModel * nif, const QModelIndex & iShape, const QVector<Triangle> & tris )
+	{
+		if ( nif->blockInherits( iShape, "NiTriBasedGeom" ) ) {
+			QModelIndex iData = nif->getBlockIndex( nif->getLink( iShape, "Data" ), "NiTriShapeData" );
+			nif->set<int>( iData, "Num Triangles", tris.count() );
+			nif->set<int>( iData, "Num Triangle Points", tris.count() * 3 );
+			nif->updateArraySize( iData, "Triangles" );
+			nif->setArray<Triangle>( iData, "Triangles", tris );
+			return;
+		}
+
+		auto desc = nif->get<BSVertexDesc>( iShape, "Vertex Desc" );
+		uint numVerts = nif->get<uint>( iShape, "Num Vertices" );
+		nif->set<uint>( iShape, "Num Triangles", tris.count() );
+		nif->set<uint>( iShape, "Data Size", desc.GetVertexSize() * numVerts + 6 * tris.count() );
+		nif->updateArraySize( iShape, "Triangles" );
+		nif->setArray<Triangle>( iShape, "Triangles", tris );
+	}
+
+	struct Options
+	{
+		//! Percentage of the triangles kept, per LOD level
+		int ratios[2] = { 50, 25 };
+		//! Error limit in percent of the mesh size, for Simplify Mesh
+		double error = 1.0;
+		bool lockBorders = false;
+	};
+
+	/*! Ask the user for the options, false if cancelled
+	 *
+	 * @param lods	Whether to ask for the two LOD ratios instead of one ratio, the error limit and the borders.
+	 *				The LODs collapse no edges, so the error limit and the borders do not apply to them.
+	 */
+	static bool getOptions( const QString & title, bool lods, Options & opts )
+	{
+		QDialog dlg;
+		dlg.setWindowTitle( title );
+
+		QGridLayout * grid = new QGridLayout;
+		dlg.setLayout( grid );
+		int row = 0;
+
+		auto addSpin = [&]( const QString & label, int min, int max, int value, const QString & suffix ) {
+			QSpinBox * spn = new QSpinBox;
+			spn->setRange( min, max );
+			spn->setValue( value );
+			spn->setSuffix( suffix );
+			grid->addWidget( new QLabel( label ), row, 0 );
+			grid->addWidget( spn, row++, 1 );
+			return spn;
+		};
+
+		QSpinBox * spnRatio1 = addSpin( lods ? Spell::tr( "LOD 1 triangles" ) : Spell::tr( "Triangles" ), 1, 100, opts.ratios[0], "%" );
+		QSpinBox * spnRatio2 = lods ? addSpin( Spell::tr( "LOD 2 triangles" ), 1, 100, opts.ratios[1], "%" ) : nullptr;
+		QDoubleSpinBox * spnError = nullptr;
+		if ( !lods ) {
+			spnError = new QDoubleSpinBox;
+			spnError->setRange( 0.01, 100.0 );
+			spnError->setSingleStep( 0.1 );
+			spnError->setValue( opts.error );
+			spnError->setSuffix( "%" );
+			grid->addWidget( new QLabel( Spell::tr( "Maximum error" ) ), row, 0 );
+			grid->addWidget( spnError, row++, 1 );
+		}
+
+		// Only edge collapses move borders, and Generate LODs leaves whole parts out instead
+		QCheckBox * chkBorders = nullptr;
+		if ( !lods ) {
+			chkBorders = new QCheckBox( Spell::tr( "Keep open borders in place" ) );
+			chkBorders->setChecked( opts.lockBorders );
+			grid->addWidget( chkBorders, row++, 0, 1, 2 );
+		}
+
+		QPushButton * btOk = new QPushButton( Spell::tr( "Simplify" ) );
+		QObject::connect( btOk, &QPushButton::clicked, &dlg, &QDialog::accept );
+
+		QPushButton * btCancel = new QPushButton( Spell::tr( "Cancel" ) );
+		QObject::connect( btCancel, &QPushButton::clicked, &dlg, &QDialog::reject );
+
+		grid->addWidget( btOk, row, 0 );
+		grid->addWidget( btCancel, row, 1 );
+
+		if ( dlg.exec() != QDialog::Accepted )
+			return false;
+
+		opts.ratios[0] = spnRatio1->value();
+		if ( spnRatio2 )
+			opts.ratios[1] = std::min( spnRatio2->value(), opts.ratios[0] );
+		if ( spnError )
+			opts.error = spnError->value();
+		if ( chkBorders )
+			opts.lockBorders = chkBorders->isChecked();
+		return true;
+	}
+}
+
+
+//! Generates the LOD levels of BSLODTriShape and BSMeshLODTriShape
+/*!
+ * These shapes draw the first "LOD0 Size" triangles at every distance, add the next "LOD1 Size"
+ * triangles closer up and the last "LOD2 Size" triangles at full detail. Each LOD is therefore a
+ * subset of the original triangles, and collapsed edges cannot be stored. The lower LODs leave out
+ * whole connected parts instead, the smallest first, so they never open holes in a surface.
+ * Use Simplify Mesh on a NiTriShape or BSTriShape to reduce a single surface.
+ */
+class spGenerateLODs final : public Spell
+{
+public:
+	QString name() const override final { return Spell::tr( "Generate LODs" ); }
+	QString page() const override final { return Spell::tr( "Mesh" ); }
+
+	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final
+	{
+		return nif->isNiBlock( index, { "BSLODTriShape", "BSMeshLODTriShape" } ) && Simplify::canSimplify( nif, index );
+	}
+
+	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
+	{
+		MeshSimplify::Mesh mesh;
+		QVector<Triangle> tris = Simplify::getMesh( nif, index, mesh );
+		if ( tris.isEmpty() )
+			return index;
+
+		// With a single part there is nothing to leave out, and the ratios would not change anything
+		if ( MeshSimplify::connectedParts( tris, mesh ).counts.count() < 2 ) {
+			Message::warning( nullptr, Spell::tr( "The shape is a single connected surface, so every LOD would draw all of its %1 triangles. "
+				"The lower LODs can only leave out whole parts. Use Simplify Mesh on a NiTriShape or BSTriShape to reduce a single surface." )
+				.arg( tris.count() ) );
+			return index;
+		}
+
+		Simplify::Options opts;
+		if ( !Simplify::getOptions( Spell::tr( "Generate LODs" ), true, opts ) )
+			return index;
+
+		QVector<int> targets;
+		for ( int ratio : opts.ratios )
+			targets << tris.count() * ratio / 100;
+
+		QVector<int> sizes;
+		tris = MeshSimplify::nestedLods( tris, mesh, targets, sizes );
+
+		nif->setArray<Triangle>( nif->blockInherits( index, "NiTriBasedGeom" )
+			? nif->getIndex( nif->getBlockIndex( nif->getLink( index, "Data" ) ), "Triangles" )
+			: nif->getIndex( index, "Triangles" ), tris );
+
+		nif->set<uint>( index, "LOD0 Size", sizes.value( 0 ) );
+		nif->set<uint>( index, "LOD1 Size", sizes.value( 1 ) );
+		nif->set<uint>( index, "LOD2 Size", sizes.value( 2 ) );
+
+		int lod2 = sizes.value( 0 ), lod1 = lod2 + sizes.value( 1 );
+		if ( lod1 > targets.value( 0 ) || lod2 > targets.value( 1 ) ) {
+			Message::warning( nullptr, Spell::tr( "LOD 1 draws %1 triangles instead of %2, and LOD 2 %3 instead of %4. "
+				"Only whole connected parts are left out of the lower LODs, and the largest part always stays." )
+				.arg( lod1 ).arg( targets.value( 0 ) ).arg( lod2 ).arg( targets.value( 1 ) ) );
+		} else {
+			Message::info( nullptr, Spell::tr( "LOD 2 draws %1, LOD 1 %2 and LOD 0 all %3 triangles. Only whole connected parts are left out of the lower LODs." )
+				.arg( lod2 ).arg( lod1 ).arg( tris.count() ) );
+		}
+
+		return index;
+	}
+};
+
+REGISTER_SPELL( spGenerateLODs )
+
+
+//! Reduces the triangle count of a shape
+/*!
+ * The remaining triangles index the original vertices, which are left in place;
+ * use Remove Unused Vertices afterwards on NiTriShapes.
+ */
+class spSimplifyMesh final : public Spell
+{
+public:
+	QString name() const override final { return Spell::tr( "Simplify Mesh" ); }
+	QString page() const override final { return Spell::tr( "Mesh" ); }
+
+	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final
+	{
+		// The LOD shapes reference ranges of the triangles, Generate LODs handles those
+		return nif->isNiBlock( index, { "NiTriShape", "BSTriShape" } ) && Simplify::canSimplify( nif, index );
+	}
+
+	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
+	{
+		Simplify::Options opts;
+		if ( !Simplify::getOptions( Spell::tr( "Simplify Mesh" ), false, opts ) )
+			return index;
+
+		MeshSimplify::Mesh mesh;
+		QVector<Triangle> tris = Simplify::getMesh( nif, index, mesh );
+		if ( tris.isEmpty() )
+			return index;
+
+		MeshSimplify::Options simplifyOpts;
+		simplifyOpts.lockBorders = opts.lockBorders;
+
+		float error = 0.0f;
+		QVector<Triangle> result = MeshSimplify::simplify( tris, mesh, tris.count() * opts.ratios[0] / 100,
+			float( opts.error / 100.0 ), simplifyOpts, &error );
+
+		if ( result.count() != tris.count() )
+			Simplify::setTriangles( nif, index, result );
+
+		Message::info( nullptr, Spell::tr( "Simplified %1 triangles to %2, with an error of %3% of the mesh size." )
+			.arg( tris.count() ).arg( result.count() ).arg( error * 100.0f, 0, 'f', 2 ) );
+
+		return index;
+	}
+};
+
+REGISTER_SPELL( spSimplifyMesh )
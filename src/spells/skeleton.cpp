@@ -3,9 +3,11 @@
 #include "spellbook.h"
 #include "gl/gltools.h"
 
+#include "lib/bonepacking.h"
 #include "lib/nvtristripwrapper.h"
 
 #include <QCheckBox>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QGridLayout>
 #include <QLabel>
@@ -302,24 +304,41 @@ public:
 		}
 	};
 
-	//! A bone and Triangle set
-	typedef struct
+	//! Partitioning options, asked for when the bone limits are not set
+	struct Options
 	{
-		QList<int> bones;
-		QVector<Triangle> triangles;
-	} Partition;
+		int maxBonesPerPartition = 0;
+		int maxBonesPerVertex = 0;
+		bool makeStrips = false;
+		bool pad = false;
+		BonePacking::Mode mode = BonePacking::KeepAdjacent;
+	};
 
 	QModelIndex cast( NifModel * nif, const QModelIndex & iBlock ) override final
 	{
-		int mbpp = 0, mbpv = 0;
-		bool make_strips = false;
-		return cast( nif, iBlock, mbpp, mbpv, make_strips );
+		Options opts;
+		BonePacking::Stats stats;
+		QElapsedTimer timer;
+		timer.start();
+
+		QModelIndex iShape = cast( nif, iBlock, opts, &stats );
+
+		if ( stats.partitions > 0 )
+			Message::info( nullptr, Spell::tr( "Made %1 partitions." ).arg( stats.partitions ), report( stats, timer.elapsed() ) );
+
+		return iShape;
 	}
 
-	//! Cast with extra parameters
-	QModelIndex cast( NifModel * nif, const QModelIndex & iBlock, int & maxBonesPerPartition, int & maxBonesPerVertex, bool make_strips, bool pad = false )
+	/*! Cast with extra parameters
+	 *
+	 * @param opts	The options, the dialog fills them in when the bone limits are not set
+	 * @param stats	Accumulates the partitions made, if not null
+	 */
+	QModelIndex cast( NifModel * nif, const QModelIndex & iBlock, Options & opts, BonePacking::Stats * stats = nullptr )
 	{
 		QPersistentModelIndex iShape = iBlock;
+		int & maxBonesPerPartition = opts.maxBonesPerPartition;
+		int & maxBonesPerVertex = opts.maxBonesPerVertex;
 		QString iShapeType = "";
 
 		if ( nif->isNiBlock( iShape, "NiTriShape" ) ) {
@@ -392,8 +411,9 @@ public:
 
 				maxBonesPerPartition = dlg.maxBonesPerPartition();
 				maxBonesPerVertex = dlg.maxBonesPerVertex();
-				make_strips = dlg.makeStrips();
-				pad = dlg.padPartitions();
+				opts.makeStrips = dlg.makeStrips();
+				opts.pad = dlg.padPartitions();
+				opts.mode = dlg.minimizePartitions() ? BonePacking::MinimizeCount : BonePacking::KeepAdjacent;
 			}
 
 			// reduce vertex influences if necessary
@@ -534,252 +554,53 @@ public:
 				}
 			}
 
-			QMap<int, int> match;
-			bool doMatch = true;
-
-			QList<int> tribones;
-
-			int cnt = 0;
-
-			for ( const Triangle& tri : triangles )
-			{
-				do {
-					tribones.clear();
-
-					for ( int c = 0; c < 3; c++ ) {
-						for ( const auto bw : weights[tri[c]] ) {
-							if ( !tribones.contains( bw.first ) )
-								tribones.append( bw.first );
-						}
-					}
-
-					if ( tribones.count() > maxBonesPerPartition ) {
-						// sum up the weights for each bone
-						// bones with weight == 1 can't be removed
-
-						QMap<int, float> sum;
-						QList<int> nono;
-
-						for ( int t = 0; t < 3; t++ ) {
-							if ( weights[tri[t]].count() == 1 )
-								nono.append( weights[tri[t]].first().first );
-
-							for ( const auto bw : weights[tri[t]] ) {
-								sum[ bw.first ] += bw.second;
-							}
-						}
-
-						// select the bone to remove
-
-						float minWeight = 5.0;
-						int minBone = -1;
-
-						for ( const auto b : sum.keys() ) {
-							if ( !nono.contains( b ) && sum[b] < minWeight ) {
-								minWeight = sum[b];
-								minBone = b;
-							}
-						}
-
-						if ( minBone < 0 )  // this shouldn't never happen
-							throw QString( "internal error 0x01" );
-
-						// do a vertex match detect
-
-						if ( doMatch ) {
-							QVector<Vector3> verts = nif->getArray<Vector3>( iData, "Vertices" );
-
-							for ( int a = 0; a < verts.count(); a++ ) {
-								match.insertMulti( a, a );
-
-								for ( int b = a + 1; b < verts.count(); b++ ) {
-									if ( verts[a] == verts[b] && weights[a] == weights[b] ) {
-										match.insertMulti( a, b );
-										match.insertMulti( b, a );
-									}
-								}
-							}
-						}
-
-						// now remove that bone from all vertices of this triangle and from all matching vertices too
-
-						for ( int t = 0; t < 3; t++ ) {
-							bool rem = false;
-							for ( const auto v : match.values( tri[t] ) )
-							{
-								QList<boneweight> & bws = weights[ v ];
-								QMutableListIterator<boneweight> it( bws );
-
-								while ( it.hasNext() ) {
-									boneweight & bw = it.next();
-
-									if ( bw.first == minBone ) {
-										it.remove();
-										rem = true;
-									}
-								}
-
-								float totalWeight = 0;
-								for ( const auto bw : bws ) {
-									totalWeight += bw.second;
-								}
-
-								if ( totalWeight == 0 )
-									throw QString( "internal error 0x02" );
-
-								for ( int b = 0; b < bws.count(); b++ ) {
-									// normalize
-									bws[b].second /= totalWeight;
-								}
-							}
-
-							if ( rem )
-								cnt++;
-						}
-					}
-				} while ( tribones.count() > maxBonesPerPartition );
-			}
+			int cnt = BonePacking::limitTriangleBones( nif->getArray<Vector3>( iData, "Vertices" ), triangles, weights, maxBonesPerPartition );
 
 			if ( cnt > 0 )
 				qCWarning( nsSpell ) << Spell::tr( "Removed %1 bone influences" ).arg( cnt );
 
 			// split the triangles into partitions
 
-			bool merged = true;
-
-			QList<Partition> parts;
+			QVector<BonePacking::Partition> parts;
 
 			if ( !trimap.isEmpty() ) {
-				QMutableListIterator<Triangle> it( triangles );
-
-				while ( it.hasNext() ) {
-					Triangle tri = it.next();
+				// when explicit mapping enabled, no merging is allowed
+				for ( Triangle tri : triangles ) {
 					qRotate( tri );
 					QMap<Triangle, quint32>::iterator partItr = trimap.find( tri );
 					int partIdx = ( partItr != trimap.end() ) ? partItr.value() : defaultPart;
 
-					if ( partIdx >= 0 ) {
-						//Triangle & tri = *it;
-
-						// Ensure enough partitions
-						while ( partIdx >= int( parts.size() ) )
-							parts.push_back( Partition() );
-
-						Partition & part = parts[partIdx];
-
-						QList<int> tribones;
-
-						for ( int c = 0; c < 3; c++ ) {
-							for ( const auto bw : weights[tri[c]] ) {
-								if ( !tribones.contains( bw.first ) )
-									tribones.append( bw.first );
-							}
-						}
-
-						part.bones = mergeBones( part.bones, tribones );
-						part.triangles.append( tri );
-						it.remove();
-					}
-				}
-
-				merged = false; // when explicit mapping enabled, no merging is allowed
-			}
-
-			while ( !triangles.isEmpty() ) {
-				Partition part;
-
-				QHash<int, bool> usedVerts;
+					// Ensure enough partitions
+					while ( partIdx >= int( parts.size() ) )
+						parts.push_back( BonePacking::Partition() );
 
-				bool addtriangles;
+					BonePacking::Partition & part = parts[partIdx];
 
-				do {
-					QMutableListIterator<Triangle> it( triangles );
+					QVector<int> tribones;
 
-					while ( it.hasNext() ) {
-						Triangle & tri = it.next();
-
-						QList<int> tribones;
-
-						for ( int c = 0; c < 3; c++ ) {
-							for ( const auto bw : weights[tri[c]] ) {
-								if ( !tribones.contains( bw.first ) )
-									tribones.append( bw.first );
-							}
-						}
-
-						if ( part.bones.isEmpty() || containsBones( part.bones, tribones ) ) {
-							part.bones = mergeBones( part.bones, tribones );
-							part.triangles.append( tri );
-							usedVerts[ tri[0] ] = true;
-							usedVerts[ tri[1] ] = true;
-							usedVerts[ tri[2] ] = true;
-							it.remove();
-						}
-					}
-
-					addtriangles = false;
-
-					if ( part.bones.count() < maxBonesPerPartition ) {
-						// if we have room left in the partition then add an adjacent triangle
-						it.toFront();
-
-						while ( it.hasNext() ) {
-							Triangle & tri = it.next();
-
-							if ( usedVerts.contains( tri[0] ) || usedVerts.contains( tri[1] ) || usedVerts.contains( tri[2] ) ) {
-								QList<int> tribones;
-
-								for ( int c = 0; c < 3; c++ ) {
-									for ( const auto bw : weights[tri[c]] ) {
-										if ( !tribones.contains( bw.first ) )
-											tribones.append( bw.first );
-									}
-								}
-
-								tribones = mergeBones( part.bones, tribones );
-
-								if ( tribones.count() <= maxBonesPerPartition ) {
-									part.bones = tribones;
-									part.triangles.append( tri );
-									usedVerts[ tri[0] ] = true;
-									usedVerts[ tri[1] ] = true;
-									usedVerts[ tri[2] ] = true;
-									it.remove();
-									addtriangles = true;
-									//break;
-								}
-							}
+					for ( int c = 0; c < 3; c++ ) {
+						for ( const auto bw : weights[tri[c]] ) {
+							if ( !tribones.contains( bw.first ) )
+								tribones.append( bw.first );
 						}
 					}
-				} while ( addtriangles );
 
-				parts.append( part );
-			}
-
-			//qDebug() << parts.count() << "small partitions";
-
-			// merge partitions
-
-			while ( merged ) {
-				merged = false;
-
-				for ( int p1 = 0; p1 < parts.count() && !merged; p1++ ) {
-					if ( parts[p1].bones.count() < maxBonesPerPartition ) {
-						for ( int p2 = p1 + 1; p2 < parts.count() && !merged; p2++ ) {
-							QList<int> mergedBones = mergeBones( parts[p1].bones, parts[p2].bones );
+					part.bones = mergeBones( part.bones, tribones );
+					part.triangles.append( tri );
+				}
+			} else {
+				QVector<QVector<int>> vertexBones( numVerts );
 
-							if ( mergedBones.count() <= maxBonesPerPartition ) {
-								parts[p1].bones = mergedBones;
-								parts[p1].triangles << parts[p2].triangles;
-								parts.removeAt( p2 );
-								merged = true;
-							}
-						}
-					}
+				for ( int v = 0; v < numVerts; v++ ) {
+					for ( const auto bw : weights[v] )
+						vertexBones[v].append( bw.first );
 				}
+
+				parts = BonePacking::pack( vertexBones, triangles.toVector(), maxBonesPerPartition, opts.mode );
 			}
 
-			//qDebug() << parts.count() << "partitions";
+			if ( stats )
+				*stats += BonePacking::analyze( parts, numVerts );
 
 			// create the NiSkinPartition if it doesn't exist yet
 
@@ -808,12 +629,20 @@ public:
 				}
 			}
 
-			QList<int> prevPartBones;
+			// resort the bone weights in bone order
+			QMutableVectorIterator<QList<boneweight> > it( weights );
+
+			while ( it.hasNext() ) {
+				QList<boneweight> & bw = it.next();
+				std::sort( bw.begin(), bw.end(), boneweight_equivalence() );
+			}
+
+			QVector<int> prevPartBones;
 
 			for ( int p = 0; p < parts.count(); p++ ) {
 				QModelIndex iPart = nif->getIndex( iSkinPart, "Partitions" ).child( p, 0 );
 
-				QList<int> bones = parts[p].bones;
+				QVector<int> bones = parts[p].bones;
 				std::sort( bones.begin(), bones.end() /*, std::less<int>()*/ );
 
 				// set partition flags for bs skin instance if present
@@ -852,7 +681,7 @@ public:
 
 				for ( int tri = 0; tri < triangles.count(); tri++ ) {
 					for ( int t = 0; t < 3; t++ ) {
-						triangles[tri][t] = vertices.indexOf( triangles[tri][t] );
+						triangles[tri][t] = vidx[triangles[tri][t]];
 					}
 				}
 
@@ -860,7 +689,7 @@ public:
 				QVector<QVector<quint16> > strips;
 				int numTriangles = 0;
 
-				if ( make_strips == true ) {
+				if ( opts.makeStrips ) {
 					strips = stripify( triangles );
 
 					for ( const QVector<quint16>& strip : strips ) {
@@ -871,20 +700,12 @@ public:
 				}
 
 				// fill in counts
-				if ( pad ) {
+				if ( opts.pad ) {
 					while ( bones.size() < maxBonesPerPartition ) {
 						bones.append( 0 );
 					}
 				}
 
-				// resort the bone weights in bone order
-				QMutableVectorIterator<QList<boneweight> > it( weights );
-
-				while ( it.hasNext() ) {
-					QList<boneweight> & bw = it.next();
-					std::sort( bw.begin(), bw.end(), boneweight_equivalence() );
-				}
-
 				nif->set<int>( iPart, "Num Vertices", vertices.count() );
 				nif->set<int>( iPart, "Num Triangles", numTriangles );
 				nif->set<int>( iPart, "Num Bones", bones.count() );
@@ -895,7 +716,7 @@ public:
 
 				QModelIndex iBoneMap = nif->getIndex( iPart, "Bones" );
 				nif->updateArraySize( iBoneMap );
-				nif->setArray<int>( iBoneMap, bones.toVector() );
+				nif->setArray<int>( iBoneMap, bones );
 
 				// fill in vertex map
 
@@ -921,7 +742,7 @@ public:
 
 				nif->set<int>( iPart, "Has Faces", 1 );
 
-				if ( make_strips == true ) {
+				if ( opts.makeStrips ) {
 					//Clear out any existing triangle data that might be left over from an existing Skin Partition
 					QModelIndex iTriangles = nif->getIndex( iPart, "Triangles" );
 					nif->updateArraySize( iTriangles );
@@ -981,7 +802,7 @@ public:
 		}
 	}
 
-	static QList<int> mergeBones( QList<int> a, QList<int> b )
+	static QVector<int> mergeBones( QVector<int> a, const QVector<int> & b )
 	{
 		for ( const auto c : b ) {
 			if ( !a.contains( c ) ) {
@@ -991,13 +812,17 @@ public:
 		return a;
 	}
 
-	static bool containsBones( QList<int> a, QList<int> b )
+	//! Time and quality summary of the partitions made
+	static QString report( const BonePacking::Stats & stats, qint64 msec )
 	{
-		for ( const auto c : b ) {
-			if ( !a.contains( c ) )
-				return false;
-		}
-		return true;
+		return Spell::tr( "Partitions: %1\nBones per partition: %2 to %3, %4 on average\nVertices: %5 (%6 shared between partitions)\nTime: %7 ms" )
+			.arg( stats.partitions )
+			.arg( stats.minBones )
+			.arg( stats.maxBones )
+			.arg( stats.averageBones(), 0, 'f', 1 )
+			.arg( stats.vertices )
+			.arg( stats.vertices - stats.meshVertices )
+			.arg( msec );
 	}
 };
 
@@ -1029,15 +854,20 @@ public:
 				indices.append( idx );
 		}
 
-		int mbpp = 0, mbpv = 0;
-		bool make_strips = false;
+		spSkinPartition::Options opts;
+		BonePacking::Stats stats;
+		QElapsedTimer timer;
+		timer.start();
 
 		for ( const QModelIndex& idx : indices ) {
-			Partitioner.cast( nif, idx, mbpp, mbpv, make_strips );
+			Partitioner.cast( nif, idx, opts, &stats );
 		}
 
 		qCWarning( nsSpell ) << Spell::tr( "did %1 partitions" ).arg( indices.count() );
 
+		if ( stats.partitions > 0 )
+			Message::info( nullptr, Spell::tr( "Partitioned %1 shapes." ).arg( indices.count() ), spSkinPartition::report( stats, timer.elapsed() ) );
+
 		return QModelIndex();
 	}
 };
@@ -1068,6 +898,9 @@ SkinPartitionDialog::SkinPartitionDialog( int ) : QDialog()
 	ckPad->setToolTip( "Determines whether partitions that will have fewer than the selected maximum number of bones will have extra bones added to bring them up to that number." );
 	connect( ckPad, &QCheckBox::clicked, this, &SkinPartitionDialog::changed );
 
+	ckMinimize = new QCheckBox( "&Minimize Partition Count" );
+	ckMinimize->setChecked( false );
+	ckMinimize->setToolTip( "Determines whether triangles are grouped by their bones regardless of where they are on the mesh when that needs fewer partitions.  This duplicates more vertices across partitions." );
 
 	QLabel * labVert = new QLabel( this );
 	labVert->setText( Spell::tr(
@@ -1101,6 +934,12 @@ SkinPartitionDialog::SkinPartitionDialog( int ) : QDialog()
 			"Hint:  Freedom Force seems to require this, but it doesn't seem to affect other games."
 		) );
 
+	QLabel * labMinimize = new QLabel( this );
+	labMinimize->setText( Spell::tr(
+			"<b>Whether or not to use as few partitions as possible.</b><br>"
+			"Hint:  Each partition is a separate draw call in game."
+		) );
+
 	QPushButton * btOk = new QPushButton( this );
 	btOk->setText( Spell::tr( "Ok" ) );
 	connect( btOk, &QPushButton::clicked, this, &SkinPartitionDialog::accept );
@@ -1114,7 +953,8 @@ SkinPartitionDialog::SkinPartitionDialog( int ) : QDialog()
 	grid->addWidget( labPart, 1, 0 );    grid->addWidget( spnPart, 1, 1 );
 	grid->addWidget( labTStrip, 2, 0 );  grid->addWidget( ckTStrip, 2, 1 );
 	grid->addWidget( labPad, 3, 0 );     grid->addWidget( ckPad, 3, 1 );
-	grid->addWidget( btOk, 4, 0 );       grid->addWidget( btCancel, 4, 1 );
+	grid->addWidget( labMinimize, 4, 0 ); grid->addWidget( ckMinimize, 4, 1 );
+	grid->addWidget( btOk, 5, 0 );       grid->addWidget( btCancel, 5, 1 );
 }
 
 void SkinPartitionDialog::changed()
@@ -1142,6 +982,11 @@ bool SkinPartitionDialog::padPartitions()
 	return ckPad->isChecked();
 }
 
+bool SkinPartitionDialog::minimizePartitions()
+{
+	return ckMinimize->isChecked();
+}
+
 //! Fix bone bounds
 class spFixBoneBounds final : public Spell
 {
@@ -1251,16 +1096,13 @@ public:
 
 			if ( keyframeResponse == 1 ) {
 				// delete blocks
-				int n = 0;
-
-				while ( n < nif->getBlockCount() ) {
-					QModelIndex iBlock = nif->getBlockIndex( n );
-
-					if ( nif->itemName( iBlock ).indexOf( "NiKeyframe" ) >= 0 )
-						nif->removeNiBlock( n );
-					else
-						n++;
+				QVector<qint32> remove;
+				for ( int n = 0; n < nif->getBlockCount(); n++ ) {
+					if ( nif->itemName( nif->getBlockIndex( n ) ).indexOf( "NiKeyframe" ) >= 0 )
+						remove << n;
 				}
+
+				nif->removeNiBlocks( remove );
 			}
 		}
 
@@ -26,6 +26,8 @@ public:
 	bool makeStrips();
 	//! Returns the value of ckPad
 	bool padPartitions();
+	//! Returns the value of ckMinimize
+	bool minimizePartitions();
 
 protected slots:
 	//! Sets the minimum value of spnPart to the value of spnVert
@@ -40,6 +42,8 @@ protected:
 	QCheckBox * ckTStrip;
 	//! Whether padding should be used
 	QCheckBox * ckPad;
+	//! Whether the partition count should be minimized
+	QCheckBox * ckMinimize;
 
 	//! The maximum number of influences; unused?
 	int maxInfluences;
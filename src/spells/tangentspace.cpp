@@ -1,6 +1,7 @@
 #include "tangentspace.h"
 
 #include "lib/nvtristripwrapper.h"
+#include "model/meshstreams.h"
 
 
 bool spTangentSpace::isApplicable( const NifModel * nif, const QModelIndex & index )
@@ -38,9 +39,9 @@ bool spTangentSpace::isApplicable( const NifModel * nif, const QModelIndex & ind
 	return false;
 }
 
-QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
+bool spTangentSpace::snapshot( const NifModel * nif, const QModelIndex & iBlock, Job & job )
 {
-	QPersistentModelIndex iShape = iBlock;
+	QModelIndex iShape = iBlock;
 	QModelIndex iData;
 	QModelIndex iPartBlock;
 	if ( nif->getBSVersion() < 100 ) {
@@ -59,9 +60,9 @@ QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
 		}
 	}
 
-	QVector<Vector3> verts;
-	QVector<Vector3> norms;
-	QVector<Vector2> texco;
+	QVector<Vector3> & verts = job.verts;
+	QVector<Vector3> & norms = job.norms;
+	QVector<Vector2> & texco = job.texco;
 
 	if ( nif->getBSVersion() < 100 ) {
 		verts = nif->getArray<Vector3>( iData, "Vertices" );
@@ -74,20 +75,12 @@ QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
 		else
 			numVerts = nif->get<int>( iShape, "Num Vertices" );
 
-		verts.reserve( numVerts );
-		norms.reserve( numVerts );
-		texco.reserve( numVerts );
-
-		for ( int i = 0; i < numVerts; i++ ) {
-			auto idx = nif->index( i, 0, iData );
-			verts += nif->get<Vector3>( idx, "Vertex" );
-			norms += nif->get<ByteVector3>( idx, "Normal" );;
-			texco += nif->get<HalfVector2>( idx, "UV" );
-		}
+		MeshStreams streams( nif, iData, numVerts );
+		verts = streams.positions();
+		norms = streams.normals();
+		texco = streams.uvs();
 	}
 
-	QVector<Color4> vxcol = nif->getArray<Color4>( iData, "Vertex Colors" );
-
 	if ( nif->getBSVersion() < 100 ) {
 		QModelIndex iTexCo = nif->getIndex( iData, "UV Sets" );
 		iTexCo = iTexCo.child( 0, 0 );
@@ -95,7 +88,7 @@ QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
 	}
 
 
-	QVector<Triangle> triangles;
+	QVector<Triangle> & triangles = job.triangles;
 	QModelIndex iPoints = nif->getIndex( iData, "Points" );
 
 	if ( iPoints.isValid() ) {
@@ -128,11 +121,25 @@ QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
 			.arg( texco.count() )
 			.arg( triangles.count() )
 		);
-		return iBlock;
+		return false;
 	}
 
-	QVector<Vector3> tan( verts.count() );
-	QVector<Vector3> bin( verts.count() );
+	job.iShape = iShape;
+	job.iData = iData;
+	return true;
+}
+
+void spTangentSpace::compute( Job & job )
+{
+	const QVector<Vector3> & verts = job.verts;
+	const QVector<Vector3> & norms = job.norms;
+	const QVector<Vector2> & texco = job.texco;
+	const QVector<Triangle> & triangles = job.triangles;
+
+	QVector<Vector3> & tan = job.tangents;
+	QVector<Vector3> & bin = job.bitangents;
+	tan.fill( Vector3(), verts.count() );
+	bin.fill( Vector3(), verts.count() );
 
 	QMultiHash<int, int> vmap;
 
@@ -142,7 +149,7 @@ QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
 		// for each triangle caculate the texture flow direction
 		//qDebug() << "triangle" << t;
 
-		Triangle & tri = triangles[t];
+		const Triangle & tri = triangles[t];
 
 		int i1 = tri[0];
 		int i2 = tri[1];
@@ -238,6 +245,14 @@ QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
 	}
 
 	//qDebug() << "unassigned vertices" << cnt;
+}
+
+void spTangentSpace::commit( NifModel * nif, const Job & job )
+{
+	QModelIndex iShape = job.iShape;
+	QModelIndex iData = job.iData;
+	const QVector<Vector3> & tan = job.tangents;
+	const QVector<Vector3> & bin = job.bitangents;
 
 	bool isOblivion = false;
 
@@ -278,26 +293,23 @@ QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
 		nif->setArray( iBinorms, bin );
 		nif->setArray( iTangents, tan );
 	} else if ( nif->getBSVersion() >= 100 ) {
-		int numVerts;
-		// "Num Vertices" does not exist in the partition
-		if ( iPartBlock.isValid() )
-			numVerts = nif->get<uint>( iPartBlock, "Data Size" ) / nif->get<uint>( iPartBlock, "Vertex Size" );
-		else
-			numVerts = nif->get<int>( iShape, "Num Vertices" );
-
-		nif->setState( BaseModel::Processing );
-		for ( int i = 0; i < numVerts; i++ ) {
-			auto idx = nif->index( i, 0, iData );
+		// One tangent and bitangent per vertex, as read above
+		MeshStreams streams( nif, iData );
+		streams.setTangents( tan );
+		streams.setBitangents( bin );
+	}
+}
 
-			nif->set<ByteVector3>( idx, "Tangent", tan[i] );
-			nif->set<float>(idx, "Bitangent X", bin[i][0]);
-			nif->set<float>(idx, "Bitangent Y", bin[i][1]);
-			nif->set<float>(idx, "Bitangent Z", bin[i][2]);
-		}
-		nif->restoreState();
+QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
+{
+	Job job;
+	if ( snapshot( nif, iBlock, job ) ) {
+		compute( job );
+		commit( nif, job );
+		return job.iShape;
 	}
 
-	return iShape;
+	return iBlock;
 }
 
 REGISTER_SPELL( spTangentSpace )
@@ -337,9 +349,7 @@ public:
 				indices << idx;
 		}
 
-		for ( const QModelIndex& idx : indices ) {
-			TSpacer.castIfApplicable( nif, idx );
-		}
+		castParallel<spTangentSpace::Job>( nif, indices, spTangentSpace::snapshot, spTangentSpace::compute, spTangentSpace::commit );
 
 		return QModelIndex();
 	}
@@ -361,7 +371,7 @@ public:
 
 	QModelIndex cast( NifModel * nif, const QModelIndex & ) override final
 	{
-		QVector<QModelIndex> blks;
+		QList<QPersistentModelIndex> blks;
 		for ( int l = 0; l < nif->getBlockCount(); l++ ) {
 			QModelIndex idx = nif->getBlockIndex( l, "NiTriShape" );
 			if ( !idx.isValid() )
@@ -385,9 +395,7 @@ public:
 			blks << idx;
 		}
 
-		spTangentSpace update;
-		for ( auto& b : blks )
-			update.cast( nif, b );
+		castParallel<spTangentSpace::Job>( nif, blks, spTangentSpace::snapshot, spTangentSpace::compute, spTangentSpace::commit );
 
 		return QModelIndex();
 	}
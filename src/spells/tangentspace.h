@@ -17,6 +17,28 @@ public:
 
 	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final;
 	QModelIndex cast( NifModel * nif, const QModelIndex & iBlock ) override final;
+
+	//! The geometry of a shape and the tangent space computed from it
+	struct Job
+	{
+		QPersistentModelIndex iShape;
+		QPersistentModelIndex iData;
+
+		QVector<Vector3> verts;
+		QVector<Vector3> norms;
+		QVector<Vector2> texco;
+		QVector<Triangle> triangles;
+
+		QVector<Vector3> tangents;
+		QVector<Vector3> bitangents;
+	};
+
+	//! Copy the geometry of a shape, false if there is not enough of it
+	static bool snapshot( const NifModel * nif, const QModelIndex & iBlock, Job & job );
+	//! Calculate the tangents and bitangents; does not access the model
+	static void compute( Job & job );
+	//! Write the tangents and bitangents to the model
+	static void commit( NifModel * nif, const Job & job );
 };
 
 
@@ -2,6 +2,7 @@
 
 #include "spellbook.h"
 #include "gl/gltex.h"
+#include "model/meshstreams.h"
 #include "spells/blocks.h"
 #include "ui/widgets/fileselect.h"
 #include "ui/widgets/nifeditors.h"
@@ -652,8 +653,7 @@ class spTextureTemplate final : public Spell
 				tri = nif->getArray<Triangle>( index, "Triangles" );
 			}
 
-			for ( int i = 0; i < nif->rowCount( iVertData ); i++ )
-				uv << nif->get<Vector2>( nif->index( i, 0, iVertData ), "UV" );
+			uv = MeshStreams( nif, iVertData ).uvs();
 
 		} else {
 			uv = nif->getArray<Vector2>( iSet );
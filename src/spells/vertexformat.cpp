@@ -0,0 +1,479 @@
+#include "spellbook.h"
+
+#include "gl/glproperty.h"
+#include "lib/half.h"
+#include "model/meshstreams.h"
+
+#include <QCheckBox>
+#include <QDialog>
+#include <QDir>
+#include <QDirIterator>
+#include <QDoubleSpinBox>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QGridLayout>
+#include <QLabel>
+#include <QPushButton>
+
+#include <cmath>
+#include <limits>
+
+
+// Brief description is deliberately not autolinked to class Spell
+/*! \file vertexformat.cpp
+ * \brief Vertex format compaction spells
+ *
+ * All classes here inherit from the Spell class.
+ */
+
+//! Shared by the vertex format spells
+namespace VertexFormat
+{
+	struct Options
+	{
+		//! Store the positions as half floats when the error allows it (FO4 and later)
+		bool halfPositions = true;
+		//! Largest position error allowed for half floats, in percent of the largest bounding box extent
+		double maxError = 0.1;
+		bool stripColors = true;
+		bool stripTangents = true;
+	};
+
+	//! Outcome of compacting one shape
+	struct Result
+	{
+		quint64 bytesBefore = 0;
+		quint64 bytesAfter = 0;
+		//! One line per shape, for the report
+		QString details;
+	};
+
+	//! Whether the vertex data of a shape can be rewritten on its own
+	static bool canCompact( const NifModel * nif, const QModelIndex & iShape )
+	{
+		// BSDynamicTriShape keeps its positions in a separate full precision array
+		if ( !nif->blockInherits( iShape, "BSTriShape" ) || nif->blockInherits( iShape, "BSDynamicTriShape" ) )
+			return false;
+
+		if ( nif->get<uint>( iShape, "Num Vertices" ) == 0 || !nif->getIndex( iShape, "Vertex Data" ).isValid() )
+			return false;
+
+		// Skinned SSE shapes keep a copy of the vertices in the partitions
+		auto vf = nif->get<BSVertexDesc>( iShape, "Vertex Desc" );
+		return !( (vf & VertexFlags::VF_SKINNED) && nif->getBSVersion() == 100 );
+	}
+
+	//! Whether the shader is driven by a BGSM or BGEM file, which overrides most of its flags
+	static bool hasMaterialFile( const NifModel * nif, const QModelIndex & iProperty )
+	{
+		QString name = nif->get<QString>( iProperty, "Name" );
+		return name.endsWith( ".bgsm", Qt::CaseInsensitive ) || name.endsWith( ".bgem", Qt::CaseInsensitive );
+	}
+
+	/*! Get the shader flags of a shape, false if they are not known from the NIF alone
+	 *
+	 * F76 and later store the flags as CRC lists, and material files override them.
+	 */
+	static bool getShaderFlags( const NifModel * nif, const QModelIndex & iProperty, quint32 & sf1, quint32 & sf2 )
+	{
+		QModelIndex iSF1 = nif->getIndex( iProperty, "Shader Flags 1" );
+		QModelIndex iSF2 = nif->getIndex( iProperty, "Shader Flags 2" );
+		if ( !iSF1.isValid() || !iSF2.isValid() || hasMaterialFile( nif, iProperty ) )
+			return false;
+
+		sf1 = nif->get<quint32>( iSF1 );
+		sf2 = nif->get<quint32>( iSF2 );
+		return true;
+	}
+
+	//! Whether the shader of a shape provably never reads the tangents
+	static bool tangentsUnused( const NifModel * nif, const QModelIndex & iProperty )
+	{
+		if ( nif->isNiBlock( iProperty, "BSEffectShaderProperty" ) ) {
+			if ( hasMaterialFile( nif, iProperty ) )
+				return false;
+
+			// Only FO4 and later effect shaders have a normal map
+			QModelIndex iNormal = nif->getIndex( iProperty, "Normal Texture" );
+			return !iNormal.isValid() || nif->get<QString>( iNormal ).isEmpty();
+		}
+
+		quint32 sf1, sf2;
+		if ( nif->isNiBlock( iProperty, "BSLightingShaderProperty" ) && getShaderFlags( nif, iProperty, sf1, sf2 ) )
+			return sf1 & ShaderFlags::SLSF1_Model_Space_Normals;
+
+		return false;
+	}
+
+	/*! Whether the vertex colors of a shape can be removed without changing how it renders
+	 *
+	 * @param colors		The vertex colors of the shape
+	 * @param clearFlag		Set if SLSF2_Vertex_Colors must be cleared as well,
+	 *						Skyrim draws a shape black if the flag is set without any colors
+	 */
+	static bool colorsUnused( const NifModel * nif, const QModelIndex & iProperty, const QVector<Color4> & colors, bool & clearFlag )
+	{
+		clearFlag = false;
+
+		quint32 sf1, sf2;
+		if ( !getShaderFlags( nif, iProperty, sf1, sf2 ) )
+			return false;
+
+		// Tree animation reads the vertex colors as animation weights
+		if ( sf2 & ShaderFlags::SLSF2_Tree_Anim )
+			return false;
+
+		const float white = 1.0f - 0.5f / 255.0f;
+
+		bool skyrim = nif->getBSVersion() < 130;
+		if ( skyrim && !(sf2 & ShaderFlags::SLSF2_Vertex_Colors) ) {
+			if ( !(sf1 & ShaderFlags::SLSF1_Vertex_Alpha) )
+				return true;
+
+			// SLSF1_Vertex_Alpha still reads the alpha channel on its own
+			for ( const Color4 & c : colors ) {
+				if ( c[3] < white )
+					return false;
+			}
+
+			return true;
+		}
+
+		for ( const Color4 & c : colors ) {
+			if ( c[0] < white || c[1] < white || c[2] < white || c[3] < white )
+				return false;
+		}
+
+		if ( skyrim ) {
+			// The flag can only be cleared if no other shape uses the shader
+			if ( nif->getChildRefs( nif->getBlockNumber( iProperty ) ).count() > 1 )
+				return false;
+
+			clearFlag = true;
+		}
+
+		return true;
+	}
+
+	static float roundToHalf( float x )
+	{
+		union { float f; uint32_t i; } u;
+		u.f = x;
+		u.i = half_to_float( half_from_float( u.i ) );
+		return u.f;
+	}
+
+	/*! Largest position error after converting to half floats, relative to the largest bounding box extent
+	 *
+	 * Infinite if a position does not fit in a half float.
+	 */
+	static float halfError( const QVector<Vector3> & positions )
+	{
+		if ( positions.isEmpty() )
+			return 0.0f;
+
+		Vector3 lo = positions[0], hi = positions[0];
+		float error = 0.0f;
+		for ( const Vector3 & p : positions ) {
+			lo.boundMin( p );
+			hi.boundMax( p );
+
+			Vector3 h( roundToHalf( p[0] ), roundToHalf( p[1] ), roundToHalf( p[2] ) );
+			if ( !std::isfinite( h[0] ) || !std::isfinite( h[1] ) || !std::isfinite( h[2] ) )
+				return std::numeric_limits<float>::infinity();
+
+			error = std::max( error, (h - p).length() );
+		}
+
+		float extent = std::max( { hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2] } );
+		if ( extent <= 0.0f )
+			return error > 0.0f ? std::numeric_limits<float>::infinity() : 0.0f;
+
+		return error / extent;
+	}
+
+	//! Compact the vertex format of a shape, true if anything changed
+	static bool compact( NifModel * nif, const QModelIndex & iShape, const Options & opts, Result & result )
+	{
+		auto desc = nif->get<BSVertexDesc>( iShape, "Vertex Desc" );
+		uint numVerts = nif->get<uint>( iShape, "Num Vertices" );
+		uint numTris = nif->get<uint>( iShape, "Num Triangles" );
+		QModelIndex iVertData = nif->getIndex( iShape, "Vertex Data" );
+		QModelIndex iProperty = nif->getBlockIndex( nif->getLink( iShape, "Shader Property" ) );
+
+		quint64 before = quint64( desc.GetVertexSize() ) * numVerts;
+		result.bytesBefore += before;
+		result.bytesAfter += before;
+
+		// Read everything that may be rewritten before the fields change type
+		MeshStreams streams( nif, iVertData );
+		QVector<Vector3> positions = streams.positions();
+		QVector<Vector3> bitangents = streams.bitangents();
+
+		QStringList changes;
+		BSVertexDesc newDesc = desc;
+
+		if ( opts.halfPositions && nif->getBSVersion() >= 130 && desc.HasFlag( VF_FULLPREC ) ) {
+			float error = halfError( positions );
+			if ( error * 100.0f <= opts.maxError ) {
+				newDesc.RemoveFlag( VF_FULLPREC );
+				changes << Spell::tr( "half float positions (error %1%)" ).arg( error * 100.0f, 0, 'f', 3 );
+			} else if ( std::isfinite( error ) ) {
+				changes << Spell::tr( "kept full precision positions (error %1%)" ).arg( error * 100.0f, 0, 'f', 3 );
+			} else {
+				changes << Spell::tr( "kept full precision positions (out of half float range)" );
+			}
+		}
+
+		if ( opts.stripTangents && desc.HasFlag( VA_BINORMAL ) && tangentsUnused( nif, iProperty ) ) {
+			newDesc.RemoveFlag( VA_BINORMAL );
+			changes << Spell::tr( "removed unused tangents" );
+		}
+
+		bool clearColorFlag = false;
+		if ( opts.stripColors && desc.HasFlag( VA_COLOR ) && colorsUnused( nif, iProperty, streams.colors(), clearColorFlag ) ) {
+			newDesc.RemoveFlag( VA_COLOR );
+			changes << Spell::tr( "removed unused vertex colors" );
+		}
+
+		QString name = QString( "[%1] %2" ).arg( nif->getBlockNumber( iShape ) ).arg( nif->get<QString>( iShape, "Name" ) );
+		if ( newDesc.GetFlags() == desc.GetFlags() ) {
+			if ( !changes.isEmpty() )
+				result.details += QString( "%1: %2\n" ).arg( name, changes.join( ", " ) );
+			return false;
+		}
+
+		newDesc.ResetAttributeOffsets( nif->getBSVersion() );
+		nif->set<BSVertexDesc>( iShape, "Vertex Desc", newDesc );
+		QModelIndex iDataSize = nif->getIndex( iShape, "Data Size" );
+		if ( iDataSize.isValid() )
+			nif->set<uint>( iDataSize, newDesc.GetVertexSize() * numVerts + 6 * numTris );
+		nif->updateArraySize( iShape, "Vertex Data" );
+
+		// "Vertex" and "Bitangent X" switch between float and half float fields with the precision
+		MeshStreams output( nif, iVertData );
+		output.setPositions( positions );
+		if ( newDesc.HasFlag( VA_BINORMAL ) )
+			output.setBitangents( bitangents );
+
+		if ( clearColorFlag ) {
+			QModelIndex iSF2 = nif->getIndex( iProperty, "Shader Flags 2" );
+			nif->set<quint32>( iSF2, nif->get<quint32>( iSF2 ) & ~quint32( ShaderFlags::SLSF2_Vertex_Colors ) );
+		}
+
+		quint64 after = quint64( newDesc.GetVertexSize() ) * numVerts;
+		result.bytesAfter -= before - after;
+		result.details += Spell::tr( "%1: %2 to %3 bytes per vertex, %4 bytes saved (%5)\n" )
+			.arg( name ).arg( desc.GetVertexSize() ).arg( newDesc.GetVertexSize() )
+			.arg( before - after ).arg( changes.join( ", " ) );
+
+		return true;
+	}
+
+	//! Compact every shape in a file, returns the number of shapes changed
+	static int compactAll( NifModel * nif, const Options & opts, Result & result )
+	{
+		int changed = 0;
+		for ( int b = 0; b < nif->getBlockCount(); b++ ) {
+			QModelIndex iShape = nif->getBlockIndex( b );
+			if ( canCompact( nif, iShape ) && compact( nif, iShape, opts, result ) )
+				changed++;
+		}
+
+		return changed;
+	}
+
+	//! Ask the user for the options, false if cancelled
+	static bool getOptions( const QString & title, Options & opts )
+	{
+		QDialog dlg;
+		dlg.setWindowTitle( title );
+
+		QGridLayout * grid = new QGridLayout;
+		dlg.setLayout( grid );
+		int row = 0;
+
+		QCheckBox * chkHalf = new QCheckBox( Spell::tr( "Half float positions (Fallout 4 and later)" ) );
+		chkHalf->setChecked( opts.halfPositions );
+		grid->addWidget( chkHalf, row++, 0, 1, 2 );
+
+		QDoubleSpinBox * spnError = new QDoubleSpinBox;
+		spnError->setDecimals( 3 );
+		spnError->setRange( 0.001, 10.0 );
+		spnError->setSingleStep( 0.05 );
+		spnError->setValue( opts.maxError );
+		spnError->setSuffix( "%" );
+		spnError->setToolTip( Spell::tr( "Relative to the largest extent of the mesh bounding box" ) );
+		grid->addWidget( new QLabel( Spell::tr( "Maximum position error" ) ), row, 0 );
+		grid->addWidget( spnError, row++, 1 );
+		QObject::connect( chkHalf, &QCheckBox::toggled, spnError, &QDoubleSpinBox::setEnabled );
+
+		QCheckBox * chkTangents = new QCheckBox( Spell::tr( "Remove tangents the shader does not use" ) );
+		chkTangents->setChecked( opts.stripTangents );
+		grid->addWidget( chkTangents, row++, 0, 1, 2 );
+
+		QCheckBox * chkColors = new QCheckBox( Spell::tr( "Remove vertex colors the shader does not use or that are all white" ) );
+		chkColors->setChecked( opts.stripColors );
+		grid->addWidget( chkColors, row++, 0, 1, 2 );
+
+		QPushButton * btOk = new QPushButton( Spell::tr( "Compact" ) );
+		QObject::connect( btOk, &QPushButton::clicked, &dlg, &QDialog::accept );
+
+		QPushButton * btCancel = new QPushButton( Spell::tr( "Cancel" ) );
+		QObject::connect( btCancel, &QPushButton::clicked, &dlg, &QDialog::reject );
+
+		grid->addWidget( btOk, row, 0 );
+		grid->addWidget( btCancel, row, 1 );
+
+		if ( dlg.exec() != QDialog::Accepted )
+			return false;
+
+		opts.halfPositions = chkHalf->isChecked();
+		opts.maxError = spnError->value();
+		opts.stripTangents = chkTangents->isChecked();
+		opts.stripColors = chkColors->isChecked();
+		return true;
+	}
+
+	static QString summary( const Result & result )
+	{
+		return Spell::tr( "Vertex data: %1 to %2 bytes, %3 bytes saved." )
+			.arg( result.bytesBefore ).arg( result.bytesAfter ).arg( result.bytesBefore - result.bytesAfter );
+	}
+}
+
+
+//! Converts the vertex data of a shape to the smallest format that keeps its appearance
+/*!
+ * Positions are stored as half floats if the largest error stays below a fraction of the
+ * mesh size, and tangents and vertex colors are removed if the shader provably ignores them.
+ */
+class spCompactVertexFormat final : public Spell
+{
+public:
+	QString name() const override final { return Spell::tr( "Compact Vertex Format" ); }
+	QString page() const override final { return Spell::tr( "Mesh" ); }
+
+	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final
+	{
+		return VertexFormat::canCompact( nif, index );
+	}
+
+	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
+	{
+		VertexFormat::Options opts;
+		if ( !VertexFormat::getOptions( Spell::tr( "Compact Vertex Format" ), opts ) )
+			return index;
+
+		VertexFormat::Result result;
+		VertexFormat::compact( nif, index, opts, result );
+
+		Message::info( nullptr, VertexFormat::summary( result ), result.details );
+		return index;
+	}
+};
+
+REGISTER_SPELL( spCompactVertexFormat )
+
+
+//! Compacts the vertex format of every shape in the file
+class spCompactAllVertexFormats final : public Spell
+{
+public:
+	QString name() const override final { return Spell::tr( "Compact Vertex Formats" ); }
+	QString page() const override final { return Spell::tr( "Batch" ); }
+
+	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final
+	{
+		return nif && !index.isValid() && nif->getBSVersion() >= 100;
+	}
+
+	QModelIndex cast( NifModel * nif, const QModelIndex & ) override final
+	{
+		VertexFormat::Options opts;
+		if ( !VertexFormat::getOptions( Spell::tr( "Compact Vertex Formats" ), opts ) )
+			return QModelIndex();
+
+		VertexFormat::Result result;
+		int changed = VertexFormat::compactAll( nif, opts, result );
+
+		Message::info( nullptr, Spell::tr( "Compacted %1 shapes. %2" ).arg( changed ).arg( VertexFormat::summary( result ) ),
+			result.details );
+		return QModelIndex();
+	}
+};
+
+REGISTER_SPELL( spCompactAllVertexFormats )
+
+
+//! Compacts the vertex formats of all NIFs in a folder and its subfolders
+/*!
+ * The changed files are written to an output folder with the same relative paths,
+ * which may be the source folder itself to update the files in place.
+ */
+class spCompactFolderVertexFormats final : public Spell
+{
+public:
+	QString name() const override final { return Spell::tr( "Compact Vertex Formats in Folder" ); }
+	QString page() const override final { return Spell::tr( "Batch" ); }
+
+	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final
+	{
+		return nif && !index.isValid();
+	}
+
+	QModelIndex cast( NifModel *, const QModelIndex & ) override final
+	{
+		QString source = QFileDialog::getExistingDirectory( nullptr, Spell::tr( "Choose the folder to compact" ) );
+		if ( source.isEmpty() )
+			return QModelIndex();
+
+		QString target = QFileDialog::getExistingDirectory( nullptr, Spell::tr( "Choose the output folder" ), source );
+		if ( target.isEmpty() )
+			return QModelIndex();
+
+		VertexFormat::Options opts;
+		if ( !VertexFormat::getOptions( Spell::tr( "Compact Vertex Formats" ), opts ) )
+			return QModelIndex();
+
+		QDir sourceDir( source ), targetDir( target );
+		VertexFormat::Result total;
+		QString details;
+		int files = 0, changedFiles = 0;
+
+		QDirIterator it( source, { "*.nif" }, QDir::Files, QDirIterator::Subdirectories );
+		while ( it.hasNext() ) {
+			QString path = it.next();
+			QString relative = sourceDir.relativeFilePath( path );
+			files++;
+
+			NifModel nif;
+			if ( !nif.loadFromFile( path ) ) {
+				details += Spell::tr( "%1: could not be loaded\n" ).arg( relative );
+				continue;
+			}
+
+			VertexFormat::Result result;
+			if ( VertexFormat::compactAll( &nif, opts, result ) == 0 )
+				continue;
+
+			QString out = targetDir.filePath( relative );
+			if ( !QDir().mkpath( QFileInfo( out ).path() ) || !nif.saveToFile( out ) ) {
+				details += Spell::tr( "%1: could not be saved to %2\n" ).arg( relative, out );
+				continue;
+			}
+
+			changedFiles++;
+			total.bytesBefore += result.bytesBefore;
+			total.bytesAfter += result.bytesAfter;
+			details += Spell::tr( "%1: %2 bytes saved\n%3\n" )
+				.arg( relative ).arg( result.bytesBefore - result.bytesAfter ).arg( result.details );
+		}
+
+		Message::info( nullptr, Spell::tr( "Compacted %1 of %2 files. %3" ).arg( changedFiles ).arg( files )
+			.arg( VertexFormat::summary( total ) ), details );
+		return QModelIndex();
+	}
+};
+
+REGISTER_SPELL( spCompactFolderVertexFormats )
@@ -5,6 +5,8 @@
 
 #include "gamemanager.h"
 
+#include "gl/gltex.h"
+#include "gl/gltexdiskcache.h"
 #include "ui/widgets/colorwheel.h"
 #include "ui/widgets/floatslider.h"
 #include "ui/settingsdialog.h"
@@ -544,6 +546,9 @@ SettingsResources::SettingsResources( QWidget * parent ) :
 	connect( ui->foldersList, &QListView::doubleClicked, this, &SettingsPane::modifyPane );
 	connect( ui->chkAlternateExt, &QCheckBox::clicked, this, &SettingsPane::modifyPane );
 	connect( ui->chkOtherGamesFallback, &QCheckBox::clicked, this, &SettingsPane::modifyPane );
+	connect( ui->chkTextureDiskCache, &QCheckBox::clicked, this, &SettingsPane::modifyPane );
+	connect( ui->spnTextureDiskCacheSize, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged), this, &SettingsPane::modifyPane );
+	connect( ui->btnClearTextureDiskCache, &QPushButton::clicked, []() { TexDiskCache::get()->clear(); } );
 
 	// Move Up / Move Down Behavior
 	connect( ui->foldersList->selectionModel(), &QItemSelectionModel::currentChanged,
@@ -595,6 +600,8 @@ void SettingsResources::read()
 
 	ui->chkAlternateExt->setChecked( settings.value( "Settings/Resources/Alternate Extensions", true ).toBool() );
 	ui->chkOtherGamesFallback->setChecked( settings.value("Settings/Resources/Other Games Fallback", true).toBool() );
+	ui->chkTextureDiskCache->setChecked( settings.value( "Settings/Resources/Texture Disk Cache", false ).toBool() );
+	ui->spnTextureDiskCacheSize->setValue( settings.value( "Settings/Resources/Texture Disk Cache Size", 1024 ).toInt() );
 
 	setModified( false );
 }
@@ -611,6 +618,10 @@ void SettingsResources::write()
 	QSettings settings;
 	settings.setValue( "Settings/Resources/Alternate Extensions", ui->chkAlternateExt->isChecked() );
 	settings.setValue( "Settings/Resources/Other Games Fallback", ui->chkOtherGamesFallback->isChecked() );
+	settings.setValue( "Settings/Resources/Texture Disk Cache", ui->chkTextureDiskCache->isChecked() );
+	settings.setValue( "Settings/Resources/Texture Disk Cache Size", ui->spnTextureDiskCacheSize->value() );
+	TexDiskCache::get()->loadSettings();
+	TexCache::loadSettings();
 
 	setModified( false );
 
@@ -432,6 +432,9 @@ void TestThread::run()
 	NifModel nif;
 	KfmModel kfm;
 
+	// Blocks are only decoded when they are matched or checked
+	nif.setLazyLoading( true );
+
 	QString filepath = queue->dequeue();
 
 	while ( !filepath.isEmpty() ) {
@@ -464,12 +467,12 @@ void TestThread::run()
 
 				if ( !headerOnly && loaded && model == &nif ) {
 					for ( int b = 0; b < nif.getBlockCount(); b++ ) {
-						auto blk = nif.getBlockIndex( b );
-						bool current_match = !blockMatch.isEmpty() && nif.inherits(nif.itemName(blk), blockMatch);
+						bool current_match = !blockMatch.isEmpty() && nif.inherits(nif.getBlockType(b), blockMatch);
 						blk_match |= current_match;
 
 						NifValue value;
 						if ( (blockMatch.isEmpty() || current_match) && !valueName.isEmpty() && !valueMatch.isEmpty() ) {
+							auto blk = nif.getBlockIndex( b );
 							auto nameIdx = nif.getIndex(blk, valueName);
 							bool hasName = nameIdx.isValid();
 							if ( hasName ) {
@@ -544,8 +547,12 @@ void TestThread::run()
 						}
 
 						if ( checkFile ) {
-							messages += checkLinks(&nif, blk, kf);
+							messages += checkLinks(&nif, nif.getBlockIndex( b ), kf);
 						}
+
+						// Bound the decoded items of huge files, the blocks before b are not looked at again
+						if ( (b & 1023) == 1023 )
+							nif.releaseBlocks();
 					}
 
 					if ( checkFile ) {
@@ -619,10 +626,11 @@ QList<TestMessage> TestThread::checkLinks( const NifModel * nif, const QModelInd
 				QString tmplt = nif->itemTempl( idx );
 
 				if ( !tmplt.isEmpty() ) {
-					QModelIndex iBlock = nif->getBlockIndex( l );
+					// The type is known without decoding the block, which may be pending a lazy load
+					QString type = nif->getBlockType( l );
 
-					if ( !nif->blockInherits( iBlock, tmplt ) )
-						messages.append( TestMessage() << tr( "link" ) << linkId( nif, idx ) << tr( "points to wrong block type" ) << nif->itemName( iBlock ) );
+					if ( !nif->inherits( type, tmplt ) )
+						messages.append( TestMessage() << tr( "link" ) << linkId( nif, idx ) << tr( "points to wrong block type" ) << type );
 				}
 			}
 		}
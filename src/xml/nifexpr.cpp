@@ -253,6 +253,16 @@ void NifExpr::partition( const QString & cond, int offset /*= 0*/ )
 	}
 }
 
+void NifExpr::identifiers( QStringList & names ) const
+{
+	for ( const QVariant & v : { lhs, rhs } ) {
+		if ( v.type() == QVariant::UserType && v.canConvert<NifExpr>() )
+			v.value<NifExpr>().identifiers( names );
+		else if ( v.type() == QVariant::String && !v.toString().isEmpty() )
+			names.append( v.toString() );
+	}
+}
+
 QString NifExpr::toString() const
 {
 	QString l = lhs.toString();
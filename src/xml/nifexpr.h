@@ -36,6 +36,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <QRegularExpression>
 #include <QString>
+#include <QStringList>
 #include <QVariant>
 
 
@@ -72,6 +73,9 @@ public:
 
 	QString toString() const;
 
+	//! Append the names referenced by the expression, i.e. its non-numeric operands
+	void identifiers( QStringList & names ) const;
+
 	bool noop() const
 	{
 		return opcode == NifExpr::e_nop;
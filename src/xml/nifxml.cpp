@@ -776,8 +776,150 @@ QString NifModel::parseXmlDescription( const QString & filename )
 		compounds.clear();
 		blocks.clear();
 		supportedVersions.clear();
+	} else {
+		buildFieldTables();
 	}
 
 	return handler.errorString();
 }
 
+/*! Collect the sibling names the cond and arg of @p data refer to
+ *
+ * @return Whether they also refer outside the parent item, through ".." or #ARG#
+ */
+static bool conditionRefs( const NifData & data, QStringList & refs )
+{
+	QStringList ids;
+	data.condexpr().identifiers( ids );
+	data.argexpr().identifiers( ids );
+
+	bool outer = false;
+	for ( const QString & id : ids ) {
+		QString first = id.section( '\\', 0, 0 );
+		if ( first == ".." || id == XMLARG )
+			outer = true;
+		else if ( !first.isEmpty() && !refs.contains( first ) )
+			refs.append( first );
+	}
+
+	return outer;
+}
+
+/*! Whether conditions inside an item of struct @p type may refer to the siblings of the item
+ *
+ * Conservative: templates and recursive structs are assumed to do so.
+ */
+static bool usesOuterScope( const QString & type, const QHash<QString, NifBlockPtr> & compounds, QHash<QString, bool> & memo )
+{
+	auto it = memo.constFind( type );
+	if ( it != memo.cend() )
+		return it.value();
+
+	NifBlockPtr compound = compounds.value( type );
+	if ( !compound )
+		return type == XMLTMPL;
+
+	memo.insert( type, true );
+
+	std::function<bool( const QList<NifData> & )> scan = [&]( const QList<NifData> & types ) {
+		for ( const NifData & data : types ) {
+			QStringList refs;
+			if ( conditionRefs( data, refs ) )
+				return true;
+
+			if ( data.isMixin() ) {
+				if ( NifBlockPtr mixin = compounds.value( data.type() ) ) {
+					if ( scan( mixin->types ) )
+						return true;
+				}
+			} else if ( usesOuterScope( data.type(), compounds, memo )
+						|| ( data.isTemplated() && usesOuterScope( data.templ(), compounds, memo ) ) ) {
+				return true;
+			}
+		}
+		return false;
+	};
+
+	bool outer = scan( compound->types );
+	memo.insert( type, outer );
+	return outer;
+}
+
+//! Append the rows NifModel::insertType creates for @p types
+static void appendFieldRows( NifFieldTable & table, const QList<NifData> & types, const QHash<QString, NifBlockPtr> & compounds, QHash<QString, bool> & memo )
+{
+	auto appendRow = [&]( const NifData & data ) {
+		NifFieldTable::Row row;
+		row.name = data.name();
+		row.cond = data.cond();
+		row.arg = data.arg();
+		conditionRefs( data, row.refs );
+		row.outer = usesOuterScope( data.type(), compounds, memo )
+			|| ( data.isTemplated() && usesOuterScope( data.templ(), compounds, memo ) );
+		row.compound = !data.isArray() && ( data.isCompound() || data.type() == XMLTMPL || compounds.contains( data.type() ) );
+		table.append( row );
+	};
+
+	for ( const NifData & data : types ) {
+		if ( data.isArray() ) {
+			appendRow( data );
+		} else if ( data.isCompound() ) {
+			if ( compounds.contains( data.type() ) )
+				appendRow( data );
+		} else if ( data.isMixin() ) {
+			if ( NifBlockPtr mixin = compounds.value( data.type() ) )
+				appendFieldRows( table, mixin->types, compounds, memo );
+		} else {
+			appendRow( data );
+		}
+	}
+}
+
+//! Append the rows NifModel::insertAncestor creates for the niobject @p id
+static void appendBlockRows( NifFieldTable & table, const QString & id, const QHash<QString, NifBlockPtr> & blocks, const QHash<QString, NifBlockPtr> & compounds, QHash<QString, bool> & memo )
+{
+	NifBlockPtr block = blocks.value( id );
+	if ( !block )
+		return;
+
+	if ( !block->ancestor.isEmpty() && block->ancestor != id )
+		appendBlockRows( table, block->ancestor, blocks, compounds, memo );
+
+	appendFieldRows( table, block->types, compounds, memo );
+}
+
+// documented in nifmodel.h
+void NifModel::buildFieldTables()
+{
+	QHash<QString, bool> memo;
+
+	for ( NifBlockPtr compound : compounds ) {
+		auto table = std::make_shared<NifFieldTable>();
+		appendFieldRows( *table, compound->types, compounds, memo );
+		table->finalize();
+		compound->fields = table;
+	}
+
+	for ( NifBlockPtr block : blocks ) {
+		auto table = std::make_shared<NifFieldTable>();
+		appendBlockRows( *table, block->id, blocks, compounds, memo );
+		table->finalize();
+		block->fields = table;
+	}
+
+	// Fields of a struct type carry its table, the items inserted from them share it
+	auto assign = []( QList<NifData> & types ) {
+		for ( NifData & data : types ) {
+			if ( data.isCompound() && !data.isArray() ) {
+				if ( NifBlockPtr compound = compounds.value( data.type() ) )
+					data.setFieldTable( compound->fields );
+			}
+		}
+	};
+
+	for ( NifBlockPtr compound : compounds )
+		assign( compound->types );
+	for ( NifBlockPtr block : blocks )
+		assign( block->types );
+}
+
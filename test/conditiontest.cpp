@@ -0,0 +1,142 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+
+
+#include "niftest.h"
+
+#include "model/nifmodel.h"
+
+#include <algorithm>
+
+
+//! \file conditiontest.cpp Condition invalidation checks
+
+namespace
+{
+	//! Counts of compared rows and of the conditions each way invalidates
+	struct Counts
+	{
+		qint64 rows = 0;
+		qint64 scanned = 0;
+		qint64 table = 0;
+	};
+
+	//! The siblings the substring scan of NifModel::invalidateDependentConditions invalidates for @p item
+	QVector<int> scanDependents( const NifItem * item )
+	{
+		QVector<int> rows;
+		const NifItem * p = item->parent();
+		const QString & name = item->name();
+		for ( int i = item->row() + 1; i < p->childCount(); i++ ) {
+			const NifItem * c = p->child( i );
+			if ( c->cond().contains( name ) || c->arg().contains( name ) || ( c->childCount() > 0 && !c->isArray() ) )
+				rows << i;
+		}
+		return rows;
+	}
+
+	/*! Compare NifFieldTable::dependents() with scanDependents() for the children of @p parent and below
+	 *
+	 * @return False if the table leaves out a row the scan invalidates
+	 */
+	bool compareDependents( const NifItem * parent, const QString & where, Counts & counts )
+	{
+		const NifFieldTable * fields = parent->fieldTable().get();
+		bool useTable = !parent->isArray() && fields && fields->rowCount() == parent->childCount();
+
+		for ( auto item : parent->childIter() ) {
+			if ( useTable ) {
+				const QVector<ushort> & deps = fields->dependents( item->row() );
+				const QVector<int> scanned = scanDependents( item );
+				for ( int r : scanned ) {
+					if ( !std::binary_search( deps.cbegin(), deps.cend(), ushort( r ) ) )
+						return NifTest::fail( QString( "%1: changing \"%2\" in \"%3\" does not invalidate \"%4\"" )
+							.arg( where, item->name(), parent->name(), parent->child( r )->name() ) );
+				}
+
+				counts.rows++;
+				counts.scanned += scanned.count();
+				counts.table += deps.count();
+			}
+
+			if ( item->childCount() > 0 && !compareDependents( item, where, counts ) )
+				return false;
+		}
+		return true;
+	}
+
+	//! Compare the header, the blocks and the footer of @p nif
+	bool compareFile( const NifModel & nif, const QString & where )
+	{
+		Counts counts;
+		if ( !compareDependents( nif.getHeaderItem(), where, counts ) )
+			return false;
+
+		for ( int b = 0; b < nif.getBlockCount(); b++ ) {
+			if ( !compareDependents( nif.getBlockItem( b ), where, counts ) )
+				return false;
+		}
+
+		if ( !compareDependents( nif.getFooterItem(), where, counts ) )
+			return false;
+
+		NifTest::log( QString( "  %1: %2 fields, the scan invalidates %3 conditions, the field tables %4" )
+			.arg( where ).arg( counts.rows ).arg( counts.scanned ).arg( counts.table ) );
+		return true;
+	}
+
+	//! The field tables invalidate at least the conditions the substring scan did
+	bool checkDependents( const QStringList & args )
+	{
+		QStringList files = NifTest::files( args );
+		if ( files.isEmpty() ) {
+			for ( const NifTest::Version & v : NifTest::versions() ) {
+				NifModel nif;
+				if ( !NifTest::generate( nif, v, 2, 4 ) || !compareFile( nif, v.version ) )
+					return false;
+			}
+			return true;
+		}
+
+		for ( const QString & fname : files ) {
+			NifModel nif;
+			if ( !nif.loadFromFile( fname ) )
+				return NifTest::fail( QString( "Failed to load %1" ).arg( fname ) );
+			if ( !compareFile( nif, fname ) )
+				return false;
+		}
+		return true;
+	}
+}
+
+REGISTER_TEST( "conditions", checkDependents, "Field tables invalidate at least what the substring scan did (files...)" )
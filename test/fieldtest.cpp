@@ -0,0 +1,178 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+
+
+#include "niftest.h"
+
+#include "model/nifmodel.h"
+
+#include <QSet>
+
+
+//! \file fieldtest.cpp Child lookup by name checks and benchmark
+
+namespace
+{
+	//! Find a child by comparing the name against every sibling, the lookup before the field tables
+	const NifItem * scan( const NifModel & nif, const NifItem * parent, const QString & name )
+	{
+		for ( auto item : parent->childIter() )
+			if ( item->hasName( name ) && nif.evalCondition( item ) )
+				return item;
+		return nullptr;
+	}
+
+	/*! Compare the lookup of every child name of @p parent and its descendants with scan()
+	 *
+	 * @return The number of names looked up, -1 on a mismatch
+	 */
+	int compareLookups( const NifModel & nif, const NifItem * parent, const QString & where )
+	{
+		int count = 0;
+		QSet<QString> names;
+		for ( auto item : parent->childIter() ) {
+			if ( item->childCount() > 0 ) {
+				int c = compareLookups( nif, item, where );
+				if ( c < 0 )
+					return c;
+				count += c;
+			}
+
+			if ( names.contains( item->name() ) )
+				continue;
+			names.insert( item->name() );
+
+			const NifItem * expected = scan( nif, parent, item->name() );
+			if ( nif.getItem( parent, item->name() ) != expected
+				|| nif.getItem( parent, QLatin1String( item->name().toLatin1() ) ) != expected )
+			{
+				NifTest::fail( QString( "%1: \"%2\" in \"%3\" differs from the scan over its siblings" )
+					.arg( where, item->name(), parent->name() ) );
+				return -1;
+			}
+			count++;
+		}
+
+		if ( nif.getItem( parent, "No Such Field" ) ) {
+			NifTest::fail( QString( "%1: a missing name was found in \"%2\"" ).arg( where, parent->name() ) );
+			return -1;
+		}
+		return count;
+	}
+
+	//! Compare the lookups of every block of @p nif
+	bool compareBlocks( const NifModel & nif, const QString & where )
+	{
+		int count = 0;
+		for ( int b = 0; b < nif.getBlockCount(); b++ ) {
+			int c = compareLookups( nif, nif.getBlockItem( b ), where );
+			if ( c < 0 )
+				return false;
+			count += c;
+		}
+
+		NifTest::log( QString( "  %1: %2 names in %3 blocks" ).arg( where ).arg( count ).arg( nif.getBlockCount() ) );
+		return true;
+	}
+
+	//! getItem() by name finds the same item as a scan over the siblings, in every block
+	bool checkFields( const QStringList & args )
+	{
+		QStringList files = NifTest::files( args );
+		if ( files.isEmpty() ) {
+			for ( const NifTest::Version & v : NifTest::versions() ) {
+				NifModel nif;
+				if ( !NifTest::generate( nif, v, 3, 4 ) || !compareBlocks( nif, v.version ) )
+					return false;
+			}
+			return true;
+		}
+
+		for ( const QString & fname : files ) {
+			NifModel nif;
+			if ( !nif.loadFromFile( fname ) )
+				return NifTest::fail( QString( "Failed to load %1" ).arg( fname ) );
+			if ( !compareBlocks( nif, fname ) )
+				return false;
+		}
+		return true;
+	}
+
+	//! Time of getItem() by name against scan(), on the fields of NiTriShapeData
+	bool benchFields( const QStringList & args )
+	{
+		int shapes = NifTest::intArg( args, "shapes", 5000 );
+
+		NifModel nif;
+		if ( !NifTest::generate( nif, NifTest::versions().last(), shapes, 4 ) )
+			return false;
+
+		QVector<const NifItem *> blocks;
+		for ( int b = 0; b < nif.getBlockCount(); b++ ) {
+			const NifItem * block = nif.getBlockItem( b );
+			if ( block->hasName( "NiTriShapeData" ) )
+				blocks << block;
+		}
+
+		// Early, middle and late rows, a name on two rows, and one that the version leaves out
+		const QStringList names = { "Group ID", "Num Vertices", "Vertices", "Data Flags", "Bounding Sphere", "Has UV", "Triangles", "Num Match Groups" };
+		qint64 lookups = qint64( blocks.count() ) * names.count();
+
+		int found = 0;
+		double tableMs = NifTest::bestOf( 5, [&]() {
+			found = 0;
+			for ( const NifItem * block : blocks )
+				for ( const QString & name : names )
+					found += ( nif.getItem( block, name ) != nullptr );
+		} );
+
+		int scanned = 0;
+		double scanMs = NifTest::bestOf( 5, [&]() {
+			scanned = 0;
+			for ( const NifItem * block : blocks )
+				for ( const QString & name : names )
+					scanned += ( scan( nif, block, name ) != nullptr );
+		} );
+
+		if ( found != scanned )
+			return NifTest::fail( QString( "getItem found %1 fields, the scan %2" ).arg( found ).arg( scanned ) );
+
+		NifTest::log( QString( "  %1 lookups, %2 found" ).arg( lookups ).arg( found ) );
+		NifTest::log( QString( "  field table:  %1 ms (%2 ns per lookup)" ).arg( tableMs, 0, 'f', 1 ).arg( tableMs * 1e6 / lookups, 0, 'f', 0 ) );
+		NifTest::log( QString( "  sibling scan: %1 ms (%2 ns per lookup)" ).arg( scanMs, 0, 'f', 1 ).arg( scanMs * 1e6 / lookups, 0, 'f', 0 ) );
+		return true;
+	}
+}
+
+REGISTER_TEST( "fields", checkFields, "Lookups by name match a scan over the siblings (files...)" )
+REGISTER_BENCHMARK( "fields-bench", benchFields, "Lookups by name in NiTriShapeData, field table against scan (--shapes)" )
@@ -0,0 +1,154 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+
+
+#include "niftest.h"
+
+#include "model/nifmodel.h"
+
+#include <QFile>
+
+
+//! \file lazytest.cpp Lazy load checks
+
+namespace
+{
+	//! The number of blocks still pending a lazy load, found without decoding any
+	int pendingCount( const NifModel & nif )
+	{
+		int count = 0;
+		for ( int r = 0; r < nif.rowCount(); r++ ) {
+			if ( nif.isBlockPending( nif.getItem( nif.index( r, 0 ) ) ) )
+				count++;
+		}
+		return count;
+	}
+
+	//! Whether @p a and @p b have the same names, types and values down to the last item
+	bool sameItems( const NifItem * a, const NifItem * b, QString & path )
+	{
+		path = a->name();
+		if ( a->name() != b->name() || a->valueType() != b->valueType() || a->childCount() != b->childCount()
+			|| a->getValueAsString() != b->getValueAsString() )
+			return false;
+
+		for ( int r = 0; r < a->childCount(); r++ ) {
+			if ( !sameItems( a->child( r ), b->child( r ), path ) ) {
+				path.prepend( a->name() + "/" );
+				return false;
+			}
+		}
+		return true;
+	}
+
+	//! Compare a lazy load of @p data with an eager one
+	bool compareLoads( const QByteArray & data, const QString & what )
+	{
+		NifModel eager, lazy;
+		lazy.setLazyLoading( true );
+		if ( !NifTest::load( eager, data ) || !NifTest::load( lazy, data ) )
+			return NifTest::fail( QString( "%1: could not be loaded" ).arg( what ) );
+
+		const int blocks = eager.getBlockCount();
+		if ( lazy.getBlockCount() != blocks )
+			return NifTest::fail( QString( "%1: %2 blocks loaded lazily, %3 eagerly" ).arg( what ).arg( lazy.getBlockCount() ).arg( blocks ) );
+
+		int pending = pendingCount( lazy );
+		if ( pending == 0 )
+			return NifTest::fail( QString( "%1: nothing was loaded lazily" ).arg( what ) );
+
+		// Saving and the link graph read the links of the pending blocks, but leave them pending
+		if ( NifTest::save( lazy ) != data )
+			return NifTest::fail( QString( "%1: the lazy load does not save the bytes it read" ).arg( what ) );
+
+		if ( lazy.getRootLinks() != eager.getRootLinks() )
+			return NifTest::fail( QString( "%1: the roots differ from the eager load" ).arg( what ) );
+
+		for ( int b = 0; b < blocks; b++ ) {
+			if ( lazy.getChildLinks( b ) != eager.getChildLinks( b ) || lazy.getParentLinks( b ) != eager.getParentLinks( b )
+				|| lazy.getChildRefs( b ) != eager.getChildRefs( b ) || lazy.getParent( b ) != eager.getParent( b ) )
+				return NifTest::fail( QString( "%1: the links of block %2 differ from the eager load" ).arg( what ).arg( b ) );
+		}
+
+		if ( pendingCount( lazy ) != pending )
+			return NifTest::fail( QString( "%1: saving or the link graph decoded %2 of %3 pending blocks" )
+				.arg( what ).arg( pending - pendingCount( lazy ) ).arg( pending ) );
+
+		// Decoded on access, every block has the items of the eager load
+		for ( int b = 0; b < blocks; b++ ) {
+			QString path;
+			if ( !sameItems( lazy.getBlockItem( b ), eager.getBlockItem( b ), path ) )
+				return NifTest::fail( QString( "%1: block %2 decodes differently at %3" ).arg( what ).arg( b ).arg( path ) );
+		}
+
+		if ( NifTest::save( lazy ) != data )
+			return NifTest::fail( QString( "%1: the decoded lazy load does not save the bytes it read" ).arg( what ) );
+
+		NifTest::log( QString( "  %1: %2 blocks, %3 pending" ).arg( what ).arg( blocks ).arg( pending ) );
+		return true;
+	}
+
+	//! A lazy load saves the bytes it read and decodes like an eager load
+	bool checkLazy( const QStringList & args )
+	{
+		QStringList files = NifTest::files( args );
+		if ( files.isEmpty() ) {
+			// Only files with Block Size load lazily
+			bool ok = true;
+			for ( const NifTest::Version & v : NifTest::versions() ) {
+				if ( NifModel::version2number( v.version ) < 0x14020000 )
+					continue;
+
+				NifModel nif;
+				if ( !NifTest::generate( nif, v, NifTest::intArg( args, "shapes", 50 ), 8 ) )
+					return false;
+
+				QString what = QString( "%1 %2/%3" ).arg( v.version ).arg( v.userVersion ).arg( v.bsVersion );
+				ok = compareLoads( NifTest::save( nif ), what ) && ok;
+			}
+			return ok;
+		}
+
+		bool ok = true;
+		for ( const QString & fname : files ) {
+			QFile file( fname );
+			if ( !file.open( QIODevice::ReadOnly ) )
+				ok = NifTest::fail( QString( "%1: could not be opened" ).arg( fname ) );
+			else
+				ok = compareLoads( file.readAll(), fname ) && ok;
+		}
+		return ok;
+	}
+}
+
+REGISTER_TEST( "lazy", checkLazy, "Lazy loads save the bytes read and decode like eager loads (--shapes, files...)" )
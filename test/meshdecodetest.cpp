@@ -0,0 +1,151 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+
+#include "niftest.h"
+
+#include "io/MeshDecode.h"
+
+#include <QByteArray>
+#include <QVector>
+
+#include <cstring>
+#include <random>
+
+
+//! \file meshdecodetest.cpp MeshDecode checks and benchmark
+
+namespace
+{
+	//! The packed streams of a synthetic .mesh with @p count vertices
+	struct Streams
+	{
+		Streams( int count )
+		{
+			std::mt19937 rng( 1234 );
+			auto fill = [&rng]( QByteArray & data, int size ) {
+				data.resize( size );
+				for ( char & c : data )
+					c = char( rng() );
+			};
+
+			fill( positions, count * 6 );
+			fill( texcoords, count * 4 );
+			fill( normals, count * 4 );
+			fill( colors, count * 4 );
+			fill( triangles, count * 6 );
+
+			// Every half float bit pattern, NaNs and denormals included
+			for ( int i = 0; i < count * 2; i++ ) {
+				quint16 h = quint16( i );
+				memcpy( texcoords.data() + i * 2, &h, 2 );
+			}
+		}
+
+		QByteArray positions, texcoords, normals, colors, triangles;
+	};
+
+	//! Decoded streams
+	struct Decoded
+	{
+		Decoded( int count ) : positions( count ), texcoords( count ), normals( count ), colors( count ), triangles( count ) {}
+
+		QVector<Vector3> positions;
+		QVector<Vector2> texcoords;
+		QVector<Vector3> normals;
+		QVector<Color4> colors;
+		QVector<Triangle> triangles;
+	};
+
+	void decode( const Streams & in, Decoded & out, bool simd )
+	{
+		int count = out.positions.count();
+		MeshDecode::positions( in.positions.constData(), count, 1.5f, out.positions.data(), simd );
+		MeshDecode::texcoords( in.texcoords.constData(), count, out.texcoords.data(), simd );
+		MeshDecode::udec3( in.normals.constData(), count, out.normals.data(), simd );
+		MeshDecode::colors( in.colors.constData(), count, out.colors.data(), simd );
+		MeshDecode::triangles( in.triangles.constData(), count, out.triangles.data() );
+	}
+
+	template <typename T> bool sameBits( const QVector<T> & a, const QVector<T> & b, const char * stream )
+	{
+		if ( a.count() == b.count() && memcmp( a.constData(), b.constData(), a.count() * sizeof( T ) ) == 0 )
+			return true;
+		return NifTest::fail( QString( "%1 path differs from the scalar path for %2" ).arg( MeshDecode::simdPath() ).arg( stream ) );
+	}
+
+	bool sameBits( const Decoded & a, const Decoded & b )
+	{
+		return sameBits( a.positions, b.positions, "positions" )
+			&& sameBits( a.texcoords, b.texcoords, "texture coordinates" )
+			&& sameBits( a.normals, b.normals, "UDEC3 normals" )
+			&& sameBits( a.colors, b.colors, "colors" );
+	}
+
+	//! The vector paths must match the scalar ones bit for bit
+	bool checkMeshDecode( const QStringList & args )
+	{
+		// 32768 vertices hold every half float in their texture coordinates
+		int count = NifTest::intArg( args, "vertices", 32768 );
+		Streams in( count );
+		Decoded simd( count ), scalar( count );
+		decode( in, simd, true );
+		decode( in, scalar, false );
+
+		NifTest::log( QString( "%1 vertices, %2 path" ).arg( count ).arg( MeshDecode::simdPath() ) );
+		return sameBits( simd, scalar );
+	}
+
+	//! Decode time of a large mesh, vector and scalar paths
+	bool benchMeshDecode( const QStringList & args )
+	{
+		int count = NifTest::intArg( args, "vertices", 1000000 );
+		int runs = NifTest::intArg( args, "runs", 5 );
+
+		Streams in( count );
+		Decoded simd( count ), scalar( count );
+
+		double simdMs = NifTest::bestOf( runs, [&]() { decode( in, simd, true ); } );
+		double scalarMs = NifTest::bestOf( runs, [&]() { decode( in, scalar, false ); } );
+
+		NifTest::log( QString( "%1 vertices, best of %2 runs" ).arg( count ).arg( runs ) );
+		NifTest::log( QString( "  %1: %2 ms, %3 M vertices/s" ).arg( MeshDecode::simdPath(), -6 )
+			.arg( simdMs, 0, 'f', 2 ).arg( count / simdMs / 1000.0, 0, 'f', 1 ) );
+		NifTest::log( QString( "  %1: %2 ms, %3 M vertices/s" ).arg( "Scalar", -6 )
+			.arg( scalarMs, 0, 'f', 2 ).arg( count / scalarMs / 1000.0, 0, 'f', 1 ) );
+
+		return sameBits( simd, scalar );
+	}
+}
+
+REGISTER_TEST( "meshdecode", checkMeshDecode, "MeshDecode vector and scalar paths agree bit for bit" )
+REGISTER_BENCHMARK( "meshdecode-bench", benchMeshDecode, "Decode a 1M vertex .mesh stream set (--vertices, --runs)" )
@@ -0,0 +1,174 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+
+#include "niftest.h"
+
+#include "lib/meshoptimize.h"
+
+#include <algorithm>
+#include <random>
+
+
+//! \file meshoptimizetest.cpp Vertex cache figures of MeshOptimize
+
+namespace
+{
+	//! A grid of @p size x @p size quads, with the triangles shuffled
+	QVector<Triangle> shuffledGrid( int size, QVector<Vector3> & positions )
+	{
+		const int row = size + 1;
+		positions.clear();
+		for ( int y = 0; y <= size; y++ ) {
+			for ( int x = 0; x <= size; x++ )
+				positions << Vector3( float( x ), float( y ), float( (x * y) % 3 ) );
+		}
+
+		QVector<Triangle> tris;
+		for ( int y = 0; y < size; y++ ) {
+			for ( int x = 0; x < size; x++ ) {
+				quint16 v = quint16( y * row + x );
+				tris << Triangle( v, v + 1, v + row ) << Triangle( v + 1, v + row + 1, v + row );
+			}
+		}
+
+		std::mt19937 rng( 3 );
+		std::shuffle( tris.begin(), tris.end(), rng );
+		return tris;
+	}
+
+	QVector<Triangle> sorted( QVector<Triangle> tris )
+	{
+		std::sort( tris.begin(), tris.end(), []( const Triangle & a, const Triangle & b ) {
+			return std::lexicographical_compare( &a[0], &a[0] + 3, &b[0], &b[0] + 3 );
+		} );
+		return tris;
+	}
+
+	QString describe( const MeshOptimize::CacheStats & st )
+	{
+		return QString( "ACMR %1, ATVR %2" ).arg( st.acmr(), 0, 'f', 3 ).arg( st.atvr(), 0, 'f', 3 );
+	}
+
+	//! The optimizations keep the triangles and reach the expected cache figures on a grid
+	bool checkMeshOptimize( const QStringList & args )
+	{
+		// Up to 65536 vertices, as Triangle holds 16 bit indices
+		int size = std::min( NifTest::intArg( args, "size", 100 ), 255 );
+
+		MeshOptimize::CacheStats one = MeshOptimize::analyzeVertexCache( { Triangle( 0, 1, 2 ) }, 3 );
+		if ( one.transformed != 3 || one.acmr() != 3.0 || one.atvr() != 1.0 )
+			return NifTest::fail( QString( "A single triangle: %1" ).arg( describe( one ) ) );
+
+		QVector<Vector3> positions;
+		QVector<Triangle> tris = shuffledGrid( size, positions );
+		const int numVerts = positions.count();
+
+		MeshOptimize::CacheStats before = MeshOptimize::analyzeVertexCache( tris, numVerts );
+		QVector<Triangle> cached = MeshOptimize::optimizeVertexCache( tris, numVerts );
+		MeshOptimize::CacheStats after = MeshOptimize::analyzeVertexCache( cached, numVerts );
+
+		NifTest::log( QString( "  %1 triangles, FIFO 16" ).arg( tris.count() ) );
+		NifTest::log( QString( "  shuffled:     %1" ).arg( describe( before ) ) );
+		NifTest::log( QString( "  vertex cache: %1" ).arg( describe( after ) ) );
+
+		if ( sorted( cached ) != sorted( tris ) )
+			return NifTest::fail( "optimizeVertexCache changed the triangles" );
+
+		// Shuffled, a grid is near 3 (ATVR 6). A cache ordered one stays under 1, about 0.7 here,
+		// and with two triangles per vertex the ATVR is twice that
+		if ( after.acmr() > 1.0 || after.atvr() > 2.0 )
+			return NifTest::fail( QString( "optimizeVertexCache only reached %1" ).arg( describe( after ) ) );
+
+		QVector<Triangle> drawn = MeshOptimize::optimizeOverdraw( cached, positions );
+		MeshOptimize::CacheStats overdraw = MeshOptimize::analyzeVertexCache( drawn, numVerts );
+		NifTest::log( QString( "  overdraw:     %1" ).arg( describe( overdraw ) ) );
+
+		if ( sorted( drawn ) != sorted( tris ) )
+			return NifTest::fail( "optimizeOverdraw changed the triangles" );
+		if ( overdraw.acmr() > after.acmr() * 1.05 + 1e-9 )
+			return NifTest::fail( "optimizeOverdraw raised the ACMR past its threshold" );
+
+		// The fetch order renumbers the vertices in first use order
+		QVector<Triangle> fetched = drawn;
+		QVector<int> oldIndex = MeshOptimize::optimizeVertexFetch( fetched, numVerts );
+		int next = 0;
+		for ( int t = 0; t < fetched.count(); t++ ) {
+			for ( int c = 0; c < 3; c++ ) {
+				int v = fetched[t][c];
+				if ( v > next )
+					return NifTest::fail( QString( "Vertex %1 is used before vertex %2" ).arg( v ).arg( next ) );
+				if ( v == next )
+					next++;
+				if ( oldIndex.value( v, -1 ) != drawn[t][c] )
+					return NifTest::fail( "optimizeVertexFetch returned a wrong remap table" );
+			}
+		}
+
+		// Triangles past the vertex count stay at the end
+		QVector<Triangle> withLoose = tris;
+		withLoose.prepend( Triangle( 0, 1, quint16( numVerts ) ) );
+		QVector<Triangle> loose = MeshOptimize::optimizeVertexCache( withLoose, numVerts );
+		if ( !( loose.last() == withLoose.first() ) )
+			return NifTest::fail( "A triangle past the vertex count was moved" );
+
+		return true;
+	}
+
+	//! Optimization time and cache figures of a large mesh
+	bool benchMeshOptimize( const QStringList & args )
+	{
+		int size = std::min( NifTest::intArg( args, "size", 255 ), 255 );
+		int runs = NifTest::intArg( args, "runs", 3 );
+
+		QVector<Vector3> positions;
+		QVector<Triangle> tris = shuffledGrid( size, positions );
+		const int numVerts = positions.count();
+
+		QVector<Triangle> cached, drawn;
+		double cacheMs = NifTest::bestOf( runs, [&]() { cached = MeshOptimize::optimizeVertexCache( tris, numVerts ); } );
+		double overdrawMs = NifTest::bestOf( runs, [&]() { drawn = MeshOptimize::optimizeOverdraw( cached, positions ); } );
+
+		NifTest::log( QString( "  %1 triangles, %2 vertices" ).arg( tris.count() ).arg( numVerts ) );
+		for ( int cacheSize : { 16, 32 } ) {
+			NifTest::log( QString( "  FIFO %1: shuffled %2; optimized %3; overdraw %4" ).arg( cacheSize )
+				.arg( describe( MeshOptimize::analyzeVertexCache( tris, numVerts, cacheSize ) ) )
+				.arg( describe( MeshOptimize::analyzeVertexCache( cached, numVerts, cacheSize ) ) )
+				.arg( describe( MeshOptimize::analyzeVertexCache( drawn, numVerts, cacheSize ) ) ) );
+		}
+		NifTest::log( QString( "  vertex cache %1 ms, overdraw %2 ms" ).arg( cacheMs, 0, 'f', 1 ).arg( overdrawMs, 0, 'f', 1 ) );
+		return true;
+	}
+}
+
+REGISTER_TEST( "meshoptimize", checkMeshOptimize, "Vertex cache, overdraw and fetch ordering keep the mesh and lower the ACMR" )
+REGISTER_BENCHMARK( "meshoptimize-bench", benchMeshOptimize, "ACMR, ATVR and time on a shuffled 130050 triangle grid (--size, --runs)" )
@@ -0,0 +1,371 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+
+
+#include "niftest.h"
+
+#include "lib/meshsimplify.h"
+
+#include <QMap>
+#include <QSet>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+
+//! \file meshsimplifytest.cpp Triangle counts, locked vertices, error bound and LOD ranges of MeshSimplify
+
+namespace
+{
+	/*! Append a grid of @p size x @p size quads to @p mesh
+	 *
+	 * With @p seam, the vertices of the middle column are split for their UVs, as a texture
+	 * seam would, so the grid is still one surface but has vertices sharing positions.
+	 */
+	void addGrid( MeshSimplify::Mesh & mesh, QVector<Triangle> & tris, int size, const Vector3 & offset, float bumps, bool seam )
+	{
+		const int row = size + 1;
+		const int first = mesh.positions.count();
+		const int middle = size / 2;
+
+		for ( int y = 0; y <= size; y++ ) {
+			for ( int x = 0; x <= size; x++ ) {
+				float z = bumps * std::sin( x * 0.7f ) * std::cos( y * 0.5f );
+				mesh.positions << offset + Vector3( float( x ), float( y ), z );
+				mesh.uvs << Vector2( float( x ) / size, float( y ) / size );
+			}
+		}
+
+		// The copies of the middle column, used by the quads right of it
+		QVector<int> split( row, -1 );
+		if ( seam ) {
+			for ( int y = 0; y <= size; y++ ) {
+				split[y] = mesh.positions.count();
+				mesh.positions << mesh.positions.at( first + y * row + middle );
+				mesh.uvs << Vector2( 1.0f, float( y ) / size );
+			}
+		}
+
+		for ( int y = 0; y < size; y++ ) {
+			for ( int x = 0; x < size; x++ ) {
+				auto vertex = [&]( int vx, int vy ) {
+					return quint16( (seam && vx == middle && x >= middle) ? split[vy] : first + vy * row + vx );
+				};
+				tris << Triangle( vertex( x, y ), vertex( x + 1, y ), vertex( x, y + 1 ) )
+					<< Triangle( vertex( x + 1, y ), vertex( x + 1, y + 1 ), vertex( x, y + 1 ) );
+			}
+		}
+	}
+
+	//! The first vertex at the position of each vertex, by a pairwise search
+	QVector<int> samePosition( const MeshSimplify::Mesh & mesh )
+	{
+		const QVector<Vector3> & pos = mesh.positions;
+		QVector<int> first( pos.count() );
+		for ( int a = 0; a < pos.count(); a++ ) {
+			first[a] = a;
+			for ( int b = 0; b < a; b++ ) {
+				if ( pos[a][0] == pos[b][0] && pos[a][1] == pos[b][1] && pos[a][2] == pos[b][2] ) {
+					first[a] = b;
+					break;
+				}
+			}
+		}
+		return first;
+	}
+
+	//! Vertices used by @p tris
+	QSet<int> usedVertices( const QVector<Triangle> & tris )
+	{
+		QSet<int> used;
+		for ( const Triangle & tri : tris )
+			used << tri[0] << tri[1] << tri[2];
+		return used;
+	}
+
+	//! Positions on open borders, edges between positions used by a single triangle
+	QSet<int> borderPositions( const QVector<Triangle> & tris, const QVector<int> & position )
+	{
+		QMap<QPair<int, int>, int> edges;
+		for ( const Triangle & tri : tris ) {
+			for ( int k = 0; k < 3; k++ ) {
+				int a = position[tri[k]], b = position[tri[(k + 1) % 3]];
+				edges[qMakePair( std::min( a, b ), std::max( a, b ) )]++;
+			}
+		}
+
+		QSet<int> border;
+		for ( auto it = edges.cbegin(); it != edges.cend(); ++it ) {
+			if ( it.value() == 1 )
+				border << it.key().first << it.key().second;
+		}
+		return border;
+	}
+
+	/*! Simplify and check the result against the input
+	 *
+	 * The result must keep every vertex on a seam, must have open borders only on the open
+	 * borders of the input, and with @p lockBorders must keep every border vertex.
+	 */
+	bool checkResult( const QString & what, const QVector<Triangle> & tris, const MeshSimplify::Mesh & mesh,
+		int target, float maxError, bool lockBorders, QVector<Triangle> & result )
+	{
+		MeshSimplify::Options opts;
+		opts.lockBorders = lockBorders;
+
+		float error = -1.0f;
+		result = MeshSimplify::simplify( tris, mesh, target, maxError, opts, &error );
+
+		NifTest::log( QString( "  %1: %2 triangles to %3, error %4 of at most %5" ).arg( what )
+			.arg( tris.count() ).arg( result.count() ).arg( error, 0, 'g', 3 ).arg( maxError, 0, 'g', 3 ) );
+
+		if ( error < 0.0f || error > maxError )
+			return NifTest::fail( QString( "%1: the error %2 is over the bound %3" ).arg( what ).arg( error ).arg( maxError ) );
+
+		QVector<int> position = samePosition( mesh );
+		QSet<int> before = usedVertices( tris ), after = usedVertices( result );
+		QSet<int> borderBefore = borderPositions( tris, position ), borderAfter = borderPositions( result, position );
+
+		for ( const Triangle & tri : result ) {
+			if ( position[tri[0]] == position[tri[1]] || position[tri[1]] == position[tri[2]] || position[tri[2]] == position[tri[0]] )
+				return NifTest::fail( QString( "%1: a degenerate triangle was left" ).arg( what ) );
+		}
+
+		QVector<int> wedges( position.count(), 0 );
+		for ( int v : before )
+			wedges[position[v]]++;
+
+		for ( int v : before ) {
+			if ( wedges[position[v]] > 1 && !after.contains( v ) )
+				return NifTest::fail( QString( "%1: the seam vertex %2 was collapsed" ).arg( what ).arg( v ) );
+			if ( lockBorders && borderBefore.contains( position[v] ) && !after.contains( v ) )
+				return NifTest::fail( QString( "%1: the locked border vertex %2 was collapsed" ).arg( what ).arg( v ) );
+		}
+
+		for ( int p : borderAfter ) {
+			if ( !borderBefore.contains( p ) )
+				return NifTest::fail( QString( "%1: vertex %2 is on a border it was not on before" ).arg( what ).arg( p ) );
+		}
+
+		return true;
+	}
+
+	//! The connected parts of @p tris by a flood fill over shared positions, -1 past the vertex count
+	QVector<int> floodParts( const QVector<Triangle> & tris, const MeshSimplify::Mesh & mesh, int & numParts )
+	{
+		QVector<int> position = samePosition( mesh );
+		int numVerts = mesh.positions.count();
+		QVector<int> part( tris.count(), -1 );
+		numParts = 0;
+
+		for ( int seed = 0; seed < tris.count(); seed++ ) {
+			const Triangle & s = tris[seed];
+			if ( part[seed] >= 0 || s[0] >= numVerts || s[1] >= numVerts || s[2] >= numVerts )
+				continue;
+
+			QSet<int> reached = { position[s[0]], position[s[1]], position[s[2]] };
+			part[seed] = numParts;
+			for ( bool grown = true; grown; ) {
+				grown = false;
+				for ( int t = 0; t < tris.count(); t++ ) {
+					const Triangle & tri = tris[t];
+					if ( part[t] >= 0 || tri[0] >= numVerts || tri[1] >= numVerts || tri[2] >= numVerts )
+						continue;
+					if ( reached.contains( position[tri[0]] ) || reached.contains( position[tri[1]] ) || reached.contains( position[tri[2]] ) ) {
+						reached << position[tri[0]] << position[tri[1]] << position[tri[2]];
+						part[t] = numParts;
+						grown = true;
+					}
+				}
+			}
+			numParts++;
+		}
+		return part;
+	}
+
+	bool sameTriangle( const Triangle & a, const Triangle & b )
+	{
+		return a[0] == b[0] && a[1] == b[1] && a[2] == b[2];
+	}
+
+	/*! nestedLods keeps every triangle, and its ranges hold whole parts within the targets
+	 *
+	 * Parts leave the ranges smallest area first, and a range only goes over its target
+	 * with the largest part alone.
+	 */
+	bool checkLods( const QString & what, const QVector<Triangle> & tris, const MeshSimplify::Mesh & mesh,
+		const QVector<int> & targets, QVector<int> & sizes )
+	{
+		QVector<Triangle> result = MeshSimplify::nestedLods( tris, mesh, targets, sizes );
+
+		NifTest::log( QString( "  %1: ranges of %2, %3 and %4 triangles" ).arg( what )
+			.arg( sizes.value( 0 ) ).arg( sizes.value( 1 ) ).arg( sizes.value( 2 ) ) );
+
+		if ( sizes.count() != targets.count() + 1 || std::accumulate( sizes.begin(), sizes.end(), 0 ) != tris.count() )
+			return NifTest::fail( QString( "%1: the ranges do not add up to the triangle count" ).arg( what ) );
+
+		auto less = []( const Triangle & a, const Triangle & b ) {
+			return std::lexicographical_compare( &a[0], &a[0] + 3, &b[0], &b[0] + 3 );
+		};
+		QVector<Triangle> a = tris, b = result;
+		std::sort( a.begin(), a.end(), less );
+		std::sort( b.begin(), b.end(), less );
+		if ( !std::equal( a.begin(), a.end(), b.begin(), sameTriangle ) )
+			return NifTest::fail( QString( "%1: the triangles changed" ).arg( what ) );
+
+		int numParts = 0;
+		QVector<int> part = floodParts( result, mesh, numParts );
+
+		// The range of each part, coarsest first, and the area of each part
+		QVector<int> range( numParts, -1 ), count( numParts, 0 );
+		QVector<double> area( numParts, 0.0 );
+		int t = 0;
+		for ( int r = 0; r < sizes.count(); r++ ) {
+			for ( int end = t + sizes[r]; t < end; t++ ) {
+				int p = part[t];
+				if ( p < 0 ) {
+					if ( r != sizes.count() - 1 )
+						return NifTest::fail( QString( "%1: a triangle past the vertex count is in a coarse range" ).arg( what ) );
+					continue;
+				}
+				if ( range[p] >= 0 && range[p] != r )
+					return NifTest::fail( QString( "%1: part %2 is split over two ranges" ).arg( what ).arg( p ) );
+
+				const Triangle & tri = result[t];
+				const Vector3 & p0 = mesh.positions[tri[0]];
+				range[p] = r;
+				count[p]++;
+				area[p] += Vector3::crossproduct( mesh.positions[tri[1]] - p0, mesh.positions[tri[2]] - p0 ).length();
+			}
+		}
+
+		for ( int p = 0; p < numParts; p++ ) {
+			for ( int q = 0; q < numParts; q++ ) {
+				if ( range[p] < range[q] && area[p] < area[q] )
+					return NifTest::fail( QString( "%1: a smaller part is in a coarser range than a larger one" ).arg( what ) );
+			}
+		}
+
+		// Range r is drawn by the LODs of targets[targets.count() - 1 - r] and finer
+		int drawn = 0;
+		for ( int r = 0; r < targets.count(); r++ ) {
+			drawn += sizes[r];
+			int target = targets[targets.count() - 1 - r];
+			int parts = int( std::count_if( range.begin(), range.end(), [r]( int x ) { return x >= 0 && x <= r; } ) );
+			if ( drawn > target && parts > 1 )
+				return NifTest::fail( QString( "%1: %2 triangles are drawn for a target of %3" ).arg( what ).arg( drawn ).arg( target ) );
+			if ( parts == 0 && numParts > 0 )
+				return NifTest::fail( QString( "%1: a coarse LOD lost the largest part" ).arg( what ) );
+
+			// The next part by area would not have fit
+			int next = -1;
+			for ( int p = 0; p < numParts; p++ ) {
+				if ( range[p] > r && ( next < 0 || area[p] > area[next] ) )
+					next = p;
+			}
+			if ( next >= 0 && drawn + count[next] <= target )
+				return NifTest::fail( QString( "%1: a part of %2 triangles would have fit the target of %3" )
+					.arg( what ).arg( count[next] ).arg( target ) );
+		}
+
+		return true;
+	}
+
+	//! Simplification and LOD ranges on generated grids
+	bool checkSimplify( const QStringList & )
+	{
+		QVector<Triangle> result;
+
+		// A flat grid collapses down to the target at no error
+		MeshSimplify::Mesh flat;
+		QVector<Triangle> flatTris;
+		addGrid( flat, flatTris, 24, Vector3(), 0.0f, false );
+		if ( !checkResult( "flat", flatTris, flat, 100, 1.0e-4f, false, result ) )
+			return false;
+		if ( result.count() > 100 )
+			return NifTest::fail( QString( "flat: %1 triangles left for a target of 100" ).arg( result.count() ) );
+
+		// A bumpy grid with a seam: seams stay, borders stay with lockBorders or on the border without
+		MeshSimplify::Mesh bumpy;
+		QVector<Triangle> bumpyTris;
+		addGrid( bumpy, bumpyTris, 24, Vector3(), 1.5f, true );
+		if ( !checkResult( "bumpy", bumpyTris, bumpy, 0, 1.0f, false, result )
+			|| !checkResult( "bumpy, locked borders", bumpyTris, bumpy, 0, 1.0f, true, result ) )
+			return false;
+
+		int loose = 0;
+		for ( float maxError : { 0.002f, 0.01f, 0.05f } ) {
+			if ( !checkResult( "bumpy, error bound", bumpyTris, bumpy, 0, maxError, false, result ) )
+				return false;
+			if ( loose > 0 && result.count() > loose )
+				return NifTest::fail( "bumpy: a larger error bound kept more triangles" );
+			loose = result.count();
+		}
+
+		// Triangles past the vertex count stay at the end
+		QVector<Triangle> withLoose = flatTris;
+		withLoose.prepend( Triangle( 0, 1, quint16( flat.positions.count() ) ) );
+		result = MeshSimplify::simplify( withLoose, flat, 100, 1.0f );
+		if ( result.isEmpty() || !sameTriangle( result.last(), withLoose.first() ) )
+			return NifTest::fail( "A triangle past the vertex count was changed or moved" );
+
+		// LOD ranges: a large part with a seam, a medium one and small ones
+		MeshSimplify::Mesh parts;
+		QVector<Triangle> partTris;
+		addGrid( parts, partTris, 12, Vector3(), 0.5f, true );
+		addGrid( parts, partTris, 6, Vector3( 20, 0, 0 ), 0.5f, false );
+		for ( int i = 0; i < 4; i++ )
+			addGrid( parts, partTris, 1 + i % 2, Vector3( 30 + 5 * i, 0, 0 ), 0.0f, false );
+		partTris << Triangle( 0, 1, quint16( parts.positions.count() ) );
+
+		QVector<int> sizes;
+		int numTris = partTris.count();
+		for ( const QVector<int> & targets : { QVector<int>{ numTris / 2, numTris / 4 }, QVector<int>{ numTris * 9 / 10, numTris * 8 / 10 },
+			QVector<int>{ numTris - 10, numTris - 20 },
+			QVector<int>{ 10, 5 }, QVector<int>{ numTris, numTris } } ) {
+			if ( !checkLods( QString( "LODs for %1 and %2" ).arg( targets[0] ).arg( targets[1] ), partTris, parts, targets, sizes ) )
+				return false;
+		}
+
+		// A single surface cannot leave anything out
+		if ( !checkLods( "LODs of one surface", bumpyTris, bumpy, { 100, 50 }, sizes ) )
+			return false;
+		if ( sizes.value( 0 ) != bumpyTris.count() )
+			return NifTest::fail( "LODs of one surface: the coarsest range lost triangles" );
+
+		return true;
+	}
+}
+
+REGISTER_TEST( "simplify", checkSimplify, "Simplification reaches its target within the error bound, keeps seams and borders, and LOD ranges nest" )
@@ -0,0 +1,517 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+
+
+#include "niftest.h"
+
+#include "lib/moppbuilder.h"
+#include "lib/nifmopp.h"
+#include "model/nifmodel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+
+//! \file mopptest.cpp MoppBuilder query and build checks
+
+namespace
+{
+	/*! A hand-assembled MOPP code and the keys expected at some points
+	 *
+	 * The origin is 0 and the scale 65536, so a coordinate in [n, n + 1) lands in cell n
+	 * of the 8-bit space that the commands compare against.
+	 */
+	struct Fixture
+	{
+		const char * name;
+		QByteArray data;
+		//! Query points and the keys each returns, in any order
+		QVector<QPair<Vector3, QVector<quint32>>> queries;
+	};
+
+	QByteArray bytes( std::initializer_list<int> list )
+	{
+		QByteArray out;
+		for ( int b : list )
+			out.append( char( b ) );
+		return out;
+	}
+
+	QVector<Fixture> fixtures()
+	{
+		const Vector3 any( 10.5f, 20.5f, 30.5f );
+
+		return {
+			{ "TERM4", bytes( { 0x35 } ), { { any, { 5 } } } },
+			{ "TERM8", bytes( { 0x50, 0x40 } ), { { any, { 0x40 } } } },
+			{ "TERM16", bytes( { 0x51, 0x12, 0x34 } ), { { any, { 0x1234 } } } },
+			{ "TERM24", bytes( { 0x52, 0x12, 0x34, 0x56 } ), { { any, { 0x123456 } } } },
+			{ "TERM32", bytes( { 0x53, 0x12, 0x34, 0x56, 0x78 } ), { { any, { 0x12345678 } } } },
+			{ "RETURN", bytes( { 0x00 } ), { { any, {} } } },
+			// Split on Y: at or below 100 left to key 1, at or above 150 right to key 2
+			{ "SPLIT_Y", bytes( { 0x11, 100, 150, 1, 0x31, 0x32 } ), {
+				{ Vector3( 0.5f, 50.5f, 0.5f ), { 1 } },
+				{ Vector3( 0.5f, 100.5f, 0.5f ), { 1 } },
+				{ Vector3( 0.5f, 120.5f, 0.5f ), {} },
+				{ Vector3( 0.5f, 150.5f, 0.5f ), { 2 } },
+				{ Vector3( 0.5f, 200.5f, 0.5f ), { 2 } }
+			} },
+			// Overlapping sides, both are taken between 100 and 150
+			{ "SPLIT_Z overlap", bytes( { 0x12, 150, 100, 1, 0x31, 0x32 } ), {
+				{ Vector3( 0.5f, 0.5f, 50.5f ), { 1 } },
+				{ Vector3( 0.5f, 0.5f, 120.5f ), { 1, 2 } },
+				{ Vector3( 0.5f, 0.5f, 200.5f ), { 2 } }
+			} },
+			{ "DOUBLE_CUT_Z", bytes( { 0x28, 10, 20, 0x33 } ), {
+				{ Vector3( 0.5f, 0.5f, 9.5f ), {} },
+				{ Vector3( 0.5f, 0.5f, 10.5f ), { 3 } },
+				{ Vector3( 0.5f, 0.5f, 20.5f ), { 3 } },
+				{ Vector3( 0.5f, 0.5f, 21.5f ), {} }
+			} },
+			// 16-bit offsets of the two sides after the 7 bytes of the command
+			{ "SPLIT_JUMP_X", bytes( { 0x23, 100, 150, 0x00, 0x00, 0x00, 0x01, 0x31, 0x32 } ), {
+				{ Vector3( 50.5f, 0.5f, 0.5f ), { 1 } },
+				{ Vector3( 120.5f, 0.5f, 0.5f ), {} },
+				{ Vector3( 200.5f, 0.5f, 0.5f ), { 2 } }
+			} },
+			{ "JUMP8", bytes( { 0x05, 0x02, 0x31, 0x31, 0x33 } ), { { any, { 3 } } } },
+			{ "JUMP16", bytes( { 0x06, 0x00, 0x01, 0x31, 0x34 } ), { { any, { 4 } } } },
+			{ "REOFFSET8", bytes( { 0x09, 0x10, 0x32 } ), { { any, { 18 } } } },
+			{ "REOFFSET16", bytes( { 0x0A, 0x01, 0x00, 0x50, 0x05 } ), { { any, { 261 } } } },
+			{ "REOFFSET32", bytes( { 0x0B, 0x00, 0x00, 0x10, 0x00, 0x30 } ), { { any, { 4096 } } } },
+			// Each side of the split only sees its own key offset
+			{ "REOFFSET in a split", bytes( { 0x10, 150, 100, 3, 0x09, 0x10, 0x31, 0x32 } ), {
+				{ Vector3( 120.5f, 0.5f, 0.5f ), { 17, 2 } }
+			} }
+		};
+	}
+
+	QVector<quint32> sorted( QVector<quint32> keys )
+	{
+		std::sort( keys.begin(), keys.end() );
+		return keys;
+	}
+
+	QString describe( const QVector<quint32> & keys )
+	{
+		QStringList list;
+		for ( quint32 k : keys )
+			list << QString::number( k );
+		return "{" + list.join( ", " ) + "}";
+	}
+
+	//! query() on the fixtures, and its errors on broken codes
+	bool checkFixtures()
+	{
+		MoppBuilder::Code code;
+		code.scale = 65536.0f;
+
+		for ( const Fixture & f : fixtures() ) {
+			code.data = f.data;
+			for ( const auto & q : f.queries ) {
+				QVector<quint32> result;
+				QString error;
+				if ( !MoppBuilder::query( code, q.first, result, &error ) )
+					return NifTest::fail( QString( "%1: %2" ).arg( f.name ).arg( error ) );
+
+				if ( sorted( result ) != sorted( q.second ) ) {
+					return NifTest::fail( QString( "%1 at (%2, %3, %4): %5, expected %6" ).arg( f.name )
+						.arg( q.first[0] ).arg( q.first[1] ).arg( q.first[2] )
+						.arg( describe( result ) ).arg( describe( q.second ) ) );
+				}
+			}
+		}
+
+		const QVector<QPair<const char *, QByteArray>> broken = {
+			{ "an empty code", QByteArray() },
+			{ "a cut off terminal", bytes( { 0x51, 0x12 } ) },
+			{ "a split without its right side", bytes( { 0x10, 255, 0, 1, 0x31 } ) },
+			{ "a jump past the end", bytes( { 0x05, 0x10, 0x31 } ) },
+			{ "a rescale command", bytes( { 0x01, 0x00, 0x00, 0x00, 0x31 } ) }
+		};
+		for ( const auto & b : broken ) {
+			code.data = b.second;
+			QVector<quint32> result;
+			QString error;
+			if ( MoppBuilder::query( code, Vector3( 0.5f, 0.5f, 0.5f ), result, &error ) || error.isEmpty() )
+				return NifTest::fail( QString( "query() accepted %1" ).arg( b.first ) );
+		}
+
+		NifTest::log( QString( "  %1 hand-assembled codes" ).arg( fixtures().count() ) );
+		return true;
+	}
+
+	//! A @p size x @p size grid of unit quads on a bump, with the triangles shuffled
+	QVector<Triangle> grid( int size, QVector<Vector3> & positions )
+	{
+		const int row = size + 1;
+		positions.clear();
+		for ( int y = 0; y <= size; y++ ) {
+			for ( int x = 0; x <= size; x++ )
+				positions << Vector3( float( x ), float( y ), float( (x * (size - x) + y * (size - y)) % 7 ) * 0.25f );
+		}
+
+		QVector<Triangle> tris;
+		for ( int y = 0; y < size; y++ ) {
+			for ( int x = 0; x < size; x++ ) {
+				quint16 v = quint16( y * row + x );
+				tris << Triangle( v, v + 1, v + row ) << Triangle( v + 1, v + row + 1, v + row );
+			}
+		}
+
+		std::mt19937 rng( 5 );
+		std::shuffle( tris.begin(), tris.end(), rng );
+		return tris;
+	}
+
+	//! The 12 triangles of an axis aligned box
+	QVector<Triangle> box( QVector<Vector3> & positions )
+	{
+		positions.clear();
+		for ( int i = 0; i < 8; i++ )
+			positions << Vector3( (i & 1) ? 2.0f : -2.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 3.0f : -3.0f );
+
+		return {
+			{ 0, 2, 1 }, { 1, 2, 3 }, { 4, 5, 6 }, { 5, 7, 6 },
+			{ 0, 1, 4 }, { 1, 5, 4 }, { 2, 6, 3 }, { 3, 6, 7 },
+			{ 0, 4, 2 }, { 2, 4, 6 }, { 1, 3, 5 }, { 3, 7, 5 }
+		};
+	}
+
+	Vector3 center( const QVector<Vector3> & positions, const Triangle & t )
+	{
+		return (positions[t[0]] + positions[t[1]] + positions[t[2]]) / 3.0f;
+	}
+
+	//! Build and validate one mesh, and check that queries stay close to the triangles
+	bool checkBuild( const QString & name, const QVector<Vector3> & positions, const QVector<Triangle> & tris,
+		const QVector<quint32> & keys, int maxKeys )
+	{
+		MoppBuilder::Code code = MoppBuilder::build( positions, tris, keys );
+		if ( code.data != MoppBuilder::build( positions, tris, keys ).data )
+			return NifTest::fail( QString( "%1: two builds differ" ).arg( name ) );
+
+		QString error;
+		MoppBuilder::Stats stats;
+		if ( !MoppBuilder::validate( code, positions, tris, keys, &error, &stats ) )
+			return NifTest::fail( QString( "%1: %2" ).arg( name ).arg( error ) );
+
+		int inRange = 0;
+		for ( const Triangle & t : tris )
+			inRange += ( t[0] < positions.count() && t[1] < positions.count() && t[2] < positions.count() );
+		if ( stats.leaves != inRange )
+			return NifTest::fail( QString( "%1: %2 leaves for %3 triangles" ).arg( name ).arg( stats.leaves ).arg( inRange ) );
+
+		int most = 0;
+		for ( int t = 0; t < tris.count(); t++ ) {
+			if ( tris[t][0] >= positions.count() || tris[t][1] >= positions.count() || tris[t][2] >= positions.count() )
+				continue;
+
+			QVector<quint32> result;
+			MoppBuilder::query( code, center( positions, tris[t] ), result );
+			most = std::max( most, result.count() );
+		}
+		if ( most > maxKeys )
+			return NifTest::fail( QString( "%1: a triangle center reaches %2 leaves" ).arg( name ).arg( most ) );
+
+		NifTest::log( QString( "  %1: %2 triangles, %3 bytes, depth %4, at most %5 keys per center" )
+			.arg( name, -16 ).arg( inRange ).arg( stats.codeSize ).arg( stats.depth ).arg( most ) );
+		return true;
+	}
+
+	//! build() output reaches every triangle and nothing away from the mesh
+	bool checkGenerated()
+	{
+		QVector<Vector3> positions;
+		QVector<Triangle> tris = box( positions );
+		if ( !checkBuild( "box", positions, tris, {}, 12 ) )
+			return false;
+
+		// 8192 triangles, so the splits need the long jumps past the left side
+		tris = grid( 64, positions );
+		if ( !checkBuild( "grid", positions, tris, {}, 12 ) )
+			return false;
+
+		// Keys of every terminal width
+		QVector<quint32> keys( tris.count() );
+		for ( int t = 0; t < keys.count(); t++ )
+			keys[t] = quint32( t ) * 0x9E3779B1u >> (t % 4 * 8);
+		if ( !checkBuild( "grid, keyed", positions, tris, keys, 12 ) )
+			return false;
+
+		// A triangle past the vertex count is left out by both build() and validate()
+		QVector<Triangle> loose = tris;
+		loose.insert( 10, Triangle( 0, 1, quint16( positions.count() ) ) );
+		if ( !checkBuild( "grid, loose", positions, loose, {}, 12 ) )
+			return false;
+
+		// The bump is under 2 units high, the grid 64 units wide
+		MoppBuilder::Code code = MoppBuilder::build( positions, tris );
+		QVector<quint32> result;
+		MoppBuilder::query( code, Vector3( 32.0f, 32.0f, 40.0f ), result );
+		if ( !result.isEmpty() )
+			return NifTest::fail( QString( "A point above the grid reaches %1 leaves" ).arg( result.count() ) );
+
+		if ( !MoppBuilder::build( positions, {} ).data.isEmpty() || !MoppBuilder::build( {}, tris ).data.isEmpty() )
+			return NifTest::fail( "build() made a code without geometry" );
+
+		return true;
+	}
+
+	/*! Compare build() with a reference MOPP code of the same triangles
+	 *
+	 * query() must decode the reference at every vertex and center of a triangle. build() must
+	 * choose the same origin and scale, and reach at each of these points at least the triangles
+	 * the reference reaches there.
+	 *
+	 * With @p indexKeys, the reference must also return each triangle by its index at its own
+	 * points, which is the key layout build() assumes. Otherwise, for several sub shapes, the
+	 * points where it does not are only counted, as build() is not used for these without asking.
+	 */
+	bool compareReference( const QString & what, const MoppBuilder::Code & reference,
+		const QVector<Vector3> & verts, const QVector<Triangle> & tris, bool indexKeys )
+	{
+		MoppBuilder::Code built = MoppBuilder::build( verts, tris );
+
+		Vector3 lo = verts.value( 0 ), hi = lo;
+		for ( const Vector3 & v : verts ) {
+			lo.boundMin( v );
+			hi.boundMax( v );
+		}
+		float size = std::max( { hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2], 1.0f } );
+
+		for ( int a = 0; a < 3; a++ ) {
+			if ( std::fabs( built.origin[a] - reference.origin[a] ) > 1.0e-4f * size )
+				return NifTest::fail( QString( "%1: the origin (%2, %3, %4) differs from the reference (%5, %6, %7)" ).arg( what )
+					.arg( built.origin[0] ).arg( built.origin[1] ).arg( built.origin[2] )
+					.arg( reference.origin[0] ).arg( reference.origin[1] ).arg( reference.origin[2] ) );
+		}
+		if ( std::fabs( built.scale - reference.scale ) > 1.0e-4f * reference.scale )
+			return NifTest::fail( QString( "%1: the scale %2 differs from the reference %3" ).arg( what ).arg( built.scale ).arg( reference.scale ) );
+
+		int points = 0, otherKeys = 0;
+		QVector<quint32> expected, result;
+		for ( int t = 0; t < tris.count(); t++ ) {
+			const Triangle & tri = tris[t];
+			if ( tri[0] >= verts.count() || tri[1] >= verts.count() || tri[2] >= verts.count() )
+				continue;
+
+			for ( const Vector3 & p : { verts[tri[0]], verts[tri[1]], verts[tri[2]], center( verts, tri ) } ) {
+				QString error;
+				expected.clear();
+				if ( !MoppBuilder::query( reference, p, expected, &error ) )
+					return NifTest::fail( QString( "%1: the reference could not be decoded: %2" ).arg( what ).arg( error ) );
+
+				if ( !expected.contains( quint32( t ) ) ) {
+					if ( indexKeys )
+						return NifTest::fail( QString( "%1: the reference does not return triangle %2 by its index" ).arg( what ).arg( t ) );
+					otherKeys++;
+				}
+
+				result.clear();
+				MoppBuilder::query( built, p, result );
+				for ( quint32 key : expected ) {
+					if ( indexKeys && !result.contains( key ) )
+						return NifTest::fail( QString( "%1: build() misses triangle %2 near triangle %3" ).arg( what ).arg( key ).arg( t ) );
+				}
+				points++;
+			}
+		}
+
+		NifTest::log( QString( "  %1: %2 triangles, reference %3 bytes, built %4 bytes, depth %5%6" )
+			.arg( what ).arg( tris.count() ).arg( reference.data.size() ).arg( built.stats.codeSize ).arg( built.stats.depth )
+			.arg( indexKeys ? QString() : QString( ", %1 of %2 points keyed otherwise" ).arg( otherKeys ).arg( points ) ) );
+		return true;
+	}
+
+	/*! Compare build() with NifMopp.dll on generated meshes, where it is available
+	 *
+	 * The origin documented in nif.xml, the vertex minimum less 0.1, is checked in any case.
+	 */
+	bool checkNifMopp()
+	{
+		struct Mesh
+		{
+			QString name;
+			QVector<Vector3> verts;
+			QVector<Triangle> tris;
+		};
+
+		QVector<Mesh> meshes( 3 );
+		meshes[0].name = "box";
+		meshes[0].tris = box( meshes[0].verts );
+		meshes[1].name = "grid 16";
+		meshes[1].tris = grid( 16, meshes[1].verts );
+		meshes[2].name = "grid 64";
+		meshes[2].tris = grid( 64, meshes[2].verts );
+
+		for ( const Mesh & m : meshes ) {
+			Vector3 lo = m.verts[0];
+			for ( const Vector3 & v : m.verts )
+				lo.boundMin( v );
+
+			MoppBuilder::Code code = MoppBuilder::build( m.verts, m.tris );
+			for ( int a = 0; a < 3; a++ ) {
+				if ( code.origin[a] != lo[a] - 0.1f )
+					return NifTest::fail( QString( "%1: the origin is not the vertex minimum less 0.1" ).arg( m.name ) );
+			}
+		}
+
+		if ( !NifMopp::isAvailable() ) {
+			NifTest::log( "  NifMopp.dll not found, build() is only compared with the codes of the given files" );
+			return true;
+		}
+
+		for ( const Mesh & m : meshes ) {
+			MoppBuilder::Code reference = NifMopp::build( {}, m.verts, m.tris );
+			if ( reference.data.isEmpty() )
+				return NifTest::fail( QString( "%1: NifMopp.dll made no code" ).arg( m.name ) );
+			if ( !compareReference( QString( "NifMopp.dll, %1" ).arg( m.name ), reference, m.verts, m.tris, true ) )
+				return false;
+		}
+
+		// Two sub shapes, to see how NifMopp.dll keys them
+		const Mesh & m = meshes.last();
+		int half = m.verts.count() / 2;
+		MoppBuilder::Code reference = NifMopp::build( { half, m.verts.count() - half }, m.verts, m.tris );
+		if ( !reference.data.isEmpty() && !compareReference( "NifMopp.dll, grid 64 in 2 sub shapes", reference, m.verts, m.tris, false ) )
+			return false;
+
+		return true;
+	}
+
+	/*! Compare build() with the game MOPP codes of the given files
+	 *
+	 * Shapes with a single sub shape must be keyed by triangle index. With several sub shapes,
+	 * the points where the game code keys the triangles otherwise are counted.
+	 */
+	bool checkFiles( const QStringList & files )
+	{
+		bool ok = true;
+		for ( const QString & fname : files ) {
+			NifModel nif;
+			if ( !nif.loadFromFile( fname ) ) {
+				ok = NifTest::fail( QString( "%1: could not be loaded" ).arg( fname ) );
+				continue;
+			}
+
+			int checked = 0, skipped = 0;
+			for ( int b = 0; b < nif.getBlockCount(); b++ ) {
+				QModelIndex iMopp = nif.getBlockIndex( b );
+				if ( !nif.isNiBlock( iMopp, "bhkMoppBvTreeShape" ) )
+					continue;
+
+				QModelIndex iShape = nif.getBlockIndex( nif.getLink( iMopp, "Shape" ) );
+				QModelIndex iData = nif.getBlockIndex( nif.getLink( iShape, "Data" ) );
+				if ( !nif.isNiBlock( iShape, "bhkPackedNiTriStripsShape" ) || !nif.isNiBlock( iData, "hkPackedNiTriStripsData" ) ) {
+					skipped++;
+					continue;
+				}
+
+				QModelIndex iMoppCode = nif.getIndex( iMopp, "MOPP Code" );
+				Vector4 offset = nif.get<Vector4>( iMoppCode, "Offset" );
+				MoppBuilder::Code code;
+				code.origin = Vector3( offset );
+				code.scale = offset[3];
+				code.data = nif.get<QByteArray>( nif.getIndex( iMoppCode, "Data" ).child( 0, 0 ) );
+
+				QVector<Vector3> verts = nif.getArray<Vector3>( iData, "Vertices" );
+				QModelIndex iTriangles = nif.getIndex( iData, "Triangles" );
+				QVector<Triangle> tris( nif.get<int>( iData, "Num Triangles" ) );
+				for ( int t = 0; t < tris.count(); t++ )
+					tris[t] = nif.get<Triangle>( iTriangles.child( t, 0 ), "Triangle" );
+
+				int subShapes = nif.checkVersion( 0x14020007, 0x14020007 ) ? nif.get<int>( iData, "Num Sub Shapes" )
+					: nif.get<int>( iShape, "Num Sub Shapes" );
+
+				if ( compareReference( QString( "%1 block %2" ).arg( fname ).arg( b ), code, verts, tris, subShapes <= 1 ) )
+					checked++;
+				else
+					ok = false;
+			}
+
+			NifTest::log( QString( "  %1: %2 MOPP codes compared, %3 skipped" ).arg( fname ).arg( checked ).arg( skipped ) );
+		}
+		return ok;
+	}
+
+	//! Hand-assembled codes, generated meshes, then the references of NifMopp.dll and the given files
+	bool checkMopp( const QStringList & args )
+	{
+		return checkFixtures() && checkGenerated() && checkNifMopp() && checkFiles( NifTest::files( args ) );
+	}
+
+	//! Build time, code size, depth and query time over growing grids
+	bool benchMopp( const QStringList & args )
+	{
+		int largest = std::min( NifTest::intArg( args, "size", 255 ), 255 );
+		int runs = NifTest::intArg( args, "runs", 3 );
+
+		for ( int size = std::min( 8, largest ); ; size = std::min( size * 2, largest ) ) {
+			QVector<Vector3> positions;
+			QVector<Triangle> tris = grid( size, positions );
+
+			MoppBuilder::Code code;
+			double buildMs = NifTest::bestOf( runs, [&]() { code = MoppBuilder::build( positions, tris ); } );
+
+			QVector<Vector3> points;
+			for ( const Triangle & t : tris )
+				points << center( positions, t );
+
+			qint64 found = 0;
+			double queryMs = NifTest::bestOf( runs, [&]() {
+				found = 0;
+				QVector<quint32> result;
+				for ( const Vector3 & p : points ) {
+					result.clear();
+					MoppBuilder::query( code, p, result );
+					found += result.count();
+				}
+			} );
+
+			NifTest::log( QString( "  %1 triangles: build %2 ms, %3 bytes (%4 per triangle), depth %5, "
+				"query %6 us, %7 keys per query" )
+				.arg( tris.count(), 6 ).arg( buildMs, 0, 'f', 2 ).arg( code.stats.codeSize )
+				.arg( double( code.stats.codeSize ) / tris.count(), 0, 'f', 2 ).arg( code.stats.depth )
+				.arg( queryMs * 1000.0 / points.count(), 0, 'f', 3 ).arg( double( found ) / points.count(), 0, 'f', 2 ) );
+
+			if ( size >= largest )
+				break;
+		}
+		return true;
+	}
+}
+
+REGISTER_TEST( "mopp", checkMopp, "MOPP queries on hand-assembled codes and built codes, compared with NifMopp.dll and the codes of the given files" )
+REGISTER_BENCHMARK( "mopp-bench", benchMopp, "MOPP build and query figures from 128 to 130050 triangles (--size, --runs)" )
@@ -0,0 +1,287 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+
+#include "niftest.h"
+
+#include "data/nifvalue.h"
+#include "model/nifmodel.h"
+
+#include <QApplication>
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QMap>
+#include <QSettings>
+
+#include <cstdio>
+#include <random>
+
+#if defined(Q_OS_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(Q_OS_LINUX)
+#include <unistd.h>
+#endif
+
+
+//! \file niftest.cpp NifTest runner
+
+namespace
+{
+	struct Entry
+	{
+		NifTest::Function func;
+		QString description;
+		bool benchmark;
+	};
+
+	//! Sorted by name; a function so it exists before the first Registrar runs
+	QMap<QString, Entry> & registry()
+	{
+		static QMap<QString, Entry> tests;
+		return tests;
+	}
+
+	void usage()
+	{
+		NifTest::log( "Usage: NifTest all | <name> [--option=value] [files]\n" );
+		for ( bool benchmark : { false, true } ) {
+			NifTest::log( benchmark ? "Benchmarks:" : "Checks:" );
+			for ( auto it = registry().cbegin(); it != registry().cend(); ++it ) {
+				if ( it.value().benchmark == benchmark )
+					NifTest::log( QString( "  %1  %2" ).arg( it.key(), -20 ).arg( it.value().description ) );
+			}
+		}
+	}
+
+	bool run( const QString & name, const Entry & entry, const QStringList & args )
+	{
+		NifTest::log( QString( "== %1" ).arg( name ) );
+		bool ok = entry.func( args );
+		NifTest::log( QString( "== %1 %2\n" ).arg( name, ok ? "passed" : "FAILED" ) );
+		return ok;
+	}
+}
+
+NifTest::Registrar::Registrar( const char * name, Function func, const char * description, bool benchmark )
+{
+	registry().insert( name, { func, description, benchmark } );
+}
+
+void NifTest::log( const QString & msg )
+{
+	fprintf( stdout, "%s\n", qPrintable( msg ) );
+	fflush( stdout );
+}
+
+bool NifTest::fail( const QString & msg )
+{
+	fprintf( stderr, "FAIL: %s\n", qPrintable( msg ) );
+	fflush( stderr );
+	return false;
+}
+
+int NifTest::intArg( const QStringList & args, const QString & name, int fallback )
+{
+	QString prefix = QString( "--%1=" ).arg( name );
+	for ( const QString & arg : args ) {
+		if ( arg.startsWith( prefix ) ) {
+			bool ok = false;
+			int value = arg.mid( prefix.length() ).toInt( &ok );
+			return ok ? value : fallback;
+		}
+	}
+	return fallback;
+}
+
+QStringList NifTest::files( const QStringList & args )
+{
+	QStringList result;
+	for ( const QString & arg : args ) {
+		if ( !arg.startsWith( "--" ) )
+			result << arg;
+	}
+	return result;
+}
+
+qint64 NifTest::residentBytes()
+{
+#if defined(Q_OS_WIN32)
+	PROCESS_MEMORY_COUNTERS pmc;
+	if ( GetProcessMemoryInfo( GetCurrentProcess(), &pmc, sizeof( pmc ) ) )
+		return qint64( pmc.WorkingSetSize );
+#elif defined(Q_OS_LINUX)
+	if ( FILE * f = fopen( "/proc/self/statm", "r" ) ) {
+		long pages = 0, resident = 0;
+		int n = fscanf( f, "%ld %ld", &pages, &resident );
+		fclose( f );
+		if ( n == 2 )
+			return qint64( resident ) * sysconf( _SC_PAGESIZE );
+	}
+#endif
+	return 0;
+}
+
+QVector<NifTest::Version> NifTest::versions()
+{
+	return {
+		{ "4.0.0.2", 0, 0 },
+		{ "10.0.1.0", 0, 0 },
+		{ "20.0.0.4", 11, 11 },
+		{ "20.0.0.5", 11, 11 },
+		{ "20.2.0.7", 11, 34 },
+		{ "20.2.0.7", 12, 83 },
+		{ "20.2.0.7", 12, 100 },
+		{ "20.2.0.7", 12, 130 },
+	};
+}
+
+bool NifTest::generate( NifModel & nif, const Version & version, int shapes, int vertices )
+{
+	// NifModel::clear() starts from the startup defaults, these are NifTest's own settings
+	QSettings settings;
+	settings.beginGroup( "Settings/NIF/Startup Defaults" );
+	settings.setValue( "Version", version.version );
+	settings.setValue( "User Version", version.userVersion );
+	settings.setValue( "User Version 2", version.bsVersion );
+	settings.endGroup();
+
+	nif.updateSettings();
+	nif.clear();
+
+	if ( nif.getVersion() != version.version )
+		return fail( QString( "Version %1 is not supported by nif.xml" ).arg( version.version ) );
+
+	std::mt19937 rng( shapes * 31 + vertices );
+	std::uniform_real_distribution<float> coord( -100.0f, 100.0f );
+
+	QPersistentModelIndex iRoot = nif.insertNiBlock( "NiNode" );
+	nif.set<QString>( iRoot, "Name", "Scene Root" );
+
+	QVector<qint32> children;
+	for ( int s = 0; s < shapes; s++ ) {
+		QModelIndex iShape = nif.insertNiBlock( "NiTriShape" );
+		nif.set<QString>( iShape, "Name", QString( "Shape:%1" ).arg( s ) );
+		nif.set<Vector3>( iShape, "Translation", Vector3( float( s ), 0.0f, 0.0f ) );
+		children << nif.getBlockNumber( iShape );
+
+		QModelIndex iData = nif.insertNiBlock( "NiTriShapeData" );
+		nif.setLink( nif.getBlockIndex( children.last() ), "Data", nif.getBlockNumber( iData ) );
+
+		QVector<Vector3> verts( vertices );
+		for ( Vector3 & v : verts )
+			v = Vector3( coord( rng ), coord( rng ), coord( rng ) );
+
+		nif.set<int>( iData, "Num Vertices", vertices );
+		nif.set<int>( iData, "Has Vertices", 1 );
+		nif.updateArraySize( iData, "Vertices" );
+		nif.setArray<Vector3>( iData, "Vertices", verts );
+	}
+
+	nif.set<int>( iRoot, "Num Children", children.count() );
+	nif.updateArraySize( iRoot, "Children" );
+	nif.setLinkArray( iRoot, "Children", children );
+	return true;
+}
+
+QByteArray NifTest::save( const NifModel & nif )
+{
+	QBuffer buffer;
+	buffer.open( QIODevice::WriteOnly );
+	if ( !nif.save( buffer ) )
+		return QByteArray();
+	return buffer.data();
+}
+
+bool NifTest::load( NifModel & nif, const QByteArray & data )
+{
+	QBuffer buffer;
+	buffer.setData( data );
+	buffer.open( QIODevice::ReadOnly );
+	return nif.load( buffer );
+}
+
+QString NifTest::md5( const QByteArray & data )
+{
+	return QString::fromLatin1( QCryptographicHash::hash( data, QCryptographicHash::Md5 ).toHex() );
+}
+
+
+//! The test runner
+int main( int argc, char * argv[] )
+{
+	// Some model code reports through message boxes, pass "-platform offscreen" to run headless
+	QApplication app( argc, argv );
+	app.setOrganizationName( "NifTools" );
+	app.setOrganizationDomain( "niftools.org" );
+	app.setApplicationName( "NifTest" );
+
+	qRegisterMetaType<NifValue>( "NifValue" );
+	QMetaType::registerComparators<NifValue>();
+
+	QStringList args = app.arguments().mid( 1 );
+	if ( args.isEmpty() || args.first() == "--help" ) {
+		usage();
+		return 0;
+	}
+
+	// The file names are relative to the working directory, nif.xml is found next to the executable
+	if ( !NifModel::loadXML() ) {
+		NifTest::fail( QString( "nif.xml was not found in %1" ).arg( QDir::toNativeSeparators( app.applicationDirPath() ) ) );
+		return 2;
+	}
+
+	QString name = args.takeFirst();
+	if ( name == "all" ) {
+		QStringList failed;
+		for ( auto it = registry().cbegin(); it != registry().cend(); ++it ) {
+			if ( !it.value().benchmark && !run( it.key(), it.value(), args ) )
+				failed << it.key();
+		}
+
+		if ( !failed.isEmpty() ) {
+			NifTest::fail( QString( "%1 checks failed: %2" ).arg( failed.count() ).arg( failed.join( ", " ) ) );
+			return 1;
+		}
+		return 0;
+	}
+
+	auto it = registry().constFind( name );
+	if ( it == registry().cend() ) {
+		NifTest::fail( QString( "Unknown check or benchmark '%1'" ).arg( name ) );
+		usage();
+		return 2;
+	}
+
+	return run( it.key(), it.value(), args ) ? 0 : 1;
+}
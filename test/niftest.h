@@ -0,0 +1,126 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+
+#ifndef NIFTEST_H
+#define NIFTEST_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include <algorithm>
+#include <cfloat>
+
+
+class NifModel;
+
+//! \file niftest.h Checks and benchmarks run by NifTest
+
+//! Register a test function using a NifTest::Registrar
+#define REGISTER_TEST( NAME, FUNC, DESCRIPTION ) static NifTest::Registrar __ ## FUNC ## __( NAME, FUNC, DESCRIPTION, false );
+//! Register a benchmark function using a NifTest::Registrar
+#define REGISTER_BENCHMARK( NAME, FUNC, DESCRIPTION ) static NifTest::Registrar __ ## FUNC ## __( NAME, FUNC, DESCRIPTION, true );
+
+/*! Command line runner for the checks and benchmarks in test/
+ *
+ * NifTest links the NifSkope sources without the main window (see NifTest.pro).
+ * "NifTest all" runs every check, "NifTest <name> [args]" runs one check or benchmark.
+ * The exit code is non-zero if a check failed.
+ */
+namespace NifTest
+{
+	//! A check or benchmark, returns false on failure
+	using Function = bool (*)( const QStringList & args );
+
+	//! Registers a check or benchmark at static initialization
+	class Registrar final
+	{
+	public:
+		Registrar( const char * name, Function func, const char * description, bool benchmark );
+	};
+
+	//! Print a line to stdout
+	void log( const QString & msg );
+	//! Print a failure to stderr, always returns false
+	bool fail( const QString & msg );
+
+	//! Value of the "--name=value" argument, or @p fallback
+	int intArg( const QStringList & args, const QString & name, int fallback );
+	//! The arguments not starting with "--"
+	QStringList files( const QStringList & args );
+
+	//! Best wall time of @p runs calls to @p func, in milliseconds
+	template <typename F> double bestOf( int runs, F func )
+	{
+		double best = DBL_MAX;
+		for ( int i = 0; i < runs; i++ ) {
+			QElapsedTimer timer;
+			timer.start();
+			func();
+			best = std::min( best, timer.nsecsElapsed() / 1e6 );
+		}
+		return best;
+	}
+
+	//! Resident set size of the process in bytes, 0 where unknown
+	qint64 residentBytes();
+
+	//! A file version to generate models for
+	struct Version
+	{
+		const char * version;
+		int userVersion;
+		int bsVersion;
+	};
+
+	//! Morrowind to Fallout 4
+	QVector<Version> versions();
+
+	/*! Replace the contents of @p nif with a generated scene
+	 *
+	 * A root NiNode with @p shapes NiTriShape children, each with its own NiTriShapeData
+	 * of @p vertices random vertices. The same arguments give the same scene.
+	 */
+	bool generate( NifModel & nif, const Version & version, int shapes, int vertices );
+
+	//! Save @p nif to memory
+	QByteArray save( const NifModel & nif );
+	//! Load @p nif from memory
+	bool load( NifModel & nif, const QByteArray & data );
+	//! Hex MD5 digest of @p data
+	QString md5( const QByteArray & data );
+}
+
+#endif
@@ -0,0 +1,167 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+
+#include "niftest.h"
+
+#include "data/nifpool.h"
+#include "model/nifmodel.h"
+
+#include <QFile>
+
+#include <memory>
+
+
+//! \file pooltest.cpp NifPool checks and benchmark
+
+namespace
+{
+	inline double mb( qint64 bytes )
+	{
+		return double( bytes ) / (1024 * 1024);
+	}
+
+	QString usage( const QString & when )
+	{
+		NifPool::Stats st = NifPool::stats();
+		return QString( "  %1 %2 MB in use, %3 MB in slabs, %4 MB resident" ).arg( when, -12 )
+			.arg( mb( st.bytesInUse ), 7, 'f', 1 ).arg( mb( st.slabBytes ), 7, 'f', 1 )
+			.arg( mb( NifTest::residentBytes() ), 7, 'f', 1 );
+	}
+
+	//! Best load, clear and close times of a file
+	struct Times
+	{
+		double load = DBL_MAX;
+		double clear = DBL_MAX;
+		double close = DBL_MAX;
+	};
+
+	/*! Load @p data @p cycles times, clearing the model once and destroying it once per cycle
+	 *
+	 * @return	False if the file could not be loaded or the slabs of a closed file were not released
+	 */
+	bool cycle( const QString & name, const QByteArray & data, int cycles, Times & times )
+	{
+		NifTest::log( QString( "  %1" ).arg( name ) );
+		NifTest::log( usage( "start" ) );
+		for ( int c = 0; c < cycles; c++ ) {
+			qint64 before = NifPool::stats().slabBytes;
+
+			auto nif = std::make_unique<NifModel>();
+			bool loaded = false;
+			times.load = std::min( times.load, NifTest::bestOf( 1, [&]() { loaded = NifTest::load( *nif, data ); } ) );
+			if ( !loaded )
+				return NifTest::fail( QString( "%1 could not be loaded" ).arg( name ) );
+			qint64 peak = NifPool::stats().slabBytes;
+			NifTest::log( usage( QString( "loaded %1" ).arg( c + 1 ) ) );
+
+			times.clear = std::min( times.clear, NifTest::bestOf( 1, [&]() { nif->clear(); } ) );
+			NifTest::log( usage( "cleared" ) );
+
+			NifTest::load( *nif, data );
+			times.close = std::min( times.close, NifTest::bestOf( 1, [&]() { nif.reset(); } ) );
+			qint64 after = NifPool::stats().slabBytes;
+			NifTest::log( usage( "closed" ) );
+
+			// The thread free lists keep a few chunks, and with them a few slabs
+			if ( after - before > ( peak - before ) / 4 )
+				return NifTest::fail( QString( "%1 of %2 MB of slabs were kept after closing %3" )
+					.arg( mb( after - before ), 0, 'f', 1 ).arg( mb( peak - before ), 0, 'f', 1 ).arg( name ) );
+		}
+
+		return true;
+	}
+
+	/*! The given files, or a generated file of @p shapes shapes
+	 *
+	 * @return	Pairs of name and contents, empty if a file could not be read
+	 */
+	QVector<QPair<QString, QByteArray>> inputs( const QStringList & args, int shapes )
+	{
+		QVector<QPair<QString, QByteArray>> list;
+
+		QStringList files = NifTest::files( args );
+		if ( files.isEmpty() ) {
+			NifModel nif;
+			if ( NifTest::generate( nif, NifTest::versions().last(), shapes, 64 ) )
+				list.append( { QString( "generated, %1 shapes" ).arg( shapes ), NifTest::save( nif ) } );
+			return list;
+		}
+
+		for ( const QString & fname : files ) {
+			QFile f( fname );
+			if ( !f.open( QIODevice::ReadOnly ) ) {
+				NifTest::fail( QString( "%1: could not be read" ).arg( fname ) );
+				return {};
+			}
+			list.append( { fname, f.readAll() } );
+		}
+		return list;
+	}
+
+	//! Closing a file returns its slabs
+	bool checkPool( const QStringList & args )
+	{
+		auto list = inputs( args, NifTest::intArg( args, "shapes", 2000 ) );
+		if ( list.isEmpty() )
+			return false;
+
+		for ( const auto & input : list ) {
+			Times times;
+			if ( !cycle( input.first, input.second, 2, times ) )
+				return false;
+		}
+		return true;
+	}
+
+	//! Memory, load, clear and close times over repeated loads of large or given files
+	bool benchPool( const QStringList & args )
+	{
+		auto list = inputs( args, NifTest::intArg( args, "shapes", 20000 ) );
+		if ( list.isEmpty() )
+			return false;
+
+		for ( const auto & input : list ) {
+			Times times;
+			if ( !cycle( input.first, input.second, NifTest::intArg( args, "cycles", 5 ), times ) )
+				return false;
+
+			NifTest::log( QString( "  best of %1: load %2 ms, clear %3 ms, close %4 ms" ).arg( input.first )
+				.arg( times.load, 0, 'f', 1 ).arg( times.clear, 0, 'f', 1 ).arg( times.close, 0, 'f', 1 ) );
+		}
+		return true;
+	}
+}
+
+REGISTER_TEST( "pool", checkPool, "NifPool releases the slabs of a closed file, generated or given" )
+REGISTER_BENCHMARK( "pool-bench", benchPool, "Pool memory and load, clear and close times of the given or a generated file (--shapes, --cycles)" )
@@ -0,0 +1,122 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+
+#include "niftest.h"
+
+#include "model/nifmodel.h"
+
+#include <algorithm>
+#include <functional>
+
+
+//! \file removetest.cpp Block removal checks and benchmark
+
+namespace
+{
+	//! The data blocks of every other shape, and the shapes of every third
+	QVector<qint32> scattered( const NifModel & nif )
+	{
+		QVector<qint32> blocks;
+		for ( int b = 1; b < nif.getBlockCount(); b += 2 ) {
+			int shape = b / 2;
+			if ( shape % 2 == 0 )
+				blocks << b + 1;
+			if ( shape % 3 == 0 )
+				blocks << b;
+		}
+		return blocks;
+	}
+
+	//! Remove @p blocks one by one, highest first, as the spells did before removeNiBlocks
+	void removeEach( NifModel & nif, const QVector<qint32> & blocks )
+	{
+		QVector<qint32> sorted = blocks;
+		std::sort( sorted.begin(), sorted.end(), std::greater<qint32>() );
+		for ( qint32 b : sorted )
+			nif.removeNiBlock( b );
+	}
+
+	/*! Remove the blocks in one pass and one by one, return the times in milliseconds
+	 *
+	 * @return False if the two files differ afterwards
+	 */
+	bool removeBoth( int shapes, double & batchMs, double & eachMs )
+	{
+		NifTest::Version v = NifTest::versions().last();
+		NifModel batch, each;
+		if ( !NifTest::generate( batch, v, shapes, 4 ) || !NifTest::generate( each, v, shapes, 4 ) )
+			return false;
+
+		QVector<qint32> blocks = scattered( batch );
+
+		QElapsedTimer timer;
+		timer.start();
+		batch.removeNiBlocks( blocks );
+		batchMs = timer.nsecsElapsed() / 1e6;
+
+		timer.restart();
+		removeEach( each, blocks );
+		eachMs = timer.nsecsElapsed() / 1e6;
+
+		if ( batch.getBlockCount() != each.getBlockCount() || NifTest::save( batch ) != NifTest::save( each ) )
+			return NifTest::fail( QString( "Removing %1 of %2 blocks in one pass differs from removing them one by one" )
+				.arg( blocks.count() ).arg( shapes * 2 + 1 ) );
+
+		NifTest::log( QString( "  %1 of %2 blocks removed" ).arg( blocks.count() ).arg( shapes * 2 + 1 ) );
+		return true;
+	}
+
+	//! removeNiBlocks leaves the same file as removing the blocks one at a time
+	bool checkRemove( const QStringList & args )
+	{
+		double batchMs, eachMs;
+		return removeBoth( NifTest::intArg( args, "shapes", 300 ), batchMs, eachMs );
+	}
+
+	//! Time of removeNiBlocks against a removeNiBlock loop
+	bool benchRemove( const QStringList & args )
+	{
+		int shapes = NifTest::intArg( args, "shapes", 10000 );
+
+		double batchMs, eachMs;
+		if ( !removeBoth( shapes, batchMs, eachMs ) )
+			return false;
+
+		NifTest::log( QString( "  one pass:     %1 ms" ).arg( batchMs, 0, 'f', 1 ) );
+		NifTest::log( QString( "  one by one:   %1 ms" ).arg( eachMs, 0, 'f', 1 ) );
+		return true;
+	}
+}
+
+REGISTER_TEST( "remove", checkRemove, "Removing blocks in one pass matches removing them one by one" )
+REGISTER_BENCHMARK( "remove-bench", benchRemove, "Remove and renumber 40% of 20000 blocks (--shapes)" )
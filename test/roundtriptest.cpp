@@ -0,0 +1,158 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+
+#include "niftest.h"
+
+#include "model/nifmodel.h"
+
+#include <QFile>
+
+
+//! \file roundtriptest.cpp Byte exact load and save checks
+
+namespace
+{
+	/*! The serial writer gives the bytes of the parallel one, @p parallel
+	 *
+	 * The serial writer takes Block Size from blockSize(), the parallel one from the length
+	 * of each serialized block, so the header entries are compared to blockSize() as well.
+	 * This decodes every pending block of a lazy load.
+	 */
+	bool compareWriters( NifModel & nif, const QString & what, const QByteArray & parallel )
+	{
+		if ( nif.getVersionNumber() >= 0x14020000 ) {
+			QVector<int> sizes = nif.getArray<int>( nif.getHeaderItem(), "Block Size" );
+			for ( int b = 0; b < nif.getBlockCount(); b++ ) {
+				int computed = nif.blockSize( nif.getBlockItem( b ) );
+				if ( sizes.value( b, -1 ) != computed )
+					return NifTest::fail( QString( "%1: block %2 is %3 bytes, blockSize() gives %4" )
+						.arg( what ).arg( b ).arg( sizes.value( b, -1 ) ).arg( computed ) );
+			}
+		}
+
+		nif.setParallelSaving( false );
+		QByteArray serial = NifTest::save( nif );
+		nif.setParallelSaving( true );
+
+		if ( serial != parallel ) {
+			int at = 0;
+			while ( at < serial.size() && at < parallel.size() && serial[at] == parallel[at] )
+				at++;
+			return NifTest::fail( QString( "%1: the serial writer gives %2 bytes, the parallel one %3, first difference at %4" )
+				.arg( what ).arg( serial.size() ).arg( parallel.size() ).arg( at ) );
+		}
+
+		return true;
+	}
+
+	//! Save, load the result and save again; all outputs and the serial writer must agree
+	bool roundtrip( NifModel & nif, const QString & what, QString & digest )
+	{
+		QByteArray first = NifTest::save( nif );
+		if ( first.isEmpty() )
+			return NifTest::fail( QString( "%1: could not be saved" ).arg( what ) );
+
+		// The blocks are serialized on the thread pool, the order they finish in must not matter
+		digest = NifTest::md5( first );
+		for ( int i = 0; i < 3; i++ ) {
+			if ( NifTest::md5( NifTest::save( nif ) ) != digest )
+				return NifTest::fail( QString( "%1: saving twice gave different files" ).arg( what ) );
+		}
+
+		NifModel reloaded;
+		if ( !NifTest::load( reloaded, first ) )
+			return NifTest::fail( QString( "%1: the saved file could not be loaded" ).arg( what ) );
+
+		if ( NifTest::md5( NifTest::save( reloaded ) ) != digest )
+			return NifTest::fail( QString( "%1: the reloaded file saves differently" ).arg( what ) );
+
+		return compareWriters( nif, what, first );
+	}
+
+	/*! Generated models of every supported game, and files given on the command line
+	 *
+	 * A file must save back to the same MD5 digest it was read with, loaded normally
+	 * and, where it has Block Size, lazily.
+	 */
+	bool checkRoundtrip( const QStringList & args )
+	{
+		int shapes = NifTest::intArg( args, "shapes", 200 );
+		bool ok = true;
+
+		for ( const NifTest::Version & v : NifTest::versions() ) {
+			QString what = QString( "%1 %2/%3" ).arg( v.version ).arg( v.userVersion ).arg( v.bsVersion );
+
+			NifModel nif;
+			QString digest;
+			if ( !NifTest::generate( nif, v, shapes, 32 ) || !roundtrip( nif, what, digest ) ) {
+				ok = false;
+				continue;
+			}
+
+			NifTest::log( QString( "  %1 %2 blocks, md5 %3" ).arg( what, -16 ).arg( nif.getBlockCount() ).arg( digest ) );
+		}
+
+		for ( const QString & fname : NifTest::files( args ) ) {
+			QFile file( fname );
+			if ( !file.open( QIODevice::ReadOnly ) ) {
+				ok = NifTest::fail( QString( "%1: could not be opened" ).arg( fname ) );
+				continue;
+			}
+
+			QByteArray data = file.readAll();
+			QString original = NifTest::md5( data );
+
+			for ( bool lazy : { false, true } ) {
+				NifModel nif;
+				nif.setLazyLoading( lazy );
+				QString what = QString( lazy ? "%1 (lazy)" : "%1" ).arg( fname );
+
+				QString digest;
+				if ( !NifTest::load( nif, data ) ) {
+					ok = NifTest::fail( QString( "%1: could not be loaded" ).arg( what ) );
+				} else if ( roundtrip( nif, what, digest ) ) {
+					if ( digest != original )
+						ok = NifTest::fail( QString( "%1: saved as %2, read as %3" ).arg( what, digest, original ) );
+					else
+						NifTest::log( QString( "  %1 md5 %2" ).arg( what ).arg( digest ) );
+				} else {
+					ok = false;
+				}
+			}
+		}
+
+		return ok;
+	}
+}
+
+REGISTER_TEST( "roundtrip", checkRoundtrip, "Load and save keep the MD5 digest and match the serial writer, for every game and for given files" )
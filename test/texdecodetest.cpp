@@ -0,0 +1,256 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+
+#include "niftest.h"
+
+#include "gl/gltexdecode.h"
+
+#include <dxgiformat.h>
+
+#include <QByteArray>
+
+#include <initializer_list>
+#include <random>
+
+
+//! \file texdecodetest.cpp TexDecode checks and benchmark
+
+namespace
+{
+	struct Format
+	{
+		quint32 format;
+		TexDecode::Target target;
+	};
+
+	const Format formats[] = {
+		{ DXGI_FORMAT_BC1_UNORM, TexDecode::RGBA8 },
+		{ DXGI_FORMAT_BC3_UNORM, TexDecode::RGBA8 },
+		{ DXGI_FORMAT_BC5_UNORM, TexDecode::RGBA8 },
+		{ DXGI_FORMAT_BC6H_UF16, TexDecode::RGBA16F },
+		{ DXGI_FORMAT_BC7_UNORM, TexDecode::RGBA8 },
+		{ DXGI_FORMAT_B8G8R8A8_UNORM, TexDecode::RGBA8 },
+	};
+
+	//! Random image data; every bit pattern is a valid block in these formats
+	QByteArray noise( qint64 size )
+	{
+		std::mt19937 rng( 42 );
+		QByteArray data( int( size ), Qt::Uninitialized );
+		for ( char & c : data )
+			c = char( rng() );
+		return data;
+	}
+
+	//! Writes the fields of a compressed block from the least significant bit up
+	class BlockWriter final
+	{
+	public:
+		BlockWriter( int bytes ) : data( bytes, 0 ) {}
+
+		BlockWriter & put( int bits, quint32 value )
+		{
+			for ( int i = 0; i < bits; i++, pos++ ) {
+				if ( (value >> i) & 1 )
+					data[pos / 8] = char( data[pos / 8] | (1 << (pos % 8)) );
+			}
+			return *this;
+		}
+
+		QByteArray data;
+
+	private:
+		int pos = 0;
+	};
+
+	QByteArray bytes( std::initializer_list<int> list )
+	{
+		QByteArray out;
+		for ( int b : list )
+			out.append( char( b ) );
+		return out;
+	}
+
+	/*! A 4 x 4 image and its expected pixels
+	 *
+	 * The values follow from the format specifications. The blocks only use endpoints and
+	 * interpolants that are exact, so they do not depend on the rounding of the decoder.
+	 */
+	struct KnownBlock
+	{
+		const char * name;
+		quint32 format;
+		TexDecode::Target target;
+		QByteArray data;
+		//! RGBA of the first pixels, as 8-bit values or half floats; the other pixels repeat pixel 0
+		QVector<QVector<int>> pixels;
+	};
+
+	QVector<KnownBlock> knownBlocks()
+	{
+		// 565 endpoints red and blue, pixels 0-3 take indices 0-3
+		const QByteArray redBlue = bytes( { 0x00, 0xF8, 0x1F, 0x00, 0xE4, 0x00, 0x00, 0x00 } );
+		// Alpha 252 and 0 with 8 values, pixels 0-3 take indices 0, 1, 2 and 7
+		const QByteArray alpha8 = bytes( { 0xFC, 0x00, 0x88, 0x0E, 0x00, 0x00, 0x00, 0x00 } );
+		// Alpha 0 and 255 with 6 values, pixels 0-5 take indices 0, 1, 2, 5, 6 and 7
+		const QByteArray alpha6 = bytes( { 0x00, 0xFF, 0x88, 0xEA, 0x03, 0x00, 0x00, 0x00 } );
+
+		// BC6H mode 11, 10-bit endpoints (0, 0, 0) and (1023, 0, 512), pixels 1-2 take indices 15 and 8
+		BlockWriter bc6h( 16 );
+		bc6h.put( 5, 0x03 ).put( 30, 0 ).put( 10, 1023 ).put( 10, 0 ).put( 10, 512 ).put( 3, 0 ).put( 4, 15 ).put( 4, 8 );
+
+		// BC7 mode 6, endpoints (0, 0, 0, 0) p 0 and (127, 0, 63, 127) p 1, pixels 1-2 take indices 15 and 8
+		BlockWriter bc7( 16 );
+		bc7.put( 7, 0x40 ).put( 7, 0 ).put( 7, 127 ).put( 7, 0 ).put( 7, 0 ).put( 7, 0 ).put( 7, 63 ).put( 7, 0 ).put( 7, 127 )
+			.put( 1, 0 ).put( 1, 1 ).put( 3, 0 ).put( 4, 15 ).put( 4, 8 );
+
+		return {
+			{ "BC1", DXGI_FORMAT_BC1_UNORM, TexDecode::RGBA8, redBlue,
+				{ { 255, 0, 0, 255 }, { 0, 0, 255, 255 }, { 170, 0, 85, 255 }, { 85, 0, 170, 255 } } },
+			// Endpoints in the other order select 3 colors and transparent black
+			{ "BC1 transparent", DXGI_FORMAT_BC1_UNORM, TexDecode::RGBA8, bytes( { 0x1F, 0x00, 0x00, 0xF8, 0xF4, 0x00, 0x00, 0x00 } ),
+				{ { 0, 0, 255, 255 }, { 255, 0, 0, 255 }, { 0, 0, 0, 0 }, { 0, 0, 0, 0 } } },
+			// 4-bit alpha F, 0, 8 and 1, then F
+			{ "BC2", DXGI_FORMAT_BC2_UNORM, TexDecode::RGBA8, bytes( { 0x0F, 0x18, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF } ) + redBlue,
+				{ { 255, 0, 0, 255 }, { 0, 0, 255, 0 }, { 170, 0, 85, 136 }, { 85, 0, 170, 17 } } },
+			{ "BC3", DXGI_FORMAT_BC3_UNORM, TexDecode::RGBA8, alpha6 + redBlue,
+				{ { 255, 0, 0, 0 }, { 0, 0, 255, 255 }, { 170, 0, 85, 51 }, { 85, 0, 170, 204 }, { 255, 0, 0, 0 }, { 255, 0, 0, 255 } } },
+			{ "BC4", DXGI_FORMAT_BC4_UNORM, TexDecode::RGBA8, alpha8,
+				{ { 252, 0, 0, 255 }, { 0, 0, 0, 255 }, { 216, 0, 0, 255 }, { 36, 0, 0, 255 } } },
+			{ "BC5", DXGI_FORMAT_BC5_UNORM, TexDecode::RGBA8, alpha8 + alpha6,
+				{ { 252, 0, 0, 255 }, { 0, 255, 0, 255 }, { 216, 51, 0, 255 }, { 36, 204, 0, 255 }, { 252, 0, 0, 255 }, { 252, 255, 0, 255 } } },
+			// 1023 unquantizes to 0xFFFF and 512 to 32800, and both are scaled by 31/64
+			{ "BC6H", DXGI_FORMAT_BC6H_UF16, TexDecode::RGBA16F, bc6h.data,
+				{ { 0, 0, 0, 0x3C00 }, { 0x7BFF, 0, 0x3E0F, 0x3C00 }, { 0x41DF, 0, 0x20F8, 0x3C00 } } },
+			{ "BC7", DXGI_FORMAT_BC7_UNORM, TexDecode::RGBA8, bc7.data,
+				{ { 0, 0, 0, 0 }, { 255, 1, 127, 255 }, { 135, 1, 67, 135 } } },
+			{ "BGRA8", DXGI_FORMAT_B8G8R8A8_UNORM, TexDecode::RGBA8, bytes( { 10, 20, 30, 40 } ).repeated( 16 ),
+				{ { 30, 20, 10, 40 } } },
+		};
+	}
+
+	//! Each format decodes the known blocks to the pixels of its specification
+	bool checkKnownAnswers()
+	{
+		for ( const KnownBlock & k : knownBlocks() ) {
+			TexDecode::Image out;
+			if ( !TexDecode::decode( k.format, k.data.constData(), k.data.size(), 4, 4, out, k.target, false ) )
+				return NifTest::fail( QString( "The %1 block could not be decoded" ).arg( k.name ) );
+
+			const quint8 * px = reinterpret_cast<const quint8 *>( out.pixels.constData() );
+			for ( int p = 0; p < 16; p++ ) {
+				const QVector<int> & expected = k.pixels.value( p, k.pixels.first() );
+				for ( int c = 0; c < 4; c++ ) {
+					int value = ( k.target == TexDecode::RGBA8 ) ? px[p * 4 + c] : ( px[p * 8 + c * 2] | (px[p * 8 + c * 2 + 1] << 8) );
+					if ( value != expected[c] )
+						return NifTest::fail( QString( "%1 pixel %2 channel %3 is 0x%4 instead of 0x%5" ).arg( k.name ).arg( p ).arg( c )
+							.arg( value, 0, 16 ).arg( expected[c], 0, 16 ) );
+				}
+			}
+		}
+
+		return true;
+	}
+
+	//! Known blocks decode to their expected pixels, parallel and serial decoding agree, and short data is refused
+	bool checkTexDecode( const QStringList & args )
+	{
+		if ( !checkKnownAnswers() )
+			return false;
+
+		int size = NifTest::intArg( args, "size", 512 );
+
+		for ( const Format & f : formats ) {
+			QString name = TexDecode::formatName( f.format );
+			QByteArray src = noise( TexDecode::levelSize( f.format, size, size ) );
+
+			TexDecode::Image serial, parallel;
+			if ( !TexDecode::decode( f.format, src.constData(), src.size(), size, size, serial, f.target, false )
+				|| !TexDecode::decode( f.format, src.constData(), src.size(), size, size, parallel, f.target, true ) )
+				return NifTest::fail( QString( "%1 could not be decoded" ).arg( name ) );
+
+			if ( serial.pixels != parallel.pixels )
+				return NifTest::fail( QString( "%1 decodes differently on the thread pool" ).arg( name ) );
+
+			TexDecode::Image truncated;
+			if ( TexDecode::decode( f.format, src.constData(), src.size() - 1, size, size, truncated, f.target )
+				|| !truncated.isNull() )
+				return NifTest::fail( QString( "%1 decoded from truncated data" ).arg( name ) );
+		}
+
+		// The size check must not overflow for the largest dimensions a DDS header can hold
+		TexDecode::Image huge;
+		QByteArray small = noise( 1024 );
+		if ( TexDecode::decode( DXGI_FORMAT_B8G8R8A8_UNORM, small.constData(), small.size(), 0x7FFFFFFF, 0x7FFFFFFF, huge, TexDecode::RGBA8 ) )
+			return NifTest::fail( "An image of 2^31 x 2^31 pixels was accepted" );
+
+		NifTest::log( QString( "%1 known blocks, %2 formats at %3 x %3" ).arg( knownBlocks().count() )
+			.arg( int( sizeof( formats ) / sizeof( formats[0] ) ) ).arg( size ) );
+		return true;
+	}
+
+	//! Decoding throughput per format, serial and on the thread pool
+	bool benchTexDecode( const QStringList & args )
+	{
+		int size = NifTest::intArg( args, "size", 2048 );
+		int runs = NifTest::intArg( args, "runs", 5 );
+		double pixels = double( size ) * size;
+
+		NifTest::log( QString( "%1 x %1, best of %2 runs, M pixels/s" ).arg( size ).arg( runs ) );
+		NifTest::log( QString( "  %1 %2 %3" ).arg( "format", -18 ).arg( "serial", 10 ).arg( "parallel", 10 ) );
+
+		for ( const Format & f : formats ) {
+			QByteArray src = noise( TexDecode::levelSize( f.format, size, size ) );
+			TexDecode::Image out;
+			bool ok = true;
+
+			double serialMs = NifTest::bestOf( runs, [&]() {
+				ok &= TexDecode::decode( f.format, src.constData(), src.size(), size, size, out, f.target, false );
+			} );
+			double parallelMs = NifTest::bestOf( runs, [&]() {
+				ok &= TexDecode::decode( f.format, src.constData(), src.size(), size, size, out, f.target, true );
+			} );
+
+			if ( !ok )
+				return NifTest::fail( QString( "%1 could not be decoded" ).arg( TexDecode::formatName( f.format ) ) );
+
+			NifTest::log( QString( "  %1 %2 %3" ).arg( TexDecode::formatName( f.format ), -18 )
+				.arg( pixels / serialMs / 1000.0, 10, 'f', 1 ).arg( pixels / parallelMs / 1000.0, 10, 'f', 1 ) );
+		}
+
+		return true;
+	}
+}
+
+REGISTER_TEST( "texdecode", checkTexDecode, "TexDecode gives the specified pixels for BC1-BC7 and BGRA8, the same on every thread, and refuses short or huge images" )
+REGISTER_BENCHMARK( "texdecode-bench", benchTexDecode, "Decode throughput of BC1-BC7 and BGRA8 (--size, --runs)" )
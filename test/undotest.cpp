@@ -0,0 +1,214 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+
+
+#include "niftest.h"
+
+#include "model/nifmodel.h"
+#include "model/undocommands.h"
+#include "spellbook.h"
+
+#include <QUndoStack>
+
+#include <functional>
+
+
+//! \file undotest.cpp Spell undo and redo checks
+
+namespace
+{
+	using Edit = std::function<void ( NifModel & )>;
+
+	//! The vertices of the first NiTriShapeData, see NifTest::generate
+	QModelIndex firstVertices( NifModel & nif )
+	{
+		return nif.getIndex( nif.getBlockIndex( 2 ), "Vertices" );
+	}
+
+	//! Set a value with the usual signals
+	void setValue( NifModel & nif )
+	{
+		nif.set<QString>( nif.getBlockIndex( 1 ), "Name", "Renamed" );
+	}
+
+	//! Set values in Processing state, without signals, as the spells do
+	void setProcessing( NifModel & nif )
+	{
+		nif.setState( BaseModel::Processing );
+		QModelIndex iVerts = firstVertices( nif );
+		for ( int r = 0; r < nif.rowCount( iVerts ); r++ )
+			nif.set<Vector3>( iVerts.child( r, 0 ), Vector3( float( r ), 1.0f, 2.0f ) );
+		nif.restoreState();
+	}
+
+	//! Reverse a vertex array with BaseModel::reorderArray
+	void reorder( NifModel & nif )
+	{
+		QModelIndex iVerts = firstVertices( nif );
+		QVector<int> order;
+		for ( int r = nif.rowCount( iVerts ) - 1; r >= 0; r-- )
+			order << r;
+		nif.reorderArray( iVerts, order );
+	}
+
+	//! Scale the vertices of every shape with Spell::castParallel
+	void scaleParallel( NifModel & nif )
+	{
+		struct Job
+		{
+			QPersistentModelIndex iData;
+			QVector<Vector3> verts;
+		};
+
+		QList<QPersistentModelIndex> blocks;
+		for ( int b = 0; b < nif.getBlockCount(); b++ ) {
+			QModelIndex iBlock = nif.getBlockIndex( b );
+			if ( nif.isNiBlock( iBlock, "NiTriShapeData" ) )
+				blocks << iBlock;
+		}
+
+		Spell::castParallel<Job>( &nif, blocks,
+			[]( NifModel * nif, const QPersistentModelIndex & iBlock, Job & job ) {
+				job.iData = iBlock;
+				job.verts = nif->getArray<Vector3>( iBlock, "Vertices" );
+				return true;
+			},
+			[]( Job & job ) {
+				for ( Vector3 & v : job.verts )
+					v *= 2.0f;
+			},
+			[]( NifModel * nif, const Job & job ) {
+				nif->setArray<Vector3>( job.iData, "Vertices", job.verts );
+			}
+		);
+	}
+
+	//! Remove the first shape and its data
+	void removeBlocks( NifModel & nif )
+	{
+		nif.removeNiBlocks( { 1, 2 } );
+	}
+
+	//! Append a block
+	void insertBlock( NifModel & nif )
+	{
+		QModelIndex iNode = nif.insertNiBlock( "NiNode" );
+		nif.set<QString>( iNode, "Name", "Inserted" );
+	}
+
+	/*! Record @p edit as a spell, then check that undo and redo give back the saved bytes
+	 *
+	 * Every edit is pushed on the same stack, so undo also has to cope with the commands before it.
+	 */
+	bool checkEdit( NifModel & nif, QUndoStack & stack, const QString & what, const Edit & edit )
+	{
+		QByteArray before = NifTest::save( nif );
+
+		auto cmd = new SpellCommand( what, &nif );
+		edit( nif );
+		if ( !cmd->finish() ) {
+			delete cmd;
+			return NifTest::fail( QString( "%1: no change was recorded" ).arg( what ) );
+		}
+		stack.push( cmd );
+
+		QByteArray after = NifTest::save( nif );
+		if ( after == before )
+			return NifTest::fail( QString( "%1: the file did not change" ).arg( what ) );
+
+		stack.undo();
+		if ( NifTest::save( nif ) != before )
+			return NifTest::fail( QString( "%1: undo does not restore the saved bytes" ).arg( what ) );
+
+		stack.redo();
+		if ( NifTest::save( nif ) != after )
+			return NifTest::fail( QString( "%1: redo does not restore the edited bytes" ).arg( what ) );
+
+		return true;
+	}
+
+	//! Run every edit on @p nif, then undo them all back to @p original
+	bool checkEdits( NifModel & nif, const QByteArray & original, const QString & load )
+	{
+		QUndoStack stack;
+		nif.undoStack = &stack;
+
+		const QVector<QPair<QString, Edit>> edits = {
+			{ "set", setValue },
+			{ "Processing state", setProcessing },
+			{ "reorderArray", reorder },
+			{ "castParallel", scaleParallel },
+			{ "remove blocks", removeBlocks },
+			{ "insert block", insertBlock },
+		};
+
+		bool ok = true;
+		for ( const auto & edit : edits )
+			ok = checkEdit( nif, stack, QString( "%1, %2" ).arg( load, edit.first ), edit.second ) && ok;
+
+		while ( stack.canUndo() )
+			stack.undo();
+		if ( NifTest::save( nif ) != original )
+			ok = NifTest::fail( QString( "%1: undoing every spell does not restore the loaded file" ).arg( load ) );
+
+		nif.undoStack = nullptr;
+		return ok;
+	}
+
+	//! Undo after a spell restores the saved bytes exactly, for eager and lazy loads
+	bool checkUndo( const QStringList & args )
+	{
+		int shapes = NifTest::intArg( args, "shapes", 20 );
+
+		bool ok = true;
+		for ( const NifTest::Version & v : NifTest::versions() ) {
+			NifModel generated;
+			if ( !NifTest::generate( generated, v, shapes, 16 ) )
+				return false;
+			QByteArray data = NifTest::save( generated );
+
+			for ( bool lazy : { false, true } ) {
+				NifModel nif;
+				nif.setLazyLoading( lazy );
+				if ( !NifTest::load( nif, data ) )
+					return NifTest::fail( QString( "%1: failed to load the generated file" ).arg( v.version ) );
+
+				QString load = QString( "%1 %2" ).arg( v.version, lazy ? "lazy" : "eager" );
+				ok = checkEdits( nif, NifTest::save( nif ), load ) && ok;
+			}
+		}
+		return ok;
+	}
+}
+
+REGISTER_TEST( "undo", checkUndo, "Undo and redo of spells restore the saved bytes (--shapes)" )
@@ -0,0 +1,168 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+
+#include "niftest.h"
+
+#include "data/nifitem.h"
+#include "data/nifpool.h"
+#include "model/nifmodel.h"
+
+#include <algorithm>
+#include <iterator>
+
+
+//! \file valuetest.cpp NifValue storage checks and memory measurement
+
+namespace
+{
+	//! The types NifValue keeps in its inline storage
+	const NifValue::Type inlineTypes[] = {
+		NifValue::tVector2, NifValue::tHalfVector2,
+		NifValue::tVector3, NifValue::tHalfVector3, NifValue::tUshortVector3, NifValue::tByteVector3,
+		NifValue::tVector4, NifValue::tQuat, NifValue::tQuatXYZW, NifValue::tTriangle,
+		NifValue::tColor3, NifValue::tColor4, NifValue::tByteColor4, NifValue::tBSVertexDesc,
+	};
+
+	bool isInline( NifValue::Type t )
+	{
+		return std::find( std::begin( inlineTypes ), std::end( inlineTypes ), t ) != std::end( inlineTypes );
+	}
+
+	struct Counts
+	{
+		qint64 items = 0;
+		//! Values of the inline types
+		qint64 inlined = 0;
+		//! Values with a payload on the heap
+		qint64 heap = 0;
+		qint64 heapBytes = 0;
+	};
+
+	void count( const NifItem * item, Counts & counts )
+	{
+		counts.items++;
+		const NifValue & value = item->value();
+		if ( isInline( value.type() ) )
+			counts.inlined++;
+		if ( size_t bytes = value.payloadSize() ) {
+			counts.heap++;
+			counts.heapBytes += qint64( bytes );
+		}
+
+		for ( int c = 0; c < item->childCount(); c++ )
+			count( item->child( c ), counts );
+	}
+
+	inline double mb( qint64 bytes )
+	{
+		return double( bytes ) / (1024 * 1024);
+	}
+
+	//! Measure one loaded model, @p pooled is the growth of the pool while loading it
+	void report( const QString & what, const NifModel & nif, qint64 pooled )
+	{
+		Counts counts;
+		for ( int r = 0; r < nif.rowCount(); r++ )
+			count( static_cast<const NifItem *>( nif.index( r, 0 ).internalPointer() ), counts );
+
+		// Before inline storage, each of those values held a 16 byte pool chunk
+		NifTest::log( QString( "  %1" ).arg( what ) );
+		NifTest::log( QString( "    %1 items, %2 MB pooled, %3 bytes per item" )
+			.arg( counts.items ).arg( mb( pooled ), 0, 'f', 1 )
+			.arg( counts.items ? double( pooled ) / counts.items : 0.0, 0, 'f', 1 ) );
+		NifTest::log( QString( "    %1 inline payloads (%2%), %3 MB of chunks saved" )
+			.arg( counts.inlined ).arg( counts.items ? 100.0 * counts.inlined / counts.items : 0.0, 0, 'f', 1 )
+			.arg( mb( counts.inlined * 16 ), 0, 'f', 1 ) );
+		NifTest::log( QString( "    %1 heap payloads, %2 MB" ).arg( counts.heap ).arg( mb( counts.heapBytes ), 0, 'f', 1 ) );
+	}
+
+	//! Only the large types allocate
+	bool checkValues( const QStringList & )
+	{
+		for ( NifValue::Type t : inlineTypes ) {
+			NifValue value( t );
+			if ( value.payloadSize() != 0 )
+				return NifTest::fail( QString( "Type %1 allocates %2 bytes" ).arg( int( t ) ).arg( value.payloadSize() ) );
+		}
+
+		for ( NifValue::Type t : { NifValue::tMatrix, NifValue::tMatrix4, NifValue::tByteArray } ) {
+			NifValue value( t );
+			if ( value.payloadSize() == 0 )
+				return NifTest::fail( QString( "Type %1 has no heap payload" ).arg( int( t ) ) );
+		}
+
+		NifTest::log( QString( "  sizeof NifValue %1, sizeof NifItem %2" ).arg( sizeof( NifValue ) ).arg( sizeof( NifItem ) ) );
+		return true;
+	}
+
+	//! Memory per value of the given files, or of generated scenes
+	bool benchValues( const QStringList & args )
+	{
+		NifTest::log( QString( "  sizeof NifValue %1, sizeof NifItem %2" ).arg( sizeof( NifValue ) ).arg( sizeof( NifItem ) ) );
+
+		QStringList files = NifTest::files( args );
+		if ( files.isEmpty() ) {
+			for ( const NifTest::Version & v : NifTest::versions() ) {
+				QByteArray data;
+				{
+					NifModel nif;
+					if ( !NifTest::generate( nif, v, 1000, 64 ) )
+						return false;
+					data = NifTest::save( nif );
+				}
+
+				qint64 before = NifPool::stats().bytesInUse;
+				NifModel nif;
+				NifTest::load( nif, data );
+				report( QString( "generated %1 %2/%3" ).arg( v.version ).arg( v.userVersion ).arg( v.bsVersion ),
+					nif, NifPool::stats().bytesInUse - before );
+			}
+			return true;
+		}
+
+		bool ok = true;
+		for ( const QString & fname : files ) {
+			qint64 before = NifPool::stats().bytesInUse;
+			NifModel nif;
+			if ( !nif.loadFromFile( fname ) ) {
+				ok = NifTest::fail( QString( "%1: could not be loaded" ).arg( fname ) );
+				continue;
+			}
+			report( fname, nif, NifPool::stats().bytesInUse - before );
+		}
+		return ok;
+	}
+}
+
+REGISTER_TEST( "values", checkValues, "NifValue keeps vectors, colors and triangles inline" )
+REGISTER_BENCHMARK( "values-bench", benchValues, "Item and payload memory of the given files or of generated scenes" )
@@ -0,0 +1,472 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+
+#include "niftest.h"
+
+#include "lib/bonepacking.h"
+#include "lib/vertexweld.h"
+#include "model/nifmodel.h"
+
+#include <QMultiHash>
+
+#include <cmath>
+#include <limits>
+#include <random>
+
+
+//! \file weldtest.cpp VertexGrid, weldVertices and the bone limit against the pairwise loops they replaced
+
+namespace
+{
+	/*! Random positions on a coarse lattice, so there are exact duplicates and near misses
+	 *
+	 * With @p special, some coordinates are NaN, infinite, negative zero or huge.
+	 */
+	QVector<Vector3> positions( std::mt19937 & rng, int count, bool special )
+	{
+		const float nan = std::numeric_limits<float>::quiet_NaN();
+		const float inf = std::numeric_limits<float>::infinity();
+		const float specials[] = { nan, inf, -inf, -0.0f, 0.0f, 3.0e38f, -3.0e38f, 1.0e-40f };
+
+		std::uniform_int_distribution<int> lattice( -8, 8 );
+		std::uniform_int_distribution<int> pick( 0, 99 );
+		std::uniform_real_distribution<float> jitter( -0.05f, 0.05f );
+
+		QVector<Vector3> result( count );
+		for ( Vector3 & v : result ) {
+			for ( int c = 0; c < 3; c++ ) {
+				int p = pick( rng );
+				if ( special && p < 8 )
+					v[c] = specials[p];
+				else if ( p < 50 )
+					v[c] = lattice( rng ) * 0.25f;
+				else
+					v[c] = lattice( rng ) * 0.25f + jitter( rng );
+			}
+		}
+
+		// Copies of earlier vertices
+		for ( int i = count / 2; i < count && count > 1; i += 3 )
+			result[i] = result[pick( rng ) % (count / 2)];
+
+		return result;
+	}
+
+	bool isFinite( const Vector3 & v )
+	{
+		return std::isfinite( v[0] ) && std::isfinite( v[1] ) && std::isfinite( v[2] );
+	}
+
+	//! The pairwise neighbor search VertexGrid replaced
+	QVector<int> bruteNeighbors( const QVector<Vector3> & verts, int i, float maxSquaredDistance )
+	{
+		QVector<int> out;
+		if ( !isFinite( verts[i] ) )
+			return out;
+
+		for ( int j = 0; j < verts.count(); j++ ) {
+			if ( j != i && isFinite( verts[j] ) && ( verts[i] - verts[j] ).squaredLength() < maxSquaredDistance )
+				out.append( j );
+		}
+		return out;
+	}
+
+	//! The pairwise weld weldVertices replaced: the first earlier group head that matches
+	template <typename Pred> QVector<int> bruteWeld( const QVector<Vector3> & verts, Pred same )
+	{
+		QVector<int> group( verts.count() );
+		for ( int i = 0; i < verts.count(); i++ ) {
+			group[i] = i;
+			for ( int g = 0; g < i; g++ ) {
+				if ( group[g] == g && verts[g] == verts[i] && same( g, i ) ) {
+					group[i] = g;
+					break;
+				}
+			}
+		}
+		return group;
+	}
+
+	//! Random inputs, special values and distances, compared with the pairwise loops
+	bool checkWeld( const QStringList & args )
+	{
+		const float inf = std::numeric_limits<float>::infinity();
+		const float distances[] = { -1.0f, 0.0f, 1.0e-12f, 1.0e-4f, 0.01f, 0.0625f, 0.3f, 1.0f, 16.0f, 1.0e30f, inf,
+			std::numeric_limits<float>::quiet_NaN() };
+
+		int rounds = NifTest::intArg( args, "rounds", 200 );
+		std::mt19937 rng( 7 );
+		std::uniform_int_distribution<int> size( 1, 300 );
+		std::uniform_int_distribution<int> attr( 0, 2 );
+
+		QVector<int> found;
+		for ( int r = 0; r < rounds; r++ ) {
+			QVector<Vector3> verts = positions( rng, size( rng ), r % 2 == 1 );
+
+			for ( float d : distances ) {
+				VertexGrid grid( verts, d );
+				for ( int i = 0; i < verts.count(); i++ ) {
+					grid.neighbors( i, found );
+					if ( found != bruteNeighbors( verts, i, d ) )
+						return NifTest::fail( QString( "Round %1: the neighbors of vertex %2 within %3 differ" ).arg( r ).arg( i ).arg( d ) );
+				}
+			}
+
+			QVector<int> attrs( verts.count() );
+			for ( int & a : attrs )
+				a = attr( rng );
+			auto same = [&attrs]( int a, int b ) { return attrs[a] == attrs[b]; };
+
+			if ( weldVertices( verts, same ) != bruteWeld( verts, same ) )
+				return NifTest::fail( QString( "Round %1: the welded groups differ" ).arg( r ) );
+		}
+
+		NifTest::log( QString( "  %1 random meshes, %2 distances each" ).arg( rounds ).arg( int( sizeof( distances ) / sizeof( float ) ) ) );
+		return true;
+	}
+
+	//! Neighbor search and welding against the pairwise loops
+	bool benchWeld( const QStringList & args )
+	{
+		int count = NifTest::intArg( args, "vertices", 20000 );
+		std::mt19937 rng( 11 );
+		QVector<Vector3> verts = positions( rng, count, false );
+		const float maxSquaredDistance = 1.0e-4f;
+
+		qint64 gridPairs = 0, brutePairs = 0;
+		QVector<int> found;
+		double gridMs = NifTest::bestOf( 1, [&]() {
+			VertexGrid grid( verts, maxSquaredDistance );
+			for ( int i = 0; i < count; i++ ) {
+				grid.neighbors( i, found );
+				gridPairs += found.count();
+			}
+		} );
+		double bruteMs = NifTest::bestOf( 1, [&]() {
+			for ( int i = 0; i < count; i++ )
+				brutePairs += bruteNeighbors( verts, i, maxSquaredDistance ).count();
+		} );
+
+		auto same = []( int, int ) { return true; };
+		QVector<int> welded, bruteWelded;
+		double weldMs = NifTest::bestOf( 1, [&]() { welded = weldVertices( verts, same ); } );
+		double bruteWeldMs = NifTest::bestOf( 1, [&]() { bruteWelded = bruteWeld( verts, same ); } );
+
+		NifTest::log( QString( "  %1 vertices, %2 near pairs" ).arg( count ).arg( gridPairs ) );
+		NifTest::log( QString( "  neighbors: grid %1 ms, pairwise %2 ms" ).arg( gridMs, 0, 'f', 1 ).arg( bruteMs, 0, 'f', 1 ) );
+		NifTest::log( QString( "  weld:      hash %1 ms, pairwise %2 ms" ).arg( weldMs, 0, 'f', 1 ).arg( bruteWeldMs, 0, 'f', 1 ) );
+
+		if ( gridPairs != brutePairs || welded != bruteWelded )
+			return NifTest::fail( "The grid and the pairwise loops disagree" );
+		return true;
+	}
+
+	using BoneWeight = BonePacking::BoneWeight;
+
+	//! A skinned mesh as the Make Skin Partition spell reads it
+	struct SkinnedMesh
+	{
+		QVector<Vector3> verts;
+		QVector<Triangle> triangles;
+		QVector<QList<BoneWeight>> weights;
+	};
+
+	/*! The influence limit of the Make Skin Partition spell before limitTriangleBones
+	 *
+	 * The vertex match is searched pairwise again for every triangle over the limit and
+	 * added to the matches found before.
+	 */
+	int bruteLimitBones( const SkinnedMesh & mesh, QVector<QList<BoneWeight>> & weights, int maxBones )
+	{
+		const QVector<Vector3> & verts = mesh.verts;
+		QMultiHash<int, int> match;
+		QList<int> tribones;
+		int cnt = 0;
+
+		for ( const Triangle & tri : mesh.triangles ) {
+			do {
+				tribones.clear();
+				for ( int c = 0; c < 3; c++ ) {
+					for ( const auto & bw : weights[tri[c]] ) {
+						if ( !tribones.contains( bw.first ) )
+							tribones.append( bw.first );
+					}
+				}
+
+				if ( tribones.count() > maxBones ) {
+					QMap<int, float> sum;
+					QList<int> nono;
+
+					for ( int t = 0; t < 3; t++ ) {
+						if ( weights[tri[t]].count() == 1 )
+							nono.append( weights[tri[t]].first().first );
+
+						for ( const auto & bw : weights[tri[t]] )
+							sum[bw.first] += bw.second;
+					}
+
+					float minWeight = 5.0;
+					int minBone = -1;
+					for ( const auto b : sum.keys() ) {
+						if ( !nono.contains( b ) && sum[b] < minWeight ) {
+							minWeight = sum[b];
+							minBone = b;
+						}
+					}
+
+					if ( minBone < 0 )
+						throw QString( "internal error 0x01" );
+
+					for ( int a = 0; a < verts.count(); a++ ) {
+						match.insert( a, a );
+						for ( int b = a + 1; b < verts.count(); b++ ) {
+							if ( verts[a] == verts[b] && weights[a] == weights[b] ) {
+								match.insert( a, b );
+								match.insert( b, a );
+							}
+						}
+					}
+
+					for ( int t = 0; t < 3; t++ ) {
+						bool rem = false;
+						for ( const auto v : match.values( tri[t] ) ) {
+							QList<BoneWeight> & bws = weights[v];
+							QMutableListIterator<BoneWeight> it( bws );
+							while ( it.hasNext() ) {
+								if ( it.next().first == minBone ) {
+									it.remove();
+									rem = true;
+								}
+							}
+
+							float totalWeight = 0;
+							for ( const auto & bw : bws )
+								totalWeight += bw.second;
+
+							if ( totalWeight == 0 )
+								throw QString( "internal error 0x02" );
+
+							for ( int b = 0; b < bws.count(); b++ )
+								bws[b].second /= totalWeight;
+						}
+
+						if ( rem )
+							cnt++;
+					}
+				}
+			} while ( tribones.count() > maxBones );
+		}
+
+		return cnt;
+	}
+
+	/*! A limb: two tubes along a chain of bones, weighted by the distance to the joints
+	 *
+	 * Both tubes are cut open along a seam whose two columns share positions and weights, as
+	 * a UV seam would. The tubes overlap, and the first has an extra light bone, so vertices at
+	 * the same position only get the same weights once that bone was removed. The weights are
+	 * sixteenths, so that removing the extra bone gives exactly the weights of the other tube.
+	 */
+	SkinnedMesh limb( std::mt19937 & rng, int rings, int sides, int bones )
+	{
+		std::uniform_int_distribution<int> extra( bones, bones + 2 );
+		SkinnedMesh mesh;
+
+		for ( int tube = 0; tube < 2; tube++ ) {
+			int first = mesh.verts.count();
+			for ( int r = 0; r < rings; r++ ) {
+				float along = float( r ) / ( rings - 1 ) * bones;
+
+				QList<int> ids;
+				QList<float> influence;
+				float total = 0;
+				for ( int b = 0; b < bones; b++ ) {
+					float w = std::max( 0.0f, 1.6f - std::fabs( along - b ) );
+					if ( w > 0.05f ) {
+						ids.append( b );
+						influence.append( w );
+						total += w;
+					}
+				}
+
+				QList<int> sixteenths;
+				int sum = 0, heaviest = 0;
+				for ( int i = 0; i < ids.count(); i++ ) {
+					sixteenths.append( std::max( 1, int( influence[i] / total * 16 ) ) );
+					sum += sixteenths[i];
+					if ( sixteenths[i] > sixteenths[heaviest] )
+						heaviest = i;
+				}
+				sixteenths[heaviest] += 16 - sum;
+
+				QList<BoneWeight> ring;
+				for ( int i = 0; i < ids.count(); i++ )
+					ring.append( { ids[i], sixteenths[i] / 16.0f * ( tube == 0 ? 15.0f / 16.0f : 1.0f ) } );
+				if ( tube == 0 )
+					ring.append( { extra( rng ), 1.0f / 16.0f } );
+
+				// sides + 1 columns, the last repeats the first
+				for ( int c = 0; c <= sides; c++ ) {
+					float a = 2.0f * float( PI ) * ( c % sides ) / sides;
+					mesh.verts.append( Vector3( std::cos( a ), std::sin( a ), along ) );
+
+					QList<BoneWeight> w = ring;
+					if ( tube == 1 && c % sides != 0 && c % 3 == 0 && w.count() > 1 )
+						std::swap( w.first().second, w.last().second );
+					mesh.weights.append( w );
+				}
+			}
+
+			for ( int r = 0; r + 1 < rings; r++ ) {
+				for ( int c = 0; c < sides; c++ ) {
+					int a = first + r * ( sides + 1 ) + c, b = a + sides + 1;
+					mesh.triangles.append( Triangle( a, b, a + 1 ) );
+					mesh.triangles.append( Triangle( a + 1, b, b + 1 ) );
+				}
+			}
+		}
+
+		return mesh;
+	}
+
+	//! The skinned NiTriShapes of @p nif, read as the Make Skin Partition spell reads them
+	QVector<SkinnedMesh> skinnedMeshes( const NifModel & nif )
+	{
+		QVector<SkinnedMesh> meshes;
+		for ( int b = 0; b < nif.getBlockCount(); b++ ) {
+			QModelIndex iShape = nif.getBlockIndex( b, "NiTriShape" );
+			QModelIndex iData = nif.getBlockIndex( nif.getLink( iShape, "Data" ), "NiTriShapeData" );
+			QModelIndex iSkinInst = nif.getBlockIndex( nif.getLink( iShape, "Skin Instance" ), "NiSkinInstance" );
+			QModelIndex iSkinData = nif.getBlockIndex( nif.getLink( iSkinInst, "Data" ), "NiSkinData" );
+			if ( !iData.isValid() || !iSkinData.isValid() )
+				continue;
+
+			SkinnedMesh mesh;
+			mesh.verts = nif.getArray<Vector3>( iData, "Vertices" );
+			mesh.triangles = nif.getArray<Triangle>( iData, "Triangles" );
+			mesh.weights.resize( mesh.verts.count() );
+
+			QModelIndex iBoneList = nif.getIndex( iSkinData, "Bone List" );
+			for ( int bone = 0; bone < nif.rowCount( iBoneList ); bone++ ) {
+				QModelIndex iVertexWeights = nif.getIndex( iBoneList.child( bone, 0 ), "Vertex Weights" );
+				for ( int r = 0; r < nif.rowCount( iVertexWeights ); r++ ) {
+					int vertex = nif.get<int>( iVertexWeights.child( r, 0 ), "Index" );
+					if ( vertex < mesh.weights.count() )
+						mesh.weights[vertex].append( { bone, nif.get<float>( iVertexWeights.child( r, 0 ), "Weight" ) } );
+				}
+			}
+
+			bool valid = true;
+			for ( const Triangle & t : mesh.triangles )
+				valid = valid && t[0] < mesh.verts.count() && t[1] < mesh.verts.count() && t[2] < mesh.verts.count();
+			for ( const auto & w : mesh.weights )
+				valid = valid && !w.isEmpty();
+			if ( valid )
+				meshes.append( mesh );
+		}
+		return meshes;
+	}
+
+	/*! limitTriangleBones against bruteLimitBones
+	 *
+	 * The old loop visited a vertex once for every search it matched in, renormalizing its
+	 * weights again each time, so the weights are compared with a tolerance.
+	 */
+	bool compareLimit( const SkinnedMesh & mesh, int maxBones, const QString & what, int & removed )
+	{
+		QVector<QList<BoneWeight>> limited = mesh.weights, brute = mesh.weights;
+		int count, bruteCount;
+		try {
+			count = BonePacking::limitTriangleBones( mesh.verts, mesh.triangles, limited, maxBones );
+			bruteCount = bruteLimitBones( mesh, brute, maxBones );
+		} catch ( const QString & e ) {
+			return NifTest::fail( QString( "%1, %2 bones: %3" ).arg( what ).arg( maxBones ).arg( e ) );
+		}
+
+		if ( count != bruteCount )
+			return NifTest::fail( QString( "%1, %2 bones: %3 influences removed, the old loop removed %4" )
+				.arg( what ).arg( maxBones ).arg( count ).arg( bruteCount ) );
+
+		for ( int v = 0; v < limited.count(); v++ ) {
+			bool same = limited[v].count() == brute[v].count();
+			for ( int i = 0; same && i < limited[v].count(); i++ ) {
+				same = limited[v][i].first == brute[v][i].first
+					&& std::fabs( limited[v][i].second - brute[v][i].second ) <= 1.0e-5f;
+			}
+			if ( !same )
+				return NifTest::fail( QString( "%1, %2 bones: the weights of vertex %3 differ from the old loop" )
+					.arg( what ).arg( maxBones ).arg( v ) );
+		}
+
+		removed += count;
+		return true;
+	}
+
+	//! The Make Skin Partition influence limit removes what the old pairwise loop did
+	bool checkBoneLimit( const QStringList & args )
+	{
+		QVector<QPair<QString, SkinnedMesh>> meshes;
+
+		QStringList files = NifTest::files( args );
+		for ( const QString & fname : files ) {
+			NifModel nif;
+			if ( !nif.loadFromFile( fname ) )
+				return NifTest::fail( QString( "Failed to load %1" ).arg( fname ) );
+
+			QVector<SkinnedMesh> found = skinnedMeshes( nif );
+			for ( int m = 0; m < found.count(); m++ )
+				meshes.append( { QString( "%1 mesh %2" ).arg( fname ).arg( m ), found[m] } );
+		}
+
+		if ( files.isEmpty() ) {
+			std::mt19937 rng( 5 );
+			for ( int i = 0; i < 6; i++ )
+				meshes.append( { QString( "limb %1" ).arg( i ), limb( rng, 8 + i * 4, 6 + i * 2, 3 + i ) } );
+		}
+
+		int removed = 0;
+		for ( const auto & m : meshes ) {
+			for ( int maxBones = 2; maxBones <= 6; maxBones++ ) {
+				if ( !compareLimit( m.second, maxBones, m.first, removed ) )
+					return false;
+			}
+		}
+
+		NifTest::log( QString( "  %1 meshes, %2 influences removed in all" ).arg( meshes.count() ).arg( removed ) );
+		return true;
+	}
+}
+
+REGISTER_TEST( "weld", checkWeld, "VertexGrid and weldVertices match the pairwise loops, NaN and infinities included" )
+REGISTER_BENCHMARK( "weld-bench", benchWeld, "Neighbor search and welding against the pairwise loops (--vertices)" )
+REGISTER_TEST( "bone-limit", checkBoneLimit, "The skin partition influence limit matches the old pairwise loop (files...)" )